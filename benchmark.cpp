@@ -0,0 +1,5559 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    benchmark.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Benchmark entry point
+
+GENERAL DESCRIPTION:
+    This is a harness to measure the cost of the different ways
+    of talking to the honeywell 6130 sensors.  Each benchmark is
+    picked by name on the command line.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    main
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    The syscalls benchmark needs real sensors on the i2c bus,
+    unless the device is given as "sim"
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "honeywell6130bus.h"
+#include "simulatedi2c.h"
+#include "framedecoder.h"
+#include "humidiconsensor.h"
+#include "samplehistory.h"
+#include "samplequeue.h"
+#include "sensorfleet.h"
+#include "pollscheduler.h"
+#include "sensorstats.h"
+#include "uringacquisition.h"
+#include "sensorexecutor.h"
+#include "sharedpublisher.h"
+#include "queryserver.h"
+#include "samplelog.h"
+#include "samplesink.h"
+#include "windowaggregator.h"
+#include "deadbandfilter.h"
+#include "sensordiscovery.h"
+#include "samplereplay.h"
+#include "psychrometrics.h"
+#include "sensorfilterbank.h"
+#include "samplecollector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// One named benchmark
+struct Benchmark
+{
+    const char* name;
+    const char* usage;
+    int ( *run )( int argc, char* argv[] );
+};
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+static const unsigned int SETTLE_MICROSECONDS = 1000;
+
+static const unsigned int STALE_RETRIES = 3;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static int benchSyscalls( int argc, char* argv[] );
+
+static int benchSimulator( int argc, char* argv[] );
+
+static int benchDecode( int argc, char* argv[] );
+
+static int benchTables( int argc, char* argv[] );
+
+static int benchHistory( int argc, char* argv[] );
+
+static int benchQueue( int argc, char* argv[] );
+
+static bool queueThroughput( int producers, int consumers, unsigned long long items );
+
+static void queueStall( SampleQueue< FleetSample >::OverflowPolicy policy, const char* name, unsigned long long items );
+
+static int benchScheduler( int argc, char* argv[] );
+
+static void busyMicroseconds( double microseconds );
+
+static int benchStats( int argc, char* argv[] );
+
+static int benchErrors( int argc, char* argv[] );
+
+static int benchUring( int argc, char* argv[] );
+
+static void standInResponder( std::vector< int > peers );
+
+static int benchCoroutines( int argc, char* argv[] );
+
+static SensorTask< void > whenAllRounds( SensorExecutor& executor,
+                                         std::vector< Honeywell6130Sensor* > sensors,
+                                         int rounds,
+                                         unsigned long long* fresh );
+
+static SensorTask< void > readAsyncLoop( SensorExecutor& executor,
+                                         Honeywell6130Sensor* sensor,
+                                         int rounds,
+                                         unsigned long long* fresh );
+
+template< class Sensor >
+static bool timeVariant( const char* name,
+                         const std::vector< unsigned char >& raw,
+                         const std::vector< TempHumidityData >& expected );
+
+static int benchShm( int argc, char* argv[] );
+
+static void shmReaders( const char* name, int readers, double seconds, const char* label );
+
+static TempHumidityData consistentReading( long long n );
+
+static int benchServer( int argc, char* argv[] );
+
+static void serverLoad( const char* label,
+                        const char* unixPath,
+                        int tcpPort,
+                        int connections,
+                        double seconds,
+                        int mixed,
+                        const char* range );
+
+static int connectClient( const char* unixPath, int tcpPort );
+
+static bool answerComplete( const char* answer, size_t length );
+
+static int benchLog( int argc, char* argv[] );
+
+static void removeLog( const char* directory );
+
+static int benchSinks( int argc, char* argv[] );
+
+static int benchWindows( int argc, char* argv[] );
+
+static int benchDeadband( int argc, char* argv[] );
+
+static int benchDiscover( int argc, char* argv[] );
+
+static int benchReplay( int argc, char* argv[] );
+
+static int benchPsychrometrics( int argc, char* argv[] );
+
+static int benchFilters( int argc, char* argv[] );
+
+static int benchFootprint( int argc, char* argv[] );
+
+static unsigned long long loadedBytes( const char* path );
+
+static bool runToFirstSample( const char* binary, double& seconds, long& peakKilobytes, long& heapKilobytes );
+
+static int benchCollect( int argc, char* argv[] );
+
+static bool collectRun( const char* label,
+                        int producers,
+                        int rate,
+                        double seconds,
+                        long long windowMicroseconds,
+                        bool stalls,
+                        int floods );
+
+static int collectProducer( const char* unixPath,
+                            int tcpPort,
+                            int index,
+                            int go,
+                            double seconds,
+                            int rate,
+                            bool flood,
+                            long long stallMicroseconds,
+                            unsigned long long& sent );
+
+static double cpuMicroseconds();
+
+static double wallSeconds();
+
+static void report( const char* mode,
+                    unsigned long long setupSyscalls,
+                    unsigned long long syscalls,
+                    unsigned long long samples,
+                    double cpu );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//----------------------------------------------------------------------
+// Benchmark Table
+//----------------------------------------------------------------------
+
+static const Benchmark benchmarks[] =
+{
+    { "syscalls",  "syscalls <i2c device | sim> <address> [address...]", benchSyscalls },
+    { "simulator", "simulator [frames]", benchSimulator },
+    { "decode",    "decode [frames]", benchDecode },
+    { "tables",    "tables [frames]", benchTables },
+    { "history",   "history [samples]", benchHistory },
+    { "queue",     "queue [items]", benchQueue },
+    { "scheduler", "scheduler [seconds]", benchScheduler },
+    { "stats",     "stats [reads]", benchStats },
+    { "errors",    "errors [reads] [nack ppm]", benchErrors },
+    { "uring",     "uring [sensors] [rounds]", benchUring },
+    { "coroutines", "coroutines [sensors] [rounds]", benchCoroutines },
+    { "shm",        "shm [seconds] [readers]", benchShm },
+    { "server",     "server [connections] [seconds] [shards]", benchServer },
+    { "log",        "log [records]", benchLog },
+    { "sinks",      "sinks [records]", benchSinks },
+    { "windows",    "windows [updates] [sensors]", benchWindows },
+    { "deadband",   "deadband [hours] [sensors]", benchDeadband },
+    { "discover",   "discover [buses] [sensors per bus]", benchDiscover },
+    { "replay",     "replay [records] [sensors]", benchReplay },
+    { "psychrometrics", "psychrometrics [readings]", benchPsychrometrics },
+    { "filters",    "filters [sensors] [rounds]", benchFilters },
+    { "footprint",  "footprint [runs] [binary...]", benchFootprint },
+    { "collect",    "collect [producers] [readings/sec each] [seconds] [window ms]", benchCollect },
+};
+
+static const size_t BENCHMARK_COUNT = sizeof( benchmarks ) / sizeof( benchmarks[ 0 ] );
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    main()
+
+DESCRIPTION:
+    Program entrypoint.  The first argument names the benchmark,
+    the rest are handed to it.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int main( int argc, char* argv[] )
+{
+    if ( 2 <= argc )
+    {
+        for ( size_t b = 0; b < BENCHMARK_COUNT; ++b )
+        {
+            if ( 0 == strcmp( argv[ 1 ], benchmarks[ b ].name ) )
+            {
+                return benchmarks[ b ].run( argc - 2, argv + 2 );
+            }
+        }
+    }
+
+    printf( "usage:\n" );
+
+    for ( size_t b = 0; b < BENCHMARK_COUNT; ++b )
+    {
+        printf( "    %s %s\n", argv[ 0 ], benchmarks[ b ].usage );
+    }
+
+    return 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchSyscalls()
+
+DESCRIPTION:
+    Polls the same sensors a number of rounds with one object per
+    sensor (write()/read() per sample) and then with one bus object,
+    first an I2C_RDWR per message and then combined (an I2C_RDWR per
+    bus), and prints the system calls and cpu time each one spent per
+    sample
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchSyscalls( int argc, char* argv[] )
+{
+    const int ROUNDS = 100;
+
+    if ( argc < 2 )
+    {
+        printf( "expected an i2c device and at least one address\n" );
+        return 1;
+    }
+
+    const char* device = argv[ 0 ];
+
+    const bool simulate = ( 0 == strcmp( device, "sim" ) );
+
+    std::vector< int > addresses;
+
+    SimulatedI2cBus simulatedBus;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        addresses.push_back( ( int ) strtol( argv[ i ], 0, 0 ) );
+
+        if ( simulate )
+        {
+            simulatedBus.AddDevice( addresses.back() );
+        }
+    }
+
+    std::vector< I2cTransport* > transports;
+
+    try
+    {
+        // One object per sensor, like the ws harness
+        std::vector< Honeywell6130Sensor* > sensors;
+
+        for ( size_t s = 0; s < addresses.size(); ++s )
+        {
+            if ( simulate )
+            {
+                transports.push_back( new SimulatedTransport( simulatedBus ) );
+                sensors.push_back( new Honeywell6130Sensor( transports.back(), addresses[ s ] ) );
+            }
+            else
+            {
+                sensors.push_back( new Honeywell6130Sensor( device, addresses[ s ] ) );
+            }
+        }
+
+        unsigned long long setup = 0;
+
+        for ( size_t s = 0; s < sensors.size(); ++s )
+        {
+            setup += sensors[ s ]->SyscallCount();
+        }
+
+        unsigned long long samples = 0;
+
+        double cpu = cpuMicroseconds();
+
+        for ( int round = 0; round < ROUNDS; ++round )
+        {
+            for ( size_t s = 0; s < sensors.size(); ++s )
+            {
+                sensors[ s ]->TriggerMeasurement();
+            }
+
+            std::vector< size_t > waiting;
+
+            for ( size_t s = 0; s < sensors.size(); ++s )
+            {
+                waiting.push_back( s );
+            }
+
+            for ( unsigned int attempt = 0; !waiting.empty() && attempt <= STALE_RETRIES; ++attempt )
+            {
+                usleep( SETTLE_MICROSECONDS );
+
+                size_t stillWaiting = 0;
+
+                for ( size_t w = 0; w < waiting.size(); ++w )
+                {
+                    TempHumidityData data;
+
+                    if ( sensors[ waiting[ w ] ]->TryFetch( data ) )
+                    {
+                        ++samples;
+                    }
+                    else
+                    {
+                        waiting[ stillWaiting++ ] = waiting[ w ];
+                    }
+                }
+
+                waiting.resize( stillWaiting );
+            }
+        }
+
+        cpu = cpuMicroseconds() - cpu;
+
+        unsigned long long total = 0;
+
+        for ( size_t s = 0; s < sensors.size(); ++s )
+        {
+            total += sensors[ s ]->SyscallCount();
+            delete sensors[ s ];
+        }
+
+        report( "per-sensor", setup, total - setup, samples, cpu );
+
+        // One bus object for the whole bus, a message per I2C_RDWR
+        // and then the whole round combined
+        for ( int combined = 0; combined < 2; ++combined )
+        {
+            SimulatedTransport busTransport( simulatedBus );
+
+            Honeywell6130Bus* busPointer = simulate ? new Honeywell6130Bus( &busTransport, addresses )
+                                                    : new Honeywell6130Bus( device, addresses );
+
+            Honeywell6130Bus& bus = *busPointer;
+
+            bus.SetCombined( 0 != combined );
+
+            std::vector< TempHumidityData > data( addresses.size() );
+            std::vector< size_t > pending;
+            std::vector< size_t > fresh;
+
+            setup = bus.SyscallCount();
+            samples = 0;
+
+            cpu = cpuMicroseconds();
+
+            for ( int round = 0; round < ROUNDS; ++round )
+            {
+                bus.TriggerAll( pending );
+
+                for ( unsigned int attempt = 0; !pending.empty() && attempt <= STALE_RETRIES; ++attempt )
+                {
+                    usleep( SETTLE_MICROSECONDS );
+
+                    samples += bus.Fetch( pending, &data[ 0 ], fresh );
+                }
+            }
+
+            cpu = cpuMicroseconds() - cpu;
+
+            report( combined ? "combined" : "batched", setup, bus.SyscallCount() - setup, samples, cpu );
+
+            delete busPointer;
+        }
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+        return 1;
+    }
+
+    for ( size_t t = 0; t < transports.size(); ++t )
+    {
+        delete transports[ t ];
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchSimulator()
+
+DESCRIPTION:
+    Pushes frames from simulated sensors through the sensor classes
+    as fast as they will go, with no conversion latency.  This is
+    the ceiling for everything above the bus.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchSimulator( int argc, char* argv[] )
+{
+    const unsigned long long frames = ( 0 < argc ) ? strtoull( argv[ 0 ], 0, 0 ) : 5000000ULL;
+
+    const int BUS_SENSORS = 42;
+
+    SimulatedI2cBus simulatedBus;
+
+    std::vector< int > addresses;
+
+    for ( int a = 0; a < BUS_SENSORS; ++a )
+    {
+        addresses.push_back( 0x10 + a );
+        simulatedBus.AddDevice( addresses.back() );
+    }
+
+    SimulatedTransport sensorTransport( simulatedBus );
+    SimulatedTransport busTransport( simulatedBus );
+
+    Honeywell6130Sensor sensor( &sensorTransport, addresses[ 0 ] );
+
+    Honeywell6130Bus bus( &busTransport, addresses );
+
+    // Keep the compiler from throwing the decode away
+    double checksum = 0;
+
+    unsigned long long fresh = 0;
+
+    double start = wallSeconds();
+
+    for ( unsigned long long f = 0; f < frames; ++f )
+    {
+        TempHumidityData data;
+
+        sensor.TriggerMeasurement();
+
+        if ( sensor.TryFetch( data ) )
+        {
+            ++fresh;
+            checksum += data.tempCelcius;
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-12s frames: %10llu  fresh: %10llu  frames/sec: %12.0f\n",
+            "per-sensor", frames, fresh, frames / elapsed );
+
+    std::vector< TempHumidityData > data( addresses.size() );
+    std::vector< size_t > pending;
+    std::vector< size_t > freshList;
+
+    fresh = 0;
+
+    start = wallSeconds();
+
+    for ( unsigned long long f = 0; f < frames; f += BUS_SENSORS )
+    {
+        bus.TriggerAll( pending );
+
+        fresh += bus.Fetch( pending, &data[ 0 ], freshList );
+
+        checksum += data[ 0 ].relativeHumidity;
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s frames: %10llu  fresh: %10llu  frames/sec: %12.0f\n",
+            "batched", fresh, fresh, fresh / elapsed );
+
+    return ( checksum != checksum ) ? 1 : 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchDecode()
+
+DESCRIPTION:
+    Decodes a buffer of random frames three ways: one Decode() call
+    per frame into TempHumidityData, the scalar batch decoder, and
+    the SIMD batch decoder.  Checks that the batch results match
+    bit for bit and prints frames/sec for each.
+
+RETURN VALUE:
+    int - 0 on success, 1 if the results do not match
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchDecode( int argc, char* argv[] )
+{
+    const size_t frames = ( 0 < argc ) ? ( size_t ) strtoull( argv[ 0 ], 0, 0 ) : 10000000;
+
+    const int PASSES = 5;
+
+    std::vector< unsigned char > raw( frames * Honeywell6130Sensor::FRAME_SIZE );
+
+    unsigned int random = 12345;
+
+    for ( size_t b = 0; b < raw.size(); ++b )
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        raw[ b ] = ( unsigned char ) random;
+    }
+
+    std::vector< TempHumidityData > aos( frames );
+
+    std::vector< unsigned char > status[ 2 ];
+    std::vector< float > celcius[ 2 ];
+    std::vector< float > fahrenheit[ 2 ];
+    std::vector< float > humidity[ 2 ];
+
+    for ( int v = 0; v < 2; ++v )
+    {
+        status[ v ].resize( frames );
+        celcius[ v ].resize( frames );
+        fahrenheit[ v ].resize( frames );
+        humidity[ v ].resize( frames );
+    }
+
+    double start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        for ( size_t f = 0; f < frames; ++f )
+        {
+            Honeywell6130Sensor::Decode( &raw[ f * Honeywell6130Sensor::FRAME_SIZE ], aos[ f ] );
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-12s frames/sec: %12.0f\n", "Decode()", frames * PASSES / elapsed );
+
+    start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        DecodeFramesScalar( &raw[ 0 ], frames, &status[ 0 ][ 0 ], &celcius[ 0 ][ 0 ],
+                            &fahrenheit[ 0 ][ 0 ], &humidity[ 0 ][ 0 ] );
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s frames/sec: %12.0f\n", "scalar", frames * PASSES / elapsed );
+
+    start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        DecodeFrames( &raw[ 0 ], frames, &status[ 1 ][ 0 ], &celcius[ 1 ][ 0 ],
+                      &fahrenheit[ 1 ][ 0 ], &humidity[ 1 ][ 0 ] );
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s frames/sec: %12.0f\n", DecodeFramesImplementation(), frames * PASSES / elapsed );
+
+    bool same = 0 == memcmp( &status[ 0 ][ 0 ], &status[ 1 ][ 0 ], frames ) &&
+                0 == memcmp( &celcius[ 0 ][ 0 ], &celcius[ 1 ][ 0 ], frames * sizeof( float ) ) &&
+                0 == memcmp( &fahrenheit[ 0 ][ 0 ], &fahrenheit[ 1 ][ 0 ], frames * sizeof( float ) ) &&
+                0 == memcmp( &humidity[ 0 ][ 0 ], &humidity[ 1 ][ 0 ], frames * sizeof( float ) );
+
+    printf( "bit identical: %s\n", same ? "yes" : "NO" );
+
+    return same ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchTables()
+
+DESCRIPTION:
+    Decodes a buffer of random frames with Honeywell6130Sensor::Decode()
+    and with each HumidIconSensor variant under both conversion
+    policies.  Checks every result against Decode() bit for bit and
+    prints frames/sec for each.
+
+RETURN VALUE:
+    int - 0 on success, 1 if any result does not match
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchTables( int argc, char* argv[] )
+{
+    const size_t frames = ( 0 < argc ) ? ( size_t ) strtoull( argv[ 0 ], 0, 0 ) : 10000000;
+
+    std::vector< unsigned char > raw( frames * Honeywell6130Sensor::FRAME_SIZE );
+
+    unsigned int random = 12345;
+
+    for ( size_t b = 0; b < raw.size(); ++b )
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        raw[ b ] = ( unsigned char ) random;
+    }
+
+    std::vector< TempHumidityData > expected( frames );
+
+    double start = wallSeconds();
+
+    for ( size_t f = 0; f < frames; ++f )
+    {
+        Honeywell6130Sensor::Decode( &raw[ f * Honeywell6130Sensor::FRAME_SIZE ], expected[ f ] );
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-28s frames/sec: %12.0f\n", "Decode()", frames / elapsed );
+
+    bool same = true;
+
+    same &= timeVariant< HumidIconSensor< Hih6130, ArithmeticConversion > >( "hih6130 arithmetic", raw, expected );
+    same &= timeVariant< HumidIconSensor< Hih6130, TableConversion > >( "hih6130 tables", raw, expected );
+    same &= timeVariant< HumidIconSensor< Hih6131, TableConversion > >( "hih6131 tables", raw, expected );
+    same &= timeVariant< HumidIconSensor< Hih8000, TableConversion > >( "hih8000 tables", raw, expected );
+
+    printf( "bit identical: %s\n", same ? "yes" : "NO" );
+
+    return same ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    timeVariant()
+
+DESCRIPTION:
+    Decodes raw with Sensor::Decode(), prints frames/sec and
+    compares the results against expected
+
+RETURN VALUE:
+    bool - true if every frame matched
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Sensor >
+static bool timeVariant( const char* name,
+                         const std::vector< unsigned char >& raw,
+                         const std::vector< TempHumidityData >& expected )
+{
+    const size_t frames = expected.size();
+
+    std::vector< TempHumidityData > data( frames );
+
+    double start = wallSeconds();
+
+    for ( size_t f = 0; f < frames; ++f )
+    {
+        Sensor::Decode( &raw[ f * Honeywell6130Sensor::FRAME_SIZE ], data[ f ] );
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-28s frames/sec: %12.0f\n", name, frames / elapsed );
+
+    for ( size_t f = 0; f < frames; ++f )
+    {
+        if ( data[ f ].status != expected[ f ].status ||
+             0 != memcmp( &data[ f ].tempCelcius, &expected[ f ].tempCelcius, sizeof( float ) ) ||
+             0 != memcmp( &data[ f ].tempFahrenheit, &expected[ f ].tempFahrenheit, sizeof( float ) ) ||
+             0 != memcmp( &data[ f ].relativeHumidity, &expected[ f ].relativeHumidity, sizeof( float ) ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    benchHistory()
+
+DESCRIPTION:
+    Fills a SampleHistory and a std::vector< TempHumidityData > of
+    the same capacity with a day's worth (by default) of one second
+    samples, with an occasional long dropout to force keyframes.
+    Checks that the history gives back exactly the frames and
+    (tick rounded) times that went in, then prints the memory each
+    one takes and how fast each one can be walked.
+
+RETURN VALUE:
+    int - 0 on success, 1 if the history lost something
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchHistory( int argc, char* argv[] )
+{
+    const size_t samples = ( 0 < argc ) ? ( size_t ) strtoull( argv[ 0 ], 0, 0 ) : 86400 * 4;
+
+    const size_t capacity = samples / 2 ? samples / 2 : 1;
+
+    const int PASSES = 20;
+
+    SampleHistory history( capacity );
+
+    std::vector< TempHumidityData > flat;
+
+    flat.reserve( capacity );
+
+    // What should still be in the history after the ring wraps
+    std::vector< unsigned char > keptFrames;
+    std::vector< long long > keptTimes;
+
+    unsigned int random = 12345;
+
+    long long now = 0;
+
+    for ( size_t n = 0; n < samples; ++n )
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        // One second apart with some jitter, and a ten minute
+        // dropout now and then
+        now += 1000000 + ( random % 20000 );
+
+        if ( 0 == n % 5000 )
+        {
+            now += 600000000LL;
+        }
+
+        unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+        frame[ 0 ] = ( unsigned char ) ( random & 0x3f );
+        frame[ 1 ] = ( unsigned char ) ( random >> 8 );
+        frame[ 2 ] = ( unsigned char ) ( random >> 16 );
+        frame[ 3 ] = ( unsigned char ) ( ( random >> 24 ) & 0xfc );
+
+        history.Append( frame, now );
+
+        TempHumidityData data;
+
+        Honeywell6130Sensor::Decode( frame, data );
+
+        // Same ring, one decoded sample per slot
+        if ( flat.size() < capacity )
+        {
+            flat.push_back( data );
+        }
+        else
+        {
+            flat[ n % capacity ] = data;
+        }
+
+        if ( n >= samples - capacity )
+        {
+            keptFrames.insert( keptFrames.end(), frame, frame + Honeywell6130Sensor::FRAME_SIZE );
+            keptTimes.push_back( now / history.TickMicroseconds() * history.TickMicroseconds() );
+        }
+    }
+
+    bool same = history.Size() == keptTimes.size();
+
+    size_t k = 0;
+
+    for ( SampleHistory::const_iterator it = history.begin(); same && it != history.end(); ++it, ++k )
+    {
+        unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+        ( *it ).Frame( frame );
+
+        same = 0 == memcmp( frame, &keptFrames[ k * Honeywell6130Sensor::FRAME_SIZE ], sizeof( frame ) ) &&
+               ( *it ).TimeMicroseconds() == keptTimes[ k ];
+    }
+
+    size_t flatBytes = capacity * sizeof( TempHumidityData );
+
+    printf( "%-24s bytes: %10zu  bytes/sample: %5.2f\n",
+            "vector<TempHumidityData>", flatBytes, ( double ) flatBytes / capacity );
+
+    printf( "%-24s bytes: %10zu  bytes/sample: %5.2f  keyframes: %zu  (%.2fx the history)\n",
+            "SampleHistory", history.FootprintBytes(), ( double ) history.FootprintBytes() / capacity,
+            history.KeyframeCount(), ( double ) flatBytes / history.FootprintBytes() );
+
+    // Keep the compiler from throwing the loops away
+    double checksum[ 3 ] = { 0, 0, 0 };
+
+    double start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        for ( size_t f = 0; f < flat.size(); ++f )
+        {
+            checksum[ 0 ] += flat[ f ].tempCelcius;
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-24s samples/sec: %12.0f  (Celcius only)\n", "vector<TempHumidityData>", flat.size() * PASSES / elapsed );
+
+    start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        for ( SampleHistory::const_iterator it = history.begin(); it != history.end(); ++it )
+        {
+            checksum[ 1 ] += ( *it ).Celcius();
+        }
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-24s samples/sec: %12.0f  (Celcius only)\n", "SampleHistory", history.Size() * PASSES / elapsed );
+
+    start = wallSeconds();
+
+    for ( int pass = 0; pass < PASSES; ++pass )
+    {
+        for ( SampleHistory::const_iterator it = history.begin(); it != history.end(); ++it )
+        {
+            TempHumidityData data = ( *it ).Data();
+
+            checksum[ 2 ] += data.tempFahrenheit + data.relativeHumidity + ( *it ).TimeMicroseconds();
+        }
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-24s samples/sec: %12.0f  (full decode and time)\n", "SampleHistory", history.Size() * PASSES / elapsed );
+
+    SampleHistory::Range lastHour = history.Between( keptTimes.back() - 3600000000LL, keptTimes.back() );
+
+    size_t inRange = 0;
+
+    for ( SampleHistory::const_iterator it = lastHour.begin(); it != lastHour.end(); ++it )
+    {
+        ++inRange;
+    }
+
+    printf( "samples in the last hour: %zu\n", inRange );
+
+    printf( "round trip exact: %s\n", same ? "yes" : "NO" );
+
+    return ( same && checksum[ 0 ] == checksum[ 0 ] && checksum[ 1 ] == checksum[ 1 ] && checksum[ 2 ] == checksum[ 2 ] ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchQueue()
+
+DESCRIPTION:
+    Times SampleQueue two ways.  First raw throughput with a few
+    mixes of producer and consumer threads, checking that every
+    item pushed comes out exactly once.  Then a producer pushing
+    flat out into a consumer that stalls every so often, once per
+    overflow policy, to show the worst time a Push() took and
+    what got dropped.
+
+RETURN VALUE:
+    int - 0 on success, 1 if items were lost or duplicated
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchQueue( int argc, char* argv[] )
+{
+    const unsigned long long items = ( 0 < argc ) ? strtoull( argv[ 0 ], 0, 0 ) : 4000000ULL;
+
+    bool same = queueThroughput( 1, 1, items ) &&
+                queueThroughput( 1, 3, items ) &&
+                queueThroughput( 3, 1, items ) &&
+                queueThroughput( 3, 3, items );
+
+    queueStall( SampleQueue< FleetSample >::DROP_OLDEST, "drop-oldest", items / 20 );
+    queueStall( SampleQueue< FleetSample >::DROP_NEWEST, "drop-newest", items / 20 );
+    queueStall( SampleQueue< FleetSample >::BLOCK, "block", items / 20 );
+
+    printf( "every item exactly once: %s\n", same ? "yes" : "NO" );
+
+    return same ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    queueThroughput()
+
+DESCRIPTION:
+    Pushes items through a BLOCK queue split across the producers
+    and drains it with the consumers.  Each item carries its number
+    in sensorIndex; the consumers add them up so we can tell if one
+    went missing or came out twice.
+
+RETURN VALUE:
+    bool - true if the sum came out right
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool queueThroughput( int producers, int consumers, unsigned long long items )
+{
+    SampleQueue< FleetSample > queue( 1024, SampleQueue< FleetSample >::BLOCK );
+
+    std::vector< std::thread > threads;
+
+    std::vector< unsigned long long > sums( consumers * SampleQueue< FleetSample >::CACHE_LINE_SIZE );
+
+    double start = wallSeconds();
+
+    for ( int c = 0; c < consumers; ++c )
+    {
+        threads.push_back( std::thread( [ &queue, &sums, c ]()
+        {
+            FleetSample sample;
+
+            unsigned long long sum = 0;
+
+            while ( queue.Pop( sample ) )
+            {
+                sum += sample.sensorIndex;
+            }
+
+            sums[ c * SampleQueue< FleetSample >::CACHE_LINE_SIZE ] = sum;
+        } ) );
+    }
+
+    std::vector< std::thread > pushers;
+
+    for ( int p = 0; p < producers; ++p )
+    {
+        pushers.push_back( std::thread( [ &queue, p, producers, items ]()
+        {
+            FleetSample sample = FleetSample();
+
+            for ( unsigned long long n = p; n < items; n += producers )
+            {
+                sample.sensorIndex = ( size_t ) n;
+
+                queue.Push( sample );
+            }
+        } ) );
+    }
+
+    for ( size_t p = 0; p < pushers.size(); ++p )
+    {
+        pushers[ p ].join();
+    }
+
+    queue.Close();
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+    {
+        threads[ t ].join();
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    unsigned long long sum = 0;
+
+    for ( int c = 0; c < consumers; ++c )
+    {
+        sum += sums[ c * SampleQueue< FleetSample >::CACHE_LINE_SIZE ];
+    }
+
+    // size_t may be 32 bits, so compare in the same width
+    size_t expected = 0;
+
+    for ( unsigned long long n = 0; n < items; ++n )
+    {
+        expected += ( size_t ) n;
+    }
+
+    printf( "%d producer(s) %d consumer(s)  items/sec: %12.0f\n", producers, consumers, items / elapsed );
+
+    return ( size_t ) sum == expected && queue.PoppedCount() == items;
+}
+
+/*======================================================================
+FUNCTION:
+    queueStall()
+
+DESCRIPTION:
+    One producer pushing as fast as it can into a small queue while
+    the consumer sleeps 1ms after every 256 items, like a logger
+    waiting on a slow disk
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void queueStall( SampleQueue< FleetSample >::OverflowPolicy policy, const char* name, unsigned long long items )
+{
+    SampleQueue< FleetSample > queue( 256, policy );
+
+    std::thread consumer( [ &queue ]()
+    {
+        FleetSample sample;
+
+        unsigned long long count = 0;
+
+        while ( queue.Pop( sample ) )
+        {
+            if ( 0 == ++count % 256 )
+            {
+                usleep( 1000 );
+            }
+        }
+    } );
+
+    FleetSample sample = FleetSample();
+
+    double worst = 0;
+
+    double start = wallSeconds();
+
+    for ( unsigned long long n = 0; n < items; ++n )
+    {
+        double before = wallSeconds();
+
+        queue.Push( sample );
+
+        double took = wallSeconds() - before;
+
+        if ( took > worst )
+        {
+            worst = took;
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    queue.Close();
+
+    consumer.join();
+
+    printf( "%-12s pushes/sec: %12.0f  worst push us: %9.1f  dropped: %8llu  blocked: %8llu\n",
+            name, items / elapsed, worst * 1e6, queue.DroppedCount(), queue.BlockedCount() );
+}
+
+/*======================================================================
+FUNCTION:
+    benchScheduler()
+
+DESCRIPTION:
+    Runs a 10ms job that takes 300us, first the old way (do the
+    work, then sleep for the period) and then on a PollScheduler
+    next to two more jobs sharing its bus at other phases.  Prints
+    how far the old loop drifted and the scheduler's jitter
+    histogram per job.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchScheduler( int argc, char* argv[] )
+{
+    const double seconds = ( 0 < argc ) ? atof( argv[ 0 ] ) : 2.0;
+
+    const unsigned int PERIOD = 10000;
+
+    const double WORK = 300;
+
+    unsigned long long expected = ( unsigned long long ) ( seconds * 1e6 / PERIOD );
+
+    double start = wallSeconds();
+
+    for ( unsigned long long n = 0; n < expected; ++n )
+    {
+        busyMicroseconds( WORK );
+
+        usleep( PERIOD );
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-14s runs: %6llu  drift: %9.1f ms  (%.2f%% slow)\n",
+            "work+sleep", expected, ( elapsed - seconds ) * 1e3, ( elapsed / seconds - 1 ) * 100 );
+
+    PollScheduler scheduler;
+
+    const char* names[] = { "10ms @ 0", "20ms @ 2.5ms", "5ms @ 1ms" };
+
+    scheduler.AddJob( PERIOD, 0, [ WORK ]() { busyMicroseconds( WORK ); } );
+    scheduler.AddJob( 2 * PERIOD, PERIOD / 4, [ WORK ]() { busyMicroseconds( WORK ); } );
+    scheduler.AddJob( PERIOD / 2, PERIOD / 10, [ WORK ]() { busyMicroseconds( WORK ); } );
+
+    scheduler.AddJob( ( unsigned int ) ( seconds * 1e6 ), ( unsigned int ) ( seconds * 1e6 ), [ &scheduler ]()
+    {
+        scheduler.Stop();
+    } );
+
+    start = wallSeconds();
+
+    scheduler.Run();
+
+    elapsed = wallSeconds() - start;
+
+    PollScheduler::JobStats first = scheduler.Stats( 0 );
+
+    printf( "%-14s runs: %6llu  drift: %9.1f ms\n",
+            "scheduler", first.runs, ( elapsed - seconds ) * 1e3 );
+
+    for ( size_t job = 0; job < 3; ++job )
+    {
+        PollScheduler::JobStats stats = scheduler.Stats( job );
+
+        printf( "%-14s runs: %6llu  missed: %4llu  late p50: <%5lluus  p99: <%5lluus  max: %6.1fus\n",
+                names[ job ], stats.runs, stats.missed,
+                PollScheduler::JitterPercentileMicroseconds( stats, 0.5 ),
+                PollScheduler::JitterPercentileMicroseconds( stats, 0.99 ),
+                stats.maxLatenessNanoseconds / 1e3 );
+
+        printf( "               " );
+
+        for ( size_t b = 0; b < PollScheduler::JITTER_BUCKETS; ++b )
+        {
+            if ( stats.jitter[ b ] )
+            {
+                printf( " <%lluus:%llu", PollScheduler::BucketLimitMicroseconds( b ), stats.jitter[ b ] );
+            }
+        }
+
+        printf( "\n" );
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    busyMicroseconds()
+
+DESCRIPTION:
+    Burns cpu for a while, standing in for an i2c read
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void busyMicroseconds( double microseconds )
+{
+    double until = wallSeconds() + microseconds / 1e6;
+
+    while ( wallSeconds() < until )
+    {
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    benchStats()
+
+DESCRIPTION:
+    Times the sensor read path (command, fetch, decode) against a
+    simulated sensor with no conversion delay, so the sensor code
+    is all there is to measure.  Run it from a build with and one
+    without STATS to see what the instrumentation costs.  Also
+    times the raw clock read and histogram record, and dumps what
+    the sensor collected.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchStats( int argc, char* argv[] )
+{
+    const unsigned long long reads = ( 0 < argc ) ? strtoull( argv[ 0 ], 0, 0 ) : 2000000ULL;
+
+    SimulatedI2cBus simulatedBus;
+
+    SimulatedHih6130::Config config;
+
+    // A few faults so the counters have something to show
+    config.commandModeRate = 100;
+    config.diagnosticRate  = 100;
+
+    simulatedBus.AddDevice( 0x27, config );
+
+    SimulatedTransport transport( simulatedBus );
+
+    Honeywell6130Sensor sensor( &transport, 0x27 );
+
+    double checksum = 0;
+
+    double start = wallSeconds();
+
+    for ( unsigned long long r = 0; r < reads; ++r )
+    {
+        TempHumidityData data;
+
+        sensor.TriggerMeasurement();
+
+        if ( sensor.TryFetch( data ) )
+        {
+            checksum += data.tempCelcius;
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "HONEYWELL_STATS: %s\n", SensorStats::ENABLED ? "on" : "off" );
+
+    printf( "%-20s ns/read: %8.1f\n", "sensor read path", elapsed * 1e9 / reads );
+
+    LatencyHistogram histogram;
+
+    start = wallSeconds();
+
+    for ( unsigned long long r = 0; r < reads; ++r )
+    {
+        long long before = SensorStats::Now();
+
+        histogram.Record( SensorStats::Now() - before );
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-20s ns/phase: %7.1f\n", "2 clocks + record", elapsed * 1e9 / reads );
+
+    SensorStatsSnapshot stats;
+
+    if ( sensor.Stats( stats ) )
+    {
+        stats.Dump( stdout );
+    }
+
+    return ( checksum != checksum ) ? 1 : 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchErrors()
+
+DESCRIPTION:
+    Reads a simulated sensor that NACKs a lot, first through the
+    throwing TriggerMeasurement()/TryFetch() pair with a try/catch
+    around every read, then through the error code pair.  Prints
+    the cost per read of each.  Then does the same number of full
+    TryRead() calls with retries to show how many reads the retry
+    policy saves.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchErrors( int argc, char* argv[] )
+{
+    const unsigned long long reads = ( 0 < argc ) ? strtoull( argv[ 0 ], 0, 0 ) : 1000000ULL;
+    const unsigned int nackRate = ( 1 < argc ) ? ( unsigned int ) strtoul( argv[ 1 ], 0, 0 ) : 100000;
+
+    SimulatedI2cBus simulatedBus;
+
+    SimulatedHih6130::Config config;
+
+    config.nackRate = nackRate;
+
+    simulatedBus.AddDevice( 0x27, config );
+
+    SimulatedTransport transport( simulatedBus );
+
+    Honeywell6130Sensor sensor( &transport, 0x27 );
+
+    unsigned long long failures = 0;
+
+    double start = wallSeconds();
+
+    for ( unsigned long long r = 0; r < reads; ++r )
+    {
+        try
+        {
+            TempHumidityData data;
+
+            sensor.TriggerMeasurement();
+            sensor.TryFetch( data );
+        }
+        catch( SensorException& )
+        {
+            ++failures;
+        }
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-12s ns/read: %8.1f  failed: %6.2f%%\n", "exceptions", elapsed * 1e9 / reads, 100.0 * failures / reads );
+
+    failures = 0;
+
+    start = wallSeconds();
+
+    for ( unsigned long long r = 0; r < reads; ++r )
+    {
+        TempHumidityData data;
+
+        if ( Honeywell6130Sensor::READ_OK != sensor.TryTriggerMeasurement() ||
+             Honeywell6130Sensor::READ_FETCH_FAILED == sensor.TryFetchResult( data ) )
+        {
+            ++failures;
+        }
+    }
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s ns/read: %8.1f  failed: %6.2f%%\n", "error codes", elapsed * 1e9 / reads, 100.0 * failures / reads );
+
+    // The simulated sensor has no conversion time, so there is
+    // no point backing off for long
+    Honeywell6130Sensor::RetryPolicy policy;
+
+    policy.initialBackoffMicroseconds = 1;
+    policy.maxBackoffMicroseconds     = 8;
+
+    sensor.SetRetryPolicy( policy );
+
+    // TryRead() sleeps for the settle time, so do fewer of them
+    const unsigned long long tryReads = reads / 100 ? reads / 100 : 1;
+
+    failures = 0;
+
+    for ( unsigned long long r = 0; r < tryReads; ++r )
+    {
+        TempHumidityData data;
+
+        if ( Honeywell6130Sensor::READ_OK != sensor.TryRead( data ) )
+        {
+            ++failures;
+        }
+    }
+
+    printf( "%-12s reads: %llu  failed: %6.2f%%  retries: %llu  reopens: %llu\n", "TryRead()",
+            tryReads, 100.0 * failures / tryReads, sensor.RetryCount(), sensor.ReopenCount() );
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchUring()
+
+DESCRIPTION:
+    Polls a number of stand-in sensors with the blocking
+    write()/usleep()/read() round the fleet uses, then with one
+    UringAcquisition, and prints the system calls, the cpu time
+    and the wall time each one spent.  Each stand-in is a
+    SOCK_SEQPACKET socket pair.  A responder thread answers every
+    command byte on it with one frame from a SimulatedHih6130, so
+    the fds behave like an i2c-dev fd bound to a sensor: one
+    write starts a conversion and one 4 byte read gets it.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchUring( int argc, char* argv[] )
+{
+    const size_t sensorCount = ( 0 < argc ) ? strtoul( argv[ 0 ], 0, 0 ) : 8;
+    const int rounds = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 200;
+
+    if ( 0 == sensorCount || rounds <= 0 )
+    {
+        printf( "expected a sensor count and a round count above zero\n" );
+        return 1;
+    }
+
+    std::vector< int > fileDescriptors;
+    std::vector< int > peers;
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        int pair[ 2 ];
+
+        if ( 0 != socketpair( AF_UNIX, SOCK_SEQPACKET, 0, pair ) )
+        {
+            printf( "socketpair failed\n" );
+            return 1;
+        }
+
+        fileDescriptors.push_back( pair[ 0 ] );
+        peers.push_back( pair[ 1 ] );
+    }
+
+    std::thread responder( standInResponder, peers );
+
+    std::vector< TempHumidityData > data( sensorCount );
+
+    // The blocking round, same as SensorFleet::pollRound()
+    unsigned long long syscalls = 0;
+    unsigned long long samples = 0;
+
+    double cpu = cpuMicroseconds();
+    double wall = wallSeconds();
+
+    for ( int round = 0; round < rounds; ++round )
+    {
+        static const unsigned char command[ 1 ] = { 0 };
+
+        for ( size_t s = 0; s < sensorCount; ++s )
+        {
+            ++syscalls;
+
+            if ( write( fileDescriptors[ s ], command, sizeof( command ) ) != sizeof( command ) )
+            {
+                printf( "stand-in write failed\n" );
+            }
+        }
+
+        usleep( SETTLE_MICROSECONDS );
+
+        for ( size_t s = 0; s < sensorCount; ++s )
+        {
+            unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+            ++syscalls;
+
+            if ( read( fileDescriptors[ s ], frame, sizeof( frame ) ) == sizeof( frame ) )
+            {
+                Honeywell6130Sensor::Decode( frame, data[ s ] );
+                ++samples;
+            }
+        }
+    }
+
+    cpu = cpuMicroseconds() - cpu;
+    wall = wallSeconds() - wall;
+
+    report( "blocking", 0, syscalls, samples, cpu );
+
+    printf( "%-12s wall us/round: %8.1f\n", "", wall * 1e6 / rounds );
+
+    if ( !UringAcquisition::Available() )
+    {
+        printf( "%-12s not available on this kernel\n", "io_uring" );
+    }
+    else
+    {
+        try
+        {
+            UringAcquisition uring( fileDescriptors, SETTLE_MICROSECONDS, STALE_RETRIES );
+
+            std::vector< size_t > fresh;
+
+            unsigned long long setup = uring.SyscallCount();
+
+            samples = 0;
+
+            cpu = cpuMicroseconds();
+            wall = wallSeconds();
+
+            for ( int round = 0; round < rounds; ++round )
+            {
+                samples += uring.Poll( &data[ 0 ], fresh );
+            }
+
+            cpu = cpuMicroseconds() - cpu;
+            wall = wallSeconds() - wall;
+
+            report( "io_uring", setup, uring.SyscallCount() - setup, samples, cpu );
+
+            printf( "%-12s wall us/round: %8.1f  errors: %llu\n", "", wall * 1e6 / rounds, uring.ErrorCount() );
+        }
+        catch( SensorException& ex )
+        {
+            printf( "%s\n", ex.what() );
+        }
+    }
+
+    // Hanging up stops the responder
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        close( fileDescriptors[ s ] );
+    }
+
+    responder.join();
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        close( peers[ s ] );
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    standInResponder()
+
+DESCRIPTION:
+    Sensor side of the benchUring() stand-ins.  Waits on every
+    socket and answers each command with a frame, until all of
+    the other ends have hung up.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void standInResponder( std::vector< int > peers )
+{
+    std::vector< SimulatedHih6130* > sensors;
+    std::vector< struct pollfd > waiting( peers.size() );
+
+    for ( size_t s = 0; s < peers.size(); ++s )
+    {
+        SimulatedHih6130::Config config;
+
+        config.seed = ( unsigned int ) s + 1;
+
+        sensors.push_back( new SimulatedHih6130( config ) );
+
+        waiting[ s ].fd = peers[ s ];
+        waiting[ s ].events = POLLIN;
+    }
+
+    size_t open = peers.size();
+
+    while ( 0 < open && 0 < poll( &waiting[ 0 ], waiting.size(), -1 ) )
+    {
+        for ( size_t s = 0; s < waiting.size(); ++s )
+        {
+            if ( 0 == waiting[ s ].revents )
+            {
+                continue;
+            }
+
+            unsigned char command[ 1 ];
+
+            if ( recv( waiting[ s ].fd, command, sizeof( command ), 0 ) <= 0 )
+            {
+                // Hung up.  A negative fd is skipped by poll().
+                waiting[ s ].fd = -1;
+                --open;
+                continue;
+            }
+
+            unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+            sensors[ s ]->MeasurementRequest();
+            sensors[ s ]->Fetch( frame );
+
+            if ( send( waiting[ s ].fd, frame, sizeof( frame ), 0 ) != sizeof( frame ) )
+            {
+                waiting[ s ].fd = -1;
+                --open;
+            }
+        }
+    }
+
+    for ( size_t s = 0; s < sensors.size(); ++s )
+    {
+        delete sensors[ s ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    benchCoroutines()
+
+DESCRIPTION:
+    Reads a crowd of simulated sensors with 1ms conversions from a
+    single thread.  First comes one blocking TryRead() per sensor
+    for comparison.  Then one coroutine does a WhenAll() round
+    after round.  Last, one coroutine per sensor loops on
+    ReadAsync() on its own.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchCoroutines( int argc, char* argv[] )
+{
+    const size_t sensorCount = ( 0 < argc ) ? strtoul( argv[ 0 ], 0, 0 ) : 1000;
+    const int rounds = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 50;
+
+    // Addresses 0x08 to 0x77 are free for devices
+    const size_t SENSORS_PER_BUS = 100;
+
+    if ( 0 == sensorCount || rounds <= 0 )
+    {
+        printf( "expected a sensor count and a round count above zero\n" );
+        return 1;
+    }
+
+    std::vector< SimulatedI2cBus* > buses;
+    std::vector< I2cTransport* > transports;
+    std::vector< Honeywell6130Sensor* > sensors;
+
+    SimulatedHih6130::Config config;
+
+    config.conversionMicroseconds = Honeywell6130Sensor::SETTLE_MICROSECONDS;
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        if ( 0 == s % SENSORS_PER_BUS )
+        {
+            buses.push_back( new SimulatedI2cBus );
+        }
+
+        int address = 0x08 + ( int ) ( s % SENSORS_PER_BUS );
+
+        config.seed = ( unsigned int ) s + 1;
+
+        buses.back()->AddDevice( address, config );
+
+        transports.push_back( new SimulatedTransport( *buses.back() ) );
+        sensors.push_back( new Honeywell6130Sensor( transports.back(), address ) );
+    }
+
+    // Blocking reads take a settle time each, so only time a few
+    const size_t blockingReads = sensorCount < 100 ? sensorCount : 100;
+
+    double start = wallSeconds();
+
+    for ( size_t s = 0; s < blockingReads; ++s )
+    {
+        TempHumidityData data;
+
+        sensors[ s ]->TryRead( data );
+    }
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-12s us/read: %8.1f  (a round of %u would take %.1f ms)\n", "TryRead()",
+            elapsed * 1e6 / blockingReads, ( unsigned int ) sensorCount,
+            elapsed * 1e3 * sensorCount / blockingReads );
+
+    SensorExecutor executor;
+
+    unsigned long long fresh = 0;
+
+    start = wallSeconds();
+
+    executor.Spawn( whenAllRounds( executor, sensors, rounds, &fresh ) );
+    executor.Run();
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s us/round: %8.1f  reads/sec: %9.0f  fresh: %llu/%llu  wakeups/round: %.1f\n", "WhenAll()",
+            elapsed * 1e6 / rounds, fresh / elapsed, fresh,
+            ( unsigned long long ) sensorCount * rounds, ( double ) executor.WakeupCount() / rounds );
+
+    SensorExecutor looseExecutor;
+
+    fresh = 0;
+
+    start = wallSeconds();
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        looseExecutor.Spawn( readAsyncLoop( looseExecutor, sensors[ s ], rounds, &fresh ) );
+    }
+
+    looseExecutor.Run();
+
+    elapsed = wallSeconds() - start;
+
+    printf( "%-12s us/round: %8.1f  reads/sec: %9.0f  fresh: %llu/%llu  wakeups/round: %.1f\n", "ReadAsync()",
+            elapsed * 1e6 / rounds, fresh / elapsed, fresh,
+            ( unsigned long long ) sensorCount * rounds, ( double ) looseExecutor.WakeupCount() / rounds );
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        delete sensors[ s ];
+        delete transports[ s ];
+    }
+
+    for ( size_t b = 0; b < buses.size(); ++b )
+    {
+        delete buses[ b ];
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    whenAllRounds(), readAsyncLoop()
+
+DESCRIPTION:
+    The coroutines benchCoroutines() spawns.  fresh counts the
+    reads that came back READ_OK.
+
+RETURN VALUE:
+    SensorTask< void >
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static SensorTask< void > whenAllRounds( SensorExecutor& executor,
+                                         std::vector< Honeywell6130Sensor* > sensors,
+                                         int rounds,
+                                         unsigned long long* fresh )
+{
+    for ( int round = 0; round < rounds; ++round )
+    {
+        std::vector< SensorReading > readings = co_await WhenAll( executor, sensors );
+
+        for ( size_t r = 0; r < readings.size(); ++r )
+        {
+            if ( Honeywell6130Sensor::READ_OK == readings[ r ].error )
+            {
+                ++*fresh;
+            }
+        }
+    }
+}
+
+static SensorTask< void > readAsyncLoop( SensorExecutor& executor,
+                                         Honeywell6130Sensor* sensor,
+                                         int rounds,
+                                         unsigned long long* fresh )
+{
+    for ( int round = 0; round < rounds; ++round )
+    {
+        SensorReading reading = co_await sensor->ReadAsync( executor );
+
+        if ( Honeywell6130Sensor::READ_OK == reading.error )
+        {
+            ++*fresh;
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    benchShm()
+
+DESCRIPTION:
+    Times SharedReadingsReader::Latest() from a number of reader
+    threads, each with its own mapping the way separate processes
+    would have, first with the writer idle and then with a writer
+    publishing as fast as it can.  Every record the writer puts out
+    is self consistent, so the readers also count torn copies
+    (there should be none).
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchShm( int argc, char* argv[] )
+{
+    const double seconds = ( 0 < argc ) ? atof( argv[ 0 ] ) : 1.0;
+    const int readers = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 2;
+
+    if ( seconds <= 0 || readers <= 0 )
+    {
+        printf( "expected a run time and a reader count above zero\n" );
+        return 1;
+    }
+
+    char name[ 64 ];
+
+    snprintf( name, sizeof( name ), "/honeywell6130-bench-%d", ( int ) getpid() );
+
+    try
+    {
+        SharedPublisher publisher( name, 1 );
+
+        publisher.Publish( 0, consistentReading( 0 ), 0 );
+
+        shmReaders( name, readers, seconds, "idle writer" );
+
+        std::atomic< bool > writing( true );
+        std::atomic< unsigned long long > publishes( 0 );
+
+        std::thread writer( [ &publisher, &writing, &publishes ]()
+        {
+            long long n = 1;
+
+            while ( writing.load( std::memory_order_relaxed ) )
+            {
+                publisher.Publish( 0, consistentReading( n ), n );
+                ++n;
+            }
+
+            publishes = n - 1;
+        } );
+
+        shmReaders( name, readers, seconds, "busy writer" );
+
+        writing = false;
+        writer.join();
+
+        printf( "%-12s publishes/sec: %.0f\n", "", publishes / seconds );
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+        return 1;
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    shmReaders()
+
+DESCRIPTION:
+    Runs the reader threads for benchShm() and prints one line:
+    the mean cost of Latest() in a tight loop, the percentiles of
+    individually timed calls (which include two clock reads), the
+    retries and the torn copies
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void shmReaders( const char* name, int readers, double seconds, const char* label )
+{
+    std::vector< std::thread > threads;
+
+    LatencyHistogram latency;
+
+    std::atomic< unsigned long long > reads( 0 );
+    std::atomic< unsigned long long > retries( 0 );
+    std::atomic< unsigned long long > torn( 0 );
+    std::atomic< unsigned long long > looseNanoseconds( 0 );
+
+    for ( int r = 0; r < readers; ++r )
+    {
+        threads.push_back( std::thread( [ &, name, seconds ]()
+        {
+            SharedReadingsReader reader( name );
+
+            if ( !reader.Open() )
+            {
+                printf( "reader could not open %s\n", name );
+                return;
+            }
+
+            const int BATCH = 1024;
+
+            unsigned long long count = 0;
+            unsigned long long bad = 0;
+            unsigned long long loose = 0;
+
+            double end = wallSeconds() + seconds;
+
+            while ( wallSeconds() < end )
+            {
+                SharedRecord record;
+
+                // A batch back to back for the mean...
+                long long start = SensorStats::Now();
+
+                for ( int b = 0; b < BATCH; ++b )
+                {
+                    reader.Latest( 0, record );
+                }
+
+                loose += SensorStats::Now() - start;
+
+                // ...and a batch timed one by one for the tail
+                for ( int b = 0; b < BATCH; ++b )
+                {
+                    start = SensorStats::Now();
+
+                    bool published = reader.Latest( 0, record );
+
+                    latency.Record( SensorStats::Now() - start );
+
+                    if ( !published )
+                    {
+                        continue;
+                    }
+
+                    TempHumidityData expected = consistentReading( record.timeMicroseconds );
+
+                    if ( record.data.tempCelcius != expected.tempCelcius ||
+                         record.data.tempFahrenheit != expected.tempFahrenheit ||
+                         record.data.relativeHumidity != expected.relativeHumidity )
+                    {
+                        ++bad;
+                    }
+                }
+
+                count += BATCH;
+            }
+
+            reads += count;
+            retries += reader.RetryCount();
+            torn += bad;
+            looseNanoseconds += loose;
+        } ) );
+    }
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+    {
+        threads[ t ].join();
+    }
+
+    LatencyHistogram::Counts counts;
+
+    latency.Snapshot( counts );
+
+    printf( "%-12s ns/read: %6.1f  timed p50: <%4llu  p99: <%5llu  p99.9: <%6llu  retries: %llu  torn: %llu\n",
+            label,
+            reads ? ( double ) looseNanoseconds / reads : 0.0,
+            counts.PercentileNanoseconds( 0.5 ),
+            counts.PercentileNanoseconds( 0.99 ),
+            counts.PercentileNanoseconds( 0.999 ),
+            retries.load(),
+            torn.load() );
+}
+
+/*======================================================================
+FUNCTION:
+    consistentReading()
+
+DESCRIPTION:
+    The reading benchShm() publishes for step n.  Every field is
+    tied to n, so a reader can tell a torn copy from a clean one.
+
+RETURN VALUE:
+    TempHumidityData
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static TempHumidityData consistentReading( long long n )
+{
+    TempHumidityData data;
+
+    memset( &data, 0, sizeof( data ) );
+
+    // Small enough that a float holds it exactly
+    float value = ( float ) ( n % 1000000 );
+
+    data.status           = 0;
+    data.tempCelcius      = value;
+    data.tempFahrenheit   = value * 2;
+    data.relativeHumidity = -value;
+
+    return data;
+}
+
+/*======================================================================
+FUNCTION:
+    benchServer()
+
+DESCRIPTION:
+    Load test for QueryServer over loopback.  Client threads keep
+    one request in flight on every connection and time each answer,
+    first LATEST over the Unix socket, then LATEST over TCP, then a
+    mix of LATEST, 100 row RANGE and METRICS requests over TCP.  A
+    stand-in acquisition thread calls Offer() 1000 times a second
+    the whole time, and its worst call shows whether serving ever
+    got in the way of acquisition.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchServer( int argc, char* argv[] )
+{
+    const int connections = ( 0 < argc ) ? atoi( argv[ 0 ] ) : 256;
+    const double seconds = ( 1 < argc ) ? atof( argv[ 1 ] ) : 2.0;
+    const int shards = ( 2 < argc ) ? atoi( argv[ 2 ] ) : 1;
+
+    if ( connections <= 0 || seconds <= 0 || shards <= 0 )
+    {
+        printf( "expected a connection count, a run time and a shard count above zero\n" );
+        return 1;
+    }
+
+    // Both ends of every connection live in this process
+    struct rlimit files;
+
+    if ( 0 == getrlimit( RLIMIT_NOFILE, &files ) )
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &files );
+    }
+
+    const size_t SENSORS = 8;
+    const long long READINGS = 400;
+
+    char path[ 64 ];
+
+    snprintf( path, sizeof( path ), "/tmp/honeywell6130-bench-%d.sock", ( int ) getpid() );
+
+    QueryServerOptions options;
+
+    options.unixPath       = path;
+    options.tcpPort        = 0;
+    options.shards         = ( size_t ) shards;
+    options.maxConnections = ( size_t ) connections;
+
+    try
+    {
+        QueryServer server( SENSORS, options );
+
+        // A second a reading for the last READINGS seconds, queued
+        // before the shards start so none of it is dropped
+        long long now = SharedPublisher::NowMicroseconds();
+        long long base = now - READINGS * 1000000;
+
+        for ( long long r = 0; r < READINGS; ++r )
+        {
+            for ( size_t s = 0; s < SENSORS; ++s )
+            {
+                server.Offer( s, consistentReading( r % 100 ), base + r * 1000000 );
+            }
+        }
+
+        server.Start();
+
+        char range[ 64 ];
+
+        snprintf( range, sizeof( range ), "RANGE 3 %lld %lld\n", base + 100 * 1000000, base + 199 * 1000000 );
+
+        std::atomic< bool > offering( true );
+
+        LatencyHistogram offers;
+
+        std::thread acquisition( [ &server, &offering, &offers ]()
+        {
+            for ( size_t n = 0; offering.load( std::memory_order_relaxed ); ++n )
+            {
+                long long start = SensorStats::Now();
+
+                server.Offer( n % SENSORS, consistentReading( n % 100 ) );
+
+                offers.Record( SensorStats::Now() - start );
+
+                usleep( 1000 );
+            }
+        } );
+
+        serverLoad( "unix LATEST", path, -1, connections, seconds, 0, 0 );
+        serverLoad( "tcp LATEST", 0, server.TcpPort(), connections, seconds, 0, 0 );
+        serverLoad( "tcp mixed", 0, server.TcpPort(), connections, seconds, 1, range );
+
+        offering = false;
+        acquisition.join();
+
+        LatencyHistogram::Counts counts;
+
+        offers.Snapshot( counts );
+
+        printf( "%-12s calls: %llu  p99: <%lluns  max: %lluns  dropped: %llu  rejected: %llu\n",
+                "Offer()",
+                counts.count,
+                counts.PercentileNanoseconds( 0.99 ),
+                counts.maxNanoseconds,
+                server.DroppedCount(),
+                server.RejectedCount() );
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+        return 1;
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    serverLoad()
+
+DESCRIPTION:
+    Runs the client side of one benchServer() phase and prints its
+    line.  The connections are spread over a few threads, each with
+    its own epoll set.  Without mixed every request is LATEST;
+    with it one in five is the RANGE request and one in ten is
+    METRICS.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void serverLoad( const char* label,
+                        const char* unixPath,
+                        int tcpPort,
+                        int connections,
+                        double seconds,
+                        int mixed,
+                        const char* range )
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+
+    int threadCount = ( int ) ( ( cores < 4 ) ? 1 : cores / 4 );
+
+    if ( threadCount > connections )
+    {
+        threadCount = connections;
+    }
+
+    std::vector< std::thread > threads;
+
+    std::vector< LatencyHistogram::Counts > results( threadCount );
+
+    std::atomic< unsigned long long > answered( 0 );
+    std::atomic< unsigned long long > failed( 0 );
+
+    for ( int t = 0; t < threadCount; ++t )
+    {
+        int share = connections / threadCount + ( ( t < connections % threadCount ) ? 1 : 0 );
+
+        threads.push_back( std::thread( [ &, t, share ]()
+        {
+            struct Client
+            {
+                int fileDescriptor;
+                size_t length;
+                long long sent;
+                char buffer[ 16384 ];
+            };
+
+            std::vector< Client > clients( share );
+
+            LatencyHistogram latency;
+
+            int epoll = epoll_create1( EPOLL_CLOEXEC );
+
+            unsigned long long count = 0;
+            unsigned long long bad = 0;
+
+            unsigned int random = 0x9e3779b9u * ( t + 1 );
+
+            // Picks and sends the next request
+            auto request = [ & ]( Client& client ) -> bool
+            {
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+
+                const char* text = "LATEST\n";
+
+                if ( mixed && random % 10 < 2 )
+                {
+                    text = range;
+                }
+                else if ( mixed && random % 10 == 2 )
+                {
+                    text = "METRICS\n";
+                }
+
+                client.length = 0;
+                client.sent   = SensorStats::Now();
+
+                size_t length = strlen( text );
+
+                return ( ssize_t ) length == send( client.fileDescriptor, text, length, MSG_NOSIGNAL );
+            };
+
+            for ( int c = 0; c < share; ++c )
+            {
+                Client& client = clients[ c ];
+
+                client.fileDescriptor = connectClient( unixPath, tcpPort );
+
+                if ( client.fileDescriptor < 0 )
+                {
+                    ++bad;
+                    continue;
+                }
+
+                struct epoll_event event;
+
+                memset( &event, 0, sizeof( event ) );
+
+                event.events   = EPOLLIN;
+                event.data.ptr = &client;
+
+                epoll_ctl( epoll, EPOLL_CTL_ADD, client.fileDescriptor, &event );
+            }
+
+            double end = wallSeconds() + seconds;
+
+            for ( int c = 0; c < share; ++c )
+            {
+                if ( 0 <= clients[ c ].fileDescriptor )
+                {
+                    request( clients[ c ] );
+                }
+            }
+
+            struct epoll_event events[ 64 ];
+
+            while ( wallSeconds() < end )
+            {
+                int ready = epoll_wait( epoll, events, 64, 100 );
+
+                for ( int e = 0; e < ready; ++e )
+                {
+                    Client& client = *( Client* ) events[ e ].data.ptr;
+
+                    ssize_t got = read( client.fileDescriptor,
+                                        client.buffer + client.length,
+                                        sizeof( client.buffer ) - client.length );
+
+                    if ( got <= 0 )
+                    {
+                        ++bad;
+                        close( client.fileDescriptor );
+                        continue;
+                    }
+
+                    client.length += ( size_t ) got;
+
+                    // Done once the header and the lines it promises
+                    // are all here
+                    if ( !answerComplete( client.buffer, client.length ) )
+                    {
+                        if ( client.length == sizeof( client.buffer ) )
+                        {
+                            ++bad;
+                            close( client.fileDescriptor );
+                        }
+
+                        continue;
+                    }
+
+                    latency.Record( SensorStats::Now() - client.sent );
+
+                    if ( 0 != strncmp( client.buffer, "OK ", 3 ) )
+                    {
+                        ++bad;
+                    }
+
+                    ++count;
+
+                    request( client );
+                }
+            }
+
+            for ( int c = 0; c < share; ++c )
+            {
+                if ( 0 <= clients[ c ].fileDescriptor )
+                {
+                    close( clients[ c ].fileDescriptor );
+                }
+            }
+
+            close( epoll );
+
+            latency.Snapshot( results[ t ] );
+
+            answered += count;
+            failed += bad;
+        } ) );
+    }
+
+    for ( size_t t = 0; t < threads.size(); ++t )
+    {
+        threads[ t ].join();
+    }
+
+    LatencyHistogram::Counts total = results[ 0 ];
+
+    for ( size_t t = 1; t < results.size(); ++t )
+    {
+        total.Merge( results[ t ] );
+    }
+
+    printf( "%-12s conns: %5d  req/s: %8.0f  p50: <%5lluus  p99: <%6lluus  p99.9: <%6lluus  errors: %llu\n",
+            label,
+            connections,
+            answered / seconds,
+            total.PercentileNanoseconds( 0.5 ) / 1000,
+            total.PercentileNanoseconds( 0.99 ) / 1000,
+            total.PercentileNanoseconds( 0.999 ) / 1000,
+            failed.load() );
+}
+
+/*======================================================================
+FUNCTION:
+    connectClient()
+
+DESCRIPTION:
+    Opens one blocking client connection to the Unix socket, or to
+    the TCP port on loopback when unixPath is null
+
+RETURN VALUE:
+    int - the socket, or -1
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int connectClient( const char* unixPath, int tcpPort )
+{
+    int client;
+
+    if ( 0 != unixPath )
+    {
+        struct sockaddr_un address;
+
+        memset( &address, 0, sizeof( address ) );
+
+        address.sun_family = AF_UNIX;
+        strncpy( address.sun_path, unixPath, sizeof( address.sun_path ) - 1 );
+
+        client = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+        if ( 0 <= client && 0 != connect( client, ( struct sockaddr* ) &address, sizeof( address ) ) )
+        {
+            close( client );
+            client = -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in address;
+
+        memset( &address, 0, sizeof( address ) );
+
+        address.sin_family      = AF_INET;
+        address.sin_port        = htons( ( uint16_t ) tcpPort );
+        address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+        client = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+        if ( 0 <= client && 0 != connect( client, ( struct sockaddr* ) &address, sizeof( address ) ) )
+        {
+            close( client );
+            client = -1;
+        }
+
+        if ( 0 <= client )
+        {
+            int on = 1;
+
+            setsockopt( client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+        }
+    }
+
+    return client;
+}
+
+/*======================================================================
+FUNCTION:
+    answerComplete()
+
+DESCRIPTION:
+    Checks whether a QueryServer answer is all there: an ERR line,
+    or an OK line and the number of lines it gives
+
+RETURN VALUE:
+    bool - true when the whole answer has arrived
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool answerComplete( const char* answer, size_t length )
+{
+    const char* end = answer + length;
+    const char* newline = ( const char* ) memchr( answer, '\n', length );
+
+    if ( 0 == newline )
+    {
+        return false;
+    }
+
+    if ( 0 != strncmp( answer, "OK ", 3 ) )
+    {
+        return true;
+    }
+
+    unsigned long lines = strtoul( answer + 3, 0, 10 );
+
+    for ( const char* p = newline + 1; 0 < lines; --lines, ++p )
+    {
+        p = ( const char* ) memchr( p, '\n', ( size_t ) ( end - p ) );
+
+        if ( 0 == p )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    benchLog()
+
+DESCRIPTION:
+    Appends records to a SampleLog in a scratch directory and
+    reports the cost per append, the bytes per sample against the
+    text output, the speed of a full range scan, of a short range
+    query and of Summarize().  Then a child process appends until
+    it is killed with SIGKILL, and the log is opened again to see
+    what recovery kept.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchLog( int argc, char* argv[] )
+{
+    const long long records = ( 0 < argc ) ? atoll( argv[ 0 ] ) : 4000000;
+
+    if ( records <= 0 )
+    {
+        printf( "expected a record count above zero\n" );
+        return 1;
+    }
+
+    char directory[ 64 ];
+
+    snprintf( directory, sizeof( directory ), "/tmp/honeywell6130-bench-log-%d", ( int ) getpid() );
+
+    // A spread of frames to store, and what the text output would
+    // have printed for them
+    std::vector< unsigned char > frames( 4096 * Honeywell6130Sensor::FRAME_SIZE );
+
+    double textBytes = 0;
+
+    for ( size_t f = 0; f < 4096; ++f )
+    {
+        TempHumidityData data = consistentReading( 0 );
+
+        data.tempCelcius      = 15.0f + ( f % 200 ) * 0.07f;
+        data.tempFahrenheit   = data.tempCelcius * 1.8f + 32;
+        data.relativeHumidity = 30.0f + ( f % 300 ) * 0.1f;
+
+        Honeywell6130Sensor::Encode( data, &frames[ f * Honeywell6130Sensor::FRAME_SIZE ] );
+
+        Honeywell6130Sensor::Decode( &frames[ f * Honeywell6130Sensor::FRAME_SIZE ], data );
+
+        char line[ 128 ];
+
+        textBytes += snprintf( line, sizeof( line ), "Sensor: %u  TempC: %g  TempF: %g  Humidity: %g\n",
+                               0u, data.tempCelcius, data.tempFahrenheit, data.relativeHumidity );
+    }
+
+    textBytes /= 4096;
+
+    // A reading a second, with a little jitter
+    auto timeOf = []( long long r ) -> long long
+    {
+        return 1000000000LL + r * 1000000 + ( r % 7 ) * 1000;
+    };
+
+    try
+    {
+        SampleLog log( directory );
+
+        double start = wallSeconds();
+
+        for ( long long r = 0; r < records; ++r )
+        {
+            log.Append( &frames[ ( r % 4096 ) * Honeywell6130Sensor::FRAME_SIZE ], timeOf( r ) );
+        }
+
+        double appendSeconds = wallSeconds() - start;
+
+        // Individually timed appends, for the tail the segment
+        // changes and page faults cause
+        LatencyHistogram appendLatency;
+
+        for ( long long r = records; r < records + records / 4; ++r )
+        {
+            long long before = SensorStats::Now();
+
+            log.Append( &frames[ ( r % 4096 ) * Honeywell6130Sensor::FRAME_SIZE ], timeOf( r ) );
+
+            appendLatency.Record( SensorStats::Now() - before );
+        }
+
+        LatencyHistogram::Counts counts;
+
+        appendLatency.Snapshot( counts );
+
+        printf( "append      %6.1f ns/record  p99: <%lluns  p99.9: <%lluns  max: %lluns  segments: %u\n",
+                appendSeconds * 1e9 / records,
+                counts.PercentileNanoseconds( 0.99 ),
+                counts.PercentileNanoseconds( 0.999 ),
+                counts.maxNanoseconds,
+                ( unsigned int ) log.SegmentCount() );
+
+        printf( "size        %6.2f bytes/sample in segments, %.1f as text\n",
+                ( double ) log.FileBytes() / log.RecordCount(), textBytes );
+
+        // Full scan over the raw records, then through HistoryEntry
+        std::vector< LogSpan > spans;
+
+        start = wallSeconds();
+
+        log.Query( 0, timeOf( records * 2 ), spans );
+
+        unsigned long long scanned = 0;
+        unsigned long long temperatureTotal = 0;
+
+        for ( size_t s = 0; s < spans.size(); ++s )
+        {
+            const LogRecord* raw = spans[ s ].Records();
+
+            for ( size_t r = 0; r < spans[ s ].Size(); ++r )
+            {
+                temperatureTotal += ( raw[ r ].frame & 0xffff ) >> 2;
+            }
+
+            scanned += spans[ s ].Size();
+        }
+
+        double scanSeconds = wallSeconds() - start;
+
+        start = wallSeconds();
+
+        double celciusTotal = 0;
+
+        for ( size_t s = 0; s < spans.size(); ++s )
+        {
+            for ( const HistoryEntry& entry : spans[ s ] )
+            {
+                celciusTotal += entry.Celcius();
+            }
+        }
+
+        double decodeSeconds = wallSeconds() - start;
+
+        printf( "scan        %6.2f GB/s raw (%llu records, %zu spans)  %.1f M records/s decoded  mean: %.0f counts, %.2fC\n",
+                scanned * sizeof( LogRecord ) / scanSeconds / 1e9,
+                scanned,
+                spans.size(),
+                scanned / decodeSeconds / 1e6,
+                ( double ) temperatureTotal / scanned,
+                celciusTotal / scanned );
+
+        // An hour from the middle, many times
+        const int QUERIES = 10000;
+
+        start = wallSeconds();
+
+        size_t hourRecords = 0;
+
+        for ( int q = 0; q < QUERIES; ++q )
+        {
+            long long from = timeOf( ( records / 2 + q * 97 ) % records );
+
+            log.Query( from, from + 3600LL * 1000000, spans );
+
+            for ( size_t s = 0; s < spans.size(); ++s )
+            {
+                hourRecords += spans[ s ].Size();
+            }
+        }
+
+        printf( "query       %6.2f us for an hour of samples (%zu records)\n",
+                ( wallSeconds() - start ) * 1e6 / QUERIES,
+                hourRecords / QUERIES );
+
+        LogSummary summary;
+
+        start = wallSeconds();
+
+        log.Summarize( timeOf( 100 ), timeOf( records - 100 ), summary );
+
+        printf( "summarize   %6.2f us over %llu records  temperature counts %u - %u\n",
+                ( wallSeconds() - start ) * 1e6,
+                summary.count,
+                summary.minTemperature,
+                summary.maxTemperature );
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+        removeLog( directory );
+        return 1;
+    }
+
+    removeLog( directory );
+
+    // Kill a writer mid-stream and recover what it left
+    pid_t child = fork();
+
+    if ( 0 == child )
+    {
+        try
+        {
+            SampleLog log( directory );
+
+            for ( long long r = 0; ; ++r )
+            {
+                log.Append( &frames[ ( r % 4096 ) * Honeywell6130Sensor::FRAME_SIZE ], timeOf( r ) );
+            }
+        }
+        catch( SensorException& )
+        {
+        }
+
+        _exit( 1 );
+    }
+
+    usleep( 200000 );
+
+    kill( child, SIGKILL );
+    waitpid( child, 0, 0 );
+
+    try
+    {
+        double start = wallSeconds();
+
+        SampleLog log( directory );
+
+        double openSeconds = wallSeconds() - start;
+
+        std::vector< LogSpan > spans;
+
+        log.Query( 0, timeOf( log.RecordCount() * 2 ), spans );
+
+        // Every surviving record must be the one written at its place
+        unsigned long long checked = 0;
+        unsigned long long wrong = 0;
+
+        for ( size_t s = 0; s < spans.size(); ++s )
+        {
+            for ( const HistoryEntry& entry : spans[ s ] )
+            {
+                unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+                entry.Frame( frame );
+
+                if ( entry.TimeMicroseconds() != timeOf( checked ) ||
+                     0 != memcmp( frame, &frames[ ( checked % 4096 ) * Honeywell6130Sensor::FRAME_SIZE ], sizeof( frame ) ) )
+                {
+                    ++wrong;
+                }
+
+                ++checked;
+            }
+        }
+
+        printf( "recovery    %6.2f ms to open  records: %llu  tail block: %u  discarded: %u  wrong: %llu\n",
+                openSeconds * 1e3,
+                log.RecordCount(),
+                ( unsigned int ) log.RecoveredCount(),
+                ( unsigned int ) log.DiscardedCount(),
+                wrong );
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+    }
+
+    removeLog( directory );
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    removeLog()
+
+DESCRIPTION:
+    Deletes benchLog()'s scratch directory and its segments
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void removeLog( const char* directory )
+{
+    DIR* listing = opendir( directory );
+
+    if ( 0 == listing )
+    {
+        return;
+    }
+
+    while ( struct dirent* entry = readdir( listing ) )
+    {
+        if ( '.' != entry->d_name[ 0 ] )
+        {
+            std::string path = std::string( directory ) + "/" + entry->d_name;
+
+            unlink( path.c_str() );
+        }
+    }
+
+    closedir( listing );
+
+    rmdir( directory );
+}
+
+/*======================================================================
+FUNCTION:
+    benchSinks()
+
+DESCRIPTION:
+    Writes the same decoded readings to /dev/null the way the
+    printer used to (an ostream with endl, then snprintf with a
+    flush per line) and through every sink, and reports lines per
+    second, bytes per line and write(2) calls.  Then checks
+    FormatFixed() against printf's "%.2f" over every count the
+    sensor can produce.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchSinks( int argc, char* argv[] )
+{
+    const long long records = ( 0 < argc ) ? atoll( argv[ 0 ] ) : 1000000;
+
+    if ( records <= 0 )
+    {
+        printf( "expected a record count above zero\n" );
+        return 1;
+    }
+
+    int devNull = open( "/dev/null", O_WRONLY );
+
+    if ( devNull < 0 )
+    {
+        printf( "Failed to open /dev/null\n" );
+        return 1;
+    }
+
+    // Readings as they come out of Decode(), so the floats have the
+    // usual untidy tails
+    std::vector< TempHumidityData > readings( 4096 );
+
+    for ( size_t r = 0; r < readings.size(); ++r )
+    {
+        unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+        unsigned int humidity    = ( unsigned int ) ( 4000 + r * 3 );
+        unsigned int temperature = ( unsigned int ) ( 5500 + r % 1500 );
+
+        frame[ 0 ] = ( unsigned char ) ( humidity >> 8 );
+        frame[ 1 ] = ( unsigned char ) humidity;
+        frame[ 2 ] = ( unsigned char ) ( temperature >> 6 );
+        frame[ 3 ] = ( unsigned char ) ( temperature << 2 );
+
+        Honeywell6130Sensor::Decode( frame, readings[ r ] );
+    }
+
+    long long baseTime = SensorFleet::WallClockMicroseconds();
+
+    printf( "%-24s %12s %10s %12s %12s\n", "", "lines/sec", "ns/line", "bytes/line", "writes" );
+
+    // The printer as it was: floats through operator<< and endl
+    {
+        std::ofstream out( "/dev/null" );
+
+        double start = wallSeconds();
+
+        for ( long long r = 0; r < records; ++r )
+        {
+            const TempHumidityData& data = readings[ r % readings.size() ];
+
+            out << "Sensor: " << ( r & 7 ) << "  TempC: " << data.tempCelcius << "  TempF: " << data.tempFahrenheit
+                << "  Humidity: " << data.relativeHumidity << std::endl;
+        }
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-24s %12.0f %10.1f %12s %12lld\n", "ostream << endl", records / seconds, seconds * 1e9 / records, "-", records );
+    }
+
+    // And snprintf into a line, then cout << line << flush
+    {
+        std::ofstream out( "/dev/null" );
+
+        double start = wallSeconds();
+
+        for ( long long r = 0; r < records; ++r )
+        {
+            const TempHumidityData& data = readings[ r % readings.size() ];
+
+            char line[ 128 ];
+
+            snprintf( line, sizeof( line ), "Sensor: %u  TempC: %g  TempF: %g  Humidity: %g\n",
+                      ( unsigned int ) ( r & 7 ), data.tempCelcius, data.tempFahrenheit, data.relativeHumidity );
+
+            out << line << std::flush;
+        }
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-24s %12.0f %10.1f %12s %12lld\n", "snprintf, flush", records / seconds, seconds * 1e9 / records, "-", records );
+    }
+
+    struct
+    {
+        const char* label;
+        const char* format;
+        SinkWriter::FlushPolicy policy;
+    }
+    sinks[] =
+    {
+        { "text, every record",  "text",   SinkWriter::FLUSH_EVERY_RECORD },
+        { "text",                "text",   SinkWriter::FLUSH_WHEN_FULL },
+        { "csv",                 "csv",    SinkWriter::FLUSH_WHEN_FULL },
+        { "json",                "json",   SinkWriter::FLUSH_WHEN_FULL },
+        { "binary",              "binary", SinkWriter::FLUSH_WHEN_FULL },
+        { "json, interval",      "json",   SinkWriter::FLUSH_INTERVAL },
+    };
+
+    for ( size_t s = 0; s < sizeof( sinks ) / sizeof( sinks[ 0 ] ); ++s )
+    {
+        SinkWriter writer( devNull, sinks[ s ].policy );
+
+        SampleSink* sink = SampleSink::Create( sinks[ s ].format, writer );
+
+        double start = wallSeconds();
+
+        sink->Begin();
+
+        for ( long long r = 0; r < records; ++r )
+        {
+            sink->Write( ( size_t ) ( r & 7 ), baseTime + r * 1000000, readings[ r % readings.size() ] );
+        }
+
+        writer.Flush();
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-24s %12.0f %10.1f %12.1f %12llu\n",
+                sinks[ s ].label,
+                records / seconds,
+                seconds * 1e9 / records,
+                ( double ) writer.ByteCount() / records,
+                writer.WriteCount() );
+
+        delete sink;
+    }
+
+    close( devNull );
+
+    // Every value the sensor can report, against printf
+    unsigned long long mismatches = 0;
+    unsigned long long compared   = 0;
+
+    for ( unsigned int count = 0; count < 16384; ++count )
+    {
+        double values[ 3 ] =
+        {
+            count * 165.0f / 16383 - 40,
+            ( count * 165.0f / 16383 - 40 ) * 1.8f + 32,
+            count * 100.0f / 16383
+        };
+
+        for ( size_t v = 0; v < 3; ++v )
+        {
+            char fast[ 32 ];
+            char slow[ 32 ];
+
+            size_t length = FormatFixed( ( float ) values[ v ], 2, fast );
+
+            snprintf( slow, sizeof( slow ), "%.2f", ( float ) values[ v ] );
+
+            fast[ length ] = 0;
+
+            if ( 0 != strcmp( fast, slow ) )
+            {
+                ++mismatches;
+            }
+
+            ++compared;
+        }
+    }
+
+    printf( "FormatFixed vs \"%%.2f\": %llu of %llu sensor values differ\n", mismatches, compared );
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchWindows()
+
+DESCRIPTION:
+    Feeds a day's worth of 1Hz random walk readings per sensor
+    through a WindowAggregator with one minute tumbling windows,
+    then with five minute sliding windows as well, and reports
+    updates per second.  The same minutes are also rolled up the
+    obvious way (keep the readings, sort at the end) to compare
+    speed and to check the percentiles, and every sensor's windows
+    are merged and checked against one aggregator that saw all the
+    readings.  The sliding extremes are checked against a brute
+    force scan.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchWindows( int argc, char* argv[] )
+{
+    const long long updates = ( 0 < argc ) ? atoll( argv[ 0 ] ) : 10000000;
+    const int sensors       = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 16;
+
+    if ( updates <= 0 || sensors <= 0 )
+    {
+        printf( "expected an update count and a sensor count above zero\n" );
+        return 1;
+    }
+
+    const long long MINUTE = 60000000;
+
+    // A slow random walk per channel, the same for every sensor but
+    // offset so the sensors differ
+    const size_t WALK = 1 << 16;
+
+    std::vector< unsigned int > temperatures( WALK );
+    std::vector< unsigned int > humidities( WALK );
+
+    unsigned int seed = 1;
+
+    int temperature = 6000;
+    int humidity    = 7000;
+
+    for ( size_t w = 0; w < WALK; ++w )
+    {
+        seed = seed * 1103515245 + 12345;
+
+        temperature += ( int ) ( ( seed >> 16 ) % 9 ) - 4;
+        humidity    += ( int ) ( ( seed >> 20 ) % 13 ) - 6;
+
+        temperature = std::min( std::max( temperature, 0 ), 0x3fff );
+        humidity    = std::min( std::max( humidity, 0 ), 0x3fff );
+
+        temperatures[ w ] = ( unsigned int ) temperature;
+        humidities[ w ]   = ( unsigned int ) humidity;
+    }
+
+    auto timeOf = [ sensors ]( long long u ) -> long long
+    {
+        return 1000000000000LL + ( u / sensors ) * 1000000 + ( u % sensors );
+    };
+
+    auto walkOf = [ sensors, WALK ]( long long u ) -> size_t
+    {
+        return ( size_t ) ( ( u / sensors ) + ( u % sensors ) * 997 ) & ( WALK - 1 );
+    };
+
+    unsigned long long windows = 0;
+
+    WindowAggregator::WindowHandler count = [ &windows ]( const WindowSummary& ) { ++windows; };
+
+    printf( "%-28s %12s %10s\n", "", "updates/sec", "ns/update" );
+
+    {
+        WindowAggregator aggregator( sensors, MINUTE, count );
+
+        double start = wallSeconds();
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            size_t w = walkOf( u );
+
+            aggregator.AddCounts( ( size_t ) ( u % sensors ), timeOf( u ), temperatures[ w ], humidities[ w ] );
+        }
+
+        aggregator.FlushTumbling();
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-28s %12.0f %10.1f   (%llu windows)\n", "tumbling 1 minute", updates / seconds, seconds * 1e9 / updates, windows );
+    }
+
+    {
+        WindowAggregator aggregator( sensors, MINUTE, count, 5 * MINUTE, 512 );
+
+        double start = wallSeconds();
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            size_t w = walkOf( u );
+
+            aggregator.AddCounts( ( size_t ) ( u % sensors ), timeOf( u ), temperatures[ w ], humidities[ w ] );
+        }
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-28s %12.0f %10.1f   (overflows: %llu)\n", "+ sliding 5 minutes", updates / seconds, seconds * 1e9 / updates,
+                aggregator.SlidingOverflowCount() );
+    }
+
+    {
+        WindowAggregator aggregator( sensors, MINUTE, count );
+
+        std::vector< TempHumidityData > decoded( WALK );
+
+        for ( size_t w = 0; w < WALK; ++w )
+        {
+            decoded[ w ] = consistentReading( 0 );
+
+            decoded[ w ].tempCelcius      = ( float ) WindowSummary::Celcius( temperatures[ w ] );
+            decoded[ w ].relativeHumidity = ( float ) WindowSummary::RelativeHumidity( humidities[ w ] );
+        }
+
+        double start = wallSeconds();
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            aggregator.Add( ( size_t ) ( u % sensors ), timeOf( u ), decoded[ walkOf( u ) ] );
+        }
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-28s %12.0f %10.1f\n", "tumbling, from decoded data", updates / seconds, seconds * 1e9 / updates );
+    }
+
+    // Keep each minute's readings and sort them when it ends
+    {
+        std::vector< std::vector< unsigned int > > open( sensors );
+
+        std::vector< long long > openStart( sensors, -1 );
+
+        double checksum = 0;
+
+        auto close = [ &checksum ]( std::vector< unsigned int >& values )
+        {
+            double sum = 0;
+            double squares = 0;
+
+            for ( size_t v = 0; v < values.size(); ++v )
+            {
+                sum     += values[ v ];
+                squares += ( double ) values[ v ] * values[ v ];
+            }
+
+            std::sort( values.begin(), values.end() );
+
+            checksum += sum / values.size() + squares + values.front() + values.back() + values[ values.size() / 2 ];
+
+            values.clear();
+        };
+
+        double start = wallSeconds();
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            size_t sensor = ( size_t ) ( u % sensors );
+            long long time = timeOf( u );
+
+            if ( openStart[ sensor ] != time - time % MINUTE && !open[ sensor ].empty() )
+            {
+                close( open[ sensor ] );
+            }
+
+            openStart[ sensor ] = time - time % MINUTE;
+
+            open[ sensor ].push_back( temperatures[ walkOf( u ) ] );
+        }
+
+        for ( int s = 0; s < sensors; ++s )
+        {
+            if ( !open[ s ].empty() )
+            {
+                close( open[ s ] );
+            }
+        }
+
+        double seconds = wallSeconds() - start;
+
+        printf( "%-28s %12.0f %10.1f   (one channel, checksum %.3g)\n", "store and sort", updates / seconds, seconds * 1e9 / updates, checksum );
+    }
+
+    // Percentiles against the exact ones.  A window is handed out
+    // just before the first reading of the next one goes in, so the
+    // readings kept for its sensor are exactly its own.
+    {
+        std::vector< std::vector< unsigned int > > open( sensors );
+
+        std::vector< WindowSummary* > emitted;
+
+        unsigned int worst[ 3 ] = { 0, 0, 0 };
+
+        const double QUANTILES[ 3 ] = { 0.5, 0.95, 0.99 };
+
+        WindowAggregator aggregator( sensors, MINUTE, [ &open, &emitted, &worst, &QUANTILES, sensors ]( const WindowSummary& window )
+        {
+            std::vector< unsigned int >& values = open[ window.sensor ];
+
+            std::sort( values.begin(), values.end() );
+
+            for ( int q = 0; q < 3; ++q )
+            {
+                size_t rank = ( size_t ) ceil( QUANTILES[ q ] * values.size() );
+
+                unsigned int truth = values[ ( rank < 1 ? 1 : rank ) - 1 ];
+                unsigned int guess = window.temperature.Quantile( QUANTILES[ q ] );
+
+                worst[ q ] = std::max( worst[ q ], ( truth < guess ) ? guess - truth : truth - guess );
+            }
+
+            values.clear();
+
+            if ( emitted.size() < ( size_t ) sensors )
+            {
+                emitted.push_back( new WindowSummary( window ) );
+            }
+        } );
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            size_t sensor = ( size_t ) ( u % sensors );
+            size_t w = walkOf( u );
+
+            aggregator.AddCounts( sensor, timeOf( u ), temperatures[ w ], humidities[ w ] );
+
+            open[ sensor ].push_back( temperatures[ w ] );
+        }
+
+        aggregator.FlushTumbling();
+
+        printf( "percentiles vs exact over %llu windows: worst p50 %u, p95 %u, p99 %u counts (bins of %u)\n",
+                aggregator.WindowCount(), worst[ 0 ], worst[ 1 ], worst[ 2 ], 1u << QuantileSketch::SHIFT );
+
+        // Every sensor's first minute merged, against one aggregator
+        // that saw those readings as one sensor
+        WindowSummary merged = *emitted[ 0 ];
+
+        WindowSummary* single = 0;
+
+        WindowAggregator whole( 1, MINUTE, [ &single ]( const WindowSummary& window )
+        {
+            if ( 0 == single )
+            {
+                single = new WindowSummary( window );
+            }
+        } );
+
+        for ( size_t e = 1; e < emitted.size() && emitted[ e ]->startMicroseconds == emitted[ 0 ]->startMicroseconds; ++e )
+        {
+            merged.Merge( *emitted[ e ] );
+        }
+
+        for ( long long u = 0; u < updates; ++u )
+        {
+            size_t w = walkOf( u );
+
+            whole.AddCounts( 0, timeOf( u ), temperatures[ w ], humidities[ w ] );
+        }
+
+        whole.FlushTumbling();
+
+        if ( 0 != single )
+        {
+            printf( "merged %llu readings: mean off by %.2e, sd off by %.2e counts, p50 %u vs %u\n",
+                    merged.temperature.Readings(),
+                    fabs( merged.temperature.Mean() - single->temperature.Mean() ),
+                    fabs( merged.temperature.StandardDeviation() - single->temperature.StandardDeviation() ),
+                    merged.temperature.Quantile( 0.5 ),
+                    single->temperature.Quantile( 0.5 ) );
+        }
+
+        delete single;
+
+        for ( size_t e = 0; e < emitted.size(); ++e )
+        {
+            delete emitted[ e ];
+        }
+    }
+
+    // Sliding extremes and mean against a brute force scan
+    {
+        const long long SLIDING = 5 * MINUTE;
+
+        WindowAggregator aggregator( 1, 0, WindowAggregator::WindowHandler(), SLIDING, 512 );
+
+        unsigned long long wrong = 0;
+        double worstMean = 0;
+
+        const long long CHECKS = 20000;
+
+        for ( long long u = 0; u < CHECKS; ++u )
+        {
+            long long time = u * 1000000 + ( u % 3 ) * 400000;
+
+            aggregator.AddCounts( 0, time, temperatures[ u & ( WALK - 1 ) ], humidities[ u & ( WALK - 1 ) ] );
+
+            const WindowSummary* window = 0;
+
+            aggregator.Sliding( 0, window );
+
+            unsigned int low = UINT_MAX;
+            unsigned int high = 0;
+            double sum = 0;
+            unsigned long long n = 0;
+
+            for ( long long b = u; 0 <= b && ( b * 1000000 + ( b % 3 ) * 400000 ) > time - SLIDING; --b )
+            {
+                unsigned int value = temperatures[ b & ( WALK - 1 ) ];
+
+                low  = std::min( low, value );
+                high = std::max( high, value );
+                sum += value;
+                ++n;
+            }
+
+            if ( low != window->temperature.Min() || high != window->temperature.Max() || n != window->temperature.Readings() )
+            {
+                ++wrong;
+            }
+
+            worstMean = std::max( worstMean, fabs( sum / n - window->temperature.Mean() ) );
+        }
+
+        printf( "sliding vs brute force over %lld readings: %llu wrong extremes/counts, mean off by at most %.2e counts\n",
+                CHECKS, wrong, worstMean );
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    benchDeadband()
+
+DESCRIPTION:
+    Makes a day (or the given hours) of 1Hz readings per sensor: a
+    slow daily swing in both channels, a twenty minute heating
+    cycle on top and the simulator's noise of a few counts.  Runs
+    them through a DeadbandFilter with a range of bands and reports
+    the share suppressed, the CSV bytes that would still be written,
+    and the time per decision.  Every suppressed reading is checked
+    against the last one passed, which must be within the band.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchDeadband( int argc, char* argv[] )
+{
+    const long long hours = ( 0 < argc ) ? atoll( argv[ 0 ] ) : 24;
+    const int sensors     = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 16;
+
+    if ( hours <= 0 || sensors <= 0 )
+    {
+        printf( "expected an hour count and a sensor count above zero\n" );
+        return 1;
+    }
+
+    int devNull = open( "/dev/null", O_WRONLY );
+
+    if ( devNull < 0 )
+    {
+        printf( "Failed to open /dev/null\n" );
+        return 1;
+    }
+
+    const long long seconds = hours * 3600;
+    const size_t readings   = ( size_t ) ( seconds * sensors );
+    const long long base    = 1000000000000LL;
+
+    const double celciusPerCount  = Hih6130::TEMPERATURE_SPAN / 16383;
+    const double humidityPerCount = Hih6130::HUMIDITY_SPAN / 16383;
+
+    // Time major, sensor minor, the way the fleet delivers them
+    std::vector< uint16_t > temperatures( readings );
+    std::vector< uint16_t > humidities( readings );
+
+    unsigned int seed = 1;
+
+    for ( long long t = 0; t < seconds; ++t )
+    {
+        for ( int s = 0; s < sensors; ++s )
+        {
+            double phase = 2 * M_PI * t / 86400.0 + s * 0.4;
+
+            double cycle = 2 * M_PI * t / 1200.0 + s;
+
+            double celcius  = 22.0 + 1.5 * sin( phase ) + 0.3 * sin( cycle );
+            double humidity = 45.0 + 6.0 * sin( phase + 1.0 ) - 1.0 * sin( cycle );
+
+            int temperature = ( int ) ( ( celcius + Hih6130::TEMPERATURE_OFFSET ) / celciusPerCount + 0.5 );
+            int moisture    = ( int ) ( humidity / humidityPerCount + 0.5 );
+
+            seed = seed * 1103515245 + 12345;
+            temperature += ( int ) ( ( seed >> 16 ) % 9 ) - 4;
+
+            seed = seed * 1103515245 + 12345;
+            moisture += ( int ) ( ( seed >> 16 ) % 9 ) - 4;
+
+            size_t r = ( size_t ) ( t * sensors + s );
+
+            temperatures[ r ] = ( uint16_t ) std::min( std::max( temperature, 0 ), 0x3fff );
+            humidities[ r ]   = ( uint16_t ) std::min( std::max( moisture, 0 ), 0x3fff );
+        }
+    }
+
+    auto decoded = [ & ]( size_t r ) -> TempHumidityData
+    {
+        TempHumidityData data;
+
+        data.status           = 0;
+        data.tempCelcius      = ( float ) ( temperatures[ r ] * celciusPerCount - Hih6130::TEMPERATURE_OFFSET );
+        data.tempFahrenheit   = data.tempCelcius * 9 / 5 + 32;
+        data.relativeHumidity = ( float ) ( humidities[ r ] * humidityPerCount );
+
+        return data;
+    };
+
+    // What writing everything costs
+    unsigned long long allBytes = 0;
+
+    {
+        SinkWriter writer( devNull, SinkWriter::FLUSH_WHEN_FULL );
+
+        CsvSink sink( writer );
+
+        sink.Begin();
+
+        for ( size_t r = 0; r < readings; ++r )
+        {
+            sink.Write( r % sensors, base + ( long long ) ( r / sensors ) * 1000000, decoded( r ) );
+        }
+
+        writer.Flush();
+
+        allBytes = writer.ByteCount();
+    }
+
+    struct Bands
+    {
+        const char* label;
+        double celcius;
+        double humidity;
+        double fraction;
+        long long heartbeatSeconds;
+    };
+
+    const Bands bands[] =
+    {
+        { "exact repeats only",   0,    0,   0,     300 },
+        { "0.05C 0.2%RH",         0.05, 0.2, 0,     300 },
+        { "0.1C 0.5%RH (default)", 0.1, 0.5, 0,     300 },
+        { "0.2C 1%RH",            0.2,  1.0, 0,     300 },
+        { "0.1C 0.5%RH or 1%",    0.1,  0.5, 0.01,  300 },
+        { "0.1C 0.5%RH, no beat", 0.1,  0.5, 0,     0 },
+    };
+
+    printf( "%llu readings (%d sensors, %lld hours at 1Hz), %llu CSV bytes unfiltered\n\n",
+            ( unsigned long long ) readings, sensors, hours, allBytes );
+
+    printf( "%-24s %10s %10s %12s %10s %10s %10s\n",
+            "", "suppressed", "heartbeat", "CSV bytes", "reduction", "ns/offer", "max error" );
+
+    unsigned long long failures = 0;
+
+    for ( size_t b = 0; b < sizeof( bands ) / sizeof( bands[ 0 ] ); ++b )
+    {
+        DeadbandOptions options;
+
+        options.temperatureCelcius    = bands[ b ].celcius;
+        options.relativeHumidity      = bands[ b ].humidity;
+        options.relativeFraction      = bands[ b ].fraction;
+        options.heartbeatMicroseconds = bands[ b ].heartbeatSeconds * 1000000;
+
+        // The decision alone
+        double elapsed = 0;
+
+        {
+            DeadbandFilter filter( sensors, options );
+
+            unsigned long long passed = 0;
+
+            double start = wallSeconds();
+
+            for ( size_t r = 0; r < readings; ++r )
+            {
+                passed += filter.OfferCounts( r % sensors, base + ( long long ) ( r / sensors ) * 1000000,
+                                              0, temperatures[ r ], humidities[ r ] );
+            }
+
+            elapsed = wallSeconds() - start;
+
+            if ( passed != filter.PassedCount() )
+            {
+                ++failures;
+            }
+        }
+
+        // Again through a sink, checking what every suppressed
+        // reading was stood in for by
+        DeadbandFilter filter( sensors, options );
+
+        SinkWriter writer( devNull, SinkWriter::FLUSH_WHEN_FULL );
+
+        CsvSink sink( writer );
+
+        std::vector< size_t > held( sensors, 0 );
+
+        double worstCelcius  = 0;
+        double worstHumidity = 0;
+
+        sink.Begin();
+
+        for ( size_t r = 0; r < readings; ++r )
+        {
+            size_t s = r % sensors;
+
+            TempHumidityData data = decoded( r );
+
+            if ( filter.Offer( s, base + ( long long ) ( r / sensors ) * 1000000, data ) )
+            {
+                held[ s ] = r;
+
+                sink.Write( s, base + ( long long ) ( r / sensors ) * 1000000, data );
+                continue;
+            }
+
+            TempHumidityData last = decoded( held[ s ] );
+
+            double celciusError  = fabs( data.tempCelcius - last.tempCelcius );
+            double humidityError = fabs( data.relativeHumidity - last.relativeHumidity );
+
+            worstCelcius  = std::max( worstCelcius, celciusError );
+            worstHumidity = std::max( worstHumidity, humidityError );
+
+            // The float conversions leave a little slack
+            if ( std::max( options.temperatureCelcius, options.relativeFraction * fabs( last.tempCelcius ) ) + 1e-4 < celciusError ||
+                 std::max( options.relativeHumidity, options.relativeFraction * last.relativeHumidity ) + 1e-4 < humidityError )
+            {
+                ++failures;
+            }
+        }
+
+        writer.Flush();
+
+        char worst[ 32 ];
+
+        snprintf( worst, sizeof( worst ), "%.3fC %.2f%%", worstCelcius, worstHumidity );
+
+        printf( "%-24s %9.2f%% %10llu %12llu %9.1fx %10.2f %s\n",
+                bands[ b ].label,
+                filter.SuppressionRatio() * 100,
+                filter.HeartbeatCount(),
+                writer.ByteCount(),
+                ( double ) allBytes / writer.ByteCount(),
+                elapsed * 1e9 / readings,
+                worst );
+    }
+
+    // The cost of getting the counts back from decoded readings
+    {
+        DeadbandFilter filter( sensors );
+
+        std::vector< TempHumidityData > data( 65536 );
+
+        for ( size_t d = 0; d < data.size(); ++d )
+        {
+            data[ d ] = decoded( d % readings );
+        }
+
+        unsigned long long passed = 0;
+
+        double start = wallSeconds();
+
+        for ( size_t r = 0; r < readings; ++r )
+        {
+            passed += filter.Offer( r % sensors, base + ( long long ) ( r / sensors ) * 1000000, data[ r & 65535 ] );
+        }
+
+        double elapsed = wallSeconds() - start;
+
+        printf( "\nOffer() from decoded readings: %.2f ns (%llu passed)\n", elapsed * 1e9 / readings, passed );
+    }
+
+    close( devNull );
+
+    printf( "%s\n", ( 0 == failures ) ? "every suppressed reading was within its band" : "BANDS EXCEEDED" );
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchDiscover()
+
+DESCRIPTION:
+    Builds simulated buses clocked at 100kHz, each with HIH6130s at
+    a mix of default and reprogrammed addresses (36.65ms
+    conversions) and three parts that are not sensors: an EEPROM,
+    a display that reads 0xff and a real time clock whose seconds
+    register reads like a stale frame.  Then finds the sensors with
+    SensorDiscovery on every bus at once (also with the clock's
+    address left out), with the same pipelined probe one bus after
+    another, and address by address with a conversion wait for
+    each, and checks each found exactly the sensors that were put
+    there.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchDiscover( int argc, char* argv[] )
+{
+    const int busCount  = ( 0 < argc ) ? atoi( argv[ 0 ] ) : 4;
+    const int perBus    = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 4;
+
+    const int SENSOR_ADDRESSES[] = { 0x27, 0x28, 0x11, 0x45, 0x5a, 0x63, 0x70, 0x0c, 0x31, 0x3f, 0x52, 0x6e };
+
+    const int SENSOR_SLOTS = ( int ) ( sizeof( SENSOR_ADDRESSES ) / sizeof( SENSOR_ADDRESSES[ 0 ] ) );
+
+    if ( busCount <= 0 || perBus <= 0 || SENSOR_SLOTS < perBus )
+    {
+        printf( "expected a bus count above zero and 1 - %d sensors per bus\n", SENSOR_SLOTS );
+        return 1;
+    }
+
+    std::map< std::string, SimulatedI2cBus* > buses;
+
+    std::vector< std::string > names;
+
+    std::vector< SensorAddress > expected;
+
+    for ( int b = 0; b < busCount; ++b )
+    {
+        std::string name = "/dev/i2c-" + std::to_string( b + 1 );
+
+        SimulatedI2cBus* bus = new SimulatedI2cBus;
+
+        bus->SetClock( 100000 );
+
+        for ( int s = 0; s < perBus; ++s )
+        {
+            SimulatedHih6130::Config config;
+
+            config.conversionMicroseconds = 36650;
+            config.seed = ( unsigned int ) ( b * SENSOR_SLOTS + s + 1 );
+
+            bus->AddDevice( SENSOR_ADDRESSES[ s ], config );
+
+            SensorAddress sensor = { name, SENSOR_ADDRESSES[ s ] };
+
+            expected.push_back( sensor );
+        }
+
+        bus->AddForeignDevice( 0x50, { 0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70 } );
+        bus->AddForeignDevice( 0x3c, { 0xff } );
+        bus->AddForeignDevice( 0x68, { 0x45, 0x12, 0x09, 0x05, 0x17, 0x10, 0x14, 0x00 } );
+
+        buses[ name ] = bus;
+        names.push_back( name );
+    }
+
+    std::sort( expected.begin(), expected.end(), []( const SensorAddress& a, const SensorAddress& b )
+    {
+        return ( a.device != b.device ) ? a.device < b.device : a.address < b.address;
+    } );
+
+    SensorFleet::TransportFactory factory = [ &buses ]( const std::string& device ) -> I2cTransport*
+    {
+        return new SimulatedTransport( *buses[ device ] );
+    };
+
+    auto check = [ &expected ]( std::vector< SensorAddress > found ) -> bool
+    {
+        std::sort( found.begin(), found.end(), []( const SensorAddress& a, const SensorAddress& b )
+        {
+            return ( a.device != b.device ) ? a.device < b.device : a.address < b.address;
+        } );
+
+        if ( found.size() != expected.size() )
+        {
+            return false;
+        }
+
+        for ( size_t f = 0; f < found.size(); ++f )
+        {
+            if ( found[ f ].device != expected[ f ].device || found[ f ].address != expected[ f ].address )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    DiscoveryOptions options;
+
+    int failures = 0;
+
+    printf( "%d buses at 100kHz, %d sensors and 3 other parts on each, %u addresses probed per bus\n\n",
+            busCount, perBus, ( unsigned int ) options.addresses.size() );
+
+    printf( "%-30s %10s %8s\n", "", "ms", "found" );
+
+    {
+        SensorDiscovery discovery( options, factory );
+
+        std::vector< SensorAddress > found = discovery.Discover( names );
+
+        bool right = check( found );
+
+        failures += right ? 0 : 1;
+
+        printf( "%-30s %10.1f %8u%s\n", "all buses at once", discovery.ElapsedMicroseconds() / 1000.0,
+                ( unsigned int ) found.size(), right ? "" : "  WRONG" );
+
+        for ( size_t b = 0; b < discovery.Buses().size(); ++b )
+        {
+            const BusDiscovery& bus = discovery.Buses()[ b ];
+
+            printf( "    %-26s %10.1f %8u   (%u answered, %u rejected, %u claimed)\n", bus.device.c_str(),
+                    bus.elapsedMicroseconds / 1000.0, bus.recognized, bus.responding, bus.rejected, bus.claimed );
+        }
+    }
+
+    // The clock holds every bus until the timeout; told where it is,
+    // a bus takes the scan and one conversion
+    {
+        DiscoveryOptions skipClock = options;
+
+        skipClock.addresses.erase( std::find( skipClock.addresses.begin(), skipClock.addresses.end(), 0x68 ) );
+
+        SensorDiscovery discovery( skipClock, factory );
+
+        std::vector< SensorAddress > found = discovery.Discover( names );
+
+        bool right = check( found );
+
+        failures += right ? 0 : 1;
+
+        printf( "%-30s %10.1f %8u%s\n", "all at once, 0x68 left out", discovery.ElapsedMicroseconds() / 1000.0,
+                ( unsigned int ) found.size(), right ? "" : "  WRONG" );
+    }
+
+    {
+        std::vector< SensorAddress > found;
+
+        double start = wallSeconds();
+
+        for ( size_t b = 0; b < names.size(); ++b )
+        {
+            SimulatedTransport transport( *buses[ names[ b ] ] );
+
+            BusDiscovery bus;
+
+            std::vector< DiscoveredSensor > sensors;
+
+            bus.device = names[ b ];
+
+            SensorDiscovery::ProbeBus( transport, options, bus, sensors );
+
+            for ( size_t s = 0; s < sensors.size(); ++s )
+            {
+                found.push_back( sensors[ s ].sensor );
+            }
+        }
+
+        double seconds = wallSeconds() - start;
+
+        bool right = check( found );
+
+        failures += right ? 0 : 1;
+
+        printf( "%-30s %10.1f %8u%s\n", "one bus at a time", seconds * 1000, ( unsigned int ) found.size(), right ? "" : "  WRONG" );
+    }
+
+    // The obvious way: every address on its own, waiting out a
+    // conversion for each one that might be a sensor
+    {
+        std::vector< SensorAddress > found;
+
+        double start = wallSeconds();
+
+        for ( size_t b = 0; b < names.size(); ++b )
+        {
+            SimulatedTransport transport( *buses[ names[ b ] ] );
+
+            transport.Open();
+
+            for ( size_t a = 0; a < options.addresses.size(); ++a )
+            {
+                DiscoveryOptions one = options;
+
+                one.addresses.assign( 1, options.addresses[ a ] );
+
+                BusDiscovery bus;
+
+                std::vector< DiscoveredSensor > sensors;
+
+                bus.device = names[ b ];
+
+                SensorDiscovery::ProbeBus( transport, one, bus, sensors );
+
+                for ( size_t s = 0; s < sensors.size(); ++s )
+                {
+                    found.push_back( sensors[ s ].sensor );
+                }
+            }
+        }
+
+        double seconds = wallSeconds() - start;
+
+        bool right = check( found );
+
+        failures += right ? 0 : 1;
+
+        printf( "%-30s %10.1f %8u%s\n", "one address at a time", seconds * 1000, ( unsigned int ) found.size(), right ? "" : "  WRONG" );
+    }
+
+    for ( std::map< std::string, SimulatedI2cBus* >::iterator b = buses.begin(); b != buses.end(); ++b )
+    {
+        delete b->second;
+    }
+
+    printf( "%s\n", ( 0 == failures ) ? "\nevery run found exactly the sensors on the buses" : "\nDISCOVERY WRONG" );
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchReplay()
+
+DESCRIPTION:
+    Records a synthetic capture with BinarySink, checks that a replay
+    hands back every frame as it was recorded, then times a replay
+    into a handler that only counts, one through the whole printer
+    pipeline (queue, rollups and CSV to /dev/null) with the latency
+    from the push to the write, and one paced on the recorded time
+    line sped up to take about half a second
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchReplay( int argc, char* argv[] )
+{
+    const long long records = ( 0 < argc ) ? atoll( argv[ 0 ] ) : 1000000;
+    const int sensors       = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 16;
+
+    if ( records <= 0 || sensors <= 0 )
+    {
+        printf( "expected a record count and a sensor count above zero\n" );
+        return 1;
+    }
+
+    int devNull = open( "/dev/null", O_WRONLY );
+
+    if ( devNull < 0 )
+    {
+        printf( "Failed to open /dev/null\n" );
+        return 1;
+    }
+
+    char path[ 64 ];
+
+    snprintf( path, sizeof( path ), "/tmp/honeywell6130-bench-replay-%d.bin", ( int ) getpid() );
+
+    // Time major, sensor minor at 1Hz, with a stale reading now and
+    // then.  The two bits under the temperature are always 0, as
+    // Encode() writes them.
+    std::vector< unsigned char > frames( ( size_t ) records * Honeywell6130Sensor::FRAME_SIZE );
+
+    const long long base = 1000000000000LL;
+
+    unsigned int seed = 1;
+
+    for ( long long r = 0; r < records; ++r )
+    {
+        unsigned char* frame = &frames[ ( size_t ) r * Honeywell6130Sensor::FRAME_SIZE ];
+
+        seed = seed * 1103515245 + 12345;
+
+        unsigned int humidity    = ( unsigned int ) ( 6000 + r % 2000 + ( ( seed >> 16 ) % 16 ) );
+        unsigned int temperature = ( unsigned int ) ( 6200 + ( r / sensors ) % 1000 + ( ( seed >> 20 ) % 8 ) );
+        unsigned int status      = ( 0 == ( seed >> 24 ) % 16 ) ? 1 : 0;
+
+        frame[ 0 ] = ( unsigned char ) ( ( status << 6 ) | ( humidity >> 8 ) );
+        frame[ 1 ] = ( unsigned char ) humidity;
+        frame[ 2 ] = ( unsigned char ) ( temperature >> 6 );
+        frame[ 3 ] = ( unsigned char ) ( ( temperature << 2 ) & 0xfc );
+    }
+
+    auto timeOf = [ sensors, base ]( long long r ) -> long long
+    {
+        return base + ( r / sensors ) * 1000000;
+    };
+
+    int captureFile = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+    if ( captureFile < 0 )
+    {
+        printf( "Failed to create %s\n", path );
+        close( devNull );
+        return 1;
+    }
+
+    double start = wallSeconds();
+
+    {
+        SinkWriter writer( captureFile, SinkWriter::FLUSH_WHEN_FULL );
+
+        BinarySink sink( writer );
+
+        sink.Begin();
+
+        for ( long long r = 0; r < records; ++r )
+        {
+            TempHumidityData data;
+
+            Honeywell6130Sensor::Decode( &frames[ ( size_t ) r * Honeywell6130Sensor::FRAME_SIZE ], data );
+
+            sink.Write( ( size_t ) ( r % sensors ), timeOf( r ), data );
+        }
+
+        writer.Flush();
+    }
+
+    close( captureFile );
+
+    double recordSeconds = wallSeconds() - start;
+
+    int failures = 0;
+
+    try
+    {
+        SampleReplay replay( path );
+
+        printf( "%lld readings from %u sensors, %.1fMB captured in %.1fms (%.1f ns/reading)\n\n",
+                records, ( unsigned int ) replay.SensorCount(),
+                ( BinarySink::HEADER_BYTES + records * BinarySink::RECORD_BYTES ) / 1e6,
+                recordSeconds * 1e3, recordSeconds * 1e9 / records );
+
+        // Every reading back, in order, with the frame it was
+        // recorded from
+        long long next = 0;
+        long long mismatched = 0;
+
+        replay.Replay( [ & ]( const FleetSample& sample )
+        {
+            unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+            Honeywell6130Sensor::Encode( sample.data, frame );
+
+            if ( records <= next
+                 || sample.sensorIndex != ( size_t ) ( next % sensors )
+                 || sample.timeMicroseconds != timeOf( next )
+                 || 0 != memcmp( frame, &frames[ ( size_t ) next * Honeywell6130Sensor::FRAME_SIZE ], sizeof( frame ) ) )
+            {
+                ++mismatched;
+            }
+
+            ++next;
+        } );
+
+        if ( next != records || 0 != mismatched || 0 != replay.SkippedCount() )
+        {
+            printf( "FAILED: %lld of %lld readings replayed, %lld not as recorded, %llu skipped\n",
+                    next, records, mismatched, replay.SkippedCount() );
+            ++failures;
+        }
+
+        // The replay alone
+        unsigned long long stale = 0;
+
+        start = wallSeconds();
+
+        unsigned long long delivered = replay.Replay( [ &stale ]( const FleetSample& sample )
+        {
+            stale += sample.data.status;
+        } );
+
+        double elapsed = wallSeconds() - start;
+
+        printf( "fast        %6.1f ns/reading  %6.2fM readings/sec  (%llu stale)\n",
+                elapsed * 1e9 / delivered, delivered / elapsed / 1e6, stale );
+
+        // The same handler shape as ws: the replay pushes, a printer
+        // thread rolls up and writes CSV.  One producer and one
+        // consumer, so the k-th pop is the k-th push.
+        std::vector< long long > pushed( ( size_t ) records );
+
+        SampleQueue< FleetSample > queue( 1024, SampleQueue< FleetSample >::BLOCK );
+
+        LatencyHistogram latency;
+
+        unsigned long long windows = 0;
+
+        std::thread printer( [ & ]()
+        {
+            WindowAggregator rollups( sensors, 60000000, [ &windows ]( const WindowSummary& )
+            {
+                ++windows;
+            } );
+
+            SinkWriter writer( devNull, SinkWriter::FLUSH_INTERVAL );
+
+            CsvSink sink( writer );
+
+            sink.Begin();
+
+            FleetSample sample;
+
+            size_t popped = 0;
+
+            for ( ;; )
+            {
+                if ( !queue.TryPop( sample ) )
+                {
+                    writer.Idle();
+
+                    if ( !queue.Pop( sample ) )
+                    {
+                        break;
+                    }
+                }
+
+                rollups.Add( sample.sensorIndex, sample.timeMicroseconds, sample.data );
+
+                sink.Write( sample.sensorIndex, sample.timeMicroseconds, sample.data );
+
+                latency.Record( SensorStats::Now() - pushed[ popped++ ] );
+            }
+
+            rollups.FlushTumbling();
+
+            writer.Flush();
+        } );
+
+        size_t pushes = 0;
+
+        start = wallSeconds();
+
+        delivered = replay.Replay( [ &queue, &pushed, &pushes ]( const FleetSample& sample )
+        {
+            pushed[ pushes++ ] = SensorStats::Now();
+
+            queue.Push( sample );
+        } );
+
+        queue.Close();
+
+        printer.join();
+
+        elapsed = wallSeconds() - start;
+
+        LatencyHistogram::Counts counts;
+
+        latency.Snapshot( counts );
+
+        printf( "pipeline    %6.1f ns/reading  %6.2fM readings/sec  push to write p50: <%lluns  p99: <%lluns  p99.9: <%lluns  max: %lluns  (%llu windows)\n",
+                elapsed * 1e9 / delivered, delivered / elapsed / 1e6,
+                counts.PercentileNanoseconds( 0.5 ),
+                counts.PercentileNanoseconds( 0.99 ),
+                counts.PercentileNanoseconds( 0.999 ),
+                counts.maxNanoseconds, windows );
+
+        if ( queue.DroppedCount() != 0 || counts.count != delivered )
+        {
+            printf( "FAILED: %llu dropped, %llu written of %llu\n",
+                    queue.DroppedCount(), counts.count, delivered );
+            ++failures;
+        }
+
+        // Paced, with the recorded span squeezed into half a second
+        double span  = ( double ) ( replay.LastMicroseconds() - replay.FirstMicroseconds() );
+        double speed = ( 0 < span ) ? span / 500000.0 : 1.0;
+
+        start = wallSeconds();
+
+        delivered = replay.Replay( [ &stale ]( const FleetSample& sample )
+        {
+            stale += sample.data.status;
+        }, SampleReplay::PACE_RECORDED, speed );
+
+        elapsed = wallSeconds() - start;
+
+        printf( "paced       %.0fx recorded speed, %.1fs of readings in %.3fs, worst lateness %.3fms\n",
+                speed, span / 1e6, elapsed, replay.MaxLatenessMicroseconds() / 1000.0 );
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+        ++failures;
+    }
+
+    unlink( path );
+
+    close( devNull );
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchPsychrometrics()
+
+DESCRIPTION:
+    Checks DerivePsychrometrics() against the double precision
+    references over the count pairs the sensor can send, then times
+    it against one reading at a time through libm, and the cache
+    against both on indoor readings (which repeat), on one minute of
+    them looked up again and again (to time the hits) and on pairs
+    picked at random (which do not repeat)
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchPsychrometrics( int argc, char* argv[] )
+{
+    const size_t readings = ( 0 < argc ) ? ( size_t ) strtoull( argv[ 0 ], 0, 0 ) : 10000000;
+
+    if ( 0 == readings )
+    {
+        printf( "expected a reading count above zero\n" );
+        return 1;
+    }
+
+    printf( "implementation: %s\n\n", DerivePsychrometricsImplementation() );
+
+    // Every temperature count against every 4th humidity count (and
+    // every one of the lowest 256, where the log is steepest), a row
+    // at a time
+    const unsigned int COUNTS = 1u << 14;
+
+    std::vector< float > celcius( COUNTS );
+    std::vector< float > humidity( COUNTS );
+
+    std::vector< float > dewPoint( COUNTS );
+    std::vector< float > heatIndex( COUNTS );
+    std::vector< float > absoluteHumidity( COUNTS );
+
+    double worstDew      = 0;
+    double worstIndex    = 0;
+    double worstAbsolute = 0;
+
+    unsigned long long checked = 0;
+
+    double start = wallSeconds();
+
+    for ( unsigned int h = 0; h < COUNTS; h += ( h < 256 ) ? 1 : 4 )
+    {
+        float rh = ArithmeticConversion< Hih6130 >::RelativeHumidity( h );
+
+        for ( unsigned int t = 0; t < COUNTS; ++t )
+        {
+            celcius[ t ]  = ArithmeticConversion< Hih6130 >::Celcius( t );
+            humidity[ t ] = rh;
+        }
+
+        DerivePsychrometrics( celcius.data(), humidity.data(), COUNTS,
+                              dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+
+        for ( unsigned int t = 0; t < COUNTS; ++t )
+        {
+            double dew      = fabs( dewPoint[ t ] - DewPointReference( celcius[ t ], rh ) );
+            double index    = fabs( heatIndex[ t ] - HeatIndexReference( celcius[ t ], rh ) );
+            double absolute = AbsoluteHumidityReference( celcius[ t ], rh );
+
+            // Relative, where there is any water to speak of
+            absolute = ( 1e-3 < absolute ) ? fabs( absoluteHumidity[ t ] - absolute ) / absolute : 0;
+
+            worstDew      = std::max( worstDew, dew );
+            worstIndex    = std::max( worstIndex, index );
+            worstAbsolute = std::max( worstAbsolute, absolute );
+        }
+
+        checked += COUNTS;
+    }
+
+    printf( "accuracy over %llu count pairs (%.1fs):\n", checked, wallSeconds() - start );
+    printf( "    dew point          %.5fC\n", worstDew );
+    printf( "    heat index         %.5fC\n", worstIndex );
+    printf( "    absolute humidity  %.2e relative\n\n", worstAbsolute );
+
+    // The bounds the header promises
+    int failures = 0;
+
+    if ( 0.0001 < worstDew || 0.002 < worstIndex || 2e-6 < worstAbsolute )
+    {
+        printf( "FAILED: outside the documented error bounds\n\n" );
+        ++failures;
+    }
+
+    // Indoor readings: a few sensors drifting a few hundred counts,
+    // time major like the fleet delivers them
+    const size_t SENSORS = 64;
+
+    std::vector< uint16_t > temperatureCounts( readings );
+    std::vector< uint16_t > humidityCounts( readings );
+
+    unsigned int seed = 1;
+
+    for ( size_t r = 0; r < readings; ++r )
+    {
+        size_t s = r % SENSORS;
+        size_t n = r / SENSORS;
+
+        seed = seed * 1103515245 + 12345;
+
+        temperatureCounts[ r ] = ( uint16_t ) ( 6300 + s * 5 + ( n / 60 ) % 120 + ( ( seed >> 16 ) % 5 ) );
+        humidityCounts[ r ]    = ( uint16_t ) ( 6500 + s * 20 + ( n / 30 ) % 300 + ( ( seed >> 20 ) % 9 ) );
+    }
+
+    celcius.resize( readings );
+    humidity.resize( readings );
+    dewPoint.resize( readings );
+    heatIndex.resize( readings );
+    absoluteHumidity.resize( readings );
+
+    for ( size_t r = 0; r < readings; ++r )
+    {
+        celcius[ r ]  = ArithmeticConversion< Hih6130 >::Celcius( temperatureCounts[ r ] );
+        humidity[ r ] = ArithmeticConversion< Hih6130 >::RelativeHumidity( humidityCounts[ r ] );
+    }
+
+    auto checksum = [ & ]() -> double
+    {
+        double sum = 0;
+
+        for ( size_t r = 0; r < readings; r += 997 )
+        {
+            sum += dewPoint[ r ] + heatIndex[ r ] + absoluteHumidity[ r ];
+        }
+
+        return sum;
+    };
+
+    printf( "%-26s %10s %12s\n", "", "ns/reading", "M readings/s" );
+
+    // Per sample through libm, the way the consumers do it
+    start = wallSeconds();
+
+    DerivePsychrometricsScalar( celcius.data(), humidity.data(), readings,
+                                dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+
+    double scalarSeconds = wallSeconds() - start;
+
+    double expected = checksum();
+
+    printf( "%-26s %10.2f %12.1f\n", "libm, one at a time", scalarSeconds * 1e9 / readings, readings / scalarSeconds / 1e6 );
+
+    start = wallSeconds();
+
+    DerivePsychrometrics( celcius.data(), humidity.data(), readings,
+                          dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+
+    double batchSeconds = wallSeconds() - start;
+
+    printf( "%-26s %10.2f %12.1f  (%.1fx)\n", "batch, all three", batchSeconds * 1e9 / readings,
+            readings / batchSeconds / 1e6, scalarSeconds / batchSeconds );
+
+    if ( 1e-3 * readings / 997 < fabs( checksum() - expected ) )
+    {
+        printf( "FAILED: the batch does not agree with the references\n" );
+        ++failures;
+    }
+
+    start = wallSeconds();
+
+    DerivePsychrometrics( celcius.data(), humidity.data(), readings, dewPoint.data(), 0, 0 );
+
+    double elapsed = wallSeconds() - start;
+
+    printf( "%-26s %10.2f %12.1f\n", "batch, dew point only", elapsed * 1e9 / readings, readings / elapsed / 1e6 );
+
+    // Through the cache: once cold, then warm, then on random pairs.
+    // The whole run's indoor pairs are far more than the cache holds,
+    // so the cold pass is the hit rate a stream really gets.  The
+    // warm pass looks up the first minute's readings, whose pairs do
+    // fit, over and over to the same total, so it times the hits.
+    PsychrometricCache cache;
+
+    const size_t MINUTE = std::min( readings, SENSORS * 60 );
+
+    const char* labels[] = { "cache, indoor, cold", "cache, one minute, warm", "cache, random pairs" };
+
+    for ( int pass = 0; pass < 3; ++pass )
+    {
+        if ( 2 == pass )
+        {
+            for ( size_t r = 0; r < readings; ++r )
+            {
+                seed = seed * 1103515245 + 12345;
+                temperatureCounts[ r ] = ( uint16_t ) ( ( seed >> 8 ) & 0x3fff );
+
+                seed = seed * 1103515245 + 12345;
+                humidityCounts[ r ] = ( uint16_t ) ( ( seed >> 8 ) & 0x3fff );
+            }
+        }
+
+        if ( 1 != pass )
+        {
+            cache.Clear();
+        }
+        else
+        {
+            cache.Derive( temperatureCounts.data(), humidityCounts.data(), MINUTE,
+                          dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+        }
+
+        unsigned long long hits   = cache.HitCount();
+        unsigned long long misses = cache.MissCount();
+
+        start = wallSeconds();
+
+        if ( 1 != pass )
+        {
+            cache.Derive( temperatureCounts.data(), humidityCounts.data(), readings,
+                          dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+        }
+        else
+        {
+            for ( size_t done = 0; done < readings; done += MINUTE )
+            {
+                cache.Derive( temperatureCounts.data(), humidityCounts.data(), std::min( MINUTE, readings - done ),
+                              dewPoint.data(), heatIndex.data(), absoluteHumidity.data() );
+            }
+        }
+
+        elapsed = wallSeconds() - start;
+
+        hits   = cache.HitCount() - hits;
+        misses = cache.MissCount() - misses;
+
+        printf( "%-26s %10.2f %12.1f  (%.1f%% hits)\n", labels[ pass ], elapsed * 1e9 / readings,
+                readings / elapsed / 1e6, 100.0 * hits / ( hits + misses ) );
+
+        if ( 1 == pass && 1e-3 * readings / 997 < fabs( checksum() - expected ) )
+        {
+            printf( "FAILED: the cache does not agree with the references\n" );
+            ++failures;
+        }
+    }
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchFilters()
+
+DESCRIPTION:
+    Runs a fleet's worth of rounds, with corrupted frames, stale and
+    missing readings and a real step change mixed in, through
+    SensorFilterBank and through a plain one sensor at a time
+    version of the same filters.  Checks that the two agree exactly,
+    then prints the update rate for each median window and how many
+    of the planted faults were caught.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchFilters( int argc, char* argv[] )
+{
+    const size_t sensors = ( 0 < argc ) ? ( size_t ) strtoull( argv[ 0 ], 0, 0 ) : 4096;
+    const size_t rounds  = ( 1 < argc ) ? ( size_t ) strtoull( argv[ 1 ], 0, 0 ) : 1000;
+
+    if ( 0 == sensors || 0 == rounds )
+    {
+        printf( "expected a sensor count and a round count above zero\n" );
+        return 1;
+    }
+
+    // Round major, like a polling round delivers them
+    std::vector< unsigned char > status( sensors * rounds );
+    std::vector< float > celcius( sensors * rounds );
+    std::vector< float > humidity( sensors * rounds );
+
+    // What was planted where: 1 corrupted, 2 stale, 3 missing
+    std::vector< unsigned char > planted( sensors * rounds, 0 );
+
+    unsigned int random = 12345;
+
+    auto next = [ &random ]() -> unsigned int
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    };
+
+    unsigned long long corrupted = 0;
+
+    for ( size_t r = 0; r < rounds; ++r )
+    {
+        for ( size_t s = 0; s < sensors; ++s )
+        {
+            size_t n = r * sensors + s;
+
+            double drift = sin( 2 * M_PI * ( r + s * 7 ) / 600.0 );
+
+            // Every 16th sensor steps up 3C half way through
+            double step = ( 0 == s % 16 && rounds / 2 <= r ) ? 3.0 : 0.0;
+
+            status[ n ]   = 0;
+            celcius[ n ]  = ( float ) ( 20.0 + ( s % 5 ) + 0.5 * drift + step + ( ( int ) ( next() % 21 ) - 10 ) * 0.01 );
+            humidity[ n ] = ( float ) ( 45.0 + ( s % 11 ) - 2.0 * drift + ( ( int ) ( next() % 41 ) - 20 ) * 0.01 );
+
+            unsigned int fault = next() % 1000;
+
+            if ( fault < 2 )
+            {
+                // Fresh status, nonsense counts: all ones, or a bit
+                // flip's worth of jump
+                status[ n ]   = 0;
+                celcius[ n ]  = ( 0 == fault ) ? 125.0f : celcius[ n ] + 20.0f;
+                humidity[ n ] = ( 0 == fault ) ? 100.0f : humidity[ n ];
+                planted[ n ]  = 1;
+                ++corrupted;
+            }
+            else if ( fault < 3 )
+            {
+                status[ n ]  = 1;
+                planted[ n ] = 2;
+            }
+            else if ( fault < 8 )
+            {
+                status[ n ]  = SensorFilterBank::STATUS_MISSING;
+                planted[ n ] = 3;
+            }
+        }
+    }
+
+    printf( "%llu sensor updates (%u sensors x %u rounds), implementation: %s\n\n",
+            ( unsigned long long ) ( sensors * rounds ), ( unsigned int ) sensors, ( unsigned int ) rounds,
+            SensorFilterBank::Implementation() );
+
+    // The same filters, one sensor at a time, the obvious way
+    struct Plain
+    {
+        float ema[ 2 ];
+        float kalman[ 2 ];
+        float variance[ 2 ];
+        float median[ 2 ];
+        float window[ 2 ][ SensorFilterBank::MAX_MEDIAN_WINDOW ];
+        bool primed;
+    };
+
+    int failures = 0;
+
+    printf( "%-22s %12s %14s\n", "", "ns/update", "M updates/s" );
+
+    const unsigned int windows[] = { 1, 3, 5, 7 };
+
+    for ( size_t w = 0; w < sizeof( windows ) / sizeof( windows[ 0 ] ); ++w )
+    {
+        FilterBankOptions options;
+
+        options.medianWindow = windows[ w ];
+
+        const unsigned int N = options.medianWindow;
+
+        // One at a time
+        std::vector< Plain > plain( sensors );
+
+        memset( plain.data(), 0, plain.size() * sizeof( Plain ) );
+
+        std::vector< unsigned char > plainReasons( sensors * rounds );
+
+        const float process[ 2 ] = { options.processCelcius, options.processHumidity };
+        const float noise[ 2 ]   = { options.noiseCelcius, options.noiseHumidity };
+        const float spike[ 2 ]   = { options.spikeCelcius, options.spikeHumidity };
+
+        double start = wallSeconds();
+
+        for ( size_t r = 0; r < rounds; ++r )
+        {
+            unsigned int slot = ( unsigned int ) ( r % N );
+
+            for ( size_t s = 0; s < sensors; ++s )
+            {
+                size_t n = r * sensors + s;
+
+                Plain& p = plain[ s ];
+
+                const float x[ 2 ] = { celcius[ n ], humidity[ n ] };
+
+                if ( 3 < status[ n ] )
+                {
+                    plainReasons[ n ] = SensorFilterBank::REJECT_MISSING;
+                    continue;
+                }
+
+                if ( 0 != status[ n ] )
+                {
+                    plainReasons[ n ] = SensorFilterBank::REJECT_STATUS;
+                    continue;
+                }
+
+                if ( !( options.minCelcius <= x[ 0 ] && x[ 0 ] <= options.maxCelcius &&
+                        options.minHumidity <= x[ 1 ] && x[ 1 ] <= options.maxHumidity ) )
+                {
+                    plainReasons[ n ] = SensorFilterBank::REJECT_RANGE;
+                    continue;
+                }
+
+                unsigned char reason = 0;
+                float median[ 2 ] = { x[ 0 ], x[ 1 ] };
+
+                for ( int c = 0; c < 2; ++c )
+                {
+                    if ( 1 == N )
+                    {
+                        continue;
+                    }
+
+                    for ( unsigned int k = 0; k < N; ++k )
+                    {
+                        if ( !p.primed || k == slot )
+                        {
+                            p.window[ c ][ k ] = x[ c ];
+                        }
+                    }
+
+                    float sorted[ SensorFilterBank::MAX_MEDIAN_WINDOW ];
+
+                    memcpy( sorted, p.window[ c ], N * sizeof( float ) );
+
+                    for ( unsigned int k = 1; k < N; ++k )
+                    {
+                        for ( unsigned int m = k; 0 < m && sorted[ m ] < sorted[ m - 1 ]; --m )
+                        {
+                            std::swap( sorted[ m ], sorted[ m - 1 ] );
+                        }
+                    }
+
+                    median[ c ] = sorted[ N / 2 ];
+
+                    if ( p.primed && fabsf( x[ c ] - median[ c ] ) > spike[ c ] )
+                    {
+                        reason |= ( 0 == c ) ? SensorFilterBank::REJECT_TEMPERATURE_SPIKE
+                                             : SensorFilterBank::REJECT_HUMIDITY_SPIKE;
+                    }
+                }
+
+                plainReasons[ n ] = reason;
+
+                for ( int c = 0; c < 2; ++c )
+                {
+                    p.median[ c ] = median[ c ];
+
+                    if ( 0 != reason )
+                    {
+                        continue;
+                    }
+
+                    if ( !p.primed )
+                    {
+                        p.ema[ c ]      = x[ c ];
+                        p.kalman[ c ]   = x[ c ];
+                        p.variance[ c ] = noise[ c ];
+                        continue;
+                    }
+
+                    p.ema[ c ] = p.ema[ c ] + options.emaAlpha * ( x[ c ] - p.ema[ c ] );
+
+                    float predicted = p.variance[ c ] + process[ c ];
+                    float gain      = predicted / ( predicted + noise[ c ] );
+
+                    p.kalman[ c ]   = p.kalman[ c ] + gain * ( x[ c ] - p.kalman[ c ] );
+                    p.variance[ c ] = ( 1.0f - gain ) * predicted;
+                }
+
+                p.primed = true;
+            }
+        }
+
+        double plainSeconds = wallSeconds() - start;
+
+        // The bank
+        SensorFilterBank bank( sensors, options );
+
+        std::vector< unsigned char > reasons( sensors * rounds );
+
+        start = wallSeconds();
+
+        for ( size_t r = 0; r < rounds; ++r )
+        {
+            bank.Update( &status[ r * sensors ], &celcius[ r * sensors ], &humidity[ r * sensors ],
+                         sensors, &reasons[ r * sensors ] );
+        }
+
+        double bankSeconds = wallSeconds() - start;
+
+        char label[ 32 ];
+
+        snprintf( label, sizeof( label ), "median of %u, plain", N );
+        printf( "%-22s %12.2f %14.1f\n", label, plainSeconds * 1e9 / ( sensors * rounds ),
+                sensors * rounds / plainSeconds / 1e6 );
+
+        snprintf( label, sizeof( label ), "median of %u, bank", N );
+        printf( "%-22s %12.2f %14.1f  (%.1fx)\n", label, bankSeconds * 1e9 / ( sensors * rounds ),
+                sensors * rounds / bankSeconds / 1e6, plainSeconds / bankSeconds );
+
+        // Bit for bit the same
+        size_t differences = ( 0 != memcmp( reasons.data(), plainReasons.data(), reasons.size() ) ) ? 1 : 0;
+
+        for ( size_t s = 0; s < sensors; ++s )
+        {
+            const Plain& p = plain[ s ];
+
+            if ( p.ema[ 0 ] != bank.EmaCelcius()[ s ] || p.ema[ 1 ] != bank.EmaHumidity()[ s ] ||
+                 p.kalman[ 0 ] != bank.KalmanCelcius()[ s ] || p.kalman[ 1 ] != bank.KalmanHumidity()[ s ] ||
+                 p.median[ 0 ] != bank.MedianCelcius()[ s ] || p.median[ 1 ] != bank.MedianHumidity()[ s ] )
+            {
+                ++differences;
+            }
+        }
+
+        if ( 0 != differences )
+        {
+            printf( "FAILED: the bank and the plain filters disagree\n" );
+            ++failures;
+        }
+
+        if ( 5 != N )
+        {
+            continue;
+        }
+
+        // How the faults came out with the default window
+        unsigned long long caught = 0;
+        unsigned long long falseRejects = 0;
+        unsigned long long clean = 0;
+
+        for ( size_t n = 0; n < reasons.size(); ++n )
+        {
+            if ( 1 == planted[ n ] )
+            {
+                caught += ( 0 != reasons[ n ] ) ? 1 : 0;
+            }
+            else if ( 0 == planted[ n ] )
+            {
+                ++clean;
+                falseRejects += ( 0 != reasons[ n ] ) ? 1 : 0;
+            }
+        }
+
+        // Rounds the step sensors took to be believed
+        size_t worstStep = 0;
+
+        for ( size_t s = 0; s < sensors; s += 16 )
+        {
+            size_t r = rounds / 2;
+
+            while ( r < rounds && 0 != reasons[ r * sensors + s ] )
+            {
+                ++r;
+            }
+
+            worstStep = std::max( worstStep, r - rounds / 2 );
+        }
+
+        printf( "    corrupted caught %llu of %llu, clean rejected %llu of %llu (mostly the steps), "
+                "steps believed after %u rounds at worst\n"
+                "    rejected: %llu missing, %llu status, %llu range, %llu temperature spike, %llu humidity spike\n",
+                caught, corrupted, falseRejects, clean, ( unsigned int ) worstStep,
+                bank.RejectedCount( SensorFilterBank::REJECT_MISSING ),
+                bank.RejectedCount( SensorFilterBank::REJECT_STATUS ),
+                bank.RejectedCount( SensorFilterBank::REJECT_RANGE ),
+                bank.RejectedCount( SensorFilterBank::REJECT_TEMPERATURE_SPIKE ),
+                bank.RejectedCount( SensorFilterBank::REJECT_HUMIDITY_SPIKE ) );
+    }
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    benchFootprint()
+
+DESCRIPTION:
+    Runs each build of ws against a simulated sensor a few times and
+    prints what it costs to have it on the device: the file size and
+    the bytes its segments load, how long from fork() to the first
+    reading on its output, its peak resident set and its heap at
+    that point.  The defaults are Debug/ws, Release/ws and
+    Embedded/ws, so run it from the directory wsmake builds in.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchFootprint( int argc, char* argv[] )
+{
+    static const char* DEFAULT_BINARIES[] = { "Debug/ws", "Release/ws", "Embedded/ws" };
+
+    int runs = ( 1 <= argc ) ? atoi( argv[ 0 ] ) : 5;
+
+    if ( runs < 1 )
+    {
+        runs = 1;
+    }
+
+    std::vector< const char* > binaries;
+
+    for ( int a = 1; a < argc; ++a )
+    {
+        binaries.push_back( argv[ a ] );
+    }
+
+    if ( binaries.empty() )
+    {
+        binaries.assign( DEFAULT_BINARIES, DEFAULT_BINARIES + 3 );
+    }
+
+    printf( "%d runs each, --simulate /dev/i2c-1:0x27 on a pseudo terminal\n", runs );
+    printf( "%-20s %10s %10s %12s %12s %10s %10s\n",
+            "binary", "file KB", "load KB", "first ms", "(median)", "peak KB", "heap KB" );
+
+    int failures = 0;
+
+    for ( size_t b = 0; b < binaries.size(); ++b )
+    {
+        struct stat status;
+
+        if ( 0 != stat( binaries[ b ], &status ) )
+        {
+            printf( "%-20s not built\n", binaries[ b ] );
+            continue;
+        }
+
+        std::vector< double > firstSeconds;
+
+        long peakKilobytes = 0;
+        long heapKilobytes = 0;
+
+        for ( int r = 0; r < runs; ++r )
+        {
+            double seconds = 0;
+            long peak = 0;
+            long heap = 0;
+
+            if ( !runToFirstSample( binaries[ b ], seconds, peak, heap ) )
+            {
+                break;
+            }
+
+            firstSeconds.push_back( seconds );
+
+            peakKilobytes = std::max( peakKilobytes, peak );
+            heapKilobytes = std::max( heapKilobytes, heap );
+        }
+
+        if ( firstSeconds.size() != ( size_t ) runs )
+        {
+            printf( "%-20s never printed a reading\n", binaries[ b ] );
+            ++failures;
+            continue;
+        }
+
+        std::sort( firstSeconds.begin(), firstSeconds.end() );
+
+        printf( "%-20s %10.1f %10.1f %12.2f %12.2f %10ld %10ld\n",
+                binaries[ b ],
+                status.st_size / 1024.0,
+                loadedBytes( binaries[ b ] ) / 1024.0,
+                firstSeconds.front() * 1e3,
+                firstSeconds[ firstSeconds.size() / 2 ] * 1e3,
+                peakKilobytes,
+                heapKilobytes );
+    }
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    loadedBytes()
+
+DESCRIPTION:
+    Adds up the memory sizes of an ELF file's loadable segments,
+    32 or 64 bit, which is what it takes in memory before it has
+    done anything (and unlike the file size, leaves out the symbols
+    and debug information)
+
+RETURN VALUE:
+    unsigned long long - 0 if it is not an ELF file
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static unsigned long long loadedBytes( const char* path )
+{
+    std::ifstream file( path, std::ios::binary );
+
+    unsigned char ident[ EI_NIDENT ] = { 0 };
+
+    file.read( ( char* ) ident, EI_NIDENT );
+
+    if ( !file || 0 != memcmp( ident, ELFMAG, SELFMAG ) )
+    {
+        return 0;
+    }
+
+    unsigned long long total = 0;
+
+    if ( ELFCLASS64 == ident[ EI_CLASS ] )
+    {
+        Elf64_Ehdr header;
+
+        file.seekg( 0 );
+        file.read( ( char* ) &header, sizeof( header ) );
+
+        for ( unsigned int p = 0; file && p < header.e_phnum; ++p )
+        {
+            Elf64_Phdr segment;
+
+            file.seekg( header.e_phoff + p * header.e_phentsize );
+            file.read( ( char* ) &segment, sizeof( segment ) );
+
+            total += ( PT_LOAD == segment.p_type ) ? segment.p_memsz : 0;
+        }
+    }
+    else
+    {
+        Elf32_Ehdr header;
+
+        file.seekg( 0 );
+        file.read( ( char* ) &header, sizeof( header ) );
+
+        for ( unsigned int p = 0; file && p < header.e_phnum; ++p )
+        {
+            Elf32_Phdr segment;
+
+            file.seekg( header.e_phoff + p * header.e_phentsize );
+            file.read( ( char* ) &segment, sizeof( segment ) );
+
+            total += ( PT_LOAD == segment.p_type ) ? segment.p_memsz : 0;
+        }
+    }
+
+    return total;
+}
+
+/*======================================================================
+FUNCTION:
+    runToFirstSample()
+
+DESCRIPTION:
+    Starts the binary with a pseudo terminal for its output (so ws
+    writes each line as it has it, the way it would to a console),
+    waits for the first line with a reading in it, reads the size of
+    its heap from /proc and then kills it.  The peak resident set is
+    the kernel's, from wait4().
+
+RETURN VALUE:
+    bool - false if it could not be started or printed no reading
+           within ten seconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool runToFirstSample( const char* binary, double& seconds, long& peakKilobytes, long& heapKilobytes )
+{
+    int terminal = posix_openpt( O_RDWR | O_NOCTTY | O_CLOEXEC );
+
+    if ( terminal < 0 || 0 != grantpt( terminal ) || 0 != unlockpt( terminal ) )
+    {
+        perror( "posix_openpt" );
+        return false;
+    }
+
+    std::string terminalName = ptsname( terminal );
+
+    double start = wallSeconds();
+
+    pid_t child = fork();
+
+    if ( 0 == child )
+    {
+        int output = open( terminalName.c_str(), O_RDWR | O_NOCTTY );
+
+        dup2( output, STDOUT_FILENO );
+        dup2( output, STDERR_FILENO );
+
+        execl( binary, binary, "--simulate", "/dev/i2c-1:0x27", ( char* ) 0 );
+
+        _exit( 127 );
+    }
+
+    std::string output;
+
+    bool found = false;
+
+    while ( !found && wallSeconds() - start < 10.0 )
+    {
+        struct pollfd ready = { terminal, POLLIN, 0 };
+
+        if ( 1 != poll( &ready, 1, 100 ) )
+        {
+            continue;
+        }
+
+        char buffer[ 256 ];
+
+        ssize_t got = read( terminal, buffer, sizeof( buffer ) );
+
+        if ( got <= 0 )
+        {
+            break;
+        }
+
+        output.append( buffer, got );
+
+        found = ( std::string::npos != output.find( "TempC:" ) );
+    }
+
+    seconds = wallSeconds() - start;
+
+    heapKilobytes = 0;
+
+    char mapsName[ 64 ];
+
+    snprintf( mapsName, sizeof( mapsName ), "/proc/%d/maps", ( int ) child );
+
+    std::ifstream maps( mapsName );
+
+    std::string line;
+
+    while ( std::getline( maps, line ) )
+    {
+        if ( std::string::npos != line.find( "[heap]" ) )
+        {
+            unsigned long first = 0;
+            unsigned long last = 0;
+
+            sscanf( line.c_str(), "%lx-%lx", &first, &last );
+
+            heapKilobytes += ( long ) ( ( last - first ) / 1024 );
+        }
+    }
+
+    kill( child, SIGKILL );
+
+    struct rusage usage;
+
+    wait4( child, 0, 0, &usage );
+
+    close( terminal );
+
+    peakKilobytes = usage.ru_maxrss;
+
+    return found;
+}
+
+/*======================================================================
+FUNCTION:
+    benchCollect()
+
+DESCRIPTION:
+    Load test for SampleCollector.  Forks the producers, half of them
+    on the Unix socket and half on loopback TCP, each sending four
+    sensors through SinkWriter and BinarySink the way ws --send does,
+    stamped with the wall clock at a steady rate.  Three runs: all of
+    them steady, one in eight going silent for a few windows part way
+    through, and four of them flooding as fast as they can write.
+    Each run checks the merged stream never goes back in time and
+    that every reading sent was merged, late or bad, and prints the
+    rate, how far behind the steady producers' readings came out and
+    what was held.
+
+RETURN VALUE:
+    int - 0 on success
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int benchCollect( int argc, char* argv[] )
+{
+    const int producers      = ( 0 < argc ) ? atoi( argv[ 0 ] ) : 256;
+    const int rate           = ( 1 < argc ) ? atoi( argv[ 1 ] ) : 1000;
+    const double seconds     = ( 2 < argc ) ? atof( argv[ 2 ] ) : 3.0;
+    const long long windowMs = ( 3 < argc ) ? atoll( argv[ 3 ] ) : 250;
+
+    if ( producers <= 0 || rate <= 0 || seconds <= 0 || windowMs <= 0 )
+    {
+        printf( "expected a producer count, a rate, a run time and a window above zero\n" );
+        return 1;
+    }
+
+    // Every producer is a connection here and a process
+    struct rlimit files;
+
+    if ( 0 == getrlimit( RLIMIT_NOFILE, &files ) )
+    {
+        files.rlim_cur = files.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &files );
+    }
+
+    printf( "%d producers (%d unix, %d tcp), 4 sensors each at %d readings/sec per producer for %.1fs, window %lldms\n\n",
+            producers, ( producers + 1 ) / 2, producers / 2, rate, seconds, windowMs );
+
+    int failures = 0;
+
+    failures += collectRun( "steady", producers, rate, seconds, windowMs * 1000, false, 0 ) ? 0 : 1;
+    failures += collectRun( "stalls", producers, rate, seconds, windowMs * 1000, true, 0 ) ? 0 : 1;
+    failures += collectRun( "floods", producers, rate, seconds, windowMs * 1000, false, 4 ) ? 0 : 1;
+
+    printf( "%s\n", ( 0 == failures ) ? "\nevery run merged in time order and accounted for every reading" : "\nMERGE WRONG" );
+
+    return ( 0 == failures ) ? 0 : 1;
+}
+
+/*======================================================================
+FUNCTION:
+    collectRun()
+
+DESCRIPTION:
+    One benchCollect() run.  Producer p sends its readings as
+    sensors 4p to 4p + 3, so the collector's SensorHandler says which
+    producer each merged sensor came from, and counts what it sent
+    in a shared page.  The producers are handed a start time through
+    a pipe once the last one is forked, so none of them is ahead of
+    the rest, and the collector does not start behind.
+
+RETURN VALUE:
+    bool - true if the merge was in order and complete
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool collectRun( const char* label,
+                        int producers,
+                        int rate,
+                        double seconds,
+                        long long windowMicroseconds,
+                        bool stalls,
+                        int floods )
+{
+    const size_t SENSORS = 4;
+
+    // Sent by each producer, written by the children
+    void* page = mmap( 0, producers * sizeof( unsigned long long ), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+
+    if ( MAP_FAILED == page )
+    {
+        printf( "Failed to map the shared counts\n" );
+        return false;
+    }
+
+    unsigned long long* sent = ( unsigned long long* ) page;
+
+    char path[ 64 ];
+
+    snprintf( path, sizeof( path ), "/tmp/honeywell6130-bench-collect-%d.sock", ( int ) getpid() );
+
+    CollectorOptions options;
+
+    options.unixPath            = path;
+    options.tcpPort             = 0;
+    options.reorderMicroseconds = windowMicroseconds;
+    options.maxProducers        = ( size_t ) producers;
+    options.maxSensors          = ( size_t ) producers * SENSORS;
+
+    bool passed = false;
+
+    try
+    {
+        SampleCollector collector( options );
+
+        // Each producer connects and then waits here for the start
+        // time, written once they have all been forked
+        int go[ 2 ];
+
+        if ( 0 != pipe( go ) )
+        {
+            throw SensorException( "Failed to create the start pipe" );
+        }
+
+        std::vector< pid_t > children;
+
+        for ( int p = 0; p < producers; ++p )
+        {
+            pid_t child = fork();
+
+            if ( 0 == child )
+            {
+                // Stand ins for other boards; on a small machine
+                // they would otherwise starve the collector's thread
+                setpriority( PRIO_PROCESS, 0, 10 );
+
+                close( go[ 1 ] );
+
+                bool flood = ( p < floods );
+                bool stall = stalls && 7 == p % 8;
+
+                _exit( collectProducer( ( 0 == p % 2 ) ? path : 0, collector.TcpPort(), p, go[ 0 ], seconds, rate,
+                                        flood, stall ? windowMicroseconds * 4 : 0, sent[ p ] ) );
+            }
+
+            if ( 0 < child )
+            {
+                children.push_back( child );
+            }
+        }
+
+        // Only the collector's thread touches these until the join
+        std::vector< int > producerOf( options.maxSensors, -1 );
+        std::vector< unsigned long long > merged( producers, 0 );
+
+        unsigned long long backwards = 0;
+
+        long long last = LLONG_MIN;
+
+        LatencyHistogram behind;
+
+        double collectorCpu = 0;
+
+        std::thread merger( [ & ]()
+        {
+            collector.Run( [ & ]( const FleetSample& sample )
+            {
+                if ( sample.timeMicroseconds < last )
+                {
+                    ++backwards;
+                }
+
+                last = sample.timeMicroseconds;
+
+                int producer = producerOf[ sample.sensorIndex ];
+
+                ++merged[ producer ];
+
+                if ( floods <= producer )
+                {
+                    behind.Record( ( SensorFleet::WallClockMicroseconds() - sample.timeMicroseconds ) * 1000 );
+                }
+            },
+            [ & ]( size_t sensor, const std::string&, size_t producerSensor )
+            {
+                producerOf[ sensor ] = ( int ) ( producerSensor / SENSORS );
+            } );
+
+            struct rusage usage;
+
+            getrusage( RUSAGE_THREAD, &usage );
+
+            collectorCpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                           ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1e6;
+        } );
+
+        long long start = SensorFleet::WallClockMicroseconds() + 100000;
+
+        for ( size_t c = 0; c < children.size(); ++c )
+        {
+            ssize_t ignored = write( go[ 1 ], &start, sizeof( start ) );
+
+            ( void ) ignored;
+        }
+
+        close( go[ 0 ] );
+        close( go[ 1 ] );
+
+        int crashed = 0;
+
+        for ( size_t c = 0; c < children.size(); ++c )
+        {
+            int status = 0;
+
+            waitpid( children[ c ], &status, 0 );
+
+            if ( !WIFEXITED( status ) || 0 != WEXITSTATUS( status ) )
+            {
+                ++crashed;
+            }
+        }
+
+        double elapsed = ( SensorFleet::WallClockMicroseconds() - start ) / 1e6;
+
+        collector.Stop();
+        merger.join();
+
+        // Late readings are the steady producers' unless some came
+        // from the floods
+        unsigned long long total = 0;
+        unsigned long long steadyLate = 0;
+        unsigned long long floodMerged = 0;
+
+        for ( int p = 0; p < producers; ++p )
+        {
+            total += sent[ p ];
+
+            if ( p < floods )
+            {
+                floodMerged += merged[ p ];
+            }
+            else
+            {
+                steadyLate += sent[ p ] - merged[ p ];
+            }
+        }
+
+        LatencyHistogram::Counts counts;
+
+        behind.Snapshot( counts );
+
+        printf( "%-8s %9llu readings  %7.0f/sec  late %llu (%llu steady)  forced %llu  "
+                "behind p50 <%.0fms p99 <%.0fms max %.0fms\n"
+                "         peak held %u readings  paused %llu  collector cpu %.0f%%  producers %llu of %d%s\n",
+                label, collector.MergedCount(), collector.MergedCount() / elapsed,
+                collector.LateCount(), steadyLate, collector.ForcedCount(),
+                counts.PercentileNanoseconds( 0.5 ) / 1e6, counts.PercentileNanoseconds( 0.99 ) / 1e6,
+                counts.maxNanoseconds / 1e6,
+                ( unsigned int ) collector.PeakHeldCount(), collector.PausedCount(),
+                collectorCpu * 100 / elapsed, collector.ProducerCount(), producers,
+                ( 0 < crashed ) ? "  SOME FAILED" : "" );
+
+        if ( 0 < floods )
+        {
+            printf( "         floods sent %.0f/sec each, %.0f/sec merged\n",
+                    ( total - ( unsigned long long ) ( producers - floods ) * rate * seconds ) / floods / elapsed,
+                    floodMerged / ( double ) floods / elapsed );
+        }
+
+        passed = 0 == backwards
+                 && 0 == crashed
+                 && collector.ProducerCount() == ( unsigned long long ) producers
+                 && total == collector.MergedCount() + collector.LateCount() + collector.BadRecordCount();
+
+        if ( !passed )
+        {
+            printf( "FAILED: %llu went back in time, %d producers failed, %llu sent but %llu merged, "
+                    "%llu late and %llu bad\n",
+                    backwards, crashed, total, collector.MergedCount(), collector.LateCount(),
+                    collector.BadRecordCount() );
+        }
+    }
+    catch( SensorException& ex )
+    {
+        printf( "%s\n", ex.what() );
+    }
+
+    munmap( page, producers * sizeof( unsigned long long ) );
+
+    return passed;
+}
+
+/*======================================================================
+FUNCTION:
+    collectProducer()
+
+DESCRIPTION:
+    The body of a forked collectRun() producer.  A steady producer
+    sends rate readings a second in 10ms ticks on an absolute clock
+    and leaves the flushing to FLUSH_INTERVAL, as ws does; a stall
+    skips the ticks for that long a third of the way in; a flood
+    writes as fast as the collector takes it for the same time.
+
+RETURN VALUE:
+    int - the exit status, 0 if everything was written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int collectProducer( const char* unixPath,
+                            int tcpPort,
+                            int index,
+                            int go,
+                            double seconds,
+                            int rate,
+                            bool flood,
+                            long long stallMicroseconds,
+                            unsigned long long& sent )
+{
+    const long long TICK_MICROSECONDS = 10000;
+
+    int producer = -1;
+
+    try
+    {
+        producer = ( 0 != unixPath ) ? ConnectUnixCollector( unixPath ) : ConnectTcpCollector( "127.0.0.1", tcpPort );
+    }
+    catch( SensorException& )
+    {
+        return 1;
+    }
+
+    long long startMicroseconds = 0;
+
+    if ( sizeof( startMicroseconds ) != read( go, &startMicroseconds, sizeof( startMicroseconds ) ) )
+    {
+        return 1;
+    }
+
+    SinkWriter writer( producer, flood ? SinkWriter::FLUSH_WHEN_FULL : SinkWriter::FLUSH_INTERVAL );
+
+    BinarySink sink( writer );
+
+    sink.Begin();
+
+    long long end        = startMicroseconds + ( long long ) ( seconds * 1e6 );
+    long long stallStart = startMicroseconds + ( end - startMicroseconds ) / 3;
+
+    size_t sensor = ( size_t ) index * 4;
+
+    unsigned long long count = 0;
+
+    TempHumidityData data;
+
+    memset( &data, 0, sizeof( data ) );
+
+    struct timespec wake;
+
+    wake.tv_sec  = startMicroseconds / 1000000;
+    wake.tv_nsec = ( startMicroseconds % 1000000 ) * 1000;
+
+    clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, &wake, 0 );
+
+    for ( long long tick = 0; ; ++tick )
+    {
+        long long now = SensorFleet::WallClockMicroseconds();
+
+        if ( end <= now )
+        {
+            break;
+        }
+
+        // Whatever ticks the stall takes are simply not sent
+        bool silent = stallStart <= now && now < stallStart + stallMicroseconds;
+
+        long long due = flood ? 256 : ( ( tick + 1 ) * rate * TICK_MICROSECONDS / 1000000 - tick * rate * TICK_MICROSECONDS / 1000000 );
+
+        for ( long long r = 0; !silent && r < due; ++r, ++count )
+        {
+            data.tempCelcius      = 20 + ( count % 100 ) / 10.0f;
+            data.relativeHumidity = 40 + ( count % 50 ) / 5.0f;
+
+            sink.Write( sensor + count % 4, now, data );
+        }
+
+        if ( flood )
+        {
+            continue;
+        }
+
+        writer.Idle();
+
+        long long next = startMicroseconds + ( tick + 1 ) * TICK_MICROSECONDS;
+
+        wake.tv_sec  = next / 1000000;
+        wake.tv_nsec = ( next % 1000000 ) * 1000;
+
+        clock_nanosleep( CLOCK_REALTIME, TIMER_ABSTIME, &wake, 0 );
+    }
+
+    writer.Flush();
+
+    sent = count;
+
+    int failed = ( 0 != writer.Error() ) ? 1 : 0;
+
+    close( producer );
+
+    return failed;
+}
+
+/*======================================================================
+FUNCTION:
+    cpuMicroseconds()
+
+DESCRIPTION:
+    Reads the user plus system cpu time used by this process so
+    far.  The settle sleeps do not count against it.
+
+RETURN VALUE:
+    double - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static double cpuMicroseconds()
+{
+    struct rusage usage;
+
+    getrusage( RUSAGE_SELF, &usage );
+
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1e6 +
+           ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec );
+}
+
+/*======================================================================
+FUNCTION:
+    wallSeconds()
+
+DESCRIPTION:
+    Reads the monotonic clock
+
+RETURN VALUE:
+    double - seconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static double wallSeconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*======================================================================
+FUNCTION:
+    report()
+
+DESCRIPTION:
+    Prints one line of results
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void report( const char* mode,
+                    unsigned long long setupSyscalls,
+                    unsigned long long syscalls,
+                    unsigned long long samples,
+                    double cpu )
+{
+    double perSample = samples ? ( double ) syscalls / samples : 0;
+    double cpuPerSample = samples ? cpu / samples : 0;
+
+    printf( "%-12s setup syscalls: %4llu  samples: %8llu  syscalls/sample: %6.3f  cpu us/sample: %8.3f\n",
+            mode, setupSyscalls, samples, perSample, cpuPerSample );
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The syscall counts come from the counters kept by Honeywell6130Sensor
+and Honeywell6130Bus at every call into the i2c device, so they only
+count i2c traffic (not the settle sleeps).  Stale retries are counted
+too, since they are real trips into the kernel.
+
+=====================================================================*/
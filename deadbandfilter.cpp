@@ -0,0 +1,356 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    deadbandfilter.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to suppress readings that have not moved
+
+GENERAL DESCRIPTION:
+    This file implements the deadband options and the parts of the
+    filter that run when a reading is passed: working out the
+    sensor's bands in counts and keeping the counts
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DeadbandOptions
+    DeadbandFilter
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "deadbandfilter.h"
+#include "humidiconsensor.h"
+
+#include <cmath>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+static constexpr double CELCIUS_PER_COUNT  = Hih6130::TEMPERATURE_SPAN / ( ( 1u << Hih6130::TEMPERATURE_BITS ) - 1 );
+static constexpr double HUMIDITY_PER_COUNT = Hih6130::HUMIDITY_SPAN / ( ( 1u << Hih6130::HUMIDITY_BITS ) - 1 );
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static unsigned int bandCounts( double units, double unitsPerCount );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    DeadbandOptions::DeadbandOptions()
+
+DESCRIPTION:
+    Defaults to 0.1C and 0.5%RH with a heartbeat every five minutes
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+DeadbandOptions::DeadbandOptions()
+: temperatureCelcius( 0.1 ),
+  relativeHumidity( 0.5 ),
+  relativeFraction( 0 ),
+  heartbeatMicroseconds( 300000000 )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    DeadbandFilter()
+
+DESCRIPTION:
+    This c-tor turns the absolute bands into counts and starts every
+    sensor with nothing passed, so each one's first reading goes
+    through
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+DeadbandFilter::DeadbandFilter( size_t sensorCount, const DeadbandOptions& options )
+: _options( options ),
+  _heartbeatMicroseconds( ( 0 < options.heartbeatMicroseconds ) ? options.heartbeatMicroseconds : 0 ),
+  _temperatureBand( bandCounts( options.temperatureCelcius, CELCIUS_PER_COUNT ) ),
+  _humidityBand( bandCounts( options.relativeHumidity, HUMIDITY_PER_COUNT ) ),
+  _sensors( sensorCount ),
+  _offered( 0 ),
+  _passed( 0 ),
+  _heartbeats( 0 )
+{
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        Reset( s );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~DeadbandFilter()
+
+DESCRIPTION:
+    Nothing to release
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+DeadbandFilter::~DeadbandFilter()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Offer()
+
+DESCRIPTION:
+    Encodes the reading back into a frame, the exact inverse of
+    Decode(), and offers that
+
+RETURN VALUE:
+    bool - true to pass the reading on
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool DeadbandFilter::Offer( size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+    Honeywell6130Sensor::Encode( data, frame );
+
+    return OfferFrame( sensor, timeMicroseconds, frame );
+}
+
+/*======================================================================
+FUNCTION:
+    Reset()
+
+DESCRIPTION:
+    Forgets the sensor's last passed reading
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DeadbandFilter::Reset( size_t sensor )
+{
+    if ( sensor < _sensors.size() )
+    {
+        SensorState& state = _sensors[ sensor ];
+
+        state.timeMicroseconds = 0;
+        state.temperature      = 0;
+        state.humidity         = 0;
+        state.temperatureBand  = 0;
+        state.humidityBand     = 0;
+        state.status           = 0;
+        state.passed           = false;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SuppressionRatio()
+
+DESCRIPTION:
+    Suppressed readings over offered readings
+
+RETURN VALUE:
+    double - 0 before anything is offered
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double DeadbandFilter::SuppressionRatio() const
+{
+    unsigned long long offered = OfferedCount();
+
+    if ( 0 == offered )
+    {
+        return 0;
+    }
+
+    return 1.0 - ( double ) PassedCount() / offered;
+}
+
+/*======================================================================
+FUNCTION:
+    pass()
+
+DESCRIPTION:
+    Makes the reading the sensor's last passed one and works out the
+    bands around it: the absolute ones, widened to the relative
+    fraction of the reading's value when that is larger
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DeadbandFilter::pass( SensorState& state, long long timeMicroseconds, unsigned int status,
+                           unsigned int temperature, unsigned int humidity, bool heartbeat )
+{
+    unsigned int temperatureBand = _temperatureBand;
+    unsigned int humidityBand    = _humidityBand;
+
+    if ( 0 < _options.relativeFraction )
+    {
+        double celcius = temperature * CELCIUS_PER_COUNT - Hih6130::TEMPERATURE_OFFSET;
+
+        unsigned int relative = bandCounts( _options.relativeFraction * fabs( celcius ), CELCIUS_PER_COUNT );
+
+        temperatureBand = ( temperatureBand < relative ) ? relative : temperatureBand;
+
+        relative = bandCounts( _options.relativeFraction * humidity * HUMIDITY_PER_COUNT, HUMIDITY_PER_COUNT );
+
+        humidityBand = ( humidityBand < relative ) ? relative : humidityBand;
+    }
+
+    state.timeMicroseconds = timeMicroseconds;
+    state.temperature      = ( uint16_t ) temperature;
+    state.humidity         = ( uint16_t ) humidity;
+    state.temperatureBand  = ( uint16_t ) temperatureBand;
+    state.humidityBand     = ( uint16_t ) humidityBand;
+    state.status           = ( unsigned char ) status;
+    state.passed           = true;
+
+    bump( _passed );
+
+    if ( heartbeat )
+    {
+        bump( _heartbeats );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    bandCounts()
+
+DESCRIPTION:
+    The whole counts that fit in a band of units.  Rounded down (with
+    a little slack for a band that is a whole number of counts), and
+    held to the 14 bit scale.
+
+RETURN VALUE:
+    unsigned int
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static unsigned int bandCounts( double units, double unitsPerCount )
+{
+    double counts = units / unitsPerCount + 1e-9;
+
+    // NaN lands here too
+    if ( !( 0 < counts ) )
+    {
+        return 0;
+    }
+
+    return ( counts < 0x3fff ) ? ( unsigned int ) counts : 0x3fff;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Offering a reading is a subtraction and a compare per channel plus one
+for the status and one for the heartbeat, all inline; the floating
+point is in pass(), once per reading passed, which with sensible bands
+is a few percent of them.
+
+A band of 0x3fff counts covers the whole scale, so a channel can be
+left out of the decision by giving it a huge band.
+
+=====================================================================*/
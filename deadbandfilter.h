@@ -0,0 +1,318 @@
+#ifndef _DEADBANDFILTER_H_
+#define _DEADBANDFILTER_H_
+
+/*======================================================================
+FILE:
+    deadbandfilter.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Decides which readings are worth passing on: those that moved
+    out of a deadband since the last one passed, changed status, or
+    are due as a heartbeat.
+
+DESCRIPTION:
+    This header defines a change detection stage that sits between
+    acquisition and the sinks.  Temperature and humidity move slowly,
+    so most readings repeat the last one to within the sensor's
+    noise; dropping those cuts what is written and sent by an order
+    of magnitude or more while every reading passed on is still
+    within the deadband of the truth.  The decision is made on the
+    14 bit counts with integer compares.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DeadbandOptions
+    DeadbandFilter
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// How wide the deadbands are.  A reading is suppressed while both
+// channels are within their band of the last reading passed for the
+// sensor.  Each band is the wider of the absolute band and
+// relativeFraction of the last passed value (in C and %RH), and is
+// rounded down to whole counts so a passed value is never further
+// than the band from the reading it stands in for.
+struct DeadbandOptions
+{
+    double temperatureCelcius;
+    double relativeHumidity;
+
+    // 0 for absolute bands only
+    double relativeFraction;
+
+    // A reading is passed at least this often per sensor even if
+    // nothing moved, so a quiet sensor can be told from a dead one.
+    // 0 for never.
+    long long heartbeatMicroseconds;
+
+    DeadbandOptions();
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A DeadbandFilter belongs to one thread, like a WindowAggregator.
+// Only the counts may be read from other threads.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    DeadbandFilter
+
+DESCRIPTION:
+    Keeps the last reading passed for every sensor along with its
+    bands in counts.  Offering a reading compares its counts and
+    status against those and its time against the heartbeat, and
+    says whether to pass it on.  The bands are only worked out
+    again, in floating point, when a reading is passed.
+
+HOW TO USE:
+    1. Construct the object with the sensor count and the options
+    2. Call Offer() with every reading, in time order per sensor,
+       and pass on those it returns true for
+    3. Read the counts or SuppressionRatio() whenever wanted
+
+======================================================================*/
+class DeadbandFilter
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    DeadbandFilter( size_t sensorCount, const DeadbandOptions& options = DeadbandOptions() );
+
+    virtual ~DeadbandFilter();
+
+    // Goes through Honeywell6130Sensor::Encode() for the counts
+    bool Offer( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+    // Same, straight from a raw frame
+    bool OfferFrame( size_t sensor, long long timeMicroseconds, const unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ] )
+    {
+        return OfferCounts( sensor,
+                            timeMicroseconds,
+                            frame[ 0 ] >> 6,
+                            ( ( unsigned int ) frame[ 2 ] << 6 ) | ( frame[ 3 ] >> 2 ),
+                            ( ( unsigned int ) ( frame[ 0 ] & 0x3f ) << 8 ) | frame[ 1 ] );
+    }
+
+    // Same, from the status bits and the 14 bit counts.  Readings
+    // of sensors past the count are always passed.
+    bool OfferCounts( size_t sensor, long long timeMicroseconds, unsigned int status, unsigned int temperature, unsigned int humidity )
+    {
+        if ( _sensors.size() <= sensor )
+        {
+            return true;
+        }
+
+        SensorState& state = _sensors[ sensor ];
+
+        temperature &= 0x3fff;
+        humidity    &= 0x3fff;
+
+        bump( _offered );
+
+        bool within = state.passed &&
+                      status == state.status &&
+                      ( unsigned int ) abs( ( int ) temperature - ( int ) state.temperature ) <= state.temperatureBand &&
+                      ( unsigned int ) abs( ( int ) humidity - ( int ) state.humidity ) <= state.humidityBand;
+
+        if ( within && ( 0 == _heartbeatMicroseconds || timeMicroseconds - state.timeMicroseconds < _heartbeatMicroseconds ) )
+        {
+            return false;
+        }
+
+        pass( state, timeMicroseconds, status, temperature, humidity, within );
+
+        return true;
+    }
+
+    // Forgets the sensor's last reading so its next one is passed
+    void Reset( size_t sensor );
+
+    const DeadbandOptions& Options() const { return _options; }
+
+    unsigned long long OfferedCount() const { return _offered.load( std::memory_order_relaxed ); }
+
+    unsigned long long PassedCount() const { return _passed.load( std::memory_order_relaxed ); }
+
+    // Passed only because they were due
+    unsigned long long HeartbeatCount() const { return _heartbeats.load( std::memory_order_relaxed ); }
+
+    // Fraction of the readings offered that were suppressed (0 - 1)
+    double SuppressionRatio() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct SensorState
+    {
+        long long timeMicroseconds;
+
+        uint16_t temperature;
+        uint16_t humidity;
+
+        uint16_t temperatureBand;
+        uint16_t humidityBand;
+
+        unsigned char status;
+
+        bool passed;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    DeadbandFilter( const DeadbandFilter &rhs );
+
+    // Only the owning thread writes the counts, so a plain load and
+    // store will do
+    static void bump( std::atomic< unsigned long long >& count )
+    {
+        count.store( count.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+
+    void pass( SensorState& state, long long timeMicroseconds, unsigned int status,
+               unsigned int temperature, unsigned int humidity, bool heartbeat );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    DeadbandOptions _options;
+
+    long long _heartbeatMicroseconds;
+
+    // The absolute bands, in counts
+    unsigned int _temperatureBand;
+    unsigned int _humidityBand;
+
+    std::vector< SensorState > _sensors;
+
+    std::atomic< unsigned long long > _offered;
+
+    std::atomic< unsigned long long > _passed;
+
+    std::atomic< unsigned long long > _heartbeats;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+The bands are measured from the last reading passed, not the last one
+seen, so a slow drift is passed once it has added up to a band instead
+of creeping through unnoticed a count at a time.
+
+A change in the status bits (a stale reading, command mode) is always
+passed, as is the first reading of every sensor.
+
+The default bands, 0.1C and 0.5%RH, sit just above the noise of a
+part in a still room (a few counts) and well inside its accuracy
+(+/-1C, +/-4%RH for the HIH6130), with a heartbeat every five
+minutes.
+
+======================================================================*/
+
+#endif	// #ifendif _DEADBANDFILTER_H_
@@ -0,0 +1,478 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    embeddedmain.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Program entry point for the Embedded build
+
+GENERAL DESCRIPTION:
+    This is the smallest harness that reads one honeywell 6130
+    sensor and prints it: no heap, no iostreams, no threads, and
+    with -fno-exceptions no exception tables.  Everything it needs
+    is on the stack or in static storage, and the lines go out with
+    write(2).
+
+PUBLIC CLASSES AND FUNCTIONS:
+    main
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Built by the Embedded configuration in wsmake, which defines
+    HONEYWELL_EMBEDDED.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "i2ctransport.h"
+#include "simulatedi2c.h"
+#include "samplesink.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// A transport wired straight to one simulated sensor.  A
+// SimulatedI2cBus would do the same, but it allocates its devices.
+class SimulatedDeviceTransport : public I2cTransport
+{
+public:
+
+    SimulatedDeviceTransport( SimulatedHih6130& device ) : _device( device ) { }
+
+    virtual bool Open() { ++_syscallCount; return true; }
+
+    virtual void Close() { }
+
+    virtual bool SetAddress( int ) { ++_syscallCount; return true; }
+
+    virtual int Write( const unsigned char*, int length )
+    {
+        ++_syscallCount;
+
+        if ( !_device.MeasurementRequest() )
+        {
+            errno = ENXIO;
+            return -1;
+        }
+
+        return length;
+    }
+
+    virtual int Read( unsigned char* data, int length )
+    {
+        unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+        ++_syscallCount;
+
+        if ( !_device.Fetch( frame ) )
+        {
+            errno = ENXIO;
+            return -1;
+        }
+
+        for ( int i = 0; i < length; ++i )
+        {
+            data[ i ] = ( i < Honeywell6130Sensor::FRAME_SIZE ) ? frame[ i ] : 0xff;
+        }
+
+        return length;
+    }
+
+    virtual int Transfer( struct i2c_msg*, int ) { errno = ENOTSUP; return -1; }
+
+private:
+
+    SimulatedHih6130& _device;
+};
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// How often the sensor is read, like ws with no arguments
+static const long long SAMPLE_PERIOD_NANOSECONDS = 1000000000;
+
+// Longest device path taken from the command line
+static const size_t DEVICE_BYTES = 64;
+
+// Room for the longest line, a reading with NaNs in it
+static const size_t LINE_BYTES = 128;
+
+// Where every line is put together before it is written
+static char line[ LINE_BYTES ];
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static int run( I2cTransport* transport, int address, unsigned long long count );
+
+static bool parseSensor( const char* text, char device[ DEVICE_BYTES ], int& address );
+
+static void writeText( int fileDescriptor, const char* first, const char* second = "" );
+
+static char* appendText( char* out, const char* text );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    main()
+
+DESCRIPTION:
+    Program entrypoint.  Reads the sensor at /dev/i2c-1, 0x27, or
+    the one named as device:address, once a second.  Options go in
+    front of the sensor:
+        --simulate  use a simulated sensor instead of i2c-dev
+        --count=n   stop after n readings
+
+RETURN VALUE:
+    int - 0, or 1 for a bad command line or a sensor that would
+          not open
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int main( int argc, char* argv[] )
+{
+    bool simulate = false;
+
+    unsigned long long count = 0;
+
+    const char* sensorName = "/dev/i2c-1:0x27";
+
+    for ( int a = 1; a < argc; ++a )
+    {
+        if ( 0 == strcmp( argv[ a ], "--simulate" ) )
+        {
+            simulate = true;
+        }
+        else if ( 0 == strncmp( argv[ a ], "--count=", 8 ) )
+        {
+            count = strtoull( argv[ a ] + 8, 0, 0 );
+        }
+        else if ( 0 == strncmp( argv[ a ], "--", 2 ) )
+        {
+            writeText( STDERR_FILENO, "Unknown option ", argv[ a ] );
+            return 1;
+        }
+        else
+        {
+            sensorName = argv[ a ];
+        }
+    }
+
+    char device[ DEVICE_BYTES ];
+    int address = 0;
+
+    if ( !parseSensor( sensorName, device, address ) )
+    {
+        writeText( STDERR_FILENO, "Expected device:address but got ", sensorName );
+        return 1;
+    }
+
+    SimulatedHih6130 simulated( ( SimulatedHih6130::Config() ) );
+
+    SimulatedDeviceTransport simulatedTransport( simulated );
+
+    I2cDevTransport i2cTransport( device );
+
+    I2cTransport* transport = simulate ? ( I2cTransport* ) &simulatedTransport : ( I2cTransport* ) &i2cTransport;
+
+#if defined( __cpp_exceptions )
+    try
+    {
+        return run( transport, address, count );
+    }
+    catch( SensorException& ex )
+    {
+        writeText( STDOUT_FILENO, ex.what() );
+        return 1;
+    }
+#else
+    return run( transport, address, count );
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    run()
+
+DESCRIPTION:
+    Reads the sensor on a fixed one second grid (an absolute sleep,
+    so the read time does not push the next one back) and writes a
+    line per reading in the format ws uses.  A failed read is
+    reported and skipped; the sensor already retried and reopened.
+
+RETURN VALUE:
+    int - 0 after count readings (count 0 never stops), 1 if the
+          sensor would not open
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int run( I2cTransport* transport, int address, unsigned long long count )
+{
+    Honeywell6130Sensor sensor( transport, address );
+
+    if ( Honeywell6130Sensor::READ_OK != sensor.OpenError() )
+    {
+        writeText( STDOUT_FILENO, Honeywell6130Sensor::ErrorMessage( sensor.OpenError() ) );
+        return 1;
+    }
+
+    struct timespec next;
+
+    clock_gettime( CLOCK_MONOTONIC, &next );
+
+    for ( unsigned long long readings = 0; 0 == count || readings < count; ++readings )
+    {
+        TempHumidityData data;
+
+        Honeywell6130Sensor::ReadError error = sensor.TryRead( data );
+
+        if ( Honeywell6130Sensor::READ_OK != error )
+        {
+            writeText( STDOUT_FILENO, "Read failed: ", Honeywell6130Sensor::ErrorMessage( error ) );
+        }
+        else
+        {
+            char* out = line;
+
+            out  = appendText( out, "Sensor: 0  TempC: " );
+            out += FormatFixed( data.tempCelcius, 2, out );
+            out  = appendText( out, "  TempF: " );
+            out += FormatFixed( data.tempFahrenheit, 2, out );
+            out  = appendText( out, "  Humidity: " );
+            out += FormatFixed( data.relativeHumidity, 2, out );
+
+            *out++ = '\n';
+
+            if ( write( STDOUT_FILENO, line, out - line ) < 0 )
+            {
+                return 1;
+            }
+        }
+
+        if ( 0 != count && readings + 1 == count )
+        {
+            break;
+        }
+
+        next.tv_nsec += SAMPLE_PERIOD_NANOSECONDS % 1000000000;
+        next.tv_sec  += SAMPLE_PERIOD_NANOSECONDS / 1000000000 + next.tv_nsec / 1000000000;
+        next.tv_nsec %= 1000000000;
+
+        while ( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next, 0 ) )
+        {
+        }
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    parseSensor()
+
+DESCRIPTION:
+    Splits device:address (for example /dev/i2c-2:0x28) at the
+    last colon
+
+RETURN VALUE:
+    bool - false if there is no colon, the device does not fit or
+           the address is not a 7 bit number
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool parseSensor( const char* text, char device[ DEVICE_BYTES ], int& address )
+{
+    const char* colon = strrchr( text, ':' );
+
+    if ( 0 == colon || colon == text || DEVICE_BYTES <= ( size_t ) ( colon - text ) )
+    {
+        return false;
+    }
+
+    char* end = 0;
+
+    long value = strtol( colon + 1, &end, 0 );
+
+    if ( end == colon + 1 || 0 != *end || value < 0 || 0x7f < value )
+    {
+        return false;
+    }
+
+    memcpy( device, text, colon - text );
+
+    device[ colon - text ] = 0;
+
+    address = ( int ) value;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    writeText()
+
+DESCRIPTION:
+    Writes two strings and a newline with one write(2), for the
+    messages that are not readings.  Longer ones are cut short.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void writeText( int fileDescriptor, const char* first, const char* second )
+{
+    char* end = line + sizeof( line ) - 1;
+    char* out = line;
+
+    for ( const char* in = first; 0 != *in && out < end; ++in )
+    {
+        *out++ = *in;
+    }
+
+    for ( const char* in = second; 0 != *in && out < end; ++in )
+    {
+        *out++ = *in;
+    }
+
+    *out++ = '\n';
+
+    if ( write( fileDescriptor, line, out - line ) < 0 )
+    {
+        // Nowhere left to say so
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    appendText()
+
+DESCRIPTION:
+    Copies a string literal to out
+
+RETURN VALUE:
+    char* - just past what was copied
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static char* appendText( char* out, const char* text )
+{
+    while ( 0 != *text )
+    {
+        *out++ = *text++;
+    }
+
+    return out;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+What makes this small is what it leaves out, not anything clever.
+There is no <iostream> (its static initialisers and locale tables are
+most of a hello world's start up), no std::string or std::vector, no
+thread, and with -fno-exceptions no unwind tables or the emergency
+exception pool libstdc++ sets aside at start up.  The parts of the
+library that keep things on the heap (SinkWriter and the sinks, the
+simulated bus) are compiled out under HONEYWELL_EMBEDDED, so nothing
+links operator new and with it that pool; --gc-sections drops the
+rest of what is not called.
+
+bench footprint runs this and the Debug and Release ws side by side.
+On an x86-64 host build with gcc 12 (the ARM numbers scale the same
+way), from fork() to the first reading on a pseudo terminal:
+
+                     file    loaded   first reading   peak RSS   heap
+    Debug/ws        5.2MB    1.5MB       2.6ms          3.2MB    268KB
+    Release/ws      1.6MB    1.2MB       2.6ms          3.1MB    268KB
+    Embedded/ws     755KB    689KB       1.8ms          980KB    136KB
+    (libc dynamic)   20KB     11KB       2.0ms          1.2MB      0
+
+The Embedded heap is static glibc's own start up (_dl_init_paths and
+friends, four small mallocs), not this program; linked dynamically
+it has none.  Nearly all of the static binary is glibc too.
+
+=====================================================================*/
@@ -0,0 +1,555 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    framedecoder.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Batch decoding of raw Honeywell 6130 frames
+
+GENERAL DESCRIPTION:
+    This file has a scalar decoder and SIMD decoders for SSE2,
+    AVX2 and 64 bit ARM NEON.  The SIMD decoders do the same
+    double precision math as Honeywell6130Sensor::Decode(), just
+    several frames at a time, so the results are bit identical.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DecodeFrames
+    DecodeFramesScalar
+    DecodeFramesImplementation
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define FRAMEDECODER_X86
+#elif defined( __aarch64__ )
+#define FRAMEDECODER_NEON
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "framedecoder.h"
+#include "honeywell6130sensor.h"
+
+#include <cstring>
+
+#if defined( FRAMEDECODER_X86 )
+#include <immintrin.h>
+#elif defined( FRAMEDECODER_NEON )
+#include <arm_neon.h>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+typedef void ( *DecodeFunction )( const unsigned char* frames,
+                                  size_t count,
+                                  unsigned char* status,
+                                  float* tempCelcius,
+                                  float* tempFahrenheit,
+                                  float* relativeHumidity );
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// The same constants Honeywell6130Sensor::Decode() uses, spelled
+// the same way so the compiler folds them to the same doubles
+static const double HUMIDITY_DIVISOR   = ( 16384.0 - 1 );
+static const double TEMPERATURE_FACTOR = ( 165.0 / ( 16384.0 - 1 ) );
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static DecodeFunction pickImplementation( const char** name );
+
+#if defined( FRAMEDECODER_X86 )
+static void decodeSse2( const unsigned char*, size_t, unsigned char*, float*, float*, float* );
+static void decodeAvx2( const unsigned char*, size_t, unsigned char*, float*, float*, float* );
+#elif defined( FRAMEDECODER_NEON )
+static void decodeNeon( const unsigned char*, size_t, unsigned char*, float*, float*, float* );
+#endif
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    DecodeFrames()
+
+DESCRIPTION:
+    Decodes a batch of frames with the fastest implementation the
+    CPU supports.  The pick is made once, on the first call.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DecodeFrames( const unsigned char* frames,
+                   size_t count,
+                   unsigned char* status,
+                   float* tempCelcius,
+                   float* tempFahrenheit,
+                   float* relativeHumidity )
+{
+    static const DecodeFunction decode = pickImplementation( 0 );
+
+    decode( frames, count, status, tempCelcius, tempFahrenheit, relativeHumidity );
+}
+
+/*======================================================================
+FUNCTION:
+    DecodeFramesImplementation()
+
+DESCRIPTION:
+    Names the implementation DecodeFrames() uses
+
+RETURN VALUE:
+    const char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* DecodeFramesImplementation()
+{
+    const char* name = 0;
+
+    pickImplementation( &name );
+
+    return name;
+}
+
+/*======================================================================
+FUNCTION:
+    DecodeFramesScalar()
+
+DESCRIPTION:
+    Decodes one frame at a time with the same code Read() uses.
+    This is the reference the SIMD versions are checked against,
+    and it also finishes off the frames left over at the end of a
+    batch.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DecodeFramesScalar( const unsigned char* frames,
+                         size_t count,
+                         unsigned char* status,
+                         float* tempCelcius,
+                         float* tempFahrenheit,
+                         float* relativeHumidity )
+{
+    for ( size_t i = 0; i < count; ++i )
+    {
+        TempHumidityData data;
+
+        Honeywell6130Sensor::Decode( &frames[ i * Honeywell6130Sensor::FRAME_SIZE ], data );
+
+        if ( status )           status[ i ]           = data.status;
+        if ( tempCelcius )      tempCelcius[ i ]      = data.tempCelcius;
+        if ( tempFahrenheit )   tempFahrenheit[ i ]   = data.tempFahrenheit;
+        if ( relativeHumidity ) relativeHumidity[ i ] = data.relativeHumidity;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    pickImplementation()
+
+DESCRIPTION:
+    Checks what the CPU can do and hands back the best decoder
+
+RETURN VALUE:
+    DecodeFunction
+
+SIDE EFFECTS:
+    *name is set to the implementation name if name is not 0
+
+======================================================================*/
+static DecodeFunction pickImplementation( const char** name )
+{
+    const char* ignored;
+
+    if ( 0 == name )
+    {
+        name = &ignored;
+    }
+
+#if defined( FRAMEDECODER_X86 )
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        *name = "avx2";
+        return decodeAvx2;
+    }
+
+    if ( __builtin_cpu_supports( "sse2" ) )
+    {
+        *name = "sse2";
+        return decodeSse2;
+    }
+#elif defined( FRAMEDECODER_NEON )
+    *name = "neon";
+    return decodeNeon;
+#endif
+
+    *name = "scalar";
+    return DecodeFramesScalar;
+}
+
+#if defined( FRAMEDECODER_X86 )
+
+/*======================================================================
+FUNCTION:
+    decodeSse2()
+
+DESCRIPTION:
+    Decodes 4 frames per pass with SSE2.  Each frame is loaded as
+    a little endian 32 bit word b3|b2|b1|b0 and the fields are cut
+    out with shifts and masks:
+        status      = ( word >> 6 ) & 0x03
+        humidity    = ( b0 & 0x3f ) << 8 | b1
+        temperature = b2 << 6 | b3 >> 2
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "sse2" ) ))
+static void decodeSse2( const unsigned char* frames,
+                        size_t count,
+                        unsigned char* status,
+                        float* tempCelcius,
+                        float* tempFahrenheit,
+                        float* relativeHumidity )
+{
+    const __m128i lowByte     = _mm_set1_epi32( 0xff );
+    const __m128i humidityHi  = _mm_set1_epi32( 0x3f );
+    const __m128i lowTwoBits  = _mm_set1_epi32( 0x03 );
+    const __m128d divisor     = _mm_set1_pd( HUMIDITY_DIVISOR );
+    const __m128d hundred     = _mm_set1_pd( 100.0 );
+    const __m128d factor      = _mm_set1_pd( TEMPERATURE_FACTOR );
+    const __m128  forty       = _mm_set1_ps( 40.0f );
+    const __m128d onePointEight = _mm_set1_pd( 1.8 );
+    const __m128d thirtyTwo   = _mm_set1_pd( 32.0 );
+
+    size_t i = 0;
+
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        __m128i word = _mm_loadu_si128( ( const __m128i* ) &frames[ i * 4 ] );
+
+        __m128i state = _mm_and_si128( _mm_srli_epi32( word, 6 ), lowTwoBits );
+
+        __m128i humidity = _mm_or_si128( _mm_slli_epi32( _mm_and_si128( word, humidityHi ), 8 ),
+                                         _mm_and_si128( _mm_srli_epi32( word, 8 ), lowByte ) );
+
+        __m128i temperature = _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( word, 16 ), lowByte ), 6 ),
+                                            _mm_srli_epi32( word, 26 ) );
+
+        // Two frames per double vector
+        __m128d humidityLo    = _mm_cvtepi32_pd( humidity );
+        __m128d humidityHiPd  = _mm_cvtepi32_pd( _mm_shuffle_epi32( humidity, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+        __m128d temperatureLo = _mm_cvtepi32_pd( temperature );
+        __m128d temperatureHi = _mm_cvtepi32_pd( _mm_shuffle_epi32( temperature, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+
+        __m128 rh = _mm_movelh_ps( _mm_cvtpd_ps( _mm_mul_pd( _mm_div_pd( humidityLo, divisor ), hundred ) ),
+                                   _mm_cvtpd_ps( _mm_mul_pd( _mm_div_pd( humidityHiPd, divisor ), hundred ) ) );
+
+        __m128 celcius = _mm_sub_ps( _mm_movelh_ps( _mm_cvtpd_ps( _mm_mul_pd( temperatureLo, factor ) ),
+                                                    _mm_cvtpd_ps( _mm_mul_pd( temperatureHi, factor ) ) ),
+                                     forty );
+
+        __m128d celciusLo = _mm_cvtps_pd( celcius );
+        __m128d celciusHi = _mm_cvtps_pd( _mm_movehl_ps( celcius, celcius ) );
+
+        __m128 fahrenheit = _mm_movelh_ps( _mm_cvtpd_ps( _mm_add_pd( _mm_mul_pd( celciusLo, onePointEight ), thirtyTwo ) ),
+                                           _mm_cvtpd_ps( _mm_add_pd( _mm_mul_pd( celciusHi, onePointEight ), thirtyTwo ) ) );
+
+        if ( status )
+        {
+            __m128i packed = _mm_packus_epi16( _mm_packs_epi32( state, state ), _mm_setzero_si128() );
+
+            int bytes = _mm_cvtsi128_si32( packed );
+
+            memcpy( &status[ i ], &bytes, 4 );
+        }
+
+        if ( tempCelcius )      _mm_storeu_ps( &tempCelcius[ i ], celcius );
+        if ( tempFahrenheit )   _mm_storeu_ps( &tempFahrenheit[ i ], fahrenheit );
+        if ( relativeHumidity ) _mm_storeu_ps( &relativeHumidity[ i ], rh );
+    }
+
+    DecodeFramesScalar( &frames[ i * 4 ], count - i,
+                        status           ? &status[ i ]           : 0,
+                        tempCelcius      ? &tempCelcius[ i ]      : 0,
+                        tempFahrenheit   ? &tempFahrenheit[ i ]   : 0,
+                        relativeHumidity ? &relativeHumidity[ i ] : 0 );
+}
+
+/*======================================================================
+FUNCTION:
+    decodeAvx2()
+
+DESCRIPTION:
+    Decodes 8 frames per pass with AVX2.  Same field extraction as
+    decodeSse2(), with 4 doubles per vector for the math.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "avx2" ) ))
+static void decodeAvx2( const unsigned char* frames,
+                        size_t count,
+                        unsigned char* status,
+                        float* tempCelcius,
+                        float* tempFahrenheit,
+                        float* relativeHumidity )
+{
+    const __m256i lowByte     = _mm256_set1_epi32( 0xff );
+    const __m256i humidityHi  = _mm256_set1_epi32( 0x3f );
+    const __m256i lowTwoBits  = _mm256_set1_epi32( 0x03 );
+    const __m256d divisor     = _mm256_set1_pd( HUMIDITY_DIVISOR );
+    const __m256d hundred     = _mm256_set1_pd( 100.0 );
+    const __m256d factor      = _mm256_set1_pd( TEMPERATURE_FACTOR );
+    const __m256  forty       = _mm256_set1_ps( 40.0f );
+    const __m256d onePointEight = _mm256_set1_pd( 1.8 );
+    const __m256d thirtyTwo   = _mm256_set1_pd( 32.0 );
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= count; i += 8 )
+    {
+        __m256i word = _mm256_loadu_si256( ( const __m256i* ) &frames[ i * 4 ] );
+
+        __m256i state = _mm256_and_si256( _mm256_srli_epi32( word, 6 ), lowTwoBits );
+
+        __m256i humidity = _mm256_or_si256( _mm256_slli_epi32( _mm256_and_si256( word, humidityHi ), 8 ),
+                                            _mm256_and_si256( _mm256_srli_epi32( word, 8 ), lowByte ) );
+
+        __m256i temperature = _mm256_or_si256( _mm256_slli_epi32( _mm256_and_si256( _mm256_srli_epi32( word, 16 ), lowByte ), 6 ),
+                                               _mm256_srli_epi32( word, 26 ) );
+
+        // Four frames per double vector
+        __m256d humidityLo    = _mm256_cvtepi32_pd( _mm256_castsi256_si128( humidity ) );
+        __m256d humidityHiPd  = _mm256_cvtepi32_pd( _mm256_extracti128_si256( humidity, 1 ) );
+        __m256d temperatureLo = _mm256_cvtepi32_pd( _mm256_castsi256_si128( temperature ) );
+        __m256d temperatureHi = _mm256_cvtepi32_pd( _mm256_extracti128_si256( temperature, 1 ) );
+
+        __m256 rh = _mm256_set_m128( _mm256_cvtpd_ps( _mm256_mul_pd( _mm256_div_pd( humidityHiPd, divisor ), hundred ) ),
+                                     _mm256_cvtpd_ps( _mm256_mul_pd( _mm256_div_pd( humidityLo, divisor ), hundred ) ) );
+
+        __m256 celcius = _mm256_sub_ps( _mm256_set_m128( _mm256_cvtpd_ps( _mm256_mul_pd( temperatureHi, factor ) ),
+                                                         _mm256_cvtpd_ps( _mm256_mul_pd( temperatureLo, factor ) ) ),
+                                        forty );
+
+        __m256d celciusLo = _mm256_cvtps_pd( _mm256_castps256_ps128( celcius ) );
+        __m256d celciusHi = _mm256_cvtps_pd( _mm256_extractf128_ps( celcius, 1 ) );
+
+        __m256 fahrenheit = _mm256_set_m128( _mm256_cvtpd_ps( _mm256_add_pd( _mm256_mul_pd( celciusHi, onePointEight ), thirtyTwo ) ),
+                                             _mm256_cvtpd_ps( _mm256_add_pd( _mm256_mul_pd( celciusLo, onePointEight ), thirtyTwo ) ) );
+
+        if ( status )
+        {
+            __m128i words  = _mm_packs_epi32( _mm256_castsi256_si128( state ), _mm256_extracti128_si256( state, 1 ) );
+            __m128i packed = _mm_packus_epi16( words, words );
+
+            _mm_storel_epi64( ( __m128i* ) &status[ i ], packed );
+        }
+
+        if ( tempCelcius )      _mm256_storeu_ps( &tempCelcius[ i ], celcius );
+        if ( tempFahrenheit )   _mm256_storeu_ps( &tempFahrenheit[ i ], fahrenheit );
+        if ( relativeHumidity ) _mm256_storeu_ps( &relativeHumidity[ i ], rh );
+    }
+
+    decodeSse2( &frames[ i * 4 ], count - i,
+                status           ? &status[ i ]           : 0,
+                tempCelcius      ? &tempCelcius[ i ]      : 0,
+                tempFahrenheit   ? &tempFahrenheit[ i ]   : 0,
+                relativeHumidity ? &relativeHumidity[ i ] : 0 );
+}
+
+#elif defined( FRAMEDECODER_NEON )
+
+/*======================================================================
+FUNCTION:
+    decodeNeon()
+
+DESCRIPTION:
+    Decodes 4 frames per pass with 64 bit ARM NEON.  Same field
+    extraction as the x86 versions, 2 doubles per vector for the
+    math.  32 bit ARM NEON has no double precision vectors, so
+    those builds use the scalar decoder.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void decodeNeon( const unsigned char* frames,
+                        size_t count,
+                        unsigned char* status,
+                        float* tempCelcius,
+                        float* tempFahrenheit,
+                        float* relativeHumidity )
+{
+    const uint32x4_t  lowByte       = vdupq_n_u32( 0xff );
+    const uint32x4_t  humidityHi    = vdupq_n_u32( 0x3f );
+    const uint32x4_t  lowTwoBits    = vdupq_n_u32( 0x03 );
+    const float64x2_t divisor       = vdupq_n_f64( HUMIDITY_DIVISOR );
+    const float64x2_t hundred       = vdupq_n_f64( 100.0 );
+    const float64x2_t factor        = vdupq_n_f64( TEMPERATURE_FACTOR );
+    const float32x4_t forty         = vdupq_n_f32( 40.0f );
+    const float64x2_t onePointEight = vdupq_n_f64( 1.8 );
+    const float64x2_t thirtyTwo     = vdupq_n_f64( 32.0 );
+
+    size_t i = 0;
+
+    for ( ; i + 4 <= count; i += 4 )
+    {
+        uint32x4_t word = vreinterpretq_u32_u8( vld1q_u8( &frames[ i * 4 ] ) );
+
+        uint32x4_t state = vandq_u32( vshrq_n_u32( word, 6 ), lowTwoBits );
+
+        uint32x4_t humidity = vorrq_u32( vshlq_n_u32( vandq_u32( word, humidityHi ), 8 ),
+                                         vandq_u32( vshrq_n_u32( word, 8 ), lowByte ) );
+
+        uint32x4_t temperature = vorrq_u32( vshlq_n_u32( vandq_u32( vshrq_n_u32( word, 16 ), lowByte ), 6 ),
+                                            vshrq_n_u32( word, 26 ) );
+
+        float64x2_t humidityLo    = vcvtq_f64_u64( vmovl_u32( vget_low_u32( humidity ) ) );
+        float64x2_t humidityHiPd  = vcvtq_f64_u64( vmovl_u32( vget_high_u32( humidity ) ) );
+        float64x2_t temperatureLo = vcvtq_f64_u64( vmovl_u32( vget_low_u32( temperature ) ) );
+        float64x2_t temperatureHi = vcvtq_f64_u64( vmovl_u32( vget_high_u32( temperature ) ) );
+
+        float32x4_t rh = vcombine_f32( vcvt_f32_f64( vmulq_f64( vdivq_f64( humidityLo, divisor ), hundred ) ),
+                                       vcvt_f32_f64( vmulq_f64( vdivq_f64( humidityHiPd, divisor ), hundred ) ) );
+
+        float32x4_t celcius = vsubq_f32( vcombine_f32( vcvt_f32_f64( vmulq_f64( temperatureLo, factor ) ),
+                                                       vcvt_f32_f64( vmulq_f64( temperatureHi, factor ) ) ),
+                                         forty );
+
+        float64x2_t celciusLo = vcvt_f64_f32( vget_low_f32( celcius ) );
+        float64x2_t celciusHi = vcvt_f64_f32( vget_high_f32( celcius ) );
+
+        float32x4_t fahrenheit = vcombine_f32( vcvt_f32_f64( vaddq_f64( vmulq_f64( celciusLo, onePointEight ), thirtyTwo ) ),
+                                               vcvt_f32_f64( vaddq_f64( vmulq_f64( celciusHi, onePointEight ), thirtyTwo ) ) );
+
+        if ( status )
+        {
+            uint16x4_t halves = vmovn_u32( state );
+            uint8x8_t  bytes  = vmovn_u16( vcombine_u16( halves, halves ) );
+
+            vst1_lane_u32( ( uint32_t* ) &status[ i ], vreinterpret_u32_u8( bytes ), 0 );
+        }
+
+        if ( tempCelcius )      vst1q_f32( &tempCelcius[ i ], celcius );
+        if ( tempFahrenheit )   vst1q_f32( &tempFahrenheit[ i ], fahrenheit );
+        if ( relativeHumidity ) vst1q_f32( &relativeHumidity[ i ], rh );
+    }
+
+    DecodeFramesScalar( &frames[ i * 4 ], count - i,
+                        status           ? &status[ i ]           : 0,
+                        tempCelcius      ? &tempCelcius[ i ]      : 0,
+                        tempFahrenheit   ? &tempFahrenheit[ i ]   : 0,
+                        relativeHumidity ? &relativeHumidity[ i ] : 0 );
+}
+
+#endif
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Why double precision vectors?  Read() does its math in double and then
+rounds to float: humidity / 16383.0 * 100, temperature * (165/16383)
+rounded to float before the 40 is taken off (in float), and Fahrenheit
+from the rounded Celcius in double.  Doing the same operations in the
+same order in double lanes is the only way to promise the same bits,
+and it is still several times faster than one frame at a time because
+the unpacking and conversions go 4 or 8 wide.
+
+The frames are loaded as little endian words, which is what x86 and
+ARM Linux both are.
+
+=====================================================================*/
@@ -0,0 +1,136 @@
+#ifndef _FRAMEDECODER_H_
+#define _FRAMEDECODER_H_
+
+/*======================================================================
+FILE:
+    framedecoder.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Decodes large batches of raw Honeywell 6130 frames.
+
+DESCRIPTION:
+    This header declares the batch decoder.  It takes a buffer of
+    back to back 4 byte frames and writes the status, Celcius,
+    Fahrenheit and humidity values into separate arrays, several
+    frames at a time with SIMD instructions where the CPU has them.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DecodeFrames
+    DecodeFramesScalar
+    DecodeFramesImplementation
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <cstddef>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The results are bit for bit the same as Honeywell6130Sensor::Decode()
+// only as long as the compiler does not fuse the multiply and add in
+// the Fahrenheit step into an FMA.  wsmake builds with
+// -ffp-contract=off for that reason.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// Decodes count frames (4 bytes each, back to back) from frames.
+// Any of the output arrays can be 0 if you do not want it.  Uses
+// the fastest implementation the CPU supports.
+void DecodeFrames( const unsigned char* frames,
+                   size_t count,
+                   unsigned char* status,
+                   float* tempCelcius,
+                   float* tempFahrenheit,
+                   float* relativeHumidity );
+
+// Same thing, one frame at a time with Honeywell6130Sensor::Decode()
+void DecodeFramesScalar( const unsigned char* frames,
+                         size_t count,
+                         unsigned char* status,
+                         float* tempCelcius,
+                         float* tempFahrenheit,
+                         float* relativeHumidity );
+
+// Name of the implementation DecodeFrames() picked
+// ("avx2", "sse2", "neon" or "scalar")
+const char* DecodeFramesImplementation();
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _FRAMEDECODER_H_
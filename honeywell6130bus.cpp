@@ -0,0 +1,475 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    honeywell6130bus.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to read every Honeywell 6130 sensor on a bus with
+    batched i2c transfers
+
+GENERAL DESCRIPTION:
+    This file packs the measurement commands and the result
+    reads for many sensors into combined I2C_RDWR transfers
+
+PUBLIC CLASSES AND FUNCTIONS:
+    Honeywell6130Bus
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Make sure the sensors are connected to the i2c bus
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130bus.h"
+
+#include <linux/i2c-dev.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// The measurement command we send to every sensor
+static unsigned char measurementCommand[ 1 ] = { 0 };
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    Honeywell6130Bus()
+
+DESCRIPTION:
+    This c-tor opens the i2c bus once for all of the sensors.
+    No I2C_SLAVE binding is needed since every I2C_RDWR message
+    carries its own address.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Bus::Honeywell6130Bus( const char* i2cDevice, const std::vector< int >& addresses )
+: _transport( new I2cDevTransport( i2cDevice ) ),
+  _ownsTransport( true ),
+  _addresses( addresses ),
+  _frames( addresses.size() * Honeywell6130Sensor::FRAME_SIZE ),
+  _messages( addresses.size() ),
+  _succeeded( addresses.size() ),
+  _combined( false ),
+  _errorCount( 0 )
+{
+    try
+    {
+        open();
+    }
+    catch( ... )
+    {
+        delete _transport;
+        throw;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Honeywell6130Bus()
+
+DESCRIPTION:
+    This c-tor drives the sensors through a transport the caller
+    owns, like a SimulatedTransport
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Bus::Honeywell6130Bus( I2cTransport* transport, const std::vector< int >& addresses )
+: _transport( transport ),
+  _ownsTransport( false ),
+  _addresses( addresses ),
+  _frames( addresses.size() * Honeywell6130Sensor::FRAME_SIZE ),
+  _messages( addresses.size() ),
+  _succeeded( addresses.size() ),
+  _combined( false ),
+  _errorCount( 0 )
+{
+    open();
+}
+
+/*======================================================================
+FUNCTION:
+    ~Honeywell6130Bus()
+
+DESCRIPTION:
+    This destructor will attempt to close any open
+    file descriptors
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Bus::~Honeywell6130Bus()
+{
+    if ( _ownsTransport )
+    {
+        delete _transport;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    open()
+
+DESCRIPTION:
+    This method opens the transport.  No I2C_SLAVE binding is
+    needed since every I2C_RDWR message carries its own address.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Bus::open()
+{
+    if ( !_transport->Open() )
+    {
+        throw SensorException( "Failed to open i2cbus" );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SensorCount(), Address(), ErrorCount(), SyscallCount(),
+    SetCombined(), Combined()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    The requested value
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t Honeywell6130Bus::SensorCount() const
+{
+    return _addresses.size();
+}
+
+int Honeywell6130Bus::Address( size_t sensor ) const
+{
+    return _addresses[ sensor ];
+}
+
+unsigned long long Honeywell6130Bus::ErrorCount() const
+{
+    return _errorCount;
+}
+
+unsigned long long Honeywell6130Bus::SyscallCount() const
+{
+    return _transport->SyscallCount();
+}
+
+void Honeywell6130Bus::SetCombined( bool combined )
+{
+    _combined = combined;
+}
+
+bool Honeywell6130Bus::Combined() const
+{
+    return _combined;
+}
+
+/*======================================================================
+FUNCTION:
+    TriggerAll()
+
+DESCRIPTION:
+    This method sends the measurement command to every sensor
+    on the bus
+
+RETURN VALUE:
+    size_t - number of sensors that took the command
+
+SIDE EFFECTS:
+    pending is replaced with the sensors that took the command
+
+======================================================================*/
+size_t Honeywell6130Bus::TriggerAll( std::vector< size_t >& pending )
+{
+    const size_t count = _addresses.size();
+
+    pending.clear();
+
+    if ( 0 == count )
+    {
+        return 0;
+    }
+
+    for ( size_t s = 0; s < count; ++s )
+    {
+        _messages[ s ].addr  = ( __u16 ) _addresses[ s ];
+        _messages[ s ].flags = 0;
+        _messages[ s ].len   = sizeof( measurementCommand );
+        _messages[ s ].buf   = measurementCommand;
+    }
+
+    transfer( &_messages[ 0 ], count, &_succeeded[ 0 ] );
+
+    for ( size_t s = 0; s < count; ++s )
+    {
+        if ( _succeeded[ s ] )
+        {
+            pending.push_back( s );
+        }
+        else
+        {
+            ++_errorCount;
+        }
+    }
+
+    return pending.size();
+}
+
+/*======================================================================
+FUNCTION:
+    Fetch()
+
+DESCRIPTION:
+    This method reads the 4 byte result from every pending sensor
+    and decodes the fresh ones
+
+RETURN VALUE:
+    size_t - number of sensors with fresh data
+
+SIDE EFFECTS:
+    pending is cut down to the sensors that are still stale and
+    fresh is replaced with the sensors that were decoded
+
+======================================================================*/
+size_t Honeywell6130Bus::Fetch( std::vector< size_t >& pending,
+                                TempHumidityData* data,
+                                std::vector< size_t >& fresh )
+{
+    const size_t count = pending.size();
+
+    fresh.clear();
+
+    if ( 0 == count )
+    {
+        return 0;
+    }
+
+    for ( size_t p = 0; p < count; ++p )
+    {
+        size_t s = pending[ p ];
+
+        _messages[ p ].addr  = ( __u16 ) _addresses[ s ];
+        _messages[ p ].flags = I2C_M_RD;
+        _messages[ p ].len   = Honeywell6130Sensor::FRAME_SIZE;
+        _messages[ p ].buf   = &_frames[ s * Honeywell6130Sensor::FRAME_SIZE ];
+    }
+
+    transfer( &_messages[ 0 ], count, &_succeeded[ 0 ] );
+
+    size_t stillPending = 0;
+
+    for ( size_t p = 0; p < count; ++p )
+    {
+        size_t s = pending[ p ];
+
+        if ( !_succeeded[ p ] )
+        {
+            ++_errorCount;
+            continue;
+        }
+
+        TempHumidityData decoded;
+
+        Honeywell6130Sensor::Decode( &_frames[ s * Honeywell6130Sensor::FRAME_SIZE ], decoded );
+
+        if ( Honeywell6130Sensor::STATUS_STALE == decoded.status )
+        {
+            pending[ stillPending++ ] = s;
+            continue;
+        }
+
+        data[ s ] = decoded;
+        fresh.push_back( s );
+    }
+
+    pending.resize( stillPending );
+
+    return fresh.size();
+}
+
+/*======================================================================
+FUNCTION:
+    transfer()
+
+DESCRIPTION:
+    This method pushes a list of messages through I2C_RDWR, one
+    message per call unless _combined is set.  Combined, the kernel
+    caps the number of messages per call, so big lists go out in
+    chunks.  A chunk stops at the first sensor that does not answer
+    and the kernel does not say which one that was, so when that
+    happens we go back and send the messages in that chunk one at
+    a time to find out which sensors are really missing.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    succeeded[ i ] is set for every message that went through
+
+======================================================================*/
+void Honeywell6130Bus::transfer( struct i2c_msg* messages, size_t count, unsigned char* succeeded )
+{
+    if ( !_combined )
+    {
+        for ( size_t m = 0; m < count; ++m )
+        {
+            succeeded[ m ] = ( _transport->Transfer( &messages[ m ], 1 ) == 1 );
+        }
+
+        return;
+    }
+
+    for ( size_t first = 0; first < count; first += I2C_RDWR_IOCTL_MAX_MSGS )
+    {
+        size_t chunk = count - first;
+
+        if ( I2C_RDWR_IOCTL_MAX_MSGS < chunk )
+        {
+            chunk = I2C_RDWR_IOCTL_MAX_MSGS;
+        }
+
+        if ( _transport->Transfer( &messages[ first ], ( int ) chunk ) == ( int ) chunk )
+        {
+            for ( size_t m = 0; m < chunk; ++m )
+            {
+                succeeded[ first + m ] = 1;
+            }
+
+            continue;
+        }
+
+        for ( size_t m = 0; m < chunk; ++m )
+        {
+            succeeded[ first + m ] = ( _transport->Transfer( &messages[ first + m ], 1 ) == 1 );
+        }
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+With Honeywell6130Sensor every sample costs a write() and a read() on
+a file descriptor per sensor, after an I2C_SLAVE to bind the address.
+Here every sensor shares one file descriptor and there is no binding,
+but by default a sample still costs an I2C_RDWR for the command and
+one for the result.  Each of those is a START, the address, the data
+and a STOP, which is exactly the sequence the HIH6130 datasheet gives
+for a measurement request and a data fetch.
+
+Combined, a whole bus costs one I2C_RDWR for the commands and one for
+the results (plus one per 42 sensors, which is the kernel's
+I2C_RDWR_IOCTL_MAX_MSGS limit).  That is not the same traffic on the
+wire: the adapter runs the messages of one I2C_RDWR as one combined
+transaction, with a repeated START between them and a single STOP at
+the end.  A sensor whose measurement request is followed by a repeated
+START to another address never sees the STOP after its command.
+Honeywell's application notes do not say whether the part starts a
+conversion on that, so combined transfers stay off until someone has
+checked them on real sensors; the repeated START also keeps the bus
+from other masters for the whole round.  If a sensor in the middle
+NACKs, the adapter gives up there: the commands before it have gone
+out and the ones after it have not, which is why the fallback resends
+the chunk one message at a time (a second measurement request only
+restarts the conversion).
+
+=====================================================================*/
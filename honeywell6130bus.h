@@ -0,0 +1,244 @@
+#ifndef _HONEYWELL6130BUS_H_
+#define _HONEYWELL6130BUS_H_
+
+/*======================================================================
+FILE:
+    honeywell6130bus.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Talks to every Honeywell 6130 sensor on one i2c bus using
+    batched transfers.
+
+DESCRIPTION:
+    This header defines a bus level reader.  Instead of one file
+    descriptor per sensor and a write()/read() pair per sample,
+    it uses a single file descriptor and I2C_RDWR, which carries
+    the address in every message, and can pack many addresses into
+    one system call.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    Honeywell6130Bus
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "i2ctransport.h"
+
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The i2c adapter driver has to support I2C_FUNC_I2C (plain i2c
+// transfers) for I2C_RDWR to work.  SMBus-only adapters will fail
+// every batch.
+//
+// SetCombined( true ) puts a whole round on the wire as one
+// transaction, with a repeated START between sensors and a single
+// STOP at the end.  The HIH6130 datasheet only shows its commands
+// ending in a STOP, so only turn it on once the parts on the bus
+// are known to take that.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    Honeywell6130Bus
+
+DESCRIPTION:
+    This class drives all of the sensors on one i2c bus through a
+    single file descriptor.  TriggerAll() sends every measurement
+    command, and Fetch() reads every 4 byte result, each message
+    in an I2C_RDWR of its own unless SetCombined() says to pack
+    them.
+
+HOW TO USE:
+    1. Construct the object passing the i2c device bus (or a
+       transport) and the addresses of the sensors on it
+    2. Call TriggerAll() to start a conversion on every sensor
+    3. Wait for the settle time, then call Fetch() until the
+       pending list is empty
+
+======================================================================*/
+class Honeywell6130Bus
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    Honeywell6130Bus( const char* i2cDevice, const std::vector< int >& addresses );
+
+    // The bus does not take ownership of the transport.  It only
+    // uses Transfer(), so the transport can be shared.
+    Honeywell6130Bus( I2cTransport* transport, const std::vector< int >& addresses );
+
+    virtual ~Honeywell6130Bus();
+
+    size_t SensorCount() const;
+
+    int Address( size_t sensor ) const;
+
+    // Starts a conversion on every sensor.  pending is filled with
+    // the indexes of the sensors that took the command.
+    size_t TriggerAll( std::vector< size_t >& pending );
+
+    // Fetches the sensors listed in pending.  Fresh results go into
+    // data[ sensor index ] and their indexes go into fresh.  On
+    // return pending only holds the sensors that still report
+    // stale data.
+    size_t Fetch( std::vector< size_t >& pending,
+                  TempHumidityData* data,
+                  std::vector< size_t >& fresh );
+
+    unsigned long long ErrorCount() const;
+
+    // Off by default: one I2C_RDWR per message, so every command
+    // and every fetch is its own START ... STOP.  On, a round goes
+    // out in one I2C_RDWR per I2C_RDWR_IOCTL_MAX_MSGS messages (see
+    // the warning above).
+    void SetCombined( bool combined );
+
+    bool Combined() const;
+
+    // Number of system calls made against the i2c device,
+    // including the ones made to set it up
+    unsigned long long SyscallCount() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    Honeywell6130Bus( const Honeywell6130Bus &rhs );
+
+    void open();
+
+    void transfer( struct i2c_msg* messages, size_t count, unsigned char* succeeded );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    I2cTransport* _transport;
+
+    bool _ownsTransport;
+
+    std::vector< int > _addresses;
+
+    std::vector< unsigned char > _frames;
+
+    std::vector< struct i2c_msg > _messages;
+
+    std::vector< unsigned char > _succeeded;
+
+    bool _combined;
+
+    unsigned long long _errorCount;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _HONEYWELL6130BUS_H_
@@ -1,294 +1,1124 @@
-//======================================================================
-// OBJECT FILE COPYRIGHT NOTICE
-//======================================================================
-
-static const char copyright[] =
-"Copyright (C) 2014 Sean Foley, All rights reserved.";
-
-/*======================================================================
-FILE: 
-    Honeywell6130Sensor.cpp
-
-CREATOR:
-    Sean Foley
-    coding at sean[removethis]foleydotcom
-
-SERVICES: 
-    Methods to read data from the Honeywell 6130 Sensor
-
-GENERAL DESCRIPTION:
-    This file has methods to initialize and read data from
-    the temp/humidity sensor
-   
-PUBLIC CLASSES AND FUNCTIONS:	
-    Honeywell6130Sensor
-	   
-INITIALIZATION AND SEQUENCING REQUIREMENTS:
-    Make sure the sensor is connected to the i2c bus
-
-Copyright (C) 2014 Sean Foley  All Rights Reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-
-1. Give back and help someone else out.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
-ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-
-======================================================================*/
-
-//======================================================================
-// INCLUDES AND VARIABLE DEFINITIONS
-//======================================================================
-
-//----------------------------------------------------------------------
-// Defines
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Include Files
-//----------------------------------------------------------------------
-
-#include "honeywell6130sensor.h"
-
-#include <sys/ioctl.h>
-#include <linux/i2c-dev.h>
-#include <fcntl.h>
-#include <unistd.h>
-
-//----------------------------------------------------------------------
-// Type Declarations
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Global Constant Definitions
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Global Data Definitions
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Static Variable Definitions 
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Function Prototypes
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Required Libraries
-//----------------------------------------------------------------------
-
-// None. (Where supported these should be in the form
-// of C++ pragmas).
-
-//======================================================================
-// FUNCTION IMPLEMENTATIONS
-//======================================================================
-
-/*======================================================================
-FUNCTION: 
-    Honeywell6130Sensor()	
-
-DESCRIPTION:
-    This c-tor will attempt to establish an open file handle to
-    the i2c device
-
-RETURN VALUE:
-    none.
-
-SIDE EFFECTS:
-    none
-
-======================================================================*/
-Honeywell6130Sensor::Honeywell6130Sensor( const char* i2cDevice, int i2cAddress )
-: _fileDescriptor( 0 )
-{
-    initialize( i2cDevice, i2cAddress );
-}
-
-/*======================================================================
-FUNCTION: 
-    ~Honeywell6130Sensor()	
-
-DESCRIPTION:
-    This destructor will attempt to close any open
-    file descriptors
-
-RETURN VALUE:
-    none.
-
-SIDE EFFECTS:
-    none
-
-======================================================================*/
-Honeywell6130Sensor::~Honeywell6130Sensor()
-{
-    if ( 0 < _fileDescriptor ) 
-    {
-        close( _fileDescriptor );
-    }
-}
-
-/*======================================================================
-FUNCTION: 
-    initialize()	
-
-DESCRIPTION:
-    This method will initialize the object by setting up a
-    file descriptor and grabbing control of the device
-    on the i2c bus
-
-RETURN VALUE:
-    none.
-
-SIDE EFFECTS:
-    none
-
-======================================================================*/
-void Honeywell6130Sensor::initialize( const char* i2cDevice, int i2cAddress )
-{
-    if ( ( _fileDescriptor = open( i2cDevice, O_RDWR ) ) < 0 ) 
-    {   
-        throw SensorException( "Failed to open i2cbus" );
-    }
-
-    if ( ioctl( _fileDescriptor, I2C_SLAVE, i2cAddress ) < 0 )  
-    {
-        throw SensorException( "Failed to get i/o control to the i2c bus or the device" );
-    }
-} 
-
-/*======================================================================
-FUNCTION: 
-    Read()	
-
-DESCRIPTION:
-    This method will read the temp/humidity data from the
-    device.  
- 
-RETURN VALUE:
-    TempHumidityData
-
-SIDE EFFECTS:
-    none
-
-======================================================================*/
-TempHumidityData Honeywell6130Sensor::Read() const
-{
-     unsigned char command[ 1 ] = { 0 };
-
-     if( write( _fileDescriptor, command, 1 ) != 1 ) 
-     {
-        throw SensorException ( "Sending the measurement command failed" );        
-     }
-
-     // The device needs some settle time
-     // before reading data from it
-     usleep( 1000 );
-     
-     const int BUFFER_SIZE = 4;
-
-     char buffer[ BUFFER_SIZE ] = { 0 };
-   
-     if ( read( _fileDescriptor, buffer, BUFFER_SIZE ) != BUFFER_SIZE ) 
-     {
-         throw SensorException ( "Failed to read the expected number of bytes from the i2c device" );
-     }
-
-     // We can just operate against the buffer, but we are going to be
-     // more explicit to help teach any one new to programming what is 
-     // going on.  So we are going to create some variables that match
-     // the data values for the bit definitions the sensor puts out,
-     // then we are going to do some shifting and masking to break
-     // apart and then glue the bits back together to get the final
-     // values.
-     TempHumidityData data;
-
-     unsigned char humidityHi, humidityLo, tempHi, tempLo;
-
-     humidityHi = buffer[ 0 ];
-     humidityLo = buffer[ 1 ];
-     tempHi     = buffer[ 2 ];
-     tempLo     = buffer[ 3 ];
-
-     data.status = ( humidityHi >> 6 ) & 0x03;
-    
-     humidityHi &= 0x3f;
-
-     unsigned int humidity, temperature = 0;
-
-     humidity    = ( ( unsigned int ) humidityHi << 8 ) | humidityLo;
-     temperature = ( ( unsigned int ) tempHi     << 8 ) | tempLo;
-
-     // The bottom two bits from the tempLo are not used
-     // so we need to shift everything over or our number
-     // will be 4x too big
-     temperature = temperature >> 2;
-
-     // The tempurature and humidity values are counts.  We
-     // now have to apply the formula Honeywell provides to 
-     // convert to actual values
-
-     // RH% = Humidity Output Count X 100%
-     //       ---------------------
-     //           ( 2^14 - 1 )
-     data.relativeHumidity = ( float ) ( humidity / (16384.0 - 1) * 100 );
-
-     // Temp (C) = Temperature Output Count X 165 - 40
-     //            ------------------------
-     //              ( 2^14 - 1 )
-     data.tempCelcius = ( float ) ( temperature * ( 165.0 / (16384.0 - 1) ) ) - 40;
-
-     // Finally, do a helper for fahrenheit
-     data.tempFahrenheit = data.tempCelcius * 1.8 + 32;      
-
-     return data;
-} 
-
-/*=====================================================================
-// IMPLEMENTATION NOTES
-//=====================================================================
- 
-Many thanks to Peter Anderson for posting the data sheet on his site. 
-http://www.phanderson.com/arduino/I2CCommunications.pdf 
- 
- 
-      data byte 1           |        data byte 2      |        data byte 3          |   data byte 4
-S1|S0|B13|B12|B11|B10|B9|B8 | B7|B6|B5|B4|B3|B2|B1|B0 | T13|T12|T11|T10|T9|T8|T7|T6 | T5|T4|T3|T2|T1|T0|X|X 
-Status     Humidity         |        Humidity         |        Temperature          |     Temmpurature      
- 
-Status bits (high order bits on data byte 1)
-S1 SO 
-0  0  normal operation 
-0  1  stale data. data has already been fetched since last measurement 
-1  0  device in command mode 
-1  1  diagnostic condition 
- 
-data byte 4 
-low order bits b0..b1 (the X|X above) are not used. shift them out. 
-
-=====================================================================*/
-
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE: 
+    Honeywell6130Sensor.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES: 
+    Methods to read data from the Honeywell 6130 Sensor
+
+GENERAL DESCRIPTION:
+    This file has methods to initialize and read data from
+    the temp/humidity sensor
+   
+PUBLIC CLASSES AND FUNCTIONS:	
+    Honeywell6130Sensor
+	   
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Make sure the sensor is connected to the i2c bus
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "i2ctransport.h"
+#include "sensorstats.h"
+
+#if !defined( HONEYWELL_EMBEDDED )
+#include "sensorexecutor.h"
+#endif
+
+#include <cstring>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions 
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+FUNCTION: 
+    Honeywell6130Sensor()	
+
+DESCRIPTION:
+    This c-tor will attempt to establish an open file handle to
+    the i2c device
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::Honeywell6130Sensor( const char* i2cDevice, int i2cAddress )
+: _transport( new I2cDevTransport( i2cDevice ) ),
+  _ownsTransport( true ),
+  _stats( 0 ),
+  _address( i2cAddress ),
+  _openError( READ_OK ),
+  _retryCount( 0 ),
+  _reopenCount( 0 )
+{
+    try
+    {
+        initialize( i2cAddress );
+    }
+    catch( ... )
+    {
+        delete _stats;
+        delete _transport;
+        throw;
+    }
+}
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    Honeywell6130Sensor()	
+
+DESCRIPTION:
+    This c-tor talks to the sensor through a transport the caller
+    owns, like a SimulatedTransport
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::Honeywell6130Sensor( I2cTransport* transport, int i2cAddress )
+: _transport( transport ),
+  _ownsTransport( false ),
+  _stats( 0 ),
+  _address( i2cAddress ),
+  _openError( READ_OK ),
+  _retryCount( 0 ),
+  _reopenCount( 0 )
+{
+#if defined( __cpp_exceptions )
+    try
+    {
+        initialize( i2cAddress );
+    }
+    catch( ... )
+    {
+        delete _stats;
+        throw;
+    }
+#else
+    initialize( i2cAddress );
+#endif
+}
+
+/*======================================================================
+FUNCTION: 
+    ~Honeywell6130Sensor()	
+
+DESCRIPTION:
+    This destructor will attempt to close any open
+    file descriptors
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::~Honeywell6130Sensor()
+{
+    if ( _ownsTransport ) 
+    {
+        delete _transport;
+    }
+
+    delete _stats;
+}
+
+/*======================================================================
+FUNCTION: 
+    initialize()	
+
+DESCRIPTION:
+    This method will initialize the object by opening the 
+    transport and grabbing control of the device on the i2c bus
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::initialize( int i2cAddress )
+{
+    _address = i2cAddress;
+
+    if ( SensorStats::ENABLED )
+    {
+        _stats = new SensorStats;
+    }
+
+    _openError = open();
+
+#if defined( __cpp_exceptions )
+    if ( READ_OK != _openError ) 
+    {   
+        throw SensorException( ErrorMessage( _openError ) );
+    }
+#endif
+} 
+
+/*======================================================================
+FUNCTION: 
+    OpenError()	
+
+DESCRIPTION:
+    Simple accessor for how opening went in the c-tor
+
+RETURN VALUE:
+    ReadError
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::OpenError() const
+{
+    return _openError;
+}
+
+/*======================================================================
+FUNCTION: 
+    open()	
+
+DESCRIPTION:
+    This method opens the transport and binds it to the sensor's
+    address
+
+RETURN VALUE:
+    ReadError - READ_OK, READ_OPEN_FAILED or READ_BIND_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::open() const
+{
+    if ( !_transport->Open() ) 
+    {   
+        HONEYWELL_STATS_FAILURE( _stats, SensorStats::FAILURE_OPEN );
+        return READ_OPEN_FAILED;
+    }
+
+    if ( !_transport->SetAddress( _address ) )  
+    {
+        HONEYWELL_STATS_FAILURE( _stats, SensorStats::FAILURE_BIND );
+        return READ_BIND_FAILED;
+    }
+
+    return READ_OK;
+}
+
+/*======================================================================
+FUNCTION: 
+    reopen()	
+
+DESCRIPTION:
+    This method throws away the file descriptor and starts over,
+    for when the bus or the driver got into a bad state
+
+RETURN VALUE:
+    ReadError - READ_OK, READ_OPEN_FAILED or READ_BIND_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::reopen() const
+{
+    ++_reopenCount;
+
+    _transport->Close();
+
+    return open();
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION: 
+    Read()	
+
+DESCRIPTION:
+    This method will read the temp/humidity data from the
+    device.  It is TryRead() with the errors turned into
+    exceptions.
+ 
+RETURN VALUE:
+    TempHumidityData
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+TempHumidityData Honeywell6130Sensor::Read() const
+{
+     TempHumidityData data;
+
+     ReadError error = TryRead( data );
+
+     // Like it always has, Read() hands back stale data with
+     // the status saying so rather than throwing
+     if ( READ_OK != error && READ_STALE != error )
+     {
+         throw SensorException( ErrorMessage( error ) );
+     }
+
+     return data;
+} 
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    TryRead()	
+
+DESCRIPTION:
+    This method triggers a measurement, waits for the settle time
+    and fetches the result without throwing or allocating, retrying
+    as readRetrying() does, and decodes it
+ 
+RETURN VALUE:
+    ReadError - READ_OK, or the last error if every try failed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::TryRead( TempHumidityData& data ) const
+{
+     unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+     ReadError result = readRetrying( frame );
+
+     if ( READ_OK == result || READ_STALE == result )
+     {
+         HONEYWELL_STATS_START( decodeStart );
+
+         Decode( frame, data );
+
+         HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_DECODE, decodeStart );
+     }
+
+     return result;
+}
+
+/*======================================================================
+FUNCTION: 
+    readRetrying()	
+
+DESCRIPTION:
+    TryRead() up to the decode.  Drives readStep() to the end,
+    sleeping through each wait it asks for.
+ 
+RETURN VALUE:
+    ReadError - READ_OK, or the last error if every try failed.
+                frame holds the last frame fetched for READ_OK and
+                READ_STALE.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::readRetrying( unsigned char frame[ FRAME_SIZE ] ) const
+{
+     ReadProgress progress( _retryPolicy.initialBackoffMicroseconds );
+
+     while ( readStep( progress, frame ) )
+     {
+         usleep( progress.waitMicroseconds );
+     }
+
+     return progress.result;
+}
+
+/*======================================================================
+FUNCTION: 
+    readStep()	
+
+DESCRIPTION:
+    Takes a read as far as its next wait.  On a failure it backs off
+    and tries again, up to the retry policy's limit.  A stale result
+    is fetched again (the conversion is already running); an i/o
+    failure reopens the transport if the policy says to and starts
+    over with a new trigger.  The waits are the caller's, so the
+    blocking read and the coroutine share every other step.
+ 
+RETURN VALUE:
+    bool - true to wait progress.waitMicroseconds and call again,
+           false when progress.result is the outcome of the read
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool Honeywell6130Sensor::readStep( ReadProgress& progress, unsigned char frame[ FRAME_SIZE ] ) const
+{
+     for ( ;; )
+     {
+         switch ( progress.step )
+         {
+         case ReadProgress::STEP_BACK_OFF:
+
+             ++_retryCount;
+
+             progress.step             = ReadProgress::STEP_RETRY;
+             progress.waitMicroseconds = progress.backoff;
+
+             return true;
+
+         case ReadProgress::STEP_RETRY:
+
+             progress.backoff = ( progress.backoff > _retryPolicy.maxBackoffMicroseconds / 2 ) ?
+                                _retryPolicy.maxBackoffMicroseconds : progress.backoff * 2;
+
+             progress.step = ReadProgress::STEP_TRIGGER;
+
+             if ( READ_STALE != progress.result && _retryPolicy.reopen )
+             {
+                 progress.result = reopen();
+
+                 if ( READ_OK != progress.result )
+                 {
+                     break;
+                 }
+             }
+
+             continue;
+
+         case ReadProgress::STEP_TRIGGER:
+
+             if ( progress.triggered )
+             {
+                 progress.step = ReadProgress::STEP_FETCH;
+                 continue;
+             }
+
+             progress.result = TryTriggerMeasurement();
+
+             if ( READ_OK != progress.result )
+             {
+                 break;
+             }
+
+             progress.triggered = true;
+             progress.settling  = true;
+
+#ifdef HONEYWELL_STATS
+             progress.settleStart = SensorStats::Now();
+#endif
+
+             // The device needs some settle time
+             // before reading data from it
+             progress.step             = ReadProgress::STEP_FETCH;
+             progress.waitMicroseconds = SETTLE_MICROSECONDS;
+
+             return true;
+
+         case ReadProgress::STEP_FETCH:
+
+             if ( progress.settling )
+             {
+                 HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_SETTLE, progress.settleStart );
+
+                 progress.settling = false;
+             }
+
+             progress.result = readFrame( frame );
+
+             if ( READ_OK == progress.result && STATUS_STALE == ( ( frame[ 0 ] >> 6 ) & 0x03 ) )
+             {
+                 progress.result = READ_STALE;
+             }
+
+             if ( READ_OK == progress.result )
+             {
+                 return false;
+             }
+
+             if ( READ_STALE != progress.result )
+             {
+                 progress.triggered = false;
+             }
+
+             break;
+         }
+
+         // This attempt failed
+         if ( _retryPolicy.retries <= progress.attempt )
+         {
+             return false;
+         }
+
+         ++progress.attempt;
+
+         progress.step = ReadProgress::STEP_BACK_OFF;
+     }
+}
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+FUNCTION: 
+    ReadAsync()	
+
+DESCRIPTION:
+    Same steps as TryRead(), but the settle time and the backoff
+    are co_awaited on the executor, so the thread goes on to run
+    other coroutines while this sensor converts
+ 
+RETURN VALUE:
+    SensorTask< SensorReading > - the error code and the data
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorTask< SensorReading > Honeywell6130Sensor::ReadAsync( SensorExecutor& executor ) const
+{
+     SensorReading reading;
+
+     unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+     ReadProgress progress( _retryPolicy.initialBackoffMicroseconds );
+
+     while ( readStep( progress, frame ) )
+     {
+         co_await executor.Sleep( progress.waitMicroseconds );
+     }
+
+     reading.error = progress.result;
+
+     if ( READ_OK == reading.error || READ_STALE == reading.error )
+     {
+         HONEYWELL_STATS_START( decodeStart );
+
+         Decode( frame, reading.data );
+
+         HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_DECODE, decodeStart );
+     }
+
+     co_return reading;
+}
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    SetRetryPolicy()	
+
+DESCRIPTION:
+    This method changes how hard TryRead() and Read() try
+ 
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::SetRetryPolicy( const RetryPolicy& policy )
+{
+     _retryPolicy = policy;
+}
+
+/*======================================================================
+FUNCTION: 
+    GetRetryPolicy()	
+
+DESCRIPTION:
+    This method hands back the retry policy in use
+ 
+RETURN VALUE:
+    const RetryPolicy&
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const Honeywell6130Sensor::RetryPolicy& Honeywell6130Sensor::GetRetryPolicy() const
+{
+     return _retryPolicy;
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION: 
+    TriggerMeasurement()	
+
+DESCRIPTION:
+    This method sends the measurement command to the device
+    and returns right away.  The device needs some time to do
+    the conversion, so call TryFetch() later to get the data.
+ 
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::TriggerMeasurement() const
+{
+     ReadError error = TryTriggerMeasurement();
+
+     if( READ_OK != error ) 
+     {
+        throw SensorException ( ErrorMessage( error ) );        
+     }
+}
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    TryTriggerMeasurement()	
+
+DESCRIPTION:
+    Same as TriggerMeasurement() with an error code instead of
+    an exception
+ 
+RETURN VALUE:
+    ReadError - READ_OK or READ_COMMAND_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::TryTriggerMeasurement() const
+{
+     unsigned char command[ 1 ] = { 0 };
+
+     HONEYWELL_STATS_START( commandStart );
+
+     if( _transport->Write( command, 1 ) != 1 ) 
+     {
+        HONEYWELL_STATS_FAILURE( _stats, SensorStats::FAILURE_COMMAND );
+        return READ_COMMAND_FAILED;
+     }
+
+     HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_COMMAND, commandStart );
+
+     return READ_OK;
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION: 
+    TryFetch()	
+
+DESCRIPTION:
+    This method reads the latest measurement from the device
+    without waiting.  If the device has not finished the 
+    conversion started by TriggerMeasurement() it hands back
+    the data we already fetched and flags it as stale, so we 
+    tell the caller to try again later.
+ 
+RETURN VALUE:
+    bool - true if data was filled in with a new measurement,
+           false if the measurement is not ready yet
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool Honeywell6130Sensor::TryFetch( TempHumidityData& data ) const
+{
+     TempHumidityData fetched;
+
+     ReadError error = TryFetchResult( fetched );
+
+     if ( READ_STALE == error )
+     {
+         return false;
+     }
+
+     if ( READ_OK != error )
+     {
+         throw SensorException ( ErrorMessage( error ) );
+     }
+
+     data = fetched;
+
+     return true;
+}
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    TryFetchResult()	
+
+DESCRIPTION:
+    Same as TryFetch() with an error code instead of an
+    exception.  data is filled in even when the result is stale.
+ 
+RETURN VALUE:
+    ReadError - READ_OK, READ_STALE or READ_FETCH_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::TryFetchResult( TempHumidityData& data ) const
+{
+     unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+     ReadError error = readFrame( frame );
+
+     if ( READ_OK != error )
+     {
+         return error;
+     }
+
+     HONEYWELL_STATS_START( decodeStart );
+
+     Decode( frame, data );
+
+     HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_DECODE, decodeStart );
+
+     return ( STATUS_STALE == data.status ) ? READ_STALE : READ_OK;
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION: 
+    TryFetchRaw()	
+
+DESCRIPTION:
+    Same as TryFetch() but skips the decode and copies the raw
+    frame out instead
+ 
+RETURN VALUE:
+    bool - true if frame was filled in with a new measurement,
+           false if the measurement is not ready yet
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool Honeywell6130Sensor::TryFetchRaw( unsigned char frame[ FRAME_SIZE ] ) const
+{
+     unsigned char fetched[ FRAME_SIZE ] = { 0 };
+
+     fetchFrame( fetched );
+
+     if ( STATUS_STALE == ( ( fetched[ 0 ] >> 6 ) & 0x03 ) )
+     {
+         return false;
+     }
+
+     memcpy( frame, fetched, FRAME_SIZE );
+
+     return true;
+}
+
+/*======================================================================
+FUNCTION: 
+    fetchFrame()	
+
+DESCRIPTION:
+    This method reads one raw measurement frame from the device
+ 
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::fetchFrame( unsigned char frame[ FRAME_SIZE ] ) const
+{
+     ReadError error = readFrame( frame );
+
+     if ( READ_OK != error ) 
+     {
+         throw SensorException ( ErrorMessage( error ) );
+     }
+}
+
+#endif
+
+/*======================================================================
+FUNCTION: 
+    readFrame()	
+
+DESCRIPTION:
+    Same as fetchFrame() with an error code instead of an
+    exception
+ 
+RETURN VALUE:
+    ReadError - READ_OK or READ_FETCH_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+Honeywell6130Sensor::ReadError Honeywell6130Sensor::readFrame( unsigned char frame[ FRAME_SIZE ] ) const
+{
+     HONEYWELL_STATS_START( fetchStart );
+
+     if ( _transport->Read( frame, FRAME_SIZE ) != FRAME_SIZE ) 
+     {
+         HONEYWELL_STATS_FAILURE( _stats, SensorStats::FAILURE_FETCH );
+         return READ_FETCH_FAILED;
+     }
+
+     HONEYWELL_STATS_PHASE( _stats, SensorStats::PHASE_FETCH, fetchStart );
+     HONEYWELL_STATS_STATUS( _stats, ( frame[ 0 ] >> 6 ) & 0x03 );
+
+     return READ_OK;
+}
+
+/*======================================================================
+FUNCTION: 
+    Decode()	
+
+DESCRIPTION:
+    This method turns the raw bytes from the device into the
+    status and temp/humidity values.  See the implementation
+    notes at the bottom of this file for the bit layout.
+ 
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::Decode( const unsigned char frame[ FRAME_SIZE ], TempHumidityData& data )
+{
+     // We can just operate against the buffer, but we are going to be
+     // more explicit to help teach any one new to programming what is 
+     // going on.  So we are going to create some variables that match
+     // the data values for the bit definitions the sensor puts out,
+     // then we are going to do some shifting and masking to break
+     // apart and then glue the bits back together to get the final
+     // values.
+     unsigned char humidityHi, humidityLo, tempHi, tempLo;
+
+     humidityHi = frame[ 0 ];
+     humidityLo = frame[ 1 ];
+     tempHi     = frame[ 2 ];
+     tempLo     = frame[ 3 ];
+
+     data.status = ( humidityHi >> 6 ) & 0x03;
+    
+     humidityHi &= 0x3f;
+
+     unsigned int humidity, temperature = 0;
+
+     humidity    = ( ( unsigned int ) humidityHi << 8 ) | humidityLo;
+     temperature = ( ( unsigned int ) tempHi     << 8 ) | tempLo;
+
+     // The bottom two bits from the tempLo are not used
+     // so we need to shift everything over or our number
+     // will be 4x too big
+     temperature = temperature >> 2;
+
+     // The tempurature and humidity values are counts.  We
+     // now have to apply the formula Honeywell provides to 
+     // convert to actual values
+
+     // RH% = Humidity Output Count X 100%
+     //       ---------------------
+     //           ( 2^14 - 1 )
+     data.relativeHumidity = ( float ) ( humidity / (16384.0 - 1) * 100 );
+
+     // Temp (C) = Temperature Output Count X 165 - 40
+     //            ------------------------
+     //              ( 2^14 - 1 )
+     data.tempCelcius = ( float ) ( temperature * ( 165.0 / (16384.0 - 1) ) ) - 40;
+
+     // Finally, do a helper for fahrenheit
+     data.tempFahrenheit = data.tempCelcius * 1.8 + 32;      
+} 
+
+/*======================================================================
+FUNCTION: 
+    Encode()	
+
+DESCRIPTION:
+    This method undoes Decode(): it rounds the values back to the
+    nearest counts and packs them into a frame.  A frame that went
+    through Decode() comes back out bit for bit (the two unused
+    temperature bits are always zero).
+ 
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void Honeywell6130Sensor::Encode( const TempHumidityData& data, unsigned char frame[ FRAME_SIZE ] )
+{
+     const double countMax = 16384.0 - 1;
+
+     double humidity    = data.relativeHumidity / 100.0 * countMax + 0.5;
+     double temperature = ( data.tempCelcius + 40.0 ) / 165.0 * countMax + 0.5;
+
+     // Out of range values (and NaN) pin to the ends of the scale
+     unsigned int humidityCount    = ( humidity > 0 ) ? ( ( humidity < countMax ) ? ( unsigned int ) humidity : 0x3fff ) : 0;
+     unsigned int temperatureCount = ( temperature > 0 ) ? ( ( temperature < countMax ) ? ( unsigned int ) temperature : 0x3fff ) : 0;
+
+     frame[ 0 ] = ( unsigned char ) ( ( ( data.status & 0x03 ) << 6 ) | ( humidityCount >> 8 ) );
+     frame[ 1 ] = ( unsigned char ) ( humidityCount & 0xff );
+     frame[ 2 ] = ( unsigned char ) ( temperatureCount >> 6 );
+     frame[ 3 ] = ( unsigned char ) ( ( temperatureCount << 2 ) & 0xfc );
+}
+
+/*======================================================================
+FUNCTION: 
+    SyscallCount()	
+
+DESCRIPTION:
+    Simple accessor for the number of system calls made against
+    the i2c device.  Handy for comparing against the batched
+    transfers in Honeywell6130Bus.
+ 
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long Honeywell6130Sensor::SyscallCount() const
+{
+     return _transport->SyscallCount();
+}
+
+/*======================================================================
+FUNCTION: 
+    Stats()	
+
+DESCRIPTION:
+    This method copies out the read path timings and counters
+ 
+RETURN VALUE:
+    bool - false if the build does not collect them
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool Honeywell6130Sensor::Stats( SensorStatsSnapshot& snapshot ) const
+{
+#ifdef HONEYWELL_STATS
+     if ( 0 == _stats )
+     {
+         return false;
+     }
+
+     _stats->Snapshot( snapshot );
+
+     return true;
+#else
+     // Builds without it (Embedded) do not link sensorstats.o
+     ( void ) snapshot;
+
+     return false;
+#endif
+}
+
+/*======================================================================
+FUNCTION: 
+    RetryCount()	
+
+DESCRIPTION:
+    This method returns how many retries TryRead() has made
+ 
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long Honeywell6130Sensor::RetryCount() const
+{
+     return _retryCount;
+}
+
+/*======================================================================
+FUNCTION: 
+    ReopenCount()	
+
+DESCRIPTION:
+    This method returns how many times TryRead() reopened the
+    transport
+ 
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long Honeywell6130Sensor::ReopenCount() const
+{
+     return _reopenCount;
+}
+
+/*======================================================================
+FUNCTION: 
+    ErrorMessage()	
+
+DESCRIPTION:
+    This method turns an error code into the text the exceptions
+    have always carried
+ 
+RETURN VALUE:
+    const char* - a string literal, never freed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* Honeywell6130Sensor::ErrorMessage( ReadError error )
+{
+     switch ( error )
+     {
+     case READ_OK:
+         return "No error";
+     case READ_STALE:
+         return "The sensor did not finish the measurement in time";
+     case READ_OPEN_FAILED:
+         return "Failed to open i2cbus";
+     case READ_BIND_FAILED:
+         return "Failed to get i/o control to the i2c bus or the device";
+     case READ_COMMAND_FAILED:
+         return "Sending the measurement command failed";
+     case READ_FETCH_FAILED:
+         return "Failed to read the expected number of bytes from the i2c device";
+     }
+
+     return "Unknown error";
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+ 
+Many thanks to Peter Anderson for posting the data sheet on his site. 
+http://www.phanderson.com/arduino/I2CCommunications.pdf 
+ 
+ 
+      data byte 1           |        data byte 2      |        data byte 3          |   data byte 4
+S1|S0|B13|B12|B11|B10|B9|B8 | B7|B6|B5|B4|B3|B2|B1|B0 | T13|T12|T11|T10|T9|T8|T7|T6 | T5|T4|T3|T2|T1|T0|X|X 
+Status     Humidity         |        Humidity         |        Temperature          |     Temmpurature      
+ 
+Status bits (high order bits on data byte 1)
+S1 SO 
+0  0  normal operation 
+0  1  stale data. data has already been fetched since last measurement 
+1  0  device in command mode 
+1  1  diagnostic condition 
+ 
+data byte 4 
+low order bits b0..b1 (the X|X above) are not used. shift them out. 
+
+Non-blocking reads
+A fetch does not start a new measurement, so the device hands back
+the last result with the status set to 01 (stale) until the conversion
+started by the previous measurement command is done.  TryFetch() uses
+that to tell the caller "not ready yet" instead of sleeping.
+
+=====================================================================*/
+
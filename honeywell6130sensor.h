@@ -1,206 +1,424 @@
-#ifndef _HONEYWELL6130SENSOR_H_
-#define _HONEYWELL6130SENSOR_H_
-
-/*======================================================================
-FILE: 
-    honeywell6130sensor.h
-
-CREATOR:
-    Sean Foley
-    coding at sean[removethis]foleydotcom
-
-SERVICES:
-    Provides support to read temperature and humidity data
-    from a Honeywell 6130 i2c sensor.
-
-DESCRIPTION:
-    This header defines a simple implementation interface
-    to retrieve temperature and humidity data.
-
-PUBLIC CLASSES AND FUNCTIONS:
-    Honeywell6130Sensor
-
-Copyright (C) 2014 Sean Foley  All Rights Reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-
-1. Give back and help someone else out.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
-ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-
-======================================================================*/
-
-//======================================================================
-// INCLUDES AND PUBLIC DATA DECLARATIONS
-//======================================================================
-
-//----------------------------------------------------------------------
-// Defines
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Include Files
-//----------------------------------------------------------------------
-
-#include <exception>
-#include <string>
-
-//----------------------------------------------------------------------
-// Type Declarations
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Global Constant Declarations
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Global Data Declarations
-//----------------------------------------------------------------------
-
-struct TempHumidityData
-{
-    unsigned char status;
-    float tempCelcius;
-    float tempFahrenheit;
-    float relativeHumidity;
-};
-
-//======================================================================
-// WARNINGS!!!
-//======================================================================
-
-// None.
-
-//======================================================================
-// FUNCTION DECLARATIONS
-//======================================================================
-
-// None.
-
-//=====================================================================
-// EXCEPTION CLASS DEFINITIONS
-//=====================================================================
-
-class SensorException : public std::exception
-{
-public:
-
-    // C-tors
-    SensorException( std::string message ) :_message( message ) { }
-    SensorException( const char* message ) :_message( message ) { }    
-
-    virtual ~SensorException() throw() { } 
- 
-    virtual const char* what()
-    {
-        return _message.c_str();
-    }
-
-private:
-    std::string _message;
-};
-
-//======================================================================
-// CLASS DEFINITIONS
-//======================================================================
-
-/*======================================================================
-CLASS: 
-    Honeywell6130Sensor
-
-DESCRIPTION:
-    This class hides the low level bit fiddling needed to grab
-    temp and humidity data from a Honeywell 6130 Sensor.
-
-HOW TO USE:
-    1. Construct the object passing the i2c device bus
-    2. Call Read() to get data
-
-======================================================================*/
-class Honeywell6130Sensor
-{
-public:
-	
-    //=================================================================
-    // TYPE DECLARATIONS AND CONSTANTS    
-    //=================================================================
-
-    // None.
-
-    //=================================================================
-    // CLIENT INTERFACE
-    //=================================================================
-    
-    Honeywell6130Sensor( const char* i2cDevice, int i2cAddress = 0x27 );
-
-    virtual ~Honeywell6130Sensor();
-
-    TempHumidityData Read() const;
-
-protected:
-
-    //=================================================================
-    // SUBCLASS INTERFACE   
-    //=================================================================
-    
-    // None.
-
-private:
-    
-    //=================================================================
-    // CUSTOMIZATION INTERFACE    
-    //=================================================================
-
-    // None.
-
-    //=================================================================
-    // IMPLEMENTATION INTERFACE    
-    //=================================================================
-
-    // No copying. Not implementing the method
-    // to force a link error if someone tries to 
-    // invode a copy c-tor.
-    Honeywell6130Sensor( const Honeywell6130Sensor &rhs );
-
-    void initialize( const char* i2cDevice, int i2cAddress );
-
-    //=================================================================
-    // DATA MEMBERS    
-    //=================================================================
-
-    int _fileDescriptor;
-
-};
-
-//======================================================================
-// INLINE FUNCTION DEFINITIONS
-//======================================================================
-
-// None.
-
-
-/*======================================================================
-// DOCUMENTATION
-========================================================================
-
-None.
-
-======================================================================*/
-
-#endif	// #ifendif _HONEYWELL6130SENSOR_H_
+#ifndef _HONEYWELL6130SENSOR_H_
+#define _HONEYWELL6130SENSOR_H_
+
+/*======================================================================
+FILE: 
+    honeywell6130sensor.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Provides support to read temperature and humidity data
+    from a Honeywell 6130 i2c sensor.
+
+DESCRIPTION:
+    This header defines a simple implementation interface
+    to retrieve temperature and humidity data.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    Honeywell6130Sensor
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <exception>
+
+#if !defined( HONEYWELL_EMBEDDED )
+#include <string>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+class I2cTransport;
+class SensorStats;
+class SensorStatsSnapshot;
+class SensorExecutor;
+struct SensorReading;
+template< class T > class SensorTask;
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+struct TempHumidityData
+{
+    unsigned char status;
+    float tempCelcius;
+    float tempFahrenheit;
+    float relativeHumidity;
+};
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The Embedded build (HONEYWELL_EMBEDDED) leaves out everything here
+// that allocates: the c-tor that makes its own transport, and
+// ReadAsync(), whose coroutine frames are on the heap.  Built with
+// -fno-exceptions the calls that throw are left out as well; use the
+// Try calls and OpenError().
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//=====================================================================
+// EXCEPTION CLASS DEFINITIONS
+//=====================================================================
+
+class SensorException : public std::exception
+{
+public:
+
+    // C-tors
+#if defined( HONEYWELL_EMBEDDED )
+    // Kept as given, so it has to outlive the exception; every
+    // message the sensor code throws is a string literal
+    SensorException( const char* message ) :_message( message ) { }
+#else
+    SensorException( std::string message ) :_message( message ) { }
+    SensorException( const char* message ) :_message( message ) { }    
+#endif
+
+    virtual ~SensorException() throw() { } 
+ 
+    virtual const char* what() const throw()
+    {
+#if defined( HONEYWELL_EMBEDDED )
+        return _message;
+#else
+        return _message.c_str();
+#endif
+    }
+
+private:
+#if defined( HONEYWELL_EMBEDDED )
+    const char* _message;
+#else
+    std::string _message;
+#endif
+};
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS: 
+    Honeywell6130Sensor
+
+DESCRIPTION:
+    This class hides the low level bit fiddling needed to grab
+    temp and humidity data from a Honeywell 6130 Sensor.
+
+HOW TO USE:
+    1. Construct the object passing the i2c device bus (or a
+       transport, to run over something other than i2c-dev)
+    2. Call Read() to get data, or TryRead() to get an error
+       code instead of an exception, or co_await ReadAsync()
+       from a coroutine
+
+======================================================================*/
+class Honeywell6130Sensor
+{
+public:
+	
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS    
+    //=================================================================
+
+    // The two status bits (S1|S0) the sensor puts in front of
+    // every measurement
+    enum Status
+    {
+        STATUS_NORMAL       = 0x00,
+        STATUS_STALE        = 0x01,
+        STATUS_COMMAND_MODE = 0x02,
+        STATUS_DIAGNOSTIC   = 0x03
+    };
+
+    // Number of bytes the sensor sends back for one measurement
+    static const int FRAME_SIZE = 4;
+
+    // How long Read() gives the device to finish a conversion
+    static const unsigned int SETTLE_MICROSECONDS = 1000;
+
+    // What the non-throwing calls hand back.  Everything but
+    // READ_OK and READ_STALE is a place the throwing calls would
+    // have thrown.
+    enum ReadError
+    {
+        READ_OK = 0,
+        READ_STALE,
+        READ_OPEN_FAILED,
+        READ_BIND_FAILED,
+        READ_COMMAND_FAILED,
+        READ_FETCH_FAILED
+    };
+
+    // How hard TryRead() (and so Read()) tries before giving up.
+    // Each retry waits twice as long as the one before, starting
+    // at initialBackoffMicroseconds and never more than
+    // maxBackoffMicroseconds.  With reopen set an i/o failure also
+    // closes the transport, opens it again and rebinds the address.
+    struct RetryPolicy
+    {
+        unsigned int retries;
+        unsigned int initialBackoffMicroseconds;
+        unsigned int maxBackoffMicroseconds;
+        bool reopen;
+
+        RetryPolicy() : retries( 3 ),
+                        initialBackoffMicroseconds( 1000 ),
+                        maxBackoffMicroseconds( 50000 ),
+                        reopen( true ) { }
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+    
+#if !defined( HONEYWELL_EMBEDDED )
+    Honeywell6130Sensor( const char* i2cDevice, int i2cAddress = 0x27 );
+#endif
+
+    // The sensor does not take ownership of the transport, and
+    // the transport can not be shared with another sensor
+    Honeywell6130Sensor( I2cTransport* transport, int i2cAddress = 0x27 );
+
+    virtual ~Honeywell6130Sensor();
+
+    // What opening the transport and binding the address came back
+    // with.  With exceptions the c-tor throws instead, so this is
+    // always READ_OK; without them the sensor is made anyway and
+    // TryRead() opens it again when it retries.
+    ReadError OpenError() const;
+
+#if defined( __cpp_exceptions )
+    // Throws a SensorException if TryRead() fails
+    TempHumidityData Read() const;
+#endif
+
+    // Read() without exceptions or allocation.  Retries and
+    // reopens according to the retry policy.  data is filled in
+    // for READ_OK, and for READ_STALE if the sensor never came
+    // back with a fresh measurement.
+    ReadError TryRead( TempHumidityData& data ) const;
+
+    void SetRetryPolicy( const RetryPolicy& policy );
+
+    const RetryPolicy& GetRetryPolicy() const;
+
+#if !defined( HONEYWELL_EMBEDDED )
+    // TryRead() for coroutines (see sensorexecutor.h).  The settle
+    // time and the backoff suspend the coroutine on the executor
+    // instead of sleeping the thread.
+    SensorTask< SensorReading > ReadAsync( SensorExecutor& executor ) const;
+#endif
+
+#if defined( __cpp_exceptions )
+    // Non-blocking version of Read(), split in two.  Call 
+    // TriggerMeasurement() to start a conversion, go do something
+    // else (like trigger other sensors), then call TryFetch()
+    // until it returns true.
+    void TriggerMeasurement() const;
+
+    bool TryFetch( TempHumidityData& data ) const;
+#endif
+
+    // Same pair without exceptions.  These do not retry.
+    ReadError TryTriggerMeasurement() const;
+
+    ReadError TryFetchResult( TempHumidityData& data ) const;
+
+#if defined( __cpp_exceptions )
+    // Same as TryFetch() but hands back the undecoded frame, for
+    // callers that store raw frames and convert them later
+    bool TryFetchRaw( unsigned char frame[ FRAME_SIZE ] ) const;
+#endif
+
+    // Turns a raw frame from the sensor into real values
+    static void Decode( const unsigned char frame[ FRAME_SIZE ], TempHumidityData& data );
+
+    // The other way: the frame that decodes to data, for storing
+    // readings that only arrived decoded
+    static void Encode( const TempHumidityData& data, unsigned char frame[ FRAME_SIZE ] );
+
+    // Number of system calls this object has made against the
+    // i2c device (calls into the transport), including the ones
+    // made to set it up
+    unsigned long long SyscallCount() const;
+
+    // Copies out the per-phase timings and the status and failure
+    // counters.  Returns false (and leaves snapshot alone) if the
+    // build does not have HONEYWELL_STATS.
+    bool Stats( SensorStatsSnapshot& snapshot ) const;
+
+    // Retries TryRead() made, and times it reopened the transport
+    unsigned long long RetryCount() const;
+
+    unsigned long long ReopenCount() const;
+
+    static const char* ErrorMessage( ReadError error );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE   
+    //=================================================================
+    
+#if defined( __cpp_exceptions )
+    // Reads one raw frame, for subclasses that decode it
+    // their own way
+    void fetchFrame( unsigned char frame[ FRAME_SIZE ] ) const;
+#endif
+
+    // TryRead() without the decode, for the same subclasses.
+    // frame is filled in for READ_OK and READ_STALE.
+    ReadError readRetrying( unsigned char frame[ FRAME_SIZE ] ) const;
+
+    // fetchFrame() with an error code instead of an exception
+    ReadError readFrame( unsigned char frame[ FRAME_SIZE ] ) const;
+
+private:
+    
+    //=================================================================
+    // CUSTOMIZATION INTERFACE    
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE    
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to 
+    // invode a copy c-tor.
+    Honeywell6130Sensor( const Honeywell6130Sensor &rhs );
+
+    void initialize( int i2cAddress );
+
+    ReadError open() const;
+
+    ReadError reopen() const;
+
+    // How far a read has got, between two of readStep()'s waits
+    struct ReadProgress
+    {
+        enum Step
+        {
+            STEP_TRIGGER,
+            STEP_FETCH,
+            STEP_BACK_OFF,
+            STEP_RETRY
+        };
+
+        Step step;
+        ReadError result;
+        unsigned int attempt;
+        unsigned int backoff;
+        unsigned int waitMicroseconds;
+        bool triggered;
+        bool settling;
+        long long settleStart;
+
+        ReadProgress( unsigned int initialBackoffMicroseconds )
+        : step( STEP_TRIGGER ),
+          result( READ_OK ),
+          attempt( 0 ),
+          backoff( initialBackoffMicroseconds ),
+          waitMicroseconds( 0 ),
+          triggered( false ),
+          settling( false ),
+          settleStart( 0 ) { }
+    };
+
+    // One step of a retried read, as far as the next wait.  Returns
+    // true with waitMicroseconds to sleep before calling it again,
+    // false once result is final.  frame is filled in as for
+    // readRetrying().
+    bool readStep( ReadProgress& progress, unsigned char frame[ FRAME_SIZE ] ) const;
+
+    //=================================================================
+    // DATA MEMBERS    
+    //=================================================================
+
+    I2cTransport* _transport;
+
+    bool _ownsTransport;
+
+    // Zero unless the build has HONEYWELL_STATS
+    SensorStats* _stats;
+
+    int _address;
+
+    ReadError _openError;
+
+    RetryPolicy _retryPolicy;
+
+    mutable unsigned long long _retryCount;
+
+    mutable unsigned long long _reopenCount;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _HONEYWELL6130SENSOR_H_
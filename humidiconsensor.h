@@ -0,0 +1,529 @@
+#ifndef _HUMIDICONSENSOR_H_
+#define _HUMIDICONSENSOR_H_
+
+/*======================================================================
+FILE:
+    humidiconsensor.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Compile time specialized decoding for the Honeywell HumidIcon
+    family (HIH6130, HIH6131, HIH8000 series).
+
+DESCRIPTION:
+    This header defines a trait class per sensor variant, two
+    conversion policies (plain arithmetic, or lookup tables that
+    the compiler builds with constexpr), and a sensor class
+    template that ties a variant and a policy together.  Every
+    combination gets its own decode path with no runtime branches.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    Hih6130, Hih6131, Hih8000
+    ArithmeticConversion
+    TableConversion
+    HumidIconSensor
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// Build with -DHONEYWELL_USE_LOOKUP_TABLES to make TableConversion
+// the default policy.  Tables cost 64K of read only data per 14 bit
+// table but take the double precision math off soft-float targets.
+#ifdef HONEYWELL_USE_LOOKUP_TABLES
+#define HONEYWELL_DEFAULT_CONVERSION TableConversion
+#else
+#define HONEYWELL_DEFAULT_CONVERSION ArithmeticConversion
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <array>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The tables are filled in by the compiler.  That needs C++17
+// (constexpr std::array element assignment).
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    Hih6130, Hih6131, Hih8000
+
+DESCRIPTION:
+    Variant traits.  Each one says how many bits of humidity and
+    temperature the part sends and the transfer function from the
+    datasheet:
+        RH%      = count / ( 2^bits - 1 ) X HUMIDITY_SPAN
+        Temp (C) = count / ( 2^bits - 1 ) X TEMPERATURE_SPAN - TEMPERATURE_OFFSET
+    The parts we use today all share the same numbers; they differ
+    in accuracy and filtering, not in the frame.  A new part with a
+    different resolution only needs a new trait class.
+
+HOW TO USE:
+    Pass one as the first template argument of HumidIconSensor
+
+======================================================================*/
+struct Hih6130
+{
+    static constexpr unsigned int HUMIDITY_BITS      = 14;
+    static constexpr unsigned int TEMPERATURE_BITS   = 14;
+    static constexpr double       HUMIDITY_SPAN      = 100.0;
+    static constexpr double       TEMPERATURE_SPAN   = 165.0;
+    static constexpr double       TEMPERATURE_OFFSET = 40.0;
+};
+
+// Same as the HIH6130 plus a condensation filter
+struct Hih6131 : public Hih6130
+{
+};
+
+// Tighter accuracy, same frame and transfer function
+struct Hih8000 : public Hih6130
+{
+};
+
+/*======================================================================
+CLASS:
+    ArithmeticConversion
+
+DESCRIPTION:
+    Converts counts with the same double precision math as
+    Honeywell6130Sensor::Decode().  For the 14 bit parts the results
+    are bit identical to it.
+
+HOW TO USE:
+    Pass as the second template argument of HumidIconSensor
+
+======================================================================*/
+template< class Variant >
+struct ArithmeticConversion
+{
+    static constexpr double HUMIDITY_MAX    = ( double ) ( 1u << Variant::HUMIDITY_BITS ) - 1;
+    static constexpr double TEMPERATURE_MAX = ( double ) ( 1u << Variant::TEMPERATURE_BITS ) - 1;
+
+    static constexpr float RelativeHumidity( unsigned int count )
+    {
+        return ( float ) ( count / HUMIDITY_MAX * Variant::HUMIDITY_SPAN );
+    }
+
+    static constexpr float Celcius( unsigned int count )
+    {
+        return ( float ) ( count * ( Variant::TEMPERATURE_SPAN / TEMPERATURE_MAX ) ) -
+               ( float ) Variant::TEMPERATURE_OFFSET;
+    }
+
+    static constexpr float Fahrenheit( unsigned int count )
+    {
+        return ( float ) ( Celcius( count ) * 1.8 + 32 );
+    }
+};
+
+/*======================================================================
+CLASS:
+    TableConversion
+
+DESCRIPTION:
+    Converts counts with one table lookup.  The tables are built
+    at compile time from ArithmeticConversion, so they hold exactly
+    the same values and no floating point math happens at runtime.
+
+HOW TO USE:
+    Pass as the second template argument of HumidIconSensor, or
+    build with HONEYWELL_USE_LOOKUP_TABLES to make it the default
+
+======================================================================*/
+template< class Variant >
+struct TableConversion
+{
+    static constexpr unsigned int HUMIDITY_ENTRIES    = 1u << Variant::HUMIDITY_BITS;
+    static constexpr unsigned int TEMPERATURE_ENTRIES = 1u << Variant::TEMPERATURE_BITS;
+
+    typedef std::array< float, HUMIDITY_ENTRIES >    HumidityTable;
+    typedef std::array< float, TEMPERATURE_ENTRIES > TemperatureTable;
+
+    static constexpr HumidityTable makeHumidity()
+    {
+        HumidityTable table = {};
+
+        for ( unsigned int count = 0; count < HUMIDITY_ENTRIES; ++count )
+        {
+            table[ count ] = ArithmeticConversion< Variant >::RelativeHumidity( count );
+        }
+
+        return table;
+    }
+
+    static constexpr TemperatureTable makeCelcius()
+    {
+        TemperatureTable table = {};
+
+        for ( unsigned int count = 0; count < TEMPERATURE_ENTRIES; ++count )
+        {
+            table[ count ] = ArithmeticConversion< Variant >::Celcius( count );
+        }
+
+        return table;
+    }
+
+    static constexpr TemperatureTable makeFahrenheit()
+    {
+        TemperatureTable table = {};
+
+        for ( unsigned int count = 0; count < TEMPERATURE_ENTRIES; ++count )
+        {
+            table[ count ] = ArithmeticConversion< Variant >::Fahrenheit( count );
+        }
+
+        return table;
+    }
+
+    static constexpr HumidityTable    HUMIDITY   = makeHumidity();
+    static constexpr TemperatureTable CELCIUS    = makeCelcius();
+    static constexpr TemperatureTable FAHRENHEIT = makeFahrenheit();
+
+    static float RelativeHumidity( unsigned int count ) { return HUMIDITY[ count ]; }
+
+    static float Celcius( unsigned int count ) { return CELCIUS[ count ]; }
+
+    static float Fahrenheit( unsigned int count ) { return FAHRENHEIT[ count ]; }
+};
+
+/*======================================================================
+CLASS:
+    HumidIconSensor
+
+DESCRIPTION:
+    A Honeywell6130Sensor whose decode path is fixed at compile
+    time by the variant and the conversion policy.  The I/O is the
+    same as the base class, retries and reopens included; only the
+    decode changes.  Read(), TryRead() and TryFetch() hide the base
+    class's methods rather than override them (nothing here is
+    virtual), so a call through a Honeywell6130Sensor reference or
+    pointer gets the base class's HIH6130 decode.
+
+HOW TO USE:
+    1. Pick a variant (and a policy if you want something other
+       than the default), e.g.
+           HumidIconSensor< Hih8000, TableConversion > sensor( "/dev/i2c-1" );
+    2. Use it like a Honeywell6130Sensor, through its own type
+
+======================================================================*/
+template< class Variant, template< class > class Conversion = HONEYWELL_DEFAULT_CONVERSION >
+class HumidIconSensor : public Honeywell6130Sensor
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef Conversion< Variant > Converter;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    HumidIconSensor( const char* i2cDevice, int i2cAddress = 0x27 )
+    : Honeywell6130Sensor( i2cDevice, i2cAddress ) { }
+
+    HumidIconSensor( I2cTransport* transport, int i2cAddress = 0x27 )
+    : Honeywell6130Sensor( transport, i2cAddress ) { }
+
+#if defined( __cpp_exceptions )
+    // Throws a SensorException if TryRead() fails
+    TempHumidityData Read() const;
+#endif
+
+    // Same retries as Honeywell6130Sensor::TryRead(), this
+    // variant's decode
+    ReadError TryRead( TempHumidityData& data ) const;
+
+#if defined( __cpp_exceptions )
+    bool TryFetch( TempHumidityData& data ) const;
+#endif
+
+    // TryFetch() without exceptions, like the base class's
+    ReadError TryFetchResult( TempHumidityData& data ) const;
+
+    static void Decode( const unsigned char frame[ FRAME_SIZE ], TempHumidityData& data );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // None.
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    HumidIconSensor::Decode()
+
+DESCRIPTION:
+    Same bit layout as Honeywell6130Sensor::Decode(): status in the
+    top two bits, then humidity, then temperature left justified in
+    the last two bytes.  Parts with fewer bits drop the low ones.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Variant, template< class > class Conversion >
+inline void HumidIconSensor< Variant, Conversion >::Decode( const unsigned char frame[ FRAME_SIZE ],
+                                                            TempHumidityData& data )
+{
+    unsigned int humidity    = ( ( unsigned int ) ( frame[ 0 ] & 0x3f ) << 8 ) | frame[ 1 ];
+    unsigned int temperature = ( ( unsigned int ) frame[ 2 ] << 8 ) | frame[ 3 ];
+
+    data.status = ( frame[ 0 ] >> 6 ) & 0x03;
+
+    humidity    >>= ( 14 - Variant::HUMIDITY_BITS );
+    temperature >>= ( 16 - Variant::TEMPERATURE_BITS );
+
+    data.relativeHumidity = Converter::RelativeHumidity( humidity );
+    data.tempCelcius      = Converter::Celcius( temperature );
+    data.tempFahrenheit   = Converter::Fahrenheit( temperature );
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION:
+    HumidIconSensor::Read()
+
+DESCRIPTION:
+    TryRead() with the errors turned into exceptions.  Like
+    Honeywell6130Sensor::Read() it hands back stale data with the
+    status saying so rather than throwing.
+
+RETURN VALUE:
+    TempHumidityData
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Variant, template< class > class Conversion >
+inline TempHumidityData HumidIconSensor< Variant, Conversion >::Read() const
+{
+    TempHumidityData data;
+
+    ReadError error = TryRead( data );
+
+    if ( READ_OK != error && READ_STALE != error )
+    {
+        throw SensorException( ErrorMessage( error ) );
+    }
+
+    return data;
+}
+
+#endif
+
+/*======================================================================
+FUNCTION:
+    HumidIconSensor::TryRead()
+
+DESCRIPTION:
+    The base class's trigger, settle, fetch and retry loop, then
+    this variant's decode
+
+RETURN VALUE:
+    ReadError - READ_OK, or the last error if every try failed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Variant, template< class > class Conversion >
+inline Honeywell6130Sensor::ReadError HumidIconSensor< Variant, Conversion >::TryRead( TempHumidityData& data ) const
+{
+    unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+    ReadError result = readRetrying( frame );
+
+    if ( READ_OK == result || READ_STALE == result )
+    {
+        Decode( frame, data );
+    }
+
+    return result;
+}
+
+#if defined( __cpp_exceptions )
+
+/*======================================================================
+FUNCTION:
+    HumidIconSensor::TryFetch()
+
+DESCRIPTION:
+    Same as Honeywell6130Sensor::TryFetch() with this variant's
+    decode
+
+RETURN VALUE:
+    bool - true if data was filled in with a new measurement
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Variant, template< class > class Conversion >
+inline bool HumidIconSensor< Variant, Conversion >::TryFetch( TempHumidityData& data ) const
+{
+    unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+    fetchFrame( frame );
+
+    if ( STATUS_STALE == ( ( frame[ 0 ] >> 6 ) & 0x03 ) )
+    {
+        return false;
+    }
+
+    Decode( frame, data );
+
+    return true;
+}
+
+#endif
+
+/*======================================================================
+FUNCTION:
+    HumidIconSensor::TryFetchResult()
+
+DESCRIPTION:
+    Same as Honeywell6130Sensor::TryFetchResult() with this
+    variant's decode.  data is filled in even when the result is
+    stale.
+
+RETURN VALUE:
+    ReadError - READ_OK, READ_STALE or READ_FETCH_FAILED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Variant, template< class > class Conversion >
+inline Honeywell6130Sensor::ReadError HumidIconSensor< Variant, Conversion >::TryFetchResult( TempHumidityData& data ) const
+{
+    unsigned char frame[ FRAME_SIZE ] = { 0 };
+
+    ReadError error = readFrame( frame );
+
+    if ( READ_OK != error )
+    {
+        return error;
+    }
+
+    Decode( frame, data );
+
+    return ( STATUS_STALE == data.status ) ? READ_STALE : READ_OK;
+}
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Fahrenheit comes straight from the temperature count in both policies
+(Celcius( count ) * 1.8 + 32 in double, rounded once to float), which
+is exactly what Honeywell6130Sensor::Decode() does with the Celcius it
+just computed.  That is what lets TableConversion keep a third table
+instead of doing the multiply per sample.
+
+The tables live in the class template, so every variant you actually
+instantiate with TableConversion carries its own three 64K tables.
+Variants that are never used with it cost nothing.
+
+======================================================================*/
+
+#endif	// #ifendif _HUMIDICONSENSOR_H_
@@ -0,0 +1,306 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    i2ctransport.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    The i2c-dev transport
+
+GENERAL DESCRIPTION:
+    This file has the methods that move bytes over a real i2c
+    bus through the Linux i2c-dev driver
+
+PUBLIC CLASSES AND FUNCTIONS:
+    I2cDevTransport
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    The i2c-dev kernel module has to be loaded
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "i2ctransport.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    I2cDevTransport()
+
+DESCRIPTION:
+    This c-tor only remembers the device.  Nothing is opened
+    until Open() is called.  In the Embedded build a path that
+    does not fit in DEVICE_BYTES is not kept at all, so Open()
+    fails rather than opening whatever the cut-down path names.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+I2cDevTransport::I2cDevTransport( const char* i2cDevice )
+: _fileDescriptor( -1 )
+{
+#if defined( HONEYWELL_EMBEDDED )
+    _deviceTooLong = DEVICE_BYTES <= strlen( i2cDevice );
+
+    if ( _deviceTooLong )
+    {
+        _device[ 0 ] = 0;
+    }
+    else
+    {
+        strcpy( _device, i2cDevice );
+    }
+#else
+    _device = i2cDevice;
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    ~I2cDevTransport()
+
+DESCRIPTION:
+    This destructor will attempt to close any open
+    file descriptors
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+I2cDevTransport::~I2cDevTransport()
+{
+    Close();
+}
+
+/*======================================================================
+FUNCTION:
+    Open()
+
+DESCRIPTION:
+    This method opens the i2c bus if it is not open already
+
+RETURN VALUE:
+    bool - true if the bus is open
+
+SIDE EFFECTS:
+    errno is ENAMETOOLONG if the c-tor was given a path too long
+    to keep
+
+======================================================================*/
+bool I2cDevTransport::Open()
+{
+    if ( 0 <= _fileDescriptor )
+    {
+        return true;
+    }
+
+#if defined( HONEYWELL_EMBEDDED )
+    if ( _deviceTooLong )
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+#endif
+
+    ++_syscallCount;
+
+#if defined( HONEYWELL_EMBEDDED )
+    _fileDescriptor = open( _device, O_RDWR );
+#else
+    _fileDescriptor = open( _device.c_str(), O_RDWR );
+#endif
+
+    return 0 <= _fileDescriptor;
+}
+
+/*======================================================================
+FUNCTION:
+    Close()
+
+DESCRIPTION:
+    This method closes the i2c bus
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void I2cDevTransport::Close()
+{
+    if ( 0 <= _fileDescriptor )
+    {
+        close( _fileDescriptor );
+        _fileDescriptor = -1;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SetAddress(), Write(), Read(), Transfer()
+
+DESCRIPTION:
+    Thin wrappers around the i2c-dev system calls
+
+RETURN VALUE:
+    Whatever the system call returned
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool I2cDevTransport::SetAddress( int i2cAddress )
+{
+    ++_syscallCount;
+
+    return 0 <= ioctl( _fileDescriptor, I2C_SLAVE, i2cAddress );
+}
+
+int I2cDevTransport::Write( const unsigned char* data, int length )
+{
+    ++_syscallCount;
+
+    return ( int ) write( _fileDescriptor, data, length );
+}
+
+int I2cDevTransport::Read( unsigned char* data, int length )
+{
+    ++_syscallCount;
+
+    return ( int ) read( _fileDescriptor, data, length );
+}
+
+int I2cDevTransport::Transfer( struct i2c_msg* messages, int count )
+{
+    struct i2c_rdwr_ioctl_data batch;
+
+    batch.msgs  = messages;
+    batch.nmsgs = ( __u32 ) count;
+
+    ++_syscallCount;
+
+    return ioctl( _fileDescriptor, I2C_RDWR, &batch );
+}
+
+/*======================================================================
+FUNCTION:
+    FileDescriptor()
+
+DESCRIPTION:
+    Simple accessor for anyone that needs to hand the
+    descriptor to something else (poll, io_uring, ...)
+
+RETURN VALUE:
+    int - the file descriptor, or -1 if not open
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int I2cDevTransport::FileDescriptor() const
+{
+    return _fileDescriptor;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+    None
+
+=====================================================================*/
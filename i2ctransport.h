@@ -0,0 +1,297 @@
+#ifndef _I2CTRANSPORT_H_
+#define _I2CTRANSPORT_H_
+
+/*======================================================================
+FILE:
+    i2ctransport.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Abstracts the i2c bus I/O used by the sensor classes.
+
+DESCRIPTION:
+    This header defines the transport interface the sensor classes
+    talk through, plus the real backend that goes through the
+    Linux i2c-dev driver.  The calls mirror the system calls the
+    sensor code used to make directly so the sensor logic does
+    not change when the transport does.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    I2cTransport
+    I2cDevTransport
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <linux/i2c.h>
+
+#if !defined( HONEYWELL_EMBEDDED )
+#include <string>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A transport holds one bound address, just like an i2c-dev file
+// descriptor does.  Give every Honeywell6130Sensor its own
+// transport.  Honeywell6130Bus only uses Transfer(), which carries
+// the address in each message, so it can share one.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    I2cTransport
+
+DESCRIPTION:
+    This is the interface for moving bytes to and from devices on
+    an i2c bus.  Failures are reported the way the system calls
+    report them (a negative return value) and it is up to the
+    caller to decide whether that is worth an exception.
+
+HOW TO USE:
+    1. Call Open() (it does nothing if already open)
+    2. Call SetAddress() and then Write()/Read(), or
+    3. Call Transfer() with messages that carry their own address
+
+======================================================================*/
+class I2cTransport
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    I2cTransport() : _syscallCount( 0 ) { }
+
+    virtual ~I2cTransport() { }
+
+    virtual bool Open() = 0;
+
+    virtual void Close() = 0;
+
+    // Same as ioctl( I2C_SLAVE )
+    virtual bool SetAddress( int i2cAddress ) = 0;
+
+    // Same as write()/read() on an i2c-dev file descriptor
+    virtual int Write( const unsigned char* data, int length ) = 0;
+
+    virtual int Read( unsigned char* data, int length ) = 0;
+
+    // Same as ioctl( I2C_RDWR ).  Returns the number of messages
+    // transferred, or -1 if any of them failed.
+    virtual int Transfer( struct i2c_msg* messages, int count ) = 0;
+
+    // Number of calls made into the transport so far.  For the
+    // i2c-dev backend that is the number of system calls.
+    unsigned long long SyscallCount() const { return _syscallCount; }
+
+    // The file descriptor behind the transport, for callers that
+    // drive it some other way (io_uring).  -1 if there is none.
+    virtual int FileDescriptor() const { return -1; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    unsigned long long _syscallCount;
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    I2cTransport( const I2cTransport &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // None.
+
+};
+
+/*======================================================================
+CLASS:
+    I2cDevTransport
+
+DESCRIPTION:
+    The real transport.  It talks to the Linux i2c-dev driver
+    through a file descriptor.
+
+HOW TO USE:
+    1. Construct the object passing the i2c device bus
+    2. Use it through the I2cTransport interface
+
+======================================================================*/
+class I2cDevTransport : public I2cTransport
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    I2cDevTransport( const char* i2cDevice );
+
+    virtual ~I2cDevTransport();
+
+    virtual bool Open();
+
+    virtual void Close();
+
+    virtual bool SetAddress( int i2cAddress );
+
+    virtual int Write( const unsigned char* data, int length );
+
+    virtual int Read( unsigned char* data, int length );
+
+    virtual int Transfer( struct i2c_msg* messages, int count );
+
+    virtual int FileDescriptor() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+#if defined( HONEYWELL_EMBEDDED )
+    // Room for the device path in the Embedded build, which keeps
+    // it in the object rather than on the heap.  A path this long
+    // or longer is refused: Open() always fails for it.
+    static const int DEVICE_BYTES = 64;
+#endif
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+#if defined( HONEYWELL_EMBEDDED )
+    char _device[ DEVICE_BYTES ];
+
+    bool _deviceTooLong;
+#else
+    std::string _device;
+#endif
+
+    int _fileDescriptor;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _I2CTRANSPORT_H_
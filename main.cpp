@@ -1,154 +1,1317 @@
-//======================================================================
-// OBJECT FILE COPYRIGHT NOTICE
-//======================================================================
-
-static const char copyright[] =
-"Copyright (C) 2014 Sean Foley, All rights reserved.";
-
-/*======================================================================
-FILE: 
-    main.cpp
-
-CREATOR:
-    Sean Foley
-    coding at sean[removethis]foleydotcom
-
-SERVICES: 
-    Program entry point
-
-GENERAL DESCRIPTION:
-    This is a harness to drive the honeywell 6130 sensor class
-   
-PUBLIC CLASSES AND FUNCTIONS:	
-    main
-	   
-INITIALIZATION AND SEQUENCING REQUIREMENTS:
-    Any special requirements.
-
-Copyright (C) 2014 Sean Foley  All Rights Reserved.
-
-Redistribution and use in source and binary forms, with or without
-modification, are permitted provided that the following conditions are met:
-
-1. Give back and help someone else out.
-
-THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
-ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
-WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
-DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
-ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
-(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
-ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
-(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
-SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-
-======================================================================*/
-
-//======================================================================
-// INCLUDES AND VARIABLE DEFINITIONS
-//======================================================================
-
-//----------------------------------------------------------------------
-// Defines
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Include Files
-//----------------------------------------------------------------------
-
-#include "honeywell6130sensor.h"
-
-#include <iostream>
-#include <unistd.h>
-
-//----------------------------------------------------------------------
-// Type Declarations
-//----------------------------------------------------------------------
-
-using namespace std;
-
-//----------------------------------------------------------------------
-// Global Constant Definitions
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Global Data Definitions
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Static Variable Definitions 
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Function Prototypes
-//----------------------------------------------------------------------
-
-// None.
-
-//----------------------------------------------------------------------
-// Required Libraries
-//----------------------------------------------------------------------
-
-// None. (Where supported these should be in the form
-// of C++ pragmas).
-
-//======================================================================
-// FUNCTION IMPLEMENTATIONS
-//======================================================================
-
-/*======================================================================
-FUNCTION: 
-    main()	
-
-DESCRIPTION:
-    Program entrypoint
-
-RETURN VALUE:
-    int (not used)
-
-SIDE EFFECTS:
-    none
-
-======================================================================*/
-int main()
-{
-    try
-    {
-        Honeywell6130Sensor sensor( "/dev/i2c-1", 0x27 );
-
-        while( true ) 
-        {
-            TempHumidityData data = sensor.Read();
-
-            cout << "TempC: " << data.tempCelcius << "  ";
-            cout << "TempF: " << data.tempFahrenheit << "  Humidity: " << data.relativeHumidity;
-            cout << endl;
-
-            sleep( 1 );
-        }
-    }
-    catch( SensorException ex )
-    {
-        cout << ex.what() << endl << endl;
-    }
-
-    return 0;
-}
-
-/*=====================================================================
-// IMPLEMENTATION NOTES
-//=====================================================================
-
-    None
-
-=====================================================================*/
-
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE: 
+    main.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES: 
+    Program entry point
+
+GENERAL DESCRIPTION:
+    This is a harness to drive the honeywell 6130 sensor class
+   
+PUBLIC CLASSES AND FUNCTIONS:	
+    main
+	   
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Any special requirements.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "sensorfleet.h"
+#include "samplequeue.h"
+#include "pollscheduler.h"
+#include "sensorstats.h"
+#include "simulatedi2c.h"
+#include "sharedpublisher.h"
+#include "queryserver.h"
+#include "samplelog.h"
+#include "samplesink.h"
+#include "windowaggregator.h"
+#include "deadbandfilter.h"
+#include "sensordiscovery.h"
+#include "samplereplay.h"
+#include "samplecollector.h"
+
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <signal.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+using namespace std;
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions 
+//----------------------------------------------------------------------
+
+// Room for a few seconds of samples from a big fleet
+static const size_t QUEUE_CAPACITY = 4096;
+
+// How often the single sensor is read, and how often the
+// scheduler's timing and the read path stats are reported
+static const unsigned int SAMPLE_PERIOD_MICROSECONDS = 1000000;
+static const unsigned int REPORT_PERIOD_MICROSECONDS = 60000000;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static bool parseSensorAddress( const char* text, SensorAddress& sensor );
+
+static int runFleet( int argc, char* argv[] );
+
+static void printSamples( SampleQueue< FleetSample >* queue, SampleSink* sink, WindowAggregator* rollups,
+                          DeadbandFilter* deadband, SampleSink* recorder, SampleSink* sender );
+
+static void printWindow( FILE* output, const WindowSummary& window );
+
+static void printJitter( const PollScheduler& scheduler, size_t job );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION: 
+    main()	
+
+DESCRIPTION:
+    Program entrypoint.  With no arguments we read the one sensor
+    at /dev/i2c-1, 0x27.  Otherwise every argument is a sensor in
+    the form device:address (for example /dev/i2c-2:0x28) and we
+    poll all of them with a SensorFleet.  Options go in front of
+    the sensors:
+        --batched   share one file descriptor per bus (I2C_RDWR).
+                    Still a system call per message; this alone
+                    only saves the per-sensor I2C_SLAVE ioctls.
+        --combined[=device,device...]
+                    with --batched (implied), send each round on
+                    these buses (all of them without a list) as
+                    combined I2C_RDWR transfers, a call per bus.
+                    Only for buses whose sensors are known to
+                    take a repeated START (honeywell6130bus.h).
+        --uring     drive every bus from one thread through an
+                    io_uring (falls back to blocking reads)
+        --simulate  use simulated sensors instead of i2c-dev
+        --discover  find the sensors on every /dev/i2c-* instead
+                    of listing them (with --simulate, on the
+                    simulated buses listed)
+        --overflow=oldest|newest|block
+                    what to do when printing falls behind
+        --publish[=/name]
+                    run as the daemon that owns the sensors and
+                    publish every reading to shared memory for
+                    SharedReadingsReader (sharedreadings.h)
+        --serve=/path/to/socket
+        --serve-tcp=[address:]port
+                    answer LATEST, RANGE and METRICS requests (and
+                    Prometheus scrapes) on a Unix socket and/or TCP
+        --serve-shards=n
+                    number of server threads
+        --log=/path/to/directory
+                    keep every reading in a binary SampleLog, one
+                    subdirectory per sensor
+        --format=text|csv|json|binary
+                    how readings are written to stdout; with
+                    anything but text the reports go to stderr
+        --flush=record|interval|full
+                    when output is written (SinkWriter), by default
+                    every record on a terminal and every interval
+                    or burst otherwise
+        --rollup=seconds
+                    also report count, mean, standard deviation,
+                    extremes and percentiles per sensor for every
+                    window of this many seconds
+        --deadband[=celcius,humidity[,fraction]]
+                    only write a reading once it has moved more
+                    than this from the last one written (0.1C and
+                    0.5%RH by default), or by more than this
+                    fraction of its value
+        --heartbeat=seconds
+                    with --deadband, write a reading at least this
+                    often anyway (300 by default, 0 for never)
+        --record=/path/to/capture
+                    also keep every reading's raw frame in a
+                    binary capture, deadband or not
+        --replay=/path/to/capture
+                    play a capture back through everything above
+                    instead of reading sensors
+        --pace=fast|recorded|speed
+                    with --replay, as fast as possible (the
+                    default), on the recorded time line, or that
+                    many times faster than it
+        --send=/path/to/socket
+        --send-tcp=address:port
+                    also stream every reading to a collector
+        --collect=/path/to/socket
+        --collect-tcp=[address:]port
+                    merge the readings other ws processes send, in
+                    time order, and use them instead of sensors
+        --reorder=milliseconds
+                    with --collect, how long a reading waits for
+                    older ones still on their way (2000)
+        --collect-sensors=n
+                    with --collect, how many sensors the producers
+                    have between them at most (64).  The log,
+                    shared memory and query server are sized for
+                    all of them up front, so give it for a larger
+                    fleet; readings past it are counted as bad.
+    Either way the readings are printed on their own thread so a
+    slow terminal never delays the next measurement.
+
+RETURN VALUE:
+    int (not used)
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int main( int argc, char* argv[] )
+{
+    if ( 1 < argc )
+    {
+        return runFleet( argc, argv );
+    }
+
+    SampleQueue< FleetSample > queue( QUEUE_CAPACITY );
+
+    SinkWriter writer( STDOUT_FILENO, isatty( STDOUT_FILENO ) ? SinkWriter::FLUSH_EVERY_RECORD : SinkWriter::FLUSH_INTERVAL );
+
+    TextSink sink( writer );
+
+    std::thread printer( printSamples, &queue, &sink, ( WindowAggregator* ) 0, ( DeadbandFilter* ) 0, ( SampleSink* ) 0, ( SampleSink* ) 0 );
+
+    try
+    {
+        Honeywell6130Sensor sensor( "/dev/i2c-1", 0x27 );
+
+        // The scheduler reads on a fixed one second grid, so the
+        // read time does not push every later sample back
+        PollScheduler scheduler;
+
+        // A failed read is reported and skipped; the sensor
+        // already retried and reopened the bus on its own
+        size_t readJob = scheduler.AddJob( SAMPLE_PERIOD_MICROSECONDS, 0, [ &sensor, &queue ]()
+        {
+            FleetSample sample;
+
+            sample.sensorIndex      = 0;
+            sample.timeMicroseconds = SensorFleet::WallClockMicroseconds();
+
+            Honeywell6130Sensor::ReadError error = sensor.TryRead( sample.data );
+
+            if ( Honeywell6130Sensor::READ_OK != error )
+            {
+                char line[ 128 ];
+
+                snprintf( line, sizeof( line ), "Read failed: %s\n", Honeywell6130Sensor::ErrorMessage( error ) );
+
+                cout << line << flush;
+                return;
+            }
+
+            queue.Push( sample );
+        } );
+
+        scheduler.AddJob( REPORT_PERIOD_MICROSECONDS, REPORT_PERIOD_MICROSECONDS, [ &scheduler, readJob, &sensor ]()
+        {
+            printJitter( scheduler, readJob );
+
+            SensorStatsSnapshot stats;
+
+            if ( sensor.Stats( stats ) )
+            {
+                stats.Dump( stdout );
+                fflush( stdout );
+            }
+        } );
+
+        scheduler.Run();
+    }
+    catch( SensorException& ex )
+    {
+        cout << ex.what() << endl << endl;
+    }
+
+    queue.Close();
+
+    printer.join();
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION: 
+    runFleet()	
+
+DESCRIPTION:
+    Polls every sensor named on the command line once a second
+    and prints the readings along with the aggregate rate
+
+RETURN VALUE:
+    int (not used)
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int runFleet( int argc, char* argv[] )
+{
+    std::vector< SensorAddress > sensors;
+
+    SensorFleet::Mode mode = SensorFleet::MODE_PER_SENSOR;
+
+    SampleQueue< FleetSample >::OverflowPolicy overflow = SampleQueue< FleetSample >::DROP_OLDEST;
+
+    bool simulate = false;
+
+    bool discover = false;
+
+    const char* publishName = 0;
+
+    QueryServerOptions serveOptions;
+
+    bool serve = false;
+
+    const char* logDirectory = 0;
+
+    const char* format = "text";
+
+    long long rollupSeconds = 0;
+
+    bool deadband = false;
+
+    DeadbandOptions deadbandOptions;
+
+    const char* recordPath = 0;
+
+    const char* replayPath = 0;
+
+    SampleReplay::Pace pace = SampleReplay::PACE_FAST;
+
+    double speed = 1.0;
+
+    CollectorOptions collectOptions;
+
+    bool collect = false;
+
+    const char* sendPath = 0;
+
+    std::string sendAddress;
+
+    int sendPort = -1;
+
+    bool overflowGiven = false;
+
+    bool combined = false;
+
+    std::vector< std::string > combinedBuses;
+
+    SinkWriter::FlushPolicy flushPolicy = isatty( STDOUT_FILENO ) ? SinkWriter::FLUSH_EVERY_RECORD : SinkWriter::FLUSH_INTERVAL;
+
+    int first = 1;
+
+    for ( ; first < argc && 0 == strncmp( argv[ first ], "--", 2 ); ++first )
+    {
+        if ( 0 == strcmp( argv[ first ], "--batched" ) )
+        {
+            mode = SensorFleet::MODE_BATCHED;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--combined" ) )
+        {
+            mode     = SensorFleet::MODE_BATCHED;
+            combined = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--combined=", 11 ) )
+        {
+            std::string list = argv[ first ] + 11;
+
+            for ( size_t start = 0; start <= list.size(); )
+            {
+                size_t comma = list.find( ',', start );
+
+                if ( std::string::npos == comma )
+                {
+                    comma = list.size();
+                }
+
+                if ( start < comma )
+                {
+                    combinedBuses.push_back( list.substr( start, comma - start ) );
+                }
+
+                start = comma + 1;
+            }
+
+            mode     = SensorFleet::MODE_BATCHED;
+            combined = true;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--uring" ) )
+        {
+            mode = SensorFleet::MODE_URING;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--simulate" ) )
+        {
+            simulate = true;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--discover" ) )
+        {
+            discover = true;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--publish" ) )
+        {
+            publishName = SHARED_DEFAULT_SEGMENT;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--publish=", 10 ) )
+        {
+            publishName = argv[ first ] + 10;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--serve=", 8 ) )
+        {
+            serveOptions.unixPath = argv[ first ] + 8;
+            serve = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--serve-tcp=", 12 ) )
+        {
+            const char* port  = argv[ first ] + 12;
+            const char* colon = strrchr( port, ':' );
+
+            if ( 0 != colon )
+            {
+                serveOptions.tcpAddress.assign( port, colon );
+                port = colon + 1;
+            }
+
+            serveOptions.tcpPort = atoi( port );
+            serve = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--serve-shards=", 15 ) )
+        {
+            serveOptions.shards = ( size_t ) atoi( argv[ first ] + 15 );
+        }
+        else if ( 0 == strncmp( argv[ first ], "--log=", 6 ) )
+        {
+            logDirectory = argv[ first ] + 6;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--format=", 9 ) )
+        {
+            format = argv[ first ] + 9;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--rollup=", 9 ) )
+        {
+            rollupSeconds = atoll( argv[ first ] + 9 );
+        }
+        else if ( 0 == strcmp( argv[ first ], "--deadband" ) )
+        {
+            deadband = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--deadband=", 11 ) )
+        {
+            if ( 2 > sscanf( argv[ first ] + 11, "%lf,%lf,%lf", &deadbandOptions.temperatureCelcius,
+                             &deadbandOptions.relativeHumidity, &deadbandOptions.relativeFraction ) )
+            {
+                cout << "Expected --deadband=celcius,humidity[,fraction] but got " << argv[ first ] << endl;
+                return 1;
+            }
+
+            deadband = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--heartbeat=", 12 ) )
+        {
+            deadbandOptions.heartbeatMicroseconds = atoll( argv[ first ] + 12 ) * 1000000;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--record=", 9 ) )
+        {
+            recordPath = argv[ first ] + 9;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--replay=", 9 ) )
+        {
+            replayPath = argv[ first ] + 9;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--pace=fast" ) )
+        {
+            pace = SampleReplay::PACE_FAST;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--pace=recorded" ) )
+        {
+            pace = SampleReplay::PACE_RECORDED;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--pace=", 7 ) && 0 < atof( argv[ first ] + 7 ) )
+        {
+            pace  = SampleReplay::PACE_RECORDED;
+            speed = atof( argv[ first ] + 7 );
+        }
+        else if ( 0 == strncmp( argv[ first ], "--send=", 7 ) )
+        {
+            sendPath = argv[ first ] + 7;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--send-tcp=", 11 ) )
+        {
+            const char* address = argv[ first ] + 11;
+            const char* colon   = strrchr( address, ':' );
+
+            if ( 0 == colon )
+            {
+                cout << "Expected --send-tcp=address:port but got " << argv[ first ] << endl;
+                return 1;
+            }
+
+            sendAddress.assign( address, colon );
+            sendPort = atoi( colon + 1 );
+        }
+        else if ( 0 == strncmp( argv[ first ], "--collect=", 10 ) )
+        {
+            collectOptions.unixPath = argv[ first ] + 10;
+            collect = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--collect-tcp=", 14 ) )
+        {
+            const char* port  = argv[ first ] + 14;
+            const char* colon = strrchr( port, ':' );
+
+            if ( 0 != colon )
+            {
+                collectOptions.tcpAddress.assign( port, colon );
+                port = colon + 1;
+            }
+
+            collectOptions.tcpPort = atoi( port );
+            collect = true;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--reorder=", 10 ) )
+        {
+            collectOptions.reorderMicroseconds = atoll( argv[ first ] + 10 ) * 1000;
+        }
+        else if ( 0 == strncmp( argv[ first ], "--collect-sensors=", 18 ) )
+        {
+            int count = atoi( argv[ first ] + 18 );
+
+            if ( count <= 0 )
+            {
+                cout << "Expected --collect-sensors=n with n at least 1 but got " << argv[ first ] << endl;
+                return 1;
+            }
+
+            collectOptions.maxSensors = ( size_t ) count;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--flush=record" ) )
+        {
+            flushPolicy = SinkWriter::FLUSH_EVERY_RECORD;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--flush=interval" ) )
+        {
+            flushPolicy = SinkWriter::FLUSH_INTERVAL;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--flush=full" ) )
+        {
+            flushPolicy = SinkWriter::FLUSH_WHEN_FULL;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--overflow=oldest" ) )
+        {
+            overflow = SampleQueue< FleetSample >::DROP_OLDEST;
+            overflowGiven = true;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--overflow=newest" ) )
+        {
+            overflow = SampleQueue< FleetSample >::DROP_NEWEST;
+            overflowGiven = true;
+        }
+        else if ( 0 == strcmp( argv[ first ], "--overflow=block" ) )
+        {
+            overflow = SampleQueue< FleetSample >::BLOCK;
+            overflowGiven = true;
+        }
+        else
+        {
+            cout << "Unknown option " << argv[ first ] << endl;
+            return 1;
+        }
+    }
+
+    for ( int i = first; i < argc; ++i )
+    {
+        SensorAddress sensor;
+
+        if ( !parseSensorAddress( argv[ i ], sensor ) )
+        {
+            cout << "Expected device:address but got " << argv[ i ] << endl;
+            return 1;
+        }
+
+        sensors.push_back( sensor );
+    }
+
+    if ( sensors.empty() )
+    {
+        SensorAddress sensor = { "/dev/i2c-1", 0x27 };
+
+        sensors.push_back( sensor );
+    }
+
+    // One simulated bus per device name, with a simulated
+    // sensor at every address we were asked for
+    std::map< std::string, SimulatedI2cBus* > simulatedBuses;
+
+    SensorFleet::TransportFactory transportFactory;
+
+    if ( simulate )
+    {
+        for ( size_t s = 0; s < sensors.size(); ++s )
+        {
+            SimulatedI2cBus*& bus = simulatedBuses[ sensors[ s ].device ];
+
+            if ( 0 == bus )
+            {
+                bus = new SimulatedI2cBus;
+            }
+
+            // Give every sensor its own noise
+            SimulatedHih6130::Config config;
+
+            config.seed = ( unsigned int ) s + 1;
+
+            bus->AddDevice( sensors[ s ].address, config );
+        }
+
+        transportFactory = [ &simulatedBuses ]( const std::string& device ) -> I2cTransport*
+        {
+            return new SimulatedTransport( *simulatedBuses[ device ] );
+        };
+    }
+
+    SinkWriter writer( STDOUT_FILENO, flushPolicy );
+
+    SampleSink* sink = SampleSink::Create( format, writer );
+
+    if ( 0 == sink )
+    {
+        cout << "Unknown format " << format << endl;
+        return 1;
+    }
+
+    // Keep stdout for the readings unless they are the text the
+    // reports are written in anyway
+    FILE* reports = ( 0 == strcmp( format, "text" ) ) ? stdout : stderr;
+
+    // Probed before anything is sized by the sensor count
+    if ( discover )
+    {
+        std::vector< std::string > buses;
+
+        for ( std::map< std::string, SimulatedI2cBus* >::iterator b = simulatedBuses.begin();
+              b != simulatedBuses.end(); ++b )
+        {
+            buses.push_back( b->first );
+        }
+
+        if ( !simulate )
+        {
+            buses = SensorDiscovery::ListBuses();
+        }
+
+        SensorDiscovery discovery( DiscoveryOptions(), transportFactory );
+
+        sensors = discovery.Discover( buses );
+
+        for ( size_t s = 0; s < discovery.Sensors().size(); ++s )
+        {
+            const DiscoveredSensor& found = discovery.Sensors()[ s ];
+
+            fprintf( reports, "Found sensor %u at %s:0x%02x  TempC: %.2f  Humidity: %.2f\n",
+                     ( unsigned int ) s, found.sensor.device.c_str(), found.sensor.address,
+                     found.data.tempCelcius, found.data.relativeHumidity );
+        }
+
+        fprintf( reports, "Discovered %u sensors on %u buses in %.1fms\n",
+                 ( unsigned int ) sensors.size(), ( unsigned int ) buses.size(),
+                 discovery.ElapsedMicroseconds() / 1000.0 );
+        fflush( reports );
+
+        if ( sensors.empty() )
+        {
+            return 1;
+        }
+    }
+
+    // A replay stands in for the sensors, so only their number
+    // matters
+    SampleReplay* replay = 0;
+
+    if ( 0 != replayPath )
+    {
+        try
+        {
+            replay = new SampleReplay( replayPath );
+        }
+        catch( SensorException& ex )
+        {
+            fprintf( reports, "%s\n", ex.what() );
+            return 1;
+        }
+
+        SensorAddress sensor = { replayPath, 0 };
+
+        sensors.assign( replay->SensorCount(), sensor );
+
+        // Nothing is lost by waiting on the printer when there are
+        // no sensors to fall behind
+        if ( !overflowGiven )
+        {
+            overflow = SampleQueue< FleetSample >::BLOCK;
+        }
+    }
+
+    // So does a collector, sized for every sensor it may be sent
+    // (--collect-sensors, kept small by default since everything
+    // below is sized from it).
+    // Blocking on the printer holds the producers back through
+    // their sockets rather than dropping their readings here.
+    SampleCollector* collector = 0;
+
+    if ( collect )
+    {
+        if ( 0 != replay )
+        {
+            fprintf( reports, "--collect and --replay can not be used together\n" );
+            delete replay;
+            return 1;
+        }
+
+        try
+        {
+            collector = new SampleCollector( collectOptions );
+        }
+        catch( SensorException& ex )
+        {
+            fprintf( reports, "%s\n", ex.what() );
+            return 1;
+        }
+
+        SensorAddress sensor = { "collector", 0 };
+
+        sensors.assign( collectOptions.maxSensors, sensor );
+
+        if ( !overflowGiven )
+        {
+            overflow = SampleQueue< FleetSample >::BLOCK;
+        }
+    }
+
+    // Sent from the printer thread like the capture.  A collector
+    // that goes away fails the writes rather than killing us.
+    int sendSocket = -1;
+
+    if ( 0 != sendPath || 0 <= sendPort )
+    {
+        try
+        {
+            sendSocket = ( 0 != sendPath ) ? ConnectUnixCollector( sendPath ) : ConnectTcpCollector( sendAddress, sendPort );
+        }
+        catch( SensorException& ex )
+        {
+            fprintf( reports, "%s\n", ex.what() );
+            delete collector;
+            delete replay;
+            return 1;
+        }
+
+        signal( SIGPIPE, SIG_IGN );
+    }
+
+    SinkWriter* sendWriter = ( 0 <= sendSocket ) ? new SinkWriter( sendSocket, SinkWriter::FLUSH_INTERVAL ) : 0;
+
+    SampleSink* sender = ( 0 != sendWriter ) ? new BinarySink( *sendWriter ) : 0;
+
+    // The capture is written on the printer thread, through its own
+    // writer so stdout's flush policy does not apply to it
+    int recordFile = -1;
+
+    SinkWriter* recordWriter = 0;
+
+    SampleSink* recorder = 0;
+
+    if ( 0 != recordPath )
+    {
+        recordFile = open( recordPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+
+        if ( recordFile < 0 )
+        {
+            fprintf( reports, "Failed to create capture %s: %s\n", recordPath, strerror( errno ) );
+            delete sender;
+            delete sendWriter;
+            delete collector;
+            delete replay;
+            return 1;
+        }
+
+        recordWriter = new SinkWriter( recordFile, SinkWriter::FLUSH_INTERVAL );
+
+        recorder = new BinarySink( *recordWriter );
+    }
+
+    // Rolled up on the printer thread, which owns the aggregator
+    WindowAggregator* rollups = 0;
+
+    if ( 0 < rollupSeconds )
+    {
+        rollups = new WindowAggregator( sensors.size(), rollupSeconds * 1000000, [ reports ]( const WindowSummary& window )
+        {
+            printWindow( reports, window );
+        } );
+    }
+
+    // Also the printer thread's, after the rollups so they still
+    // see every reading
+    DeadbandFilter* filter = deadband ? new DeadbandFilter( sensors.size(), deadbandOptions ) : 0;
+
+    SampleQueue< FleetSample > queue( QUEUE_CAPACITY, overflow );
+
+    std::thread printer( printSamples, &queue, sink, rollups, filter, recorder, sender );
+
+    SharedPublisher* publisher = 0;
+
+    QueryServer* server = 0;
+
+    std::vector< SampleLog* > logs;
+
+    try
+    {
+        if ( 0 != publishName )
+        {
+            publisher = new SharedPublisher( publishName, sensors.size() );
+        }
+
+        if ( serve )
+        {
+            server = new QueryServer( sensors.size(), serveOptions );
+            server->Start();
+        }
+
+        if ( 0 != logDirectory )
+        {
+            if ( 0 != mkdir( logDirectory, 0755 ) && EEXIST != errno )
+            {
+                throw SensorException( std::string( "Failed to create log directory " ) + logDirectory );
+            }
+
+            for ( size_t s = 0; s < sensors.size(); ++s )
+            {
+                logs.push_back( new SampleLog( ( std::string( logDirectory ) + "/" + std::to_string( s ) ).c_str() ) );
+            }
+        }
+
+        // The bus threads (or the replay) only publish and queue the
+        // samples, printing happens on the printer thread.  Every
+        // sensor belongs to one bus thread, so each shared slot has a
+        // single writer, and each log a single appender.
+        SensorFleet::SampleHandler handler = [ &queue, publisher, server, &logs ]( const FleetSample& sample )
+        {
+            if ( 0 != publisher )
+            {
+                publisher->Publish( sample.sensorIndex, sample.data );
+            }
+
+            // A few stores into a mapped page.  The fleet stamps with
+            // the wall clock, so the log reads the same across
+            // reboots.  A log that can not grow (a full disk) is given
+            // up rather than stopping the bus thread.
+            if ( !logs.empty() && 0 != logs[ sample.sensorIndex ] )
+            {
+                try
+                {
+                    logs[ sample.sensorIndex ]->Append( sample.data, sample.timeMicroseconds );
+                }
+                catch( SensorException& ex )
+                {
+                    fprintf( stderr, "%s, no longer logging sensor %u\n", ex.what(), ( unsigned int ) sample.sensorIndex );
+
+                    delete logs[ sample.sensorIndex ];
+                    logs[ sample.sensorIndex ] = 0;
+                }
+            }
+
+            // Only queues the reading; the server threads do the rest
+            if ( 0 != server )
+            {
+                server->Offer( sample.sensorIndex, sample.data );
+            }
+
+            queue.Push( sample );
+        };
+
+        if ( 0 != replay )
+        {
+            long long start = SensorStats::Now();
+
+            unsigned long long replayed = replay->Replay( handler, pace, speed );
+
+            double seconds = ( SensorStats::Now() - start ) / 1e9;
+
+            fprintf( reports, "Replayed %llu readings from %u sensors in %.3fs (%.0f/sec)  Skipped: %llu  Dropped: %llu\n",
+                     replayed, ( unsigned int ) sensors.size(), seconds, ( 0 < seconds ) ? replayed / seconds : 0.0,
+                     replay->SkippedCount(), queue.DroppedCount() );
+
+            if ( SampleReplay::PACE_RECORDED == pace )
+            {
+                fprintf( reports, "Worst lateness against the recorded time line: %.3fms\n",
+                         replay->MaxLatenessMicroseconds() / 1000.0 );
+            }
+
+            fflush( reports );
+        }
+        else if ( 0 != collector )
+        {
+            std::thread merger( [ collector, handler, reports ]()
+            {
+                collector->Run( handler, [ reports ]( size_t sensor, const std::string& producer, size_t producerSensor )
+                {
+                    fprintf( reports, "Sensor %u is sensor %u of %s\n",
+                             ( unsigned int ) sensor, ( unsigned int ) producerSensor, producer.c_str() );
+                    fflush( reports );
+                } );
+            } );
+
+            PollScheduler scheduler;
+
+            unsigned long long lastMerged = 0;
+
+            scheduler.AddJob( 1000000, 1000000, [ collector, &queue, &lastMerged, reports ]()
+            {
+                unsigned long long merged = collector->MergedCount();
+
+                fprintf( reports, "Samples/sec: %llu  Producers: %u  Late: %llu  Paused: %llu  Forced: %llu  Bad: %llu  Dropped: %llu\n",
+                         merged - lastMerged, ( unsigned int ) collector->OpenProducerCount(),
+                         collector->LateCount(), collector->PausedCount(), collector->ForcedCount(),
+                         collector->BadRecordCount(), queue.DroppedCount() );
+                fflush( reports );
+
+                lastMerged = merged;
+            } );
+
+            scheduler.Run();
+
+            collector->Stop();
+
+            merger.join();
+        }
+        else
+        {
+            SensorFleet fleet( sensors, 1000000, mode, transportFactory );
+
+            if ( SensorFleet::MODE_URING == mode && SensorFleet::MODE_URING != fleet.GetMode() )
+            {
+                fprintf( reports, "io_uring can not drive these sensors, using blocking reads\n" );
+                fflush( reports );
+            }
+
+            if ( combined && combinedBuses.empty() )
+            {
+                fleet.SetCombined( true );
+            }
+
+            for ( size_t b = 0; b < combinedBuses.size(); ++b )
+            {
+                if ( 0 == fleet.SetCombined( true, combinedBuses[ b ] ) )
+                {
+                    fprintf( reports, "No sensors on %s to combine transfers for\n", combinedBuses[ b ].c_str() );
+                    fflush( reports );
+                }
+            }
+
+            fleet.Start( handler );
+
+            PollScheduler scheduler;
+
+            scheduler.AddJob( 1000000, 1000000, [ &fleet, &queue, filter, reports ]()
+            {
+                if ( 0 != filter )
+                {
+                    fprintf( reports, "Samples/sec: %g  Errors: %llu  Dropped: %llu  Suppressed: %.1f%%\n",
+                             fleet.SamplesPerSecond(), fleet.ErrorCount(), queue.DroppedCount(),
+                             filter->SuppressionRatio() * 100 );
+                }
+                else
+                {
+                    fprintf( reports, "Samples/sec: %g  Errors: %llu  Dropped: %llu\n",
+                             fleet.SamplesPerSecond(), fleet.ErrorCount(), queue.DroppedCount() );
+                }
+
+                fflush( reports );
+            } );
+
+            scheduler.AddJob( REPORT_PERIOD_MICROSECONDS, REPORT_PERIOD_MICROSECONDS, [ &fleet, reports ]()
+            {
+                SensorStatsSnapshot stats;
+
+                if ( fleet.Stats( stats ) )
+                {
+                    stats.Dump( reports );
+                    fflush( reports );
+                }
+            } );
+
+            scheduler.Run();
+        }
+    }
+    catch( SensorException& ex )
+    {
+        fprintf( reports, "%s\n\n", ex.what() );
+    }
+
+    delete server;
+
+    delete publisher;
+
+    for ( size_t s = 0; s < logs.size(); ++s )
+    {
+        delete logs[ s ];
+    }
+
+    queue.Close();
+
+    printer.join();
+
+    delete rollups;
+
+    if ( 0 != filter )
+    {
+        fprintf( reports, "Deadband: %llu of %llu readings written (%llu heartbeats), %.1f%% suppressed\n",
+                 filter->PassedCount(), filter->OfferedCount(), filter->HeartbeatCount(),
+                 filter->SuppressionRatio() * 100 );
+
+        delete filter;
+    }
+
+    delete sink;
+
+    if ( 0 != recorder )
+    {
+        delete recorder;
+        delete recordWriter;
+
+        close( recordFile );
+    }
+
+    if ( 0 != sender )
+    {
+        delete sender;
+        delete sendWriter;
+
+        close( sendSocket );
+    }
+
+    delete collector;
+
+    delete replay;
+
+    for ( std::map< std::string, SimulatedI2cBus* >::iterator b = simulatedBuses.begin();
+          b != simulatedBuses.end(); ++b )
+    {
+        delete b->second;
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION: 
+    printSamples()	
+
+DESCRIPTION:
+    Printer thread.  Drains the queue until it is closed and
+    hands every sample to the rollups, the recorder and the sender
+    if there are any, and to the sink unless the deadband filter
+    suppresses it.
+    Whatever is waiting is written as one batch, and the writers are
+    told when the queue runs dry so their flush policies can decide
+    whether to write now.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void printSamples( SampleQueue< FleetSample >* queue, SampleSink* sink, WindowAggregator* rollups,
+                          DeadbandFilter* deadband, SampleSink* recorder, SampleSink* sender )
+{
+    FleetSample sample;
+
+    // Both get every reading's raw frame, deadband or not
+    SampleSink* raw[ 2 ] = { recorder, sender };
+
+    static const char* rawFailures[ 2 ] = { "Writing the capture failed", "Sending to the collector failed" };
+
+    sink->Begin();
+
+    for ( size_t r = 0; r < 2; ++r )
+    {
+        if ( 0 != raw[ r ] )
+        {
+            raw[ r ]->Begin();
+        }
+    }
+
+    for ( ;; )
+    {
+        if ( !queue->TryPop( sample ) )
+        {
+            sink->Writer().Idle();
+
+            for ( size_t r = 0; r < 2; ++r )
+            {
+                if ( 0 != raw[ r ] )
+                {
+                    raw[ r ]->Writer().Idle();
+                }
+            }
+
+            if ( !queue->Pop( sample ) )
+            {
+                break;
+            }
+        }
+
+        if ( 0 != rollups )
+        {
+            rollups->Add( sample.sensorIndex, sample.timeMicroseconds, sample.data );
+        }
+
+        for ( size_t r = 0; r < 2; ++r )
+        {
+            if ( 0 != raw[ r ] )
+            {
+                raw[ r ]->Write( sample.sensorIndex, sample.timeMicroseconds, sample.data );
+            }
+        }
+
+        if ( 0 != deadband && !deadband->Offer( sample.sensorIndex, sample.timeMicroseconds, sample.data ) )
+        {
+            continue;
+        }
+
+        sink->Write( sample.sensorIndex, sample.timeMicroseconds, sample.data );
+    }
+
+    if ( 0 != rollups )
+    {
+        rollups->FlushTumbling();
+    }
+
+    sink->Writer().Flush();
+
+    if ( 0 != sink->Writer().Error() )
+    {
+        fprintf( stderr, "Writing readings failed: %s, %llu bytes lost\n",
+                 strerror( sink->Writer().Error() ), sink->Writer().LostCount() );
+    }
+
+    for ( size_t r = 0; r < 2; ++r )
+    {
+        if ( 0 == raw[ r ] )
+        {
+            continue;
+        }
+
+        raw[ r ]->Writer().Flush();
+
+        if ( 0 != raw[ r ]->Writer().Error() )
+        {
+            fprintf( stderr, "%s: %s, %llu bytes lost\n", rawFailures[ r ],
+                     strerror( raw[ r ]->Writer().Error() ), raw[ r ]->Writer().LostCount() );
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION: 
+    printWindow()	
+
+DESCRIPTION:
+    Prints a finished rollup window, two lines per sensor
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void printWindow( FILE* output, const WindowSummary& window )
+{
+    const ChannelSummary& temperature = window.temperature;
+    const ChannelSummary& humidity    = window.humidity;
+
+    fprintf( output, "Window: sensor %u  %llu readings  TempC mean %.2f sd %.3f min %.2f p50 %.2f p95 %.2f max %.2f\n",
+             ( unsigned int ) window.sensor,
+             temperature.Readings(),
+             WindowSummary::Celcius( temperature.Mean() ),
+             temperature.StandardDeviation() * WindowSummary::CELCIUS_PER_COUNT,
+             WindowSummary::Celcius( temperature.Min() ),
+             WindowSummary::Celcius( temperature.Quantile( 0.5 ) ),
+             WindowSummary::Celcius( temperature.Quantile( 0.95 ) ),
+             WindowSummary::Celcius( temperature.Max() ) );
+
+    fprintf( output, "        sensor %u  %llu readings  Humidity mean %.2f sd %.3f min %.2f p50 %.2f p95 %.2f max %.2f\n",
+             ( unsigned int ) window.sensor,
+             humidity.Readings(),
+             WindowSummary::RelativeHumidity( humidity.Mean() ),
+             humidity.StandardDeviation() * WindowSummary::HUMIDITY_PER_COUNT,
+             WindowSummary::RelativeHumidity( humidity.Min() ),
+             WindowSummary::RelativeHumidity( humidity.Quantile( 0.5 ) ),
+             WindowSummary::RelativeHumidity( humidity.Quantile( 0.95 ) ),
+             WindowSummary::RelativeHumidity( humidity.Max() ) );
+
+    fflush( output );
+}
+
+/*======================================================================
+FUNCTION: 
+    printJitter()	
+
+DESCRIPTION:
+    Prints how late the scheduler has been waking up for a job
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void printJitter( const PollScheduler& scheduler, size_t job )
+{
+    PollScheduler::JobStats stats = scheduler.Stats( job );
+
+    char line[ 160 ];
+
+    snprintf( line, sizeof( line ), "Reads: %llu  Missed: %llu  Late p50: <%lluus  p99: <%lluus  max: %lldus\n",
+              stats.runs,
+              stats.missed,
+              PollScheduler::JitterPercentileMicroseconds( stats, 0.5 ),
+              PollScheduler::JitterPercentileMicroseconds( stats, 0.99 ),
+              stats.maxLatenessNanoseconds / 1000 );
+
+    cout << line << flush;
+}
+
+/*======================================================================
+FUNCTION: 
+    parseSensorAddress()	
+
+DESCRIPTION:
+    Splits device:address into its parts.  The address can be 
+    written in decimal or hex (0x27).
+
+RETURN VALUE:
+    bool - true if the text made sense
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool parseSensorAddress( const char* text, SensorAddress& sensor )
+{
+    const char* colon = strrchr( text, ':' );
+
+    if ( 0 == colon || colon == text )
+    {
+        return false;
+    }
+
+    char* end = 0;
+
+    long address = strtol( colon + 1, &end, 0 );
+
+    if ( end == colon + 1 || *end != '\0' || address < 0 || address > 0x7f )
+    {
+        return false;
+    }
+
+    sensor.device.assign( text, colon - text );
+    sensor.address = ( int ) address;
+
+    return true;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+    None
+
+=====================================================================*/
+
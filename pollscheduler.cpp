@@ -0,0 +1,503 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    pollscheduler.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to run periodic jobs on absolute deadlines
+
+GENERAL DESCRIPTION:
+    This file implements the scheduler loop, the missed deadline
+    accounting and the jitter histograms
+
+PUBLIC CLASSES AND FUNCTIONS:
+    PollScheduler
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "pollscheduler.h"
+
+#include <cerrno>
+#include <time.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+static const long long NANOSECONDS_PER_SECOND = 1000000000LL;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long nowNanoseconds();
+
+static void sleepUntil( long long deadline );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    PollScheduler()
+
+DESCRIPTION:
+    This c-tor starts out with no jobs, and running, so a Stop()
+    that comes before Run() is not lost
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+PollScheduler::PollScheduler()
+: _running( true )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ~PollScheduler()
+
+DESCRIPTION:
+    This destructor frees the jobs.  Run() must have returned.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+PollScheduler::~PollScheduler()
+{
+    for ( size_t e = 0; e < _entries.size(); ++e )
+    {
+        delete _entries[ e ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    AddJob()
+
+DESCRIPTION:
+    Adds a job that runs every periodMicroseconds, starting
+    phaseMicroseconds after Run() is called
+
+RETURN VALUE:
+    size_t - the job number, for Stats()
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t PollScheduler::AddJob( unsigned int periodMicroseconds, unsigned int phaseMicroseconds, Job job )
+{
+    Entry* entry = new Entry;
+
+    entry->periodNanoseconds = ( long long ) ( periodMicroseconds ? periodMicroseconds : 1 ) * 1000;
+    entry->phaseNanoseconds  = ( long long ) phaseMicroseconds * 1000;
+    entry->deadline          = 0;
+    entry->job               = job;
+
+    entry->runs.store( 0 );
+    entry->missed.store( 0 );
+    entry->maxLateness.store( 0 );
+
+    for ( size_t b = 0; b < JITTER_BUCKETS; ++b )
+    {
+        entry->jitter[ b ].store( 0 );
+    }
+
+    _entries.push_back( entry );
+
+    return _entries.size() - 1;
+}
+
+/*======================================================================
+FUNCTION:
+    JobCount()
+
+DESCRIPTION:
+    Number of jobs added
+
+RETURN VALUE:
+    size_t
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t PollScheduler::JobCount() const
+{
+    return _entries.size();
+}
+
+/*======================================================================
+FUNCTION:
+    Run()
+
+DESCRIPTION:
+    The scheduler loop.  Finds the job with the earliest deadline,
+    sleeps until then, runs it and moves its deadline one period
+    along the grid.  If the job is still behind after that, whole
+    periods are counted as missed and skipped.  Returns at once if
+    Stop() has already been called.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PollScheduler::Run()
+{
+    if ( _entries.empty() || !_running )
+    {
+        return;
+    }
+
+    long long start = nowNanoseconds();
+
+    for ( size_t e = 0; e < _entries.size(); ++e )
+    {
+        _entries[ e ]->deadline = start + _entries[ e ]->phaseNanoseconds;
+    }
+
+    while ( _running )
+    {
+        Entry* next = _entries[ 0 ];
+
+        for ( size_t e = 1; e < _entries.size(); ++e )
+        {
+            if ( _entries[ e ]->deadline < next->deadline )
+            {
+                next = _entries[ e ];
+            }
+        }
+
+        long long now = nowNanoseconds();
+
+        if ( now < next->deadline )
+        {
+            // Sleep in slices so Stop() is noticed in time
+            long long wake = next->deadline;
+
+            if ( wake - now > ( long long ) MAX_SLEEP_MICROSECONDS * 1000 )
+            {
+                sleepUntil( now + ( long long ) MAX_SLEEP_MICROSECONDS * 1000 );
+                continue;
+            }
+
+            sleepUntil( wake );
+
+            now = nowNanoseconds();
+        }
+
+        record( next, now - next->deadline );
+
+        next->job();
+
+        next->deadline += next->periodNanoseconds;
+
+        now = nowNanoseconds();
+
+        if ( next->deadline <= now )
+        {
+            long long behind = ( now - next->deadline ) / next->periodNanoseconds + 1;
+
+            next->missed += ( unsigned long long ) behind;
+            next->deadline += behind * next->periodNanoseconds;
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Stop()
+
+DESCRIPTION:
+    Asks Run() to return.  It does so after the job it is running
+    (or within MAX_SLEEP_MICROSECONDS if it is sleeping).  Called
+    before Run(), it makes Run() return straight away.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PollScheduler::Stop()
+{
+    _running = false;
+}
+
+/*======================================================================
+FUNCTION:
+    Stats()
+
+DESCRIPTION:
+    Copies out the counters for one job
+
+RETURN VALUE:
+    JobStats
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+PollScheduler::JobStats PollScheduler::Stats( size_t job ) const
+{
+    JobStats stats = JobStats();
+
+    if ( job >= _entries.size() )
+    {
+        return stats;
+    }
+
+    const Entry* entry = _entries[ job ];
+
+    stats.runs                   = entry->runs.load( std::memory_order_relaxed );
+    stats.missed                 = entry->missed.load( std::memory_order_relaxed );
+    stats.maxLatenessNanoseconds = entry->maxLateness.load( std::memory_order_relaxed );
+
+    for ( size_t b = 0; b < JITTER_BUCKETS; ++b )
+    {
+        stats.jitter[ b ] = entry->jitter[ b ].load( std::memory_order_relaxed );
+    }
+
+    return stats;
+}
+
+/*======================================================================
+FUNCTION:
+    BucketLimitMicroseconds()
+
+DESCRIPTION:
+    Upper edge of a jitter bucket
+
+RETURN VALUE:
+    unsigned long long - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long PollScheduler::BucketLimitMicroseconds( size_t bucket )
+{
+    return 1ULL << bucket;
+}
+
+/*======================================================================
+FUNCTION:
+    JitterPercentileMicroseconds()
+
+DESCRIPTION:
+    Walks the histogram until it has covered the given fraction of
+    the wakeups
+
+RETURN VALUE:
+    unsigned long long - microseconds (a bucket limit)
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long PollScheduler::JitterPercentileMicroseconds( const JobStats& stats, double fraction )
+{
+    unsigned long long total = 0;
+
+    for ( size_t b = 0; b < JITTER_BUCKETS; ++b )
+    {
+        total += stats.jitter[ b ];
+    }
+
+    unsigned long long seen = 0;
+
+    for ( size_t b = 0; b < JITTER_BUCKETS; ++b )
+    {
+        seen += stats.jitter[ b ];
+
+        if ( 0 < seen && seen >= fraction * total )
+        {
+            return BucketLimitMicroseconds( b );
+        }
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    record()
+
+DESCRIPTION:
+    Counts one wakeup and files its lateness in the histogram
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PollScheduler::record( Entry* entry, long long lateness )
+{
+    if ( lateness < 0 )
+    {
+        lateness = 0;
+    }
+
+    unsigned long long microseconds = ( unsigned long long ) lateness / 1000;
+
+    size_t bucket = 0;
+
+    while ( microseconds && bucket < JITTER_BUCKETS - 1 )
+    {
+        microseconds >>= 1;
+        ++bucket;
+    }
+
+    entry->jitter[ bucket ].fetch_add( 1, std::memory_order_relaxed );
+    entry->runs.fetch_add( 1, std::memory_order_relaxed );
+
+    if ( lateness > entry->maxLateness.load( std::memory_order_relaxed ) )
+    {
+        entry->maxLateness.store( lateness, std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    nowNanoseconds()
+
+DESCRIPTION:
+    Reads the monotonic clock
+
+RETURN VALUE:
+    long long - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowNanoseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+/*======================================================================
+FUNCTION:
+    sleepUntil()
+
+DESCRIPTION:
+    Sleeps until an absolute time on the monotonic clock, going
+    back to sleep if a signal wakes us early
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void sleepUntil( long long deadline )
+{
+    struct timespec when;
+
+    when.tv_sec  = ( time_t ) ( deadline / NANOSECONDS_PER_SECOND );
+    when.tv_nsec = ( long ) ( deadline % NANOSECONDS_PER_SECOND );
+
+    while ( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &when, 0 ) )
+    {
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Picking the next job is a linear scan.  A harness has a handful of
+jobs, and for that a scan beats keeping a heap up to date.
+
+=====================================================================*/
@@ -0,0 +1,253 @@
+#ifndef _POLLSCHEDULER_H_
+#define _POLLSCHEDULER_H_
+
+/*======================================================================
+FILE:
+    pollscheduler.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Runs periodic jobs (like reading a sensor) on a fixed grid of
+    absolute deadlines.
+
+DESCRIPTION:
+    This header defines a scheduler that sleeps to absolute points
+    on the monotonic clock instead of sleeping a fixed time after
+    each job, so the time a job takes never pushes the next one
+    back.  Every job has its own period and phase, and the
+    scheduler keeps a histogram of how late each wakeup was.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    PollScheduler
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// All jobs run on the thread that calls Run(), one after the other.
+// A job that runs long makes the others late (the histograms will
+// show it); give slow work to another thread, e.g. via SampleQueue.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    PollScheduler
+
+DESCRIPTION:
+    Job n runs at start + phase(n) + k * period(n) for k = 0, 1, 2...
+    The scheduler sleeps with clock_nanosleep( TIMER_ABSTIME ) until
+    the earliest of those deadlines, records how late it woke up,
+    and runs the job.  If a job falls a whole period or more behind
+    the missed deadlines are counted and skipped, not run in a
+    burst, and the job stays on its original grid.
+
+    Lateness goes into a log2 histogram in microseconds: bucket 0
+    is under 1us, bucket b is [ 2^(b-1), 2^b ) us and the last
+    bucket catches everything from about a second up.
+
+HOW TO USE:
+    1. Call AddJob() for each periodic job.  Give jobs that share
+       a bus different phases so they do not collide.
+    2. Call Run() on the thread that should do the work
+    3. Call Stats() from anywhere to see how it is going
+    4. Call Stop() from another thread (or a job) to make Run()
+       return.  Stop() may come before Run() starts; a stopped
+       scheduler does not run again.
+
+======================================================================*/
+class PollScheduler
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef std::function< void () > Job;
+
+    static const size_t JITTER_BUCKETS = 22;
+
+    // Longest single sleep, which is how quickly Run() notices Stop()
+    static const unsigned int MAX_SLEEP_MICROSECONDS = 100000;
+
+    struct JobStats
+    {
+        unsigned long long runs;
+        unsigned long long missed;
+        long long maxLatenessNanoseconds;
+        unsigned long long jitter[ JITTER_BUCKETS ];
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    PollScheduler();
+
+    virtual ~PollScheduler();
+
+    // Returns the job number.  Call before Run().
+    size_t AddJob( unsigned int periodMicroseconds, unsigned int phaseMicroseconds, Job job );
+
+    size_t JobCount() const;
+
+    // Runs jobs until Stop() is called, which may already have
+    // happened
+    void Run();
+
+    void Stop();
+
+    JobStats Stats( size_t job ) const;
+
+    // Upper edge of a jitter bucket in microseconds
+    static unsigned long long BucketLimitMicroseconds( size_t bucket );
+
+    // Smallest bucket limit that covers fraction ( 0 - 1 ) of the
+    // wakeups
+    static unsigned long long JitterPercentileMicroseconds( const JobStats& stats, double fraction );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // The counters are atomics so Stats() can be called while the
+    // scheduler thread updates them
+    struct Entry
+    {
+        long long periodNanoseconds;
+        long long phaseNanoseconds;
+        long long deadline;
+        Job job;
+        std::atomic< unsigned long long > runs;
+        std::atomic< unsigned long long > missed;
+        std::atomic< long long > maxLateness;
+        std::atomic< unsigned long long > jitter[ JITTER_BUCKETS ];
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    PollScheduler( const PollScheduler &rhs );
+
+    void record( Entry* entry, long long lateness );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::vector< Entry* > _entries;
+
+    // Set from the c-tor on, cleared for good by Stop()
+    std::atomic< bool > _running;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+A loop of Read(); sleep( 1 ); actually runs every 1s plus the read
+time plus whatever else the loop does, and the error adds up forever.
+Sleeping to an absolute deadline turns that into a fixed phase error
+that never grows: a late wakeup makes that one sample late but the
+next deadline is still where it always was.
+
+timerfd would give the same absolute deadlines through a file
+descriptor.  That only pays off once there is an event loop to put
+the descriptor in, so the scheduler sleeps with clock_nanosleep().
+
+======================================================================*/
+
+#endif	// #ifendif _POLLSCHEDULER_H_
@@ -0,0 +1,1003 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    psychrometrics.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Batch dew point, heat index and absolute humidity
+
+GENERAL DESCRIPTION:
+    This file has the double precision references, one vector
+    kernel built for AVX2, SSE2, 64 bit ARM NEON and plain C++, and
+    the count pair cache in front of it.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DewPointReference
+    HeatIndexReference
+    AbsoluteHumidityReference
+    DerivePsychrometrics
+    DerivePsychrometricsScalar
+    DerivePsychrometricsImplementation
+    PsychrometricCache
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define PSYCHROMETRICS_X86
+#elif defined( __aarch64__ )
+#define PSYCHROMETRICS_NEON
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "psychrometrics.h"
+#include "humidiconsensor.h"
+
+#include <cmath>
+#include <cstring>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+typedef void ( *DeriveFunction )( const float* tempCelcius,
+                                  const float* relativeHumidity,
+                                  size_t count,
+                                  float* dewPoint,
+                                  float* heatIndex,
+                                  float* absoluteHumidity );
+
+// GCC vector extensions: the kernel is written once and each of these
+// becomes whatever registers the target has (or plain scalar code)
+typedef float   Float4  __attribute__(( vector_size( 16 ) ));
+typedef int32_t Int4    __attribute__(( vector_size( 16 ) ));
+typedef double  Double4 __attribute__(( vector_size( 32 ) ));
+
+#if defined( PSYCHROMETRICS_X86 )
+typedef float   Float8  __attribute__(( vector_size( 32 ) ));
+typedef int32_t Int8    __attribute__(( vector_size( 32 ) ));
+typedef double  Double8 __attribute__(( vector_size( 64 ) ));
+#endif
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// Sonntag's Magnus constants over water
+static const double MAGNUS_B = 17.62;
+static const double MAGNUS_C = 243.12;
+
+// Saturation vapour pressure at 0C, hPa
+static const double MAGNUS_PRESSURE = 6.112;
+
+// Grams per cubic meter per hPa per Kelvin (100 Mw / R)
+static const double VAPOUR_DENSITY = 216.7;
+
+static const double KELVIN = 273.15;
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static DeriveFunction pickImplementation( const char** name );
+
+static void deriveGeneric( const float*, const float*, size_t, float*, float*, float* );
+
+#if defined( PSYCHROMETRICS_X86 )
+static void deriveSse2( const float*, const float*, size_t, float*, float*, float* );
+static void deriveAvx2( const float*, const float*, size_t, float*, float*, float* );
+#endif
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    DewPointReference()
+
+DESCRIPTION:
+    Magnus dew point with libm.  Humidity below
+    PSYCHROMETRIC_MIN_HUMIDITY is taken at that.
+
+RETURN VALUE:
+    double - Celcius
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double DewPointReference( double celcius, double relativeHumidity )
+{
+    if ( !( PSYCHROMETRIC_MIN_HUMIDITY <= relativeHumidity ) )
+    {
+        relativeHumidity = PSYCHROMETRIC_MIN_HUMIDITY;
+    }
+
+    double gamma = log( relativeHumidity / 100.0 ) + MAGNUS_B * celcius / ( MAGNUS_C + celcius );
+
+    return MAGNUS_C * gamma / ( MAGNUS_B - gamma );
+}
+
+/*======================================================================
+FUNCTION:
+    HeatIndexReference()
+
+DESCRIPTION:
+    The NWS heat index: Steadman's simple formula, and where the
+    average of that and the temperature is 80F or more the Rothfusz
+    regression with the low and high humidity adjustments
+
+RETURN VALUE:
+    double - Celcius
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double HeatIndexReference( double celcius, double relativeHumidity )
+{
+    double t = celcius * 1.8 + 32;
+    double r = relativeHumidity;
+
+    double index = 0.5 * ( t + 61.0 + ( t - 68.0 ) * 1.2 + r * 0.094 );
+
+    if ( 80 <= ( index + t ) * 0.5 )
+    {
+        index = -42.379 + 2.04901523 * t + 10.14333127 * r
+                - 0.22475541 * t * r - 0.00683783 * t * t - 0.05481717 * r * r
+                + 0.00122874 * t * t * r + 0.00085282 * t * r * r - 0.00000199 * t * t * r * r;
+
+        if ( r < 13 && 80 <= t && t <= 112 )
+        {
+            index -= ( 13 - r ) * 0.25 * sqrt( ( 17 - fabs( t - 95 ) ) / 17 );
+        }
+        else if ( 85 < r && 80 <= t && t <= 87 )
+        {
+            index += ( r - 85 ) * 0.1 * ( 87 - t ) * 0.2;
+        }
+    }
+
+    return ( index - 32 ) / 1.8;
+}
+
+/*======================================================================
+FUNCTION:
+    AbsoluteHumidityReference()
+
+DESCRIPTION:
+    Vapour density from the Magnus saturation pressure and the
+    ideal gas law
+
+RETURN VALUE:
+    double - grams per cubic meter
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double AbsoluteHumidityReference( double celcius, double relativeHumidity )
+{
+    if ( !( 0 < relativeHumidity ) )
+    {
+        relativeHumidity = 0;
+    }
+
+    double saturation = MAGNUS_PRESSURE * exp( MAGNUS_B * celcius / ( MAGNUS_C + celcius ) );
+
+    return VAPOUR_DENSITY * saturation * relativeHumidity / 100.0 / ( celcius + KELVIN );
+}
+
+/*======================================================================
+FUNCTION:
+    DerivePsychrometrics()
+
+DESCRIPTION:
+    Works out a batch with the fastest implementation the CPU
+    supports.  The pick is made once, on the first call.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DerivePsychrometrics( const float* tempCelcius,
+                           const float* relativeHumidity,
+                           size_t count,
+                           float* dewPoint,
+                           float* heatIndex,
+                           float* absoluteHumidity )
+{
+    static const DeriveFunction derive = pickImplementation( 0 );
+
+    derive( tempCelcius, relativeHumidity, count, dewPoint, heatIndex, absoluteHumidity );
+}
+
+/*======================================================================
+FUNCTION:
+    DerivePsychrometrics()
+
+DESCRIPTION:
+    Pulls the Celcius and humidity out of the readings a block at a
+    time and works the block out as above
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DerivePsychrometrics( const TempHumidityData* readings,
+                           size_t count,
+                           float* dewPoint,
+                           float* heatIndex,
+                           float* absoluteHumidity )
+{
+    const size_t BLOCK = 256;
+
+    float tempCelcius[ BLOCK ];
+    float relativeHumidity[ BLOCK ];
+
+    for ( size_t first = 0; first < count; first += BLOCK )
+    {
+        size_t n = ( count - first < BLOCK ) ? count - first : BLOCK;
+
+        for ( size_t i = 0; i < n; ++i )
+        {
+            tempCelcius[ i ]      = readings[ first + i ].tempCelcius;
+            relativeHumidity[ i ] = readings[ first + i ].relativeHumidity;
+        }
+
+        DerivePsychrometrics( tempCelcius, relativeHumidity, n,
+                              dewPoint         ? &dewPoint[ first ]         : 0,
+                              heatIndex        ? &heatIndex[ first ]        : 0,
+                              absoluteHumidity ? &absoluteHumidity[ first ] : 0 );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    DerivePsychrometricsImplementation()
+
+DESCRIPTION:
+    Names the implementation DerivePsychrometrics() uses
+
+RETURN VALUE:
+    const char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* DerivePsychrometricsImplementation()
+{
+    const char* name = 0;
+
+    pickImplementation( &name );
+
+    return name;
+}
+
+/*======================================================================
+FUNCTION:
+    DerivePsychrometricsScalar()
+
+DESCRIPTION:
+    One reading at a time through the references, rounded to float
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void DerivePsychrometricsScalar( const float* tempCelcius,
+                                 const float* relativeHumidity,
+                                 size_t count,
+                                 float* dewPoint,
+                                 float* heatIndex,
+                                 float* absoluteHumidity )
+{
+    for ( size_t i = 0; i < count; ++i )
+    {
+        if ( dewPoint )         dewPoint[ i ]         = ( float ) DewPointReference( tempCelcius[ i ], relativeHumidity[ i ] );
+        if ( heatIndex )        heatIndex[ i ]        = ( float ) HeatIndexReference( tempCelcius[ i ], relativeHumidity[ i ] );
+        if ( absoluteHumidity ) absoluteHumidity[ i ] = ( float ) AbsoluteHumidityReference( tempCelcius[ i ], relativeHumidity[ i ] );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    PsychrometricCache()
+
+DESCRIPTION:
+    This c-tor rounds the slot count up to a power of two and starts
+    every slot empty
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+PsychrometricCache::PsychrometricCache( size_t entries )
+: _shift( 31 ),
+  _hits( 0 ),
+  _misses( 0 )
+{
+    size_t size = 2;
+
+    // Keys are 28 bits, so more slots than that buys nothing
+    while ( size < entries && size < ( ( size_t ) 1 << 28 ) )
+    {
+        size <<= 1;
+        --_shift;
+    }
+
+    _entries.resize( size );
+
+    Clear();
+}
+
+/*======================================================================
+FUNCTION:
+    ~PsychrometricCache()
+
+DESCRIPTION:
+    Nothing to release
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+PsychrometricCache::~PsychrometricCache()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Derive()
+
+DESCRIPTION:
+    Looks every pair up.  Hits are copied out straight away; misses
+    are gathered up to BATCH at a time and worked out together.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PsychrometricCache::Derive( const uint16_t* temperature,
+                                 const uint16_t* humidity,
+                                 size_t count,
+                                 float* dewPoint,
+                                 float* heatIndex,
+                                 float* absoluteHumidity )
+{
+    uint32_t keys[ BATCH ];
+    size_t slots[ BATCH ];
+    size_t positions[ BATCH ];
+
+    size_t misses = 0;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        uint32_t key = ( ( ( uint32_t ) ( temperature[ i ] & 0x3fff ) << 14 ) | ( humidity[ i ] & 0x3fff ) ) + 1;
+
+        // Fibonacci hashing: neighbouring pairs land far apart
+        size_t slot = ( uint32_t ) ( key * 2654435761u ) >> _shift;
+
+        const Entry& entry = _entries[ slot ];
+
+        if ( entry.key == key )
+        {
+            if ( dewPoint )         dewPoint[ i ]         = entry.dewPoint;
+            if ( heatIndex )        heatIndex[ i ]        = entry.heatIndex;
+            if ( absoluteHumidity ) absoluteHumidity[ i ] = entry.absoluteHumidity;
+
+            ++_hits;
+            continue;
+        }
+
+        keys[ misses ]      = key;
+        slots[ misses ]     = slot;
+        positions[ misses ] = i;
+
+        if ( BATCH == ++misses )
+        {
+            fill( keys, slots, positions, misses, dewPoint, heatIndex, absoluteHumidity );
+            misses = 0;
+        }
+    }
+
+    fill( keys, slots, positions, misses, dewPoint, heatIndex, absoluteHumidity );
+}
+
+/*======================================================================
+FUNCTION:
+    Clear()
+
+DESCRIPTION:
+    Empties every slot and zeroes the counts
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PsychrometricCache::Clear()
+{
+    memset( _entries.data(), 0, _entries.size() * sizeof( Entry ) );
+
+    _hits   = 0;
+    _misses = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    fill()
+
+DESCRIPTION:
+    Turns the missed pairs back into Celcius and humidity the way
+    Read() does, works them out as one batch, keeps them and copies
+    them out
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void PsychrometricCache::fill( const uint32_t* keys, const size_t* slots, const size_t* positions, size_t count,
+                               float* dewPoint, float* heatIndex, float* absoluteHumidity )
+{
+    if ( 0 == count )
+    {
+        return;
+    }
+
+    // Initialized only to quiet -Wmaybe-uninitialized
+    float tempCelcius[ BATCH ] = { };
+    float relativeHumidity[ BATCH ] = { };
+
+    float dew[ BATCH ];
+    float index[ BATCH ];
+    float absolute[ BATCH ];
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        uint32_t pair = keys[ i ] - 1;
+
+        tempCelcius[ i ]      = ArithmeticConversion< Hih6130 >::Celcius( pair >> 14 );
+        relativeHumidity[ i ] = ArithmeticConversion< Hih6130 >::RelativeHumidity( pair & 0x3fff );
+    }
+
+    DerivePsychrometrics( tempCelcius, relativeHumidity, count, dew, index, absolute );
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        Entry& entry = _entries[ slots[ i ] ];
+
+        entry.key              = keys[ i ];
+        entry.dewPoint         = dew[ i ];
+        entry.heatIndex        = index[ i ];
+        entry.absoluteHumidity = absolute[ i ];
+
+        if ( dewPoint )         dewPoint[ positions[ i ] ]         = dew[ i ];
+        if ( heatIndex )        heatIndex[ positions[ i ] ]        = index[ i ];
+        if ( absoluteHumidity ) absoluteHumidity[ positions[ i ] ] = absolute[ i ];
+    }
+
+    _misses += count;
+}
+
+/*======================================================================
+FUNCTION:
+    pickImplementation()
+
+DESCRIPTION:
+    Checks what the CPU can do and hands back the best kernel
+
+RETURN VALUE:
+    DeriveFunction
+
+SIDE EFFECTS:
+    *name is set to the implementation name if name is not 0
+
+======================================================================*/
+static DeriveFunction pickImplementation( const char** name )
+{
+    const char* ignored;
+
+    if ( 0 == name )
+    {
+        name = &ignored;
+    }
+
+#if defined( PSYCHROMETRICS_X86 )
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        *name = "avx2";
+        return deriveAvx2;
+    }
+
+    if ( __builtin_cpu_supports( "sse2" ) )
+    {
+        *name = "sse2";
+        return deriveSse2;
+    }
+#elif defined( PSYCHROMETRICS_NEON )
+    // Float4 is a NEON register here
+    *name = "neon";
+    return deriveGeneric;
+#endif
+
+    *name = "generic";
+    return deriveGeneric;
+}
+
+/*======================================================================
+FUNCTION:
+    vectorLog()
+
+DESCRIPTION:
+    Natural log of positive normal floats.  The exponent comes
+    straight out of the bits; the mantissa is taken to
+    [0.707, 1.414) and ln m = 2 atanh( s ), s = ( m - 1 ) / ( m + 1 ),
+    to s^7.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    result is set
+
+======================================================================*/
+template< typename F, typename I >
+static inline __attribute__(( always_inline )) void vectorLog( const F& x, F& result )
+{
+    I bits;
+
+    memcpy( &bits, &x, sizeof( bits ) );
+
+    I exponent = ( ( bits >> 23 ) & 0xff ) - 127;
+
+    bits = ( bits & 0x7fffff ) | 0x3f800000;
+
+    F m;
+
+    memcpy( &m, &bits, sizeof( m ) );
+
+    // -1 in the lanes that are over, which moves the exponent up one
+    I over = ( m > 1.41421356f );
+
+    m        = over ? m * 0.5f : m;
+    exponent = exponent - over;
+
+    F s  = ( m - 1.0f ) / ( m + 1.0f );
+    F s2 = s * s;
+
+    F series = 1.0f + s2 * ( 1.0f / 3 + s2 * ( 1.0f / 5 + s2 * ( 1.0f / 7 ) ) );
+
+    result = __builtin_convertvector( exponent, F ) * 0.693147181f + 2.0f * s * series;
+}
+
+/*======================================================================
+FUNCTION:
+    vectorExp()
+
+DESCRIPTION:
+    e^x for |x| below about 87, the Cephes way: x = n ln 2 + r with
+    ln 2 in two parts, a degree 6 polynomial for e^r and n put
+    straight into the exponent bits
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    result is set
+
+======================================================================*/
+template< typename F, typename I >
+static inline __attribute__(( always_inline )) void vectorExp( const F& x, F& result )
+{
+    // Rounded to nearest; the shift keeps the truncation on positive
+    // numbers
+    I n = __builtin_convertvector( x * 1.44269504f + 128.5f, I ) - 128;
+
+    F whole = __builtin_convertvector( n, F );
+
+    F r = x - whole * 0.693359375f + whole * 2.12194440e-4f;
+
+    F polynomial = F{} + 1.9875691500e-4f;
+
+    polynomial = polynomial * r + 1.3981999507e-3f;
+    polynomial = polynomial * r + 8.3334519073e-3f;
+    polynomial = polynomial * r + 4.1665795894e-2f;
+    polynomial = polynomial * r + 1.6666665459e-1f;
+    polynomial = polynomial * r + 5.0000001201e-1f;
+    polynomial = polynomial * r * r + r + 1.0f;
+
+    I scaleBits = ( n + 127 ) << 23;
+
+    F scale;
+
+    memcpy( &scale, &scaleBits, sizeof( scale ) );
+
+    result = polynomial * scale;
+}
+
+/*======================================================================
+FUNCTION:
+    vectorSqrt()
+
+DESCRIPTION:
+    Square root of [0, 1] from the reciprocal square root bit trick
+    and three Newton steps, good to a few ulp
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    result is set
+
+======================================================================*/
+template< typename F, typename I >
+static inline __attribute__(( always_inline )) void vectorSqrt( const F& x, F& result )
+{
+    F clamped = ( x < 1e-20f ) ? F{} + 1e-20f : x;
+
+    I bits;
+
+    memcpy( &bits, &clamped, sizeof( bits ) );
+
+    bits = 0x5f3759df - ( bits >> 1 );
+
+    F y;
+
+    memcpy( &y, &bits, sizeof( y ) );
+
+    F half = clamped * 0.5f;
+
+    y = y * ( 1.5f - half * y * y );
+    y = y * ( 1.5f - half * y * y );
+    y = y * ( 1.5f - half * y * y );
+
+    result = ( x < 1e-20f ) ? F{} : clamped * y;
+}
+
+/*======================================================================
+FUNCTION:
+    derivePass()
+
+DESCRIPTION:
+    One vector of readings: the same formulas as the references with
+    the branches turned into selects
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< typename F, typename I, typename D >
+static inline __attribute__(( always_inline )) void derivePass( const float* tempCelcius,
+                                                                const float* relativeHumidity,
+                                                                float* dewPoint,
+                                                                float* heatIndex,
+                                                                float* absoluteHumidity )
+{
+    F t;
+    F h;
+
+    memcpy( &t, tempCelcius, sizeof( t ) );
+    memcpy( &h, relativeHumidity, sizeof( h ) );
+
+    F magnus = ( float ) MAGNUS_B * t / ( ( float ) MAGNUS_C + t );
+
+    if ( dewPoint )
+    {
+        F humidity = ( h < PSYCHROMETRIC_MIN_HUMIDITY ) ? F{} + PSYCHROMETRIC_MIN_HUMIDITY : h;
+
+        F logarithm;
+
+        vectorLog< F, I >( humidity * 0.01f, logarithm );
+
+        F gamma = logarithm + magnus;
+
+        F dew = ( float ) MAGNUS_C * gamma / ( ( float ) MAGNUS_B - gamma );
+
+        memcpy( dewPoint, &dew, sizeof( dew ) );
+    }
+
+    if ( heatIndex )
+    {
+        F f = t * 1.8f + 32.0f;
+
+        F simple = 0.5f * ( f + 61.0f + ( f - 68.0f ) * 1.2f + h * 0.094f );
+
+        F full = -42.379f + 2.04901523f * f + 10.14333127f * h
+                 - 0.22475541f * f * h - 0.00683783f * f * f - 0.05481717f * h * h
+                 + 0.00122874f * f * f * h + 0.00085282f * f * h * h - 0.00000199f * f * f * h * h;
+
+        F distance = f - 95.0f;
+
+        distance = ( distance < 0.0f ) ? -distance : distance;
+
+        F root;
+
+        vectorSqrt< F, I >( ( 17.0f - distance ) * ( 1.0f / 17 ), root );
+
+        // The formula jumps at these edges, so which side a reading
+        // is on is worked out exactly as the reference does it
+        D fd = __builtin_convertvector( t, D ) * 1.8 + 32;
+        D hd = __builtin_convertvector( h, D );
+
+        D simpled = 0.5 * ( fd + 61.0 + ( fd - 68.0 ) * 1.2 + hd * 0.094 );
+
+        I hot  = __builtin_convertvector( 80 <= ( simpled + fd ) * 0.5, I );
+        I warm = __builtin_convertvector( ( 80 <= fd ), I );
+        I dry  = ( h < 13.0f ) & warm & __builtin_convertvector( ( fd <= 112 ), I );
+        I damp = ( 85.0f < h ) & warm & __builtin_convertvector( ( fd <= 87 ), I );
+
+        full = dry ? full - ( 13.0f - h ) * 0.25f * root : full;
+        full = damp ? full + ( h - 85.0f ) * 0.1f * ( 87.0f - f ) * 0.2f : full;
+
+        F index = hot ? full : simple;
+
+        index = ( index - 32.0f ) / 1.8f;
+
+        memcpy( heatIndex, &index, sizeof( index ) );
+    }
+
+    if ( absoluteHumidity )
+    {
+        F saturation;
+
+        vectorExp< F, I >( magnus, saturation );
+
+        F humidity = ( h < 0.0f ) ? F{} : h;
+
+        F absolute = ( float ) ( VAPOUR_DENSITY * MAGNUS_PRESSURE / 100.0 ) * saturation * humidity / ( t + ( float ) KELVIN );
+
+        memcpy( absoluteHumidity, &absolute, sizeof( absolute ) );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    deriveBatch()
+
+DESCRIPTION:
+    Runs derivePass() over the batch; the readings left over at the
+    end go through a padded copy, so there is no scalar tail
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< typename F, typename I, typename D >
+static inline __attribute__(( always_inline )) void deriveBatch( const float* tempCelcius,
+                                                                 const float* relativeHumidity,
+                                                                 size_t count,
+                                                                 float* dewPoint,
+                                                                 float* heatIndex,
+                                                                 float* absoluteHumidity )
+{
+    const size_t LANES = sizeof( F ) / sizeof( float );
+
+    size_t i = 0;
+
+    for ( ; i + LANES <= count; i += LANES )
+    {
+        derivePass< F, I, D >( &tempCelcius[ i ], &relativeHumidity[ i ],
+                            dewPoint         ? &dewPoint[ i ]         : 0,
+                            heatIndex        ? &heatIndex[ i ]        : 0,
+                            absoluteHumidity ? &absoluteHumidity[ i ] : 0 );
+    }
+
+    if ( i < count )
+    {
+        // Something every formula is happy with in the padding
+        float t[ LANES ];
+        float h[ LANES ];
+
+        float dew[ LANES ];
+        float index[ LANES ];
+        float absolute[ LANES ];
+
+        size_t left = count - i;
+
+        for ( size_t l = 0; l < LANES; ++l )
+        {
+            t[ l ] = ( l < left ) ? tempCelcius[ i + l ]      : 20.0f;
+            h[ l ] = ( l < left ) ? relativeHumidity[ i + l ] : 50.0f;
+        }
+
+        derivePass< F, I, D >( t, h, dew, index, absolute );
+
+        for ( size_t l = 0; l < left; ++l )
+        {
+            if ( dewPoint )         dewPoint[ i + l ]         = dew[ l ];
+            if ( heatIndex )        heatIndex[ i + l ]        = index[ l ];
+            if ( absoluteHumidity ) absoluteHumidity[ i + l ] = absolute[ l ];
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    deriveGeneric()
+
+DESCRIPTION:
+    4 readings per pass in whatever the compiler makes of a 16 byte
+    vector: NEON on 64 bit ARM, SSE2 on x86, pairs or single floats
+    elsewhere
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void deriveGeneric( const float* tempCelcius,
+                           const float* relativeHumidity,
+                           size_t count,
+                           float* dewPoint,
+                           float* heatIndex,
+                           float* absoluteHumidity )
+{
+    deriveBatch< Float4, Int4, Double4 >( tempCelcius, relativeHumidity, count, dewPoint, heatIndex, absoluteHumidity );
+}
+
+#if defined( PSYCHROMETRICS_X86 )
+
+/*======================================================================
+FUNCTION:
+    deriveSse2()
+
+DESCRIPTION:
+    4 readings per pass with SSE2
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "sse2" ) ))
+static void deriveSse2( const float* tempCelcius,
+                        const float* relativeHumidity,
+                        size_t count,
+                        float* dewPoint,
+                        float* heatIndex,
+                        float* absoluteHumidity )
+{
+    deriveBatch< Float4, Int4, Double4 >( tempCelcius, relativeHumidity, count, dewPoint, heatIndex, absoluteHumidity );
+}
+
+/*======================================================================
+FUNCTION:
+    deriveAvx2()
+
+DESCRIPTION:
+    8 readings per pass with AVX2
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "avx2" ) ))
+static void deriveAvx2( const float* tempCelcius,
+                        const float* relativeHumidity,
+                        size_t count,
+                        float* dewPoint,
+                        float* heatIndex,
+                        float* absoluteHumidity )
+{
+    deriveBatch< Float8, Int8, Double8 >( tempCelcius, relativeHumidity, count, dewPoint, heatIndex, absoluteHumidity );
+}
+
+#endif
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Why vector extensions rather than intrinsics like framedecoder.cpp?
+The kernel is all arithmetic and selects, with no shuffles or
+unpacking, so one template says it for every target and the compiler
+picks the instructions.  The target attributes on the AVX2 and SSE2
+wrappers are what make the same template come out 8 or 4 wide.
+
+The exp in the absolute humidity reuses b T / ( c + T ) from the dew
+point, so all three metrics cost one log and one exp between them.
+
+The cache slot is 16 bytes, so four share a cache line and a miss in
+the cache costs one line fill on top of the math.
+
+=====================================================================*/
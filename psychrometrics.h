@@ -0,0 +1,317 @@
+#ifndef _PSYCHROMETRICS_H_
+#define _PSYCHROMETRICS_H_
+
+/*======================================================================
+FILE:
+    psychrometrics.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Works out dew point, heat index and absolute humidity for large
+    batches of readings.
+
+DESCRIPTION:
+    This header declares the derived metrics.  The batch functions
+    take the separate Celcius and humidity arrays DecodeFrames()
+    writes (or TempHumidityData, or raw counts through the cache) and
+    fill in one array per metric, several readings at a time with
+    SIMD instructions where the CPU has them.  The logarithm and
+    exponential in the Magnus formulas are polynomials rather than
+    libm calls, so the whole batch is straight line arithmetic.  The
+    reference functions are the same formulas in double precision
+    with libm, for checking against.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DewPointReference
+    HeatIndexReference
+    AbsoluteHumidityReference
+    DerivePsychrometrics
+    DerivePsychrometricsScalar
+    DerivePsychrometricsImplementation
+    PsychrometricCache
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// Below this the dew point is taken at this humidity; at 0%RH there
+// is no dew point at all
+static const float PSYCHROMETRIC_MIN_HUMIDITY = 0.1f;
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The Magnus formula is itself a fit.  With the Sonntag constants
+// used here it is within about 0.35C of the full saturation vapour
+// pressure equations from -45C to 60C, which is more than the
+// polynomials add (see the DOCUMENTATION).  Readings outside that
+// range still get numbers, just less trustworthy ones.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// Magnus dew point in Celcius, double precision with libm
+double DewPointReference( double celcius, double relativeHumidity );
+
+// The NWS heat index (Rothfusz regression with its adjustments, and
+// Steadman's simple formula where that is below 80F), in Celcius
+double HeatIndexReference( double celcius, double relativeHumidity );
+
+// Water vapour in grams per cubic meter, from the Magnus saturation
+// pressure
+double AbsoluteHumidityReference( double celcius, double relativeHumidity );
+
+// Works out the metrics for a batch of readings.  Any of the output
+// arrays can be 0 if you do not want it.  Uses the fastest
+// implementation the CPU supports.
+void DerivePsychrometrics( const float* tempCelcius,
+                           const float* relativeHumidity,
+                           size_t count,
+                           float* dewPoint,
+                           float* heatIndex,
+                           float* absoluteHumidity );
+
+// Same thing for readings as Read() returns them
+void DerivePsychrometrics( const TempHumidityData* readings,
+                           size_t count,
+                           float* dewPoint,
+                           float* heatIndex,
+                           float* absoluteHumidity );
+
+// Same thing, one reading at a time with the reference functions;
+// what working them out per sample with libm costs
+void DerivePsychrometricsScalar( const float* tempCelcius,
+                                 const float* relativeHumidity,
+                                 size_t count,
+                                 float* dewPoint,
+                                 float* heatIndex,
+                                 float* absoluteHumidity );
+
+// Name of the implementation DerivePsychrometrics() picked
+// ("avx2", "sse2", "neon" or "generic")
+const char* DerivePsychrometricsImplementation();
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    PsychrometricCache
+
+DESCRIPTION:
+    Remembers the metrics by the raw (temperature count, humidity
+    count) pair.  Indoor readings wander over a few hundred counts
+    of each, so most pairs come round again.  The cache is direct
+    mapped: a pair that lands on a taken slot replaces what was
+    there.
+
+HOW TO USE:
+    1. Construct the object with the number of slots (rounded up to
+       a power of two; 16 bytes each)
+    2. Call Derive() with the count arrays; the misses are worked out
+       together with DerivePsychrometrics() and kept
+    3. HitCount() and MissCount() say how well it is doing
+
+======================================================================*/
+class PsychrometricCache
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // 256KB.  Being direct mapped it wants the pairs in use well
+    // under this: a minute of a 64 sensor fleet is about 2000.
+    static const size_t DEFAULT_ENTRIES = 1 << 14;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    PsychrometricCache( size_t entries = DEFAULT_ENTRIES );
+
+    virtual ~PsychrometricCache();
+
+    // Counts are the 14 bit values from the frame.  Any of the
+    // output arrays can be 0.
+    void Derive( const uint16_t* temperature,
+                 const uint16_t* humidity,
+                 size_t count,
+                 float* dewPoint,
+                 float* heatIndex,
+                 float* absoluteHumidity );
+
+    void Clear();
+
+    size_t EntryCount() const { return _entries.size(); }
+
+    unsigned long long HitCount() const { return _hits; }
+
+    unsigned long long MissCount() const { return _misses; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    PsychrometricCache( const PsychrometricCache &rhs );
+
+    // The pair plus one, so 0 is an empty slot
+    struct Entry
+    {
+        uint32_t key;
+
+        float dewPoint;
+        float heatIndex;
+        float absoluteHumidity;
+    };
+
+    // Misses worked out at a time
+    static const size_t BATCH = 256;
+
+    void fill( const uint32_t* keys, const size_t* slots, const size_t* positions, size_t count,
+               float* dewPoint, float* heatIndex, float* absoluteHumidity );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::vector< Entry > _entries;
+
+    unsigned int _shift;
+
+    unsigned long long _hits;
+
+    unsigned long long _misses;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+The formulas, with T in Celcius and RH in percent, b = 17.62 and
+c = 243.12 (Sonntag 1990, over water):
+
+    gamma     = ln( RH / 100 ) + b T / ( c + T )
+    dew point = c gamma / ( b - gamma )
+    absolute  = 216.7 * 6.112 exp( b T / ( c + T ) ) * RH / 100 / ( T + 273.15 )
+
+The heat index is the NWS one, worked in Fahrenheit and handed back
+in Celcius.  It is a polynomial already; the only transcendental is
+the square root in the low humidity adjustment.
+
+The polynomials: ln is 2 atanh( s ) with s = ( m - 1 ) / ( m + 1 ) on
+the mantissa taken to [0.707, 1.414), to s^7, which leaves at most
+3e-8 before rounding.  exp is the Cephes single precision one: range
+reduced by ln 2 in two parts, then a degree 6 polynomial, about 1 ulp.
+
+Measured against the double precision references over every
+temperature count and every fourth humidity count (every one below
+256) the sensor can send, bench psychrometrics:
+
+    dew point          within 0.0001C
+    heat index         within 0.002C (float rounding in the
+                       regression's big terms, at the hot end)
+    absolute humidity  within 2e-6 relative
+
+All of it far inside the sensor's own +-0.5C and +-2%RH.  The heat
+index formula steps by up to 0.75C where it switches between the
+simple and the full regression; the kernel decides the switch in
+double precision, exactly as the reference does, so a reading never
+lands on the other side of the step.
+
+When to use the cache: a hit is about 3ns, under half of the batch on
+a CPU with SIMD, but only while the pairs in use fit.  A 64 sensor
+fleet drifting over two days hits about 74% of the time in the
+default cache, and at that rate the misses make it slower than the
+batch.  The cache pays where the math is slow, on cores without a
+vector unit, where a hit saves the whole log and exp.
+
+======================================================================*/
+
+#endif	// #ifendif _PSYCHROMETRICS_H_
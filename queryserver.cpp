@@ -0,0 +1,1845 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    queryserver.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to serve readings and metrics over sockets
+
+GENERAL DESCRIPTION:
+    This file implements the listeners, the per shard epoll loop,
+    the request parser and the response formatting
+
+PUBLIC CLASSES AND FUNCTIONS:
+    QueryServer
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "queryserver.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// The metrics buffer while buildMetrics() fills it
+struct MetricsText
+{
+    char* text;
+    size_t capacity;
+    size_t length;
+    size_t lines;
+};
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// epoll tags for the descriptors that are not connections
+static const uint64_t TAG_WAKE = 0;
+static const uint64_t TAG_UNIX = 1;
+static const uint64_t TAG_TCP  = 2;
+
+// Longest LATEST or RANGE row
+static const size_t ROW_BYTES = 64;
+
+// Room left in front of the rows for the "OK" line
+static const size_t HEADER_BYTES = 48;
+
+// Room for the HTTP response line and headers
+static const size_t HTTP_HEADER_BYTES = 128;
+
+// Longest metrics line
+static const size_t METRIC_BYTES = 112;
+
+// Metrics lines per sensor and for the shard, with their comments
+static const size_t METRIC_LINES_PER_SENSOR = 5;
+static const size_t METRIC_LINES_FIXED      = 30;
+
+// How stale the metrics text may get before a request rebuilds it
+static const long long METRICS_MAX_AGE_MICROSECONDS = 100000;
+
+// How long a shard sleeps without clients before emptying its queue
+static const int FEED_POLL_MILLISECONDS = 100;
+
+static const int MAX_EVENTS = 64;
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long nowMicroseconds();
+
+static size_t formatRow( char* row, size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+static bool parseNumber( const char*& text, long long& value );
+
+static void bump( std::atomic< unsigned long long >& counter, long long amount );
+
+static void appendMetric( MetricsText& text, const char* format, ... ) __attribute__(( format( printf, 2, 3 ) ));
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    Shard()
+
+DESCRIPTION:
+    This c-tor sets up a shard's readings.  The descriptors and
+    connection buffers come later in setupShard().
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+QueryServer::Shard::Shard( size_t sensorCount, size_t historyCapacity )
+: index( 0 ),
+  epoll( -1 ),
+  wake( -1 ),
+  tcpListener( -1 ),
+  feed( FEED_CAPACITY, SampleQueue< Reading >::DROP_OLDEST ),
+  latest( sensorCount ),
+  readingCounts( sensorCount, 0 ),
+  freeConnections( 0 ),
+  buffers( 0 ),
+  metricsLength( 0 ),
+  metricsLines( 0 ),
+  metricsBuilt( 0 ),
+  metricsStale( true ),
+  metricsPins( 0 ),
+  requests( 0 ),
+  connectionCount( 0 ),
+  rejected( 0 )
+{
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        latest[ s ].sensor           = s;
+        latest[ s ].timeMicroseconds = -1;
+
+        histories.push_back( new SampleHistory( historyCapacity ) );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    QueryServer()
+
+DESCRIPTION:
+    This c-tor binds the listeners and gives every shard its
+    epoll set and connection buffers.  Nothing is served until
+    Start().
+
+    Throws a SensorException if a socket can not be set up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+QueryServer::QueryServer( size_t sensorCount, const QueryServerOptions& options )
+: _sensorCount( sensorCount ),
+  _options( options ),
+  _unixListener( -1 ),
+  _tcpPort( -1 ),
+  _outBytes( 0 ),
+  _running( false )
+{
+    if ( 0 == _options.shards )
+    {
+        _options.shards = 1;
+    }
+
+    // Room for two of the largest answers, so a pipelining client
+    // gets at least that many per sendmsg().  LATEST pages like RANGE,
+    // so this does not grow with the sensor count.
+    size_t largest = HEADER_BYTES + RANGE_ROWS * ROW_BYTES;
+
+    _outBytes = 2 * ( largest + HTTP_HEADER_BYTES );
+
+    try
+    {
+        if ( !_options.unixPath.empty() )
+        {
+            openUnixListener();
+        }
+
+        for ( size_t s = 0; s < _options.shards; ++s )
+        {
+            _shards.push_back( new Shard( _sensorCount, _options.historyCapacity ) );
+
+            _shards.back()->index = s;
+
+            setupShard( *_shards.back() );
+        }
+    }
+    catch( ... )
+    {
+        // std::bad_alloc from the connection buffers as well as our
+        // own failures
+        for ( size_t s = 0; s < _shards.size(); ++s )
+        {
+            teardownShard( *_shards[ s ] );
+            delete _shards[ s ];
+        }
+
+        if ( 0 <= _unixListener )
+        {
+            close( _unixListener );
+            unlink( _options.unixPath.c_str() );
+        }
+
+        throw;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~QueryServer()
+
+DESCRIPTION:
+    This destructor stops the shards, hangs up on every client and
+    removes the Unix socket
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+QueryServer::~QueryServer()
+{
+    Stop();
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        teardownShard( *_shards[ s ] );
+        delete _shards[ s ];
+    }
+
+    if ( 0 <= _unixListener )
+    {
+        close( _unixListener );
+        unlink( _options.unixPath.c_str() );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Start()
+
+DESCRIPTION:
+    This method starts one thread per shard
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::Start()
+{
+    if ( _running )
+    {
+        return;
+    }
+
+    _running = true;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        _shards[ s ]->thread = std::thread( &QueryServer::run, this, std::ref( *_shards[ s ] ) );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Stop()
+
+DESCRIPTION:
+    This method wakes every shard through its eventfd and waits for
+    the threads to finish.  Connections stay open until the server
+    is destroyed.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::Stop()
+{
+    if ( !_running )
+    {
+        return;
+    }
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        uint64_t one = 1;
+
+        ssize_t ignored = write( _shards[ s ]->wake, &one, sizeof( one ) );
+
+        ( void ) ignored;
+    }
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        _shards[ s ]->thread.join();
+    }
+
+    _running = false;
+}
+
+/*======================================================================
+FUNCTION:
+    Offer()
+
+DESCRIPTION:
+    Queues a reading for every shard.  The queues drop their oldest
+    entry rather than wait, so this never blocks the caller.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::Offer( size_t sensor, const TempHumidityData& data, long long timeMicroseconds )
+{
+    if ( sensor >= _sensorCount )
+    {
+        return;
+    }
+
+    Reading reading;
+
+    reading.sensor           = sensor;
+    reading.timeMicroseconds = timeMicroseconds;
+    reading.data             = data;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        _shards[ s ]->feed.Push( reading );
+    }
+}
+
+void QueryServer::Offer( size_t sensor, const TempHumidityData& data )
+{
+    Offer( sensor, data, nowMicroseconds() );
+}
+
+/*======================================================================
+FUNCTION:
+    RequestCount() and friends
+
+DESCRIPTION:
+    Totals of the per shard counters
+
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long QueryServer::RequestCount() const
+{
+    unsigned long long total = 0;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        total += _shards[ s ]->requests.load( std::memory_order_relaxed );
+    }
+
+    return total;
+}
+
+unsigned long long QueryServer::ConnectionCount() const
+{
+    unsigned long long total = 0;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        total += _shards[ s ]->connectionCount.load( std::memory_order_relaxed );
+    }
+
+    return total;
+}
+
+unsigned long long QueryServer::RejectedCount() const
+{
+    unsigned long long total = 0;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        total += _shards[ s ]->rejected.load( std::memory_order_relaxed );
+    }
+
+    return total;
+}
+
+unsigned long long QueryServer::DroppedCount() const
+{
+    unsigned long long total = 0;
+
+    for ( size_t s = 0; s < _shards.size(); ++s )
+    {
+        total += _shards[ s ]->feed.DroppedCount();
+    }
+
+    return total;
+}
+
+/*======================================================================
+FUNCTION:
+    openUnixListener()
+
+DESCRIPTION:
+    Binds the Unix socket every shard accepts from, replacing a
+    socket file left by an earlier run
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::openUnixListener()
+{
+    struct sockaddr_un address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sun_family = AF_UNIX;
+
+    if ( _options.unixPath.size() >= sizeof( address.sun_path ) )
+    {
+        throw SensorException( "Unix socket path is too long: " + _options.unixPath );
+    }
+
+    strcpy( address.sun_path, _options.unixPath.c_str() );
+
+    _unixListener = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( _unixListener < 0 )
+    {
+        throw SensorException( "Failed to create the Unix socket" );
+    }
+
+    unlink( address.sun_path );
+
+    if ( 0 != bind( _unixListener, ( struct sockaddr* ) &address, sizeof( address ) ) ||
+         0 != listen( _unixListener, SOMAXCONN ) )
+    {
+        close( _unixListener );
+        _unixListener = -1;
+
+        throw SensorException( "Failed to listen on " + _options.unixPath );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    openTcpListener()
+
+DESCRIPTION:
+    Binds one shard's TCP socket.  Every shard binds the same
+    address with SO_REUSEPORT; the first one to bind port 0 picks
+    the port for the rest.
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    int - the listening socket
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int QueryServer::openTcpListener( int port )
+{
+    struct sockaddr_in address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sin_family = AF_INET;
+    address.sin_port   = htons( ( uint16_t ) port );
+
+    if ( 1 != inet_pton( AF_INET, _options.tcpAddress.c_str(), &address.sin_addr ) )
+    {
+        throw SensorException( "Not an IPv4 address: " + _options.tcpAddress );
+    }
+
+    int listener = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( listener < 0 )
+    {
+        throw SensorException( "Failed to create a TCP socket" );
+    }
+
+    int on = 1;
+
+    setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+
+    if ( 0 != setsockopt( listener, SOL_SOCKET, SO_REUSEPORT, &on, sizeof( on ) ) ||
+         0 != bind( listener, ( struct sockaddr* ) &address, sizeof( address ) ) ||
+         0 != listen( listener, SOMAXCONN ) )
+    {
+        close( listener );
+
+        char text[ 32 ];
+
+        snprintf( text, sizeof( text ), ":%d", port );
+
+        throw SensorException( "Failed to listen on " + _options.tcpAddress + text );
+    }
+
+    if ( 0 == port )
+    {
+        socklen_t length = sizeof( address );
+
+        getsockname( listener, ( struct sockaddr* ) &address, &length );
+    }
+
+    _tcpPort = ntohs( address.sin_port );
+
+    return listener;
+}
+
+/*======================================================================
+FUNCTION:
+    setupShard()
+
+DESCRIPTION:
+    Creates a shard's epoll set, wake up eventfd and TCP listener
+    and carves its connection buffers out of one allocation
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::setupShard( Shard& shard )
+{
+    shard.epoll = epoll_create1( EPOLL_CLOEXEC );
+    shard.wake  = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    if ( shard.epoll < 0 || shard.wake < 0 )
+    {
+        throw SensorException( "Failed to create the query server's epoll set" );
+    }
+
+    if ( 0 <= _options.tcpPort )
+    {
+        shard.tcpListener = openTcpListener( ( 0 == shard.index ) ? _options.tcpPort : _tcpPort );
+    }
+
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( event ) );
+
+    event.events   = EPOLLIN;
+    event.data.u64 = TAG_WAKE;
+
+    bool ok = ( 0 == epoll_ctl( shard.epoll, EPOLL_CTL_ADD, shard.wake, &event ) );
+
+    if ( ok && 0 <= _unixListener )
+    {
+        // One client wakes one shard, not all of them
+        event.events   = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.u64 = TAG_UNIX;
+
+        ok = ( 0 == epoll_ctl( shard.epoll, EPOLL_CTL_ADD, _unixListener, &event ) );
+    }
+
+    if ( ok && 0 <= shard.tcpListener )
+    {
+        event.events   = EPOLLIN;
+        event.data.u64 = TAG_TCP;
+
+        ok = ( 0 == epoll_ctl( shard.epoll, EPOLL_CTL_ADD, shard.tcpListener, &event ) );
+    }
+
+    if ( !ok )
+    {
+        throw SensorException( "Failed to add the listeners to the query server's epoll set" );
+    }
+
+    // Left uninitialized, so the pages of connections that never
+    // come are never touched
+    shard.buffers = new char[ _options.maxConnections * ( REQUEST_BYTES + _outBytes ) ];
+
+    shard.connections.resize( _options.maxConnections );
+
+    for ( size_t c = _options.maxConnections; 0 < c; --c )
+    {
+        Connection& connection = shard.connections[ c - 1 ];
+
+        connection.fileDescriptor = -1;
+        connection.in             = shard.buffers + ( c - 1 ) * ( REQUEST_BYTES + _outBytes );
+        connection.out            = connection.in + REQUEST_BYTES;
+        connection.nextFree       = shard.freeConnections;
+
+        shard.freeConnections = &connection;
+    }
+
+    shard.metrics.resize( METRIC_BYTES * ( METRIC_LINES_FIXED + _sensorCount * METRIC_LINES_PER_SENSOR ) );
+}
+
+/*======================================================================
+FUNCTION:
+    teardownShard()
+
+DESCRIPTION:
+    Closes a shard's clients and descriptors and frees its buffers
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::teardownShard( Shard& shard )
+{
+    for ( size_t c = 0; c < shard.connections.size(); ++c )
+    {
+        if ( 0 <= shard.connections[ c ].fileDescriptor )
+        {
+            close( shard.connections[ c ].fileDescriptor );
+        }
+    }
+
+    int descriptors[] = { shard.epoll, shard.wake, shard.tcpListener };
+
+    for ( size_t d = 0; d < sizeof( descriptors ) / sizeof( descriptors[ 0 ] ); ++d )
+    {
+        if ( 0 <= descriptors[ d ] )
+        {
+            close( descriptors[ d ] );
+        }
+    }
+
+    for ( size_t s = 0; s < shard.histories.size(); ++s )
+    {
+        delete shard.histories[ s ];
+    }
+
+    delete [] shard.buffers;
+}
+
+/*======================================================================
+FUNCTION:
+    run()
+
+DESCRIPTION:
+    A shard's thread.  Takes in whatever readings came since the
+    last pass, then handles new clients and requests.  Without
+    clients it still wakes up now and then to keep its queue from
+    overflowing.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::run( Shard& shard )
+{
+    struct epoll_event events[ MAX_EVENTS ];
+
+    for ( ;; )
+    {
+        int ready = epoll_wait( shard.epoll, events, MAX_EVENTS, FEED_POLL_MILLISECONDS );
+
+        // A request always sees the readings offered before it came
+        drainFeed( shard );
+
+        if ( ready < 0 )
+        {
+            if ( EINTR == errno )
+            {
+                continue;
+            }
+
+            return;
+        }
+
+        for ( int e = 0; e < ready; ++e )
+        {
+            uint64_t tag = events[ e ].data.u64;
+
+            if ( TAG_WAKE == tag )
+            {
+                return;
+            }
+            else if ( TAG_UNIX == tag )
+            {
+                acceptClients( shard, _unixListener );
+            }
+            else if ( TAG_TCP == tag )
+            {
+                acceptClients( shard, shard.tcpListener );
+            }
+            else
+            {
+                serviceConnection( shard, *( Connection* ) ( uintptr_t ) tag );
+            }
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    drainFeed()
+
+DESCRIPTION:
+    Moves the queued readings into the shard's latest values and
+    histories
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::drainFeed( Shard& shard )
+{
+    Reading reading;
+
+    while ( shard.feed.TryPop( reading ) )
+    {
+        unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+        Honeywell6130Sensor::Encode( reading.data, frame );
+
+        shard.histories[ reading.sensor ]->Append( frame, reading.timeMicroseconds );
+
+        shard.latest[ reading.sensor ] = reading;
+
+        ++shard.readingCounts[ reading.sensor ];
+
+        shard.metricsStale = true;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    acceptClients()
+
+DESCRIPTION:
+    Accepts every waiting client and gives each a connection from
+    the free list.  Clients past maxConnections are hung up on.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::acceptClients( Shard& shard, int listener )
+{
+    for ( ;; )
+    {
+        int client = accept4( listener, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+        if ( client < 0 )
+        {
+            // EAGAIN, or another shard got there first
+            return;
+        }
+
+        if ( 0 == shard.freeConnections )
+        {
+            close( client );
+            bump( shard.rejected, 1 );
+            continue;
+        }
+
+        if ( listener == shard.tcpListener )
+        {
+            int on = 1;
+
+            setsockopt( client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+        }
+
+        Connection& connection = *shard.freeConnections;
+
+        connection.fileDescriptor = client;
+        connection.closing        = false;
+        connection.blocked        = false;
+        connection.pinsMetrics    = false;
+        connection.inLength       = 0;
+        connection.outLength      = 0;
+        connection.firstIovec     = 0;
+        connection.iovecCount     = 0;
+
+        struct epoll_event event;
+
+        memset( &event, 0, sizeof( event ) );
+
+        event.events   = EPOLLIN;
+        event.data.u64 = ( uintptr_t ) &connection;
+
+        if ( 0 != epoll_ctl( shard.epoll, EPOLL_CTL_ADD, client, &event ) )
+        {
+            close( client );
+            connection.fileDescriptor = -1;
+            continue;
+        }
+
+        shard.freeConnections = connection.nextFree;
+
+        bump( shard.connectionCount, 1 );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    serviceConnection()
+
+DESCRIPTION:
+    Handles an epoll event on a client.  A client with output held
+    back gets that written first, and only once it has all gone do
+    we read its next requests.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::serviceConnection( Shard& shard, Connection& connection )
+{
+    if ( connection.blocked )
+    {
+        if ( !flush( shard, connection ) || connection.blocked )
+        {
+            return;
+        }
+    }
+
+    readRequests( shard, connection );
+}
+
+/*======================================================================
+FUNCTION:
+    readRequests()
+
+DESCRIPTION:
+    Answers every complete request line the client has sent, as
+    many as fit in its out buffer per sendmsg().  It only reads the
+    socket again when the last read filled the in buffer; otherwise
+    epoll will say if more came, which saves a read() that would
+    just return EAGAIN.
+
+RETURN VALUE:
+    bool - false if the connection was closed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool QueryServer::readRequests( Shard& shard, Connection& connection )
+{
+    bool mayHaveMore = true;
+
+    for ( ;; )
+    {
+        size_t start = 0;
+
+        bool waiting = false;
+
+        for ( ;; )
+        {
+            char* line = connection.in + start;
+            char* end  = ( char* ) memchr( line, '\n', connection.inLength - start );
+
+            if ( 0 == end )
+            {
+                break;
+            }
+
+            // Leave the line for the next batch if its answer might
+            // not fit
+            if ( connection.outLength + _outBytes / 2 > _outBytes ||
+                 connection.iovecCount + 3 > MAX_IOVECS )
+            {
+                waiting = true;
+                break;
+            }
+
+            *end = '\0';
+
+            if ( line < end && '\r' == end[ -1 ] )
+            {
+                end[ -1 ] = '\0';
+            }
+
+            start = ( size_t ) ( end - connection.in ) + 1;
+
+            handleRequest( shard, connection, line );
+
+            if ( connection.closing )
+            {
+                start = connection.inLength;
+                break;
+            }
+        }
+
+        connection.inLength -= start;
+
+        memmove( connection.in, connection.in + start, connection.inLength );
+
+        if ( connection.firstIovec < connection.iovecCount )
+        {
+            if ( !flush( shard, connection ) )
+            {
+                return false;
+            }
+
+            if ( connection.blocked )
+            {
+                return true;
+            }
+        }
+
+        if ( waiting )
+        {
+            continue;
+        }
+
+        if ( !mayHaveMore )
+        {
+            return true;
+        }
+
+        if ( REQUEST_BYTES == connection.inLength )
+        {
+            answerError( connection, "request too long" );
+
+            connection.closing  = true;
+            connection.inLength = 0;
+
+            return flush( shard, connection );
+        }
+
+        size_t room = REQUEST_BYTES - connection.inLength;
+
+        ssize_t count = read( connection.fileDescriptor, connection.in + connection.inLength, room );
+
+        if ( 0 < count )
+        {
+            connection.inLength += ( size_t ) count;
+
+            mayHaveMore = ( ( size_t ) count == room );
+        }
+        else if ( 0 == count || ( EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno ) )
+        {
+            closeConnection( shard, connection );
+            return false;
+        }
+        else if ( EINTR != errno )
+        {
+            return true;
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    handleRequest()
+
+DESCRIPTION:
+    Queues the answer to one request line
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::handleRequest( Shard& shard, Connection& connection, char* line )
+{
+    bump( shard.requests, 1 );
+
+    const char* arguments = line + strcspn( line, " " );
+
+    size_t length = ( size_t ) ( arguments - line );
+
+    while ( ' ' == *arguments )
+    {
+        ++arguments;
+    }
+
+    if ( 0 == length )
+    {
+        // Blank lines are harmless, answer nothing
+        return;
+    }
+    else if ( 6 == length && 0 == memcmp( line, "LATEST", 6 ) )
+    {
+        answerLatest( shard, connection, arguments );
+    }
+    else if ( 5 == length && 0 == memcmp( line, "RANGE", 5 ) )
+    {
+        answerRange( shard, connection, arguments );
+    }
+    else if ( 7 == length && 0 == memcmp( line, "METRICS", 7 ) )
+    {
+        answerMetrics( shard, connection, false );
+    }
+    else if ( 3 == length && 0 == memcmp( line, "GET", 3 ) )
+    {
+        // A scrape: one answer, then we hang up, so the rest of the
+        // HTTP headers never need parsing
+        connection.closing = true;
+
+        if ( 0 == strncmp( arguments, "/metrics", 8 ) && ( ' ' == arguments[ 8 ] || '\0' == arguments[ 8 ] ) )
+        {
+            answerMetrics( shard, connection, true );
+        }
+        else
+        {
+            static const char notFound[] =
+                "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n\r\nnot found\n";
+
+            queueOutput( connection, notFound, sizeof( notFound ) - 1 );
+        }
+    }
+    else if ( 4 == length && 0 == memcmp( line, "QUIT", 4 ) )
+    {
+        static const char bye[] = "OK 0\n";
+
+        queueOutput( connection, bye, sizeof( bye ) - 1 );
+
+        connection.closing = true;
+    }
+    else
+    {
+        answerError( connection, "unknown command" );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    answerLatest()
+
+DESCRIPTION:
+    LATEST [sensor], or LATEST FROM sensor.  Sensors that have not
+    been read yet are left out.  Without a sensor it answers up to
+    RANGE_ROWS of them; if there are more the header says which
+    sensor to go on FROM.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::answerLatest( Shard& shard, Connection& connection, const char* arguments )
+{
+    size_t first = 0;
+    size_t last  = _sensorCount;
+
+    if ( 0 == strncmp( arguments, "FROM ", 5 ) )
+    {
+        arguments += 5;
+
+        long long sensor;
+
+        if ( !parseNumber( arguments, sensor ) || '\0' != *arguments || sensor < 0 )
+        {
+            answerError( connection, "usage: LATEST FROM sensor" );
+            return;
+        }
+
+        first = ( ( size_t ) sensor < _sensorCount ) ? ( size_t ) sensor : _sensorCount;
+    }
+    else if ( '\0' != *arguments )
+    {
+        long long sensor;
+
+        if ( !parseNumber( arguments, sensor ) || '\0' != *arguments || sensor < 0 || ( size_t ) sensor >= _sensorCount )
+        {
+            answerError( connection, "no such sensor" );
+            return;
+        }
+
+        first = ( size_t ) sensor;
+        last  = first + 1;
+    }
+
+    // The rows go in after room for the header, which is then
+    // written just in front of them once the count is known
+    char* space = connection.out + connection.outLength;
+    char* rows  = space + HEADER_BYTES;
+    char* next  = rows;
+
+    size_t count = 0;
+
+    long long more = -1;
+
+    for ( size_t s = first; s < last; ++s )
+    {
+        const Reading& reading = shard.latest[ s ];
+
+        if ( 0 <= reading.timeMicroseconds )
+        {
+            if ( RANGE_ROWS == count )
+            {
+                more = ( long long ) s;
+                break;
+            }
+
+            next += formatRow( next, s, reading.timeMicroseconds, reading.data );
+            ++count;
+        }
+    }
+
+    char header[ HEADER_BYTES ];
+
+    size_t headerLength;
+
+    if ( more < 0 )
+    {
+        headerLength = ( size_t ) snprintf( header, sizeof( header ), "OK %u\n", ( unsigned int ) count );
+    }
+    else
+    {
+        headerLength = ( size_t ) snprintf( header, sizeof( header ), "OK %u MORE %lld\n", ( unsigned int ) count, more );
+    }
+
+    memcpy( rows - headerLength, header, headerLength );
+
+    queueOutput( connection, rows - headerLength, headerLength + ( size_t ) ( next - rows ) );
+
+    connection.outLength += ( size_t ) ( next - space );
+}
+
+/*======================================================================
+FUNCTION:
+    answerRange()
+
+DESCRIPTION:
+    RANGE sensor from_us [to_us].  Up to RANGE_ROWS readings, oldest
+    first; if there are more the header says where to pick up.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::answerRange( Shard& shard, Connection& connection, const char* arguments )
+{
+    long long sensor;
+    long long from;
+    long long to = nowMicroseconds();
+
+    bool ok = parseNumber( arguments, sensor ) && parseNumber( arguments, from );
+
+    if ( ok && '\0' != *arguments )
+    {
+        ok = parseNumber( arguments, to );
+    }
+
+    if ( !ok || '\0' != *arguments )
+    {
+        answerError( connection, "usage: RANGE sensor from_us [to_us]" );
+        return;
+    }
+
+    if ( sensor < 0 || ( size_t ) sensor >= _sensorCount )
+    {
+        answerError( connection, "no such sensor" );
+        return;
+    }
+
+    char* space = connection.out + connection.outLength;
+    char* rows  = space + HEADER_BYTES;
+    char* next  = rows;
+
+    size_t count = 0;
+
+    long long more = -1;
+
+    SampleHistory::Range range = shard.histories[ ( size_t ) sensor ]->Between( from, to );
+
+    for ( SampleHistory::const_iterator i = range.begin(); i != range.end(); ++i )
+    {
+        HistoryEntry entry = *i;
+
+        if ( RANGE_ROWS == count )
+        {
+            more = entry.TimeMicroseconds();
+            break;
+        }
+
+        next += formatRow( next, ( size_t ) sensor, entry.TimeMicroseconds(), entry.Data() );
+        ++count;
+    }
+
+    char header[ HEADER_BYTES ];
+
+    size_t headerLength;
+
+    if ( more < 0 )
+    {
+        headerLength = ( size_t ) snprintf( header, sizeof( header ), "OK %u\n", ( unsigned int ) count );
+    }
+    else
+    {
+        headerLength = ( size_t ) snprintf( header, sizeof( header ), "OK %u MORE %lld\n", ( unsigned int ) count, more );
+    }
+
+    memcpy( rows - headerLength, header, headerLength );
+
+    queueOutput( connection, rows - headerLength, headerLength + ( size_t ) ( next - rows ) );
+
+    connection.outLength += ( size_t ) ( next - space );
+}
+
+/*======================================================================
+FUNCTION:
+    answerMetrics()
+
+DESCRIPTION:
+    METRICS, or GET /metrics when http is set.  Only the header is
+    written per request; the body is the shard's cached metrics
+    text, handed to sendmsg() in place.  While a connection still
+    has part of it to send the text is pinned and not rebuilt.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::answerMetrics( Shard& shard, Connection& connection, bool http )
+{
+    if ( 0 == shard.metricsPins &&
+         ( shard.metricsStale || nowMicroseconds() - shard.metricsBuilt > METRICS_MAX_AGE_MICROSECONDS ) )
+    {
+        buildMetrics( shard );
+    }
+
+    char* header = connection.out + connection.outLength;
+
+    size_t headerLength;
+
+    if ( http )
+    {
+        headerLength = ( size_t ) snprintf( header, HTTP_HEADER_BYTES,
+                                            "HTTP/1.0 200 OK\r\n"
+                                            "Content-Type: text/plain; version=0.0.4\r\n"
+                                            "Content-Length: %u\r\n\r\n",
+                                            ( unsigned int ) shard.metricsLength );
+    }
+    else
+    {
+        headerLength = ( size_t ) snprintf( header, HTTP_HEADER_BYTES, "OK %u\n", ( unsigned int ) shard.metricsLines );
+    }
+
+    queueOutput( connection, header, headerLength );
+
+    connection.outLength += headerLength;
+
+    queueOutput( connection, &shard.metrics[ 0 ], shard.metricsLength );
+
+    if ( !connection.pinsMetrics )
+    {
+        connection.pinsMetrics = true;
+        ++shard.metricsPins;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    answerError()
+
+DESCRIPTION:
+    Queues "ERR <reason>"
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::answerError( Connection& connection, const char* reason )
+{
+    char* text = connection.out + connection.outLength;
+
+    size_t length = ( size_t ) snprintf( text, HEADER_BYTES, "ERR %s\n", reason );
+
+    if ( length >= HEADER_BYTES )
+    {
+        length = HEADER_BYTES - 1;
+        text[ length - 1 ] = '\n';
+    }
+
+    queueOutput( connection, text, length );
+
+    connection.outLength += length;
+}
+
+/*======================================================================
+FUNCTION:
+    queueOutput()
+
+DESCRIPTION:
+    Adds text to the connection's pending output.  Text that
+    carries straight on from the last piece just makes that piece
+    longer, so back to back answers in the out buffer go out as one
+    iovec.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::queueOutput( Connection& connection, const char* text, size_t length )
+{
+    if ( 0 == length )
+    {
+        return;
+    }
+
+    if ( 0 < connection.iovecCount )
+    {
+        struct iovec& last = connection.iovecs[ connection.iovecCount - 1 ];
+
+        if ( ( const char* ) last.iov_base + last.iov_len == text )
+        {
+            last.iov_len += length;
+            return;
+        }
+    }
+
+    struct iovec& piece = connection.iovecs[ connection.iovecCount++ ];
+
+    piece.iov_base = ( void* ) text;
+    piece.iov_len  = length;
+}
+
+/*======================================================================
+FUNCTION:
+    flush()
+
+DESCRIPTION:
+    Sends the pending output in one gathering sendmsg().  If the socket fills
+    up, the rest waits for EPOLLOUT and the client's requests wait
+    with it.  Once everything is out the buffers start over, and a
+    connection that was closing is closed.
+
+RETURN VALUE:
+    bool - false if the connection was closed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool QueryServer::flush( Shard& shard, Connection& connection )
+{
+    while ( connection.firstIovec < connection.iovecCount )
+    {
+        // writev() with MSG_NOSIGNAL, so a client that hung up is an
+        // EPIPE here and not a SIGPIPE for the whole process
+        struct msghdr message;
+
+        memset( &message, 0, sizeof( message ) );
+
+        message.msg_iov    = connection.iovecs + connection.firstIovec;
+        message.msg_iovlen = connection.iovecCount - connection.firstIovec;
+
+        ssize_t sent = sendmsg( connection.fileDescriptor, &message, MSG_NOSIGNAL );
+
+        if ( sent < 0 )
+        {
+            if ( EINTR == errno )
+            {
+                continue;
+            }
+
+            if ( EAGAIN != errno && EWOULDBLOCK != errno )
+            {
+                closeConnection( shard, connection );
+                return false;
+            }
+
+            if ( !connection.blocked )
+            {
+                struct epoll_event event;
+
+                memset( &event, 0, sizeof( event ) );
+
+                event.events   = EPOLLOUT;
+                event.data.u64 = ( uintptr_t ) &connection;
+
+                epoll_ctl( shard.epoll, EPOLL_CTL_MOD, connection.fileDescriptor, &event );
+
+                connection.blocked = true;
+            }
+
+            return true;
+        }
+
+        size_t remaining = ( size_t ) sent;
+
+        while ( 0 < remaining )
+        {
+            struct iovec& piece = connection.iovecs[ connection.firstIovec ];
+
+            if ( remaining < piece.iov_len )
+            {
+                piece.iov_base = ( char* ) piece.iov_base + remaining;
+                piece.iov_len -= remaining;
+                break;
+            }
+
+            remaining -= piece.iov_len;
+
+            ++connection.firstIovec;
+        }
+    }
+
+    connection.outLength  = 0;
+    connection.firstIovec = 0;
+    connection.iovecCount = 0;
+
+    if ( connection.pinsMetrics )
+    {
+        connection.pinsMetrics = false;
+        --shard.metricsPins;
+    }
+
+    if ( connection.closing )
+    {
+        closeConnection( shard, connection );
+        return false;
+    }
+
+    if ( connection.blocked )
+    {
+        struct epoll_event event;
+
+        memset( &event, 0, sizeof( event ) );
+
+        event.events   = EPOLLIN;
+        event.data.u64 = ( uintptr_t ) &connection;
+
+        epoll_ctl( shard.epoll, EPOLL_CTL_MOD, connection.fileDescriptor, &event );
+
+        connection.blocked = false;
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    closeConnection()
+
+DESCRIPTION:
+    Hangs up on a client and puts its connection back on the free
+    list
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::closeConnection( Shard& shard, Connection& connection )
+{
+    // Closing the descriptor takes it out of the epoll set too
+    close( connection.fileDescriptor );
+
+    connection.fileDescriptor = -1;
+
+    if ( connection.pinsMetrics )
+    {
+        connection.pinsMetrics = false;
+        --shard.metricsPins;
+    }
+
+    connection.nextFree = shard.freeConnections;
+
+    shard.freeConnections = &connection;
+
+    bump( shard.connectionCount, -1 );
+}
+
+/*======================================================================
+FUNCTION:
+    buildMetrics()
+
+DESCRIPTION:
+    Formats the shard's Prometheus text into its metrics buffer.
+    The buffer is sized for the sensor count up front; a line that
+    would not fit is left off rather than reallocating.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QueryServer::buildMetrics( Shard& shard )
+{
+    long long now = nowMicroseconds();
+
+    MetricsText out = { &shard.metrics[ 0 ], shard.metrics.size(), 0, 0 };
+
+    static const char* const gauges[][ 3 ] =
+    {
+        { "honeywell6130_temperature_celsius",       "gauge", "Latest temperature reading." },
+        { "honeywell6130_relative_humidity_percent", "gauge", "Latest relative humidity reading." },
+        { "honeywell6130_status",                    "gauge", "Status bits of the latest reading." },
+        { "honeywell6130_reading_age_seconds",       "gauge", "Time since the latest reading." },
+        { "honeywell6130_readings_total",            "counter", "Readings this shard has been offered." }
+    };
+
+    for ( size_t g = 0; g < sizeof( gauges ) / sizeof( gauges[ 0 ] ); ++g )
+    {
+        appendMetric( out, "# HELP %s %s\n", gauges[ g ][ 0 ], gauges[ g ][ 2 ] );
+        appendMetric( out, "# TYPE %s %s\n", gauges[ g ][ 0 ], gauges[ g ][ 1 ] );
+
+        for ( size_t s = 0; s < _sensorCount; ++s )
+        {
+            const Reading& reading = shard.latest[ s ];
+
+            if ( 4 == g )
+            {
+                appendMetric( out, "%s{sensor=\"%u\"} %llu\n", gauges[ g ][ 0 ], ( unsigned int ) s, shard.readingCounts[ s ] );
+                continue;
+            }
+
+            if ( reading.timeMicroseconds < 0 )
+            {
+                continue;
+            }
+
+            double value = reading.data.tempCelcius;
+
+            if ( 1 == g )
+            {
+                value = reading.data.relativeHumidity;
+            }
+            else if ( 2 == g )
+            {
+                value = reading.data.status;
+            }
+            else if ( 3 == g )
+            {
+                value = ( now - reading.timeMicroseconds ) / 1e6;
+            }
+
+            appendMetric( out, "%s{sensor=\"%u\"} %.3f\n", gauges[ g ][ 0 ], ( unsigned int ) s, value );
+        }
+    }
+
+    unsigned int index = ( unsigned int ) shard.index;
+
+    appendMetric( out, "# HELP honeywell6130_server_requests_total Requests answered by this shard.\n" );
+    appendMetric( out, "# TYPE honeywell6130_server_requests_total counter\n" );
+    appendMetric( out, "honeywell6130_server_requests_total{shard=\"%u\"} %llu\n", index,
+                  shard.requests.load( std::memory_order_relaxed ) );
+
+    appendMetric( out, "# HELP honeywell6130_server_connections Open client connections on this shard.\n" );
+    appendMetric( out, "# TYPE honeywell6130_server_connections gauge\n" );
+    appendMetric( out, "honeywell6130_server_connections{shard=\"%u\"} %llu\n", index,
+                  shard.connectionCount.load( std::memory_order_relaxed ) );
+
+    appendMetric( out, "# HELP honeywell6130_server_rejected_total Clients turned away with every connection in use.\n" );
+    appendMetric( out, "# TYPE honeywell6130_server_rejected_total counter\n" );
+    appendMetric( out, "honeywell6130_server_rejected_total{shard=\"%u\"} %llu\n", index,
+                  shard.rejected.load( std::memory_order_relaxed ) );
+
+    appendMetric( out, "# HELP honeywell6130_server_dropped_readings_total Readings lost to a full queue.\n" );
+    appendMetric( out, "# TYPE honeywell6130_server_dropped_readings_total counter\n" );
+    appendMetric( out, "honeywell6130_server_dropped_readings_total{shard=\"%u\"} %llu\n", index,
+                  shard.feed.DroppedCount() );
+
+    shard.metricsLength = out.length;
+    shard.metricsLines  = out.lines;
+    shard.metricsBuilt  = now;
+    shard.metricsStale  = false;
+}
+
+/*======================================================================
+FUNCTION:
+    nowMicroseconds()
+
+DESCRIPTION:
+    CLOCK_MONOTONIC in microseconds, the clock Offer() stamps with
+
+RETURN VALUE:
+    long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*======================================================================
+FUNCTION:
+    formatRow()
+
+DESCRIPTION:
+    Writes one LATEST/RANGE row, never more than ROW_BYTES
+
+RETURN VALUE:
+    size_t - bytes written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static size_t formatRow( char* row, size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    int length = snprintf( row, ROW_BYTES, "%u %lld %u %.2f %.2f %.2f\n",
+                           ( unsigned int ) sensor,
+                           timeMicroseconds,
+                           ( unsigned int ) data.status,
+                           data.tempCelcius,
+                           data.tempFahrenheit,
+                           data.relativeHumidity );
+
+    if ( length < 0 )
+    {
+        return 0;
+    }
+
+    if ( ( size_t ) length >= ROW_BYTES )
+    {
+        // Only a nonsense value gets here; keep the line a line
+        length = ROW_BYTES - 1;
+        row[ length - 1 ] = '\n';
+    }
+
+    return ( size_t ) length;
+}
+
+/*======================================================================
+FUNCTION:
+    parseNumber()
+
+DESCRIPTION:
+    Reads a decimal number and the spaces after it, moving text
+    along
+
+RETURN VALUE:
+    bool - true if there was a number
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool parseNumber( const char*& text, long long& value )
+{
+    char* end = 0;
+
+    errno = 0;
+
+    value = strtoll( text, &end, 10 );
+
+    if ( end == text || 0 != errno )
+    {
+        return false;
+    }
+
+    text = end;
+
+    while ( ' ' == *text )
+    {
+        ++text;
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    bump()
+
+DESCRIPTION:
+    Adds to a counter only its shard's thread writes, without the
+    locked add
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void bump( std::atomic< unsigned long long >& counter, long long amount )
+{
+    counter.store( counter.load( std::memory_order_relaxed ) + ( unsigned long long ) amount, std::memory_order_relaxed );
+}
+
+/*======================================================================
+FUNCTION:
+    appendMetric()
+
+DESCRIPTION:
+    Adds one formatted line to the metrics text, or nothing if the
+    whole line does not fit
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void appendMetric( MetricsText& text, const char* format, ... )
+{
+    size_t room = text.capacity - text.length;
+
+    va_list arguments;
+
+    va_start( arguments, format );
+
+    int written = vsnprintf( text.text + text.length, room, format, arguments );
+
+    va_end( arguments );
+
+    if ( 0 < written && ( size_t ) written < room )
+    {
+        text.length += ( size_t ) written;
+        ++text.lines;
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Per request the loop costs one read() and one gathering sendmsg(),
+plus a share of an epoll_wait() that usually reports many clients at
+once.  The
+read() that would only return EAGAIN is skipped when the last one did
+not fill the buffer, since level triggered epoll will report the
+socket again if more arrives.
+
+=====================================================================*/
@@ -0,0 +1,411 @@
+#ifndef _QUERYSERVER_H_
+#define _QUERYSERVER_H_
+
+/*======================================================================
+FILE:
+    queryserver.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Serves the latest readings, ranges of recent history and
+    Prometheus metrics over a Unix socket and TCP.
+
+DESCRIPTION:
+    This header defines an event driven query server.  Each shard
+    is one thread running an epoll loop over its listeners and
+    connections; with more than one shard the TCP port is bound
+    once per shard with SO_REUSEPORT and the kernel spreads the
+    clients across them.  The acquisition side hands readings in
+    with Offer(), which only pushes onto a lock-free queue, so a
+    slow or misbehaving client can never hold up a measurement.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    QueryServerOptions
+    QueryServer
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "samplehistory.h"
+#include "samplequeue.h"
+
+#include <atomic>
+#include <string>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// Where and how to listen.  Leave unixPath empty and/or set tcpPort
+// below zero to skip that listener; a tcpPort of 0 picks a free port.
+struct QueryServerOptions
+{
+    std::string unixPath;
+
+    std::string tcpAddress;
+
+    int tcpPort;
+
+    // Event loop threads
+    size_t shards;
+
+    // Open connections per shard.  Their buffers are allocated up
+    // front, so clients past this are turned away.
+    size_t maxConnections;
+
+    // Readings of history kept per sensor (in every shard)
+    size_t historyCapacity;
+
+    QueryServerOptions()
+    : tcpAddress( "127.0.0.1" ),
+      tcpPort( -1 ),
+      shards( 1 ),
+      maxConnections( 1024 ),
+      historyCapacity( 3600 ) { }
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Offer() can be called from any number of threads.  Everything else
+// belongs to the thread that owns the server.  Times are
+// CLOCK_MONOTONIC microseconds, the same clock SharedPublisher uses.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    QueryServer
+
+DESCRIPTION:
+    Answers line based requests:
+
+        LATEST [sensor]
+        LATEST FROM sensor
+        RANGE sensor from_us [to_us]
+        METRICS
+        QUIT
+
+    with "OK <lines>" (or "ERR <reason>") followed by that many
+    lines, and answers "GET /metrics" with an HTTP response so
+    Prometheus can scrape it directly.  Every shard keeps its own
+    copy of the latest readings and a SampleHistory per sensor,
+    fed from its own queue, so the shards never share anything but
+    the listeners.
+
+    Responses are formatted straight into buffers each connection
+    got at start up and go out with one gathering sendmsg() per
+    batch of requests.  A client that stops reading gets its output held
+    until the socket drains; until then its further requests are
+    left in the kernel.
+
+HOW TO USE:
+    1. Construct the object with the sensor count and the options
+       (the sockets are bound here)
+    2. Call Start()
+    3. Call Offer() with every fresh reading
+    4. Call Stop(), or just destroy it
+
+======================================================================*/
+class QueryServer
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Longest request line
+    static const size_t REQUEST_BYTES = 256;
+
+    // Rows in one RANGE or LATEST answer.  A longer range ends in
+    // "MORE <from_us>", and a LATEST over more sensors in
+    // "MORE <sensor>", to ask for the rest with.
+    static const size_t RANGE_ROWS = 128;
+
+    // Readings queued per shard between two trips round its loop
+    static const size_t FEED_CAPACITY = 4096;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if a listener can not be set up
+    QueryServer( size_t sensorCount, const QueryServerOptions& options );
+
+    virtual ~QueryServer();
+
+    void Start();
+
+    void Stop();
+
+    // Never blocks.  When a shard falls too far behind its oldest
+    // queued readings are dropped.
+    void Offer( size_t sensor, const TempHumidityData& data, long long timeMicroseconds );
+
+    // Same as Offer() stamped with the current CLOCK_MONOTONIC time
+    void Offer( size_t sensor, const TempHumidityData& data );
+
+    size_t SensorCount() const { return _sensorCount; }
+
+    // The bound TCP port, or -1 without a TCP listener
+    int TcpPort() const { return _tcpPort; }
+
+    const std::string& UnixPath() const { return _options.unixPath; }
+
+    unsigned long long RequestCount() const;
+
+    unsigned long long ConnectionCount() const;
+
+    // Clients turned away because their shard was full
+    unsigned long long RejectedCount() const;
+
+    // Readings a shard never saw because its queue overflowed
+    unsigned long long DroppedCount() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct Reading
+    {
+        size_t sensor;
+        long long timeMicroseconds;
+        TempHumidityData data;
+    };
+
+    // Pieces of pending output per connection
+    static const size_t MAX_IOVECS = 64;
+
+    struct Connection
+    {
+        int fileDescriptor;
+
+        // Answer, then hang up (HTTP and QUIT)
+        bool closing;
+
+        // Waiting for EPOLLOUT instead of EPOLLIN
+        bool blocked;
+
+        // Points into the shard's metrics text
+        bool pinsMetrics;
+
+        size_t inLength;
+        char* in;
+
+        size_t outLength;
+        char* out;
+
+        // Pending output, from firstIovec to iovecCount
+        size_t firstIovec;
+        size_t iovecCount;
+        struct iovec iovecs[ MAX_IOVECS ];
+
+        Connection* nextFree;
+    };
+
+    struct Shard
+    {
+        size_t index;
+
+        int epoll;
+        int wake;
+        int tcpListener;
+
+        std::thread thread;
+
+        SampleQueue< Reading > feed;
+
+        std::vector< Reading > latest;
+        std::vector< SampleHistory* > histories;
+        std::vector< unsigned long long > readingCounts;
+
+        std::vector< Connection > connections;
+        Connection* freeConnections;
+
+        // One slab for every connection's in and out buffers
+        char* buffers;
+
+        std::vector< char > metrics;
+        size_t metricsLength;
+        size_t metricsLines;
+        long long metricsBuilt;
+        bool metricsStale;
+        size_t metricsPins;
+
+        std::atomic< unsigned long long > requests;
+        std::atomic< unsigned long long > connectionCount;
+        std::atomic< unsigned long long > rejected;
+
+        Shard( size_t sensorCount, size_t historyCapacity );
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    QueryServer( const QueryServer &rhs );
+
+    void openUnixListener();
+
+    int openTcpListener( int port );
+
+    void setupShard( Shard& shard );
+
+    void teardownShard( Shard& shard );
+
+    void run( Shard& shard );
+
+    void drainFeed( Shard& shard );
+
+    void acceptClients( Shard& shard, int listener );
+
+    void serviceConnection( Shard& shard, Connection& connection );
+
+    bool readRequests( Shard& shard, Connection& connection );
+
+    void handleRequest( Shard& shard, Connection& connection, char* line );
+
+    void answerLatest( Shard& shard, Connection& connection, const char* arguments );
+
+    void answerRange( Shard& shard, Connection& connection, const char* arguments );
+
+    void answerMetrics( Shard& shard, Connection& connection, bool http );
+
+    void answerError( Connection& connection, const char* reason );
+
+    void queueOutput( Connection& connection, const char* text, size_t length );
+
+    bool flush( Shard& shard, Connection& connection );
+
+    void closeConnection( Shard& shard, Connection& connection );
+
+    void buildMetrics( Shard& shard );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    size_t _sensorCount;
+
+    QueryServerOptions _options;
+
+    int _unixListener;
+
+    int _tcpPort;
+
+    size_t _outBytes;
+
+    std::vector< Shard* > _shards;
+
+    bool _running;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+A LATEST or RANGE row is
+
+    <sensor> <time_us> <status> <celcius> <fahrenheit> <humidity>
+
+The readings are kept in each shard as their sensor frames, so a RANGE
+answer decodes to the same values the sensor produced; the history's
+time stamps are rounded down to SampleHistory's 10ms tick.
+
+LATEST over the whole fleet pages the same way RANGE does: past
+RANGE_ROWS sensors the header reads "OK <lines> MORE <sensor>" and
+"LATEST FROM <sensor>" picks up there.  That keeps every answer, and
+so each connection's output buffer, the same size whether the fleet
+has eight sensors or four thousand.
+
+The Unix listener is one socket that every shard waits on with
+EPOLLEXCLUSIVE, so a new client wakes one shard rather than all of
+them.  The TCP listeners are separate SO_REUSEPORT sockets, which also
+spreads the accept() work.
+
+======================================================================*/
+
+#endif	// #ifendif _QUERYSERVER_H_
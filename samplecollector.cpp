@@ -0,0 +1,1383 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    samplecollector.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to take readings from many producers and merge them
+    into one stream in time order
+
+GENERAL DESCRIPTION:
+    This file implements the listeners, the producers' buffers, the
+    merge and the producers' side of the connection
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SampleCollector
+    ConnectUnixCollector
+    ConnectTcpCollector
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "samplecollector.h"
+#include "samplesink.h"
+#include "framedecoder.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// epoll tags for the descriptors that are not producers
+static const uint64_t TAG_WAKE = 0;
+static const uint64_t TAG_UNIX = 1;
+static const uint64_t TAG_TCP  = 2;
+
+static const int MAX_EVENTS = 64;
+
+// Where a producer's ring starts before it grows
+static const size_t FIRST_RING_RECORDS = 64;
+
+// A producer's socket send buffer.  Unix sockets queue against the
+// sender's buffer and ignore the collector's receive buffer, so this
+// is what makes a paused producer's write() block there.
+static const int PRODUCER_SEND_BYTES = 16 * 1024;
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long recordTime( const unsigned char* record );
+
+static void bump( std::atomic< unsigned long long >& counter, unsigned long long amount );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SampleCollector()
+
+DESCRIPTION:
+    This c-tor binds the listeners and sets up the epoll set.
+    Nothing is accepted until Run().
+
+    Throws a SensorException if a socket can not be set up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleCollector::SampleCollector( const CollectorOptions& options )
+: _options( options ),
+  _unixListener( -1 ),
+  _tcpListener( -1 ),
+  _tcpPort( -1 ),
+  _epoll( -1 ),
+  _wake( -1 ),
+  _limit( 2 * READ_RECORDS ),
+  _drainTo( 0 ),
+  _heapStale( false ),
+  _pausedCount( 0 ),
+  _closedCount( 0 ),
+  _held( 0 ),
+  _nextSensor( 0 ),
+  _newestMicroseconds( LLONG_MIN / 2 ),
+  _releasedMicroseconds( LLONG_MIN ),
+  _input( READ_RECORDS * BinarySink::RECORD_BYTES + BinarySink::HEADER_BYTES + BinarySink::RECORD_BYTES ),
+  _producerCount( 0 ),
+  _openProducers( 0 ),
+  _rejected( 0 ),
+  _merged( 0 ),
+  _late( 0 ),
+  _paused( 0 ),
+  _forced( 0 ),
+  _bad( 0 ),
+  _peakHeld( 0 )
+{
+    while ( _limit < _options.producerRecords )
+    {
+        _limit *= 2;
+    }
+
+    // A paused producer has room for a whole read again afterwards
+    _drainTo = _limit - READ_RECORDS;
+
+    _batch.reserve( BATCH );
+
+    try
+    {
+        _epoll = epoll_create1( EPOLL_CLOEXEC );
+        _wake  = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+        if ( _epoll < 0 || _wake < 0 )
+        {
+            throw SensorException( "Failed to create the collector's epoll set" );
+        }
+
+        if ( !_options.unixPath.empty() )
+        {
+            openUnixListener();
+        }
+
+        if ( 0 <= _options.tcpPort )
+        {
+            openTcpListener();
+        }
+
+        struct epoll_event event;
+
+        memset( &event, 0, sizeof( event ) );
+
+        event.events   = EPOLLIN;
+        event.data.u64 = TAG_WAKE;
+
+        bool ok = ( 0 == epoll_ctl( _epoll, EPOLL_CTL_ADD, _wake, &event ) );
+
+        if ( ok && 0 <= _unixListener )
+        {
+            event.data.u64 = TAG_UNIX;
+
+            ok = ( 0 == epoll_ctl( _epoll, EPOLL_CTL_ADD, _unixListener, &event ) );
+        }
+
+        if ( ok && 0 <= _tcpListener )
+        {
+            event.data.u64 = TAG_TCP;
+
+            ok = ( 0 == epoll_ctl( _epoll, EPOLL_CTL_ADD, _tcpListener, &event ) );
+        }
+
+        if ( !ok )
+        {
+            throw SensorException( "Failed to add the listeners to the collector's epoll set" );
+        }
+    }
+    catch( SensorException& )
+    {
+        if ( 0 <= _unixListener )
+        {
+            close( _unixListener );
+            unlink( _options.unixPath.c_str() );
+        }
+
+        if ( 0 <= _tcpListener )
+        {
+            close( _tcpListener );
+        }
+
+        if ( 0 <= _wake )
+        {
+            close( _wake );
+        }
+
+        if ( 0 <= _epoll )
+        {
+            close( _epoll );
+        }
+
+        throw;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SampleCollector()
+
+DESCRIPTION:
+    This destructor hangs up on every producer, throws away what
+    they left and removes the Unix socket
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleCollector::~SampleCollector()
+{
+    for ( size_t p = 0; p < _producers.size(); ++p )
+    {
+        if ( 0 <= _producers[ p ]->fileDescriptor )
+        {
+            close( _producers[ p ]->fileDescriptor );
+        }
+
+        delete _producers[ p ];
+    }
+
+    if ( 0 <= _unixListener )
+    {
+        close( _unixListener );
+    }
+
+    if ( !_options.unixPath.empty() )
+    {
+        unlink( _options.unixPath.c_str() );
+    }
+
+    if ( 0 <= _tcpListener )
+    {
+        close( _tcpListener );
+    }
+
+    close( _wake );
+    close( _epoll );
+}
+
+/*======================================================================
+FUNCTION:
+    Run()
+
+DESCRIPTION:
+    The event loop.  Each pass reads what the producers that are
+    ready have sent, then writes out whatever the window lets go.
+    When there is something held it waits at most a window for
+    more, and writes it all out if nothing came.  After Stop() it
+    runs until every producer has hung up, or a window passes with
+    none of them sending anything and none of them paused.
+
+RETURN VALUE:
+    unsigned long long - the readings handed over
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SampleCollector::Run( SensorFleet::SampleHandler handler, SensorHandler sensorHandler )
+{
+    _handler       = handler;
+    _sensorHandler = sensorHandler;
+
+    unsigned long long before = _merged.load( std::memory_order_relaxed );
+
+    long long windowMilliseconds = _options.reorderMicroseconds / 1000 + 1;
+
+    int timeout = ( int ) std::min( windowMilliseconds, ( long long ) INT_MAX );
+
+    bool stopping = false;
+
+    struct epoll_event events[ MAX_EVENTS ];
+
+    for ( ;; )
+    {
+        int ready = epoll_wait( _epoll, events, MAX_EVENTS, ( 0 < _held || stopping ) ? timeout : -1 );
+
+        if ( ready < 0 )
+        {
+            if ( EINTR == errno )
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if ( 0 == ready )
+        {
+            // A window of quiet.  A paused producer was quiet only
+            // because it was not being read, so once writing
+            // everything out resumes it, it gets another window.
+            bool resuming = ( 0 < _pausedCount );
+
+            release( true );
+
+            for ( size_t p = 0; stopping && !resuming && p < _producers.size(); ++p )
+            {
+                if ( !_producers[ p ]->closed )
+                {
+                    closeProducer( *_producers[ p ] );
+                }
+            }
+        }
+
+        for ( int e = 0; e < ready; ++e )
+        {
+            uint64_t tag = events[ e ].data.u64;
+
+            if ( TAG_WAKE == tag )
+            {
+                uint64_t value;
+
+                ssize_t ignored = read( _wake, &value, sizeof( value ) );
+
+                ( void ) ignored;
+
+                if ( stopping )
+                {
+                    continue;
+                }
+
+                stopping = true;
+
+                // Whoever connected before Stop() is still served
+                if ( 0 <= _unixListener )
+                {
+                    acceptProducers( _unixListener );
+                    epoll_ctl( _epoll, EPOLL_CTL_DEL, _unixListener, 0 );
+                    close( _unixListener );
+                    _unixListener = -1;
+                }
+
+                if ( 0 <= _tcpListener )
+                {
+                    acceptProducers( _tcpListener );
+                    epoll_ctl( _epoll, EPOLL_CTL_DEL, _tcpListener, 0 );
+                    close( _tcpListener );
+                    _tcpListener = -1;
+                }
+            }
+            else if ( TAG_UNIX == tag )
+            {
+                acceptProducers( _unixListener );
+            }
+            else if ( TAG_TCP == tag )
+            {
+                acceptProducers( _tcpListener );
+            }
+            else
+            {
+                readProducer( *( Producer* ) ( uintptr_t ) tag );
+            }
+        }
+
+        release( false );
+
+        if ( stopping && 0 == _openProducers.load( std::memory_order_relaxed ) )
+        {
+            release( true );
+            freeClosedProducers();
+            break;
+        }
+
+        freeClosedProducers();
+    }
+
+    _handler       = SensorFleet::SampleHandler();
+    _sensorHandler = SensorHandler();
+
+    return _merged.load( std::memory_order_relaxed ) - before;
+}
+
+/*======================================================================
+FUNCTION:
+    Stop()
+
+DESCRIPTION:
+    This method wakes Run() through the eventfd
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::Stop()
+{
+    uint64_t one = 1;
+
+    ssize_t ignored = write( _wake, &one, sizeof( one ) );
+
+    ( void ) ignored;
+}
+
+/*======================================================================
+FUNCTION:
+    openUnixListener()
+
+DESCRIPTION:
+    Binds the Unix socket, replacing a socket file left by an
+    earlier run
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::openUnixListener()
+{
+    struct sockaddr_un address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sun_family = AF_UNIX;
+
+    if ( _options.unixPath.size() >= sizeof( address.sun_path ) )
+    {
+        throw SensorException( "Unix socket path is too long: " + _options.unixPath );
+    }
+
+    strcpy( address.sun_path, _options.unixPath.c_str() );
+
+    _unixListener = socket( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( _unixListener < 0 )
+    {
+        throw SensorException( "Failed to create the Unix socket" );
+    }
+
+    unlink( address.sun_path );
+
+    if ( 0 != bind( _unixListener, ( struct sockaddr* ) &address, sizeof( address ) ) ||
+         0 != listen( _unixListener, SOMAXCONN ) )
+    {
+        close( _unixListener );
+        _unixListener = -1;
+
+        throw SensorException( "Failed to listen on " + _options.unixPath );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    openTcpListener()
+
+DESCRIPTION:
+    Binds the TCP socket; port 0 picks a free one
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::openTcpListener()
+{
+    struct sockaddr_in address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sin_family = AF_INET;
+    address.sin_port   = htons( ( uint16_t ) _options.tcpPort );
+
+    if ( 1 != inet_pton( AF_INET, _options.tcpAddress.c_str(), &address.sin_addr ) )
+    {
+        throw SensorException( "Not an IPv4 address: " + _options.tcpAddress );
+    }
+
+    _tcpListener = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+
+    if ( _tcpListener < 0 )
+    {
+        throw SensorException( "Failed to create a TCP socket" );
+    }
+
+    int on = 1;
+
+    setsockopt( _tcpListener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+
+    if ( 0 != bind( _tcpListener, ( struct sockaddr* ) &address, sizeof( address ) ) ||
+         0 != listen( _tcpListener, SOMAXCONN ) )
+    {
+        close( _tcpListener );
+        _tcpListener = -1;
+
+        char text[ 32 ];
+
+        snprintf( text, sizeof( text ), ":%d", _options.tcpPort );
+
+        throw SensorException( "Failed to listen on " + _options.tcpAddress + text );
+    }
+
+    socklen_t length = sizeof( address );
+
+    getsockname( _tcpListener, ( struct sockaddr* ) &address, &length );
+
+    _tcpPort = ntohs( address.sin_port );
+}
+
+/*======================================================================
+FUNCTION:
+    acceptProducers()
+
+DESCRIPTION:
+    Accepts every waiting producer and names it by its pid (Unix) or
+    its address (TCP).  Producers past maxProducers are hung up on.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::acceptProducers( int listener )
+{
+    for ( ;; )
+    {
+        int client = accept4( listener, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+        if ( client < 0 )
+        {
+            return;
+        }
+
+        if ( _options.maxProducers <= _openProducers.load( std::memory_order_relaxed ) )
+        {
+            close( client );
+            bump( _rejected, 1 );
+            continue;
+        }
+
+        char name[ 64 ] = "";
+
+        if ( listener == _unixListener )
+        {
+            struct ucred credentials;
+
+            socklen_t length = sizeof( credentials );
+
+            if ( 0 == getsockopt( client, SOL_SOCKET, SO_PEERCRED, &credentials, &length ) )
+            {
+                snprintf( name, sizeof( name ), "pid %d", ( int ) credentials.pid );
+            }
+        }
+        else
+        {
+            struct sockaddr_in address;
+
+            socklen_t length = sizeof( address );
+
+            char text[ INET_ADDRSTRLEN ] = "";
+
+            if ( 0 == getpeername( client, ( struct sockaddr* ) &address, &length ) &&
+                 0 != inet_ntop( AF_INET, &address.sin_addr, text, sizeof( text ) ) )
+            {
+                snprintf( name, sizeof( name ), "%s:%u", text, ( unsigned int ) ntohs( address.sin_port ) );
+            }
+        }
+
+        // Only about a window's worth may wait in the kernel, so a
+        // paused producer's write() blocks instead of filling
+        // megabytes of socket buffer that would all come out late
+        int receiveBytes = ( int ) ( _limit * BinarySink::RECORD_BYTES );
+
+        setsockopt( client, SOL_SOCKET, SO_RCVBUF, &receiveBytes, sizeof( receiveBytes ) );
+
+        Producer* producer = new Producer;
+
+        producer->fileDescriptor = client;
+        producer->name           = name;
+        producer->headerLength   = 0;
+        producer->partialLength  = 0;
+        producer->head           = 0;
+        producer->count          = 0;
+        producer->paused         = false;
+        producer->closed         = false;
+
+        struct epoll_event event;
+
+        memset( &event, 0, sizeof( event ) );
+
+        event.events   = EPOLLIN;
+        event.data.u64 = ( uintptr_t ) producer;
+
+        if ( 0 != epoll_ctl( _epoll, EPOLL_CTL_ADD, client, &event ) )
+        {
+            close( client );
+            delete producer;
+            continue;
+        }
+
+        _producers.push_back( producer );
+
+        _openProducers.fetch_add( 1, std::memory_order_relaxed );
+
+        bump( _producerCount, 1 );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    readProducer()
+
+DESCRIPTION:
+    Reads at most READ_RECORDS readings from a producer, never more
+    than its ring has room for, and adds each one.  A record cut off
+    by the read waits for the rest; anything that is not a BinarySink
+    stream is hung up on.  More than one read's worth is left to the
+    next pass round the loop (epoll is level triggered), so the
+    other producers get their turn first.  A producer whose ring is
+    full is paused.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::readProducer( Producer& producer )
+{
+    if ( producer.closed )
+    {
+        return;
+    }
+
+    size_t room = std::min( ( size_t ) READ_RECORDS, _limit - producer.count );
+
+    if ( 0 == room )
+    {
+        return;
+    }
+
+    size_t want = room * BinarySink::RECORD_BYTES + ( BinarySink::HEADER_BYTES - producer.headerLength ) - producer.partialLength;
+
+    unsigned char* input = _input.data();
+
+    memcpy( input, producer.partial, producer.partialLength );
+
+    ssize_t got = read( producer.fileDescriptor, input + producer.partialLength, want );
+
+    if ( got <= 0 )
+    {
+        if ( 0 == got || ( EAGAIN != errno && EINTR != errno ) )
+        {
+            closeProducer( producer );
+        }
+
+        return;
+    }
+
+    size_t length = producer.partialLength + ( size_t ) got;
+    size_t offset = 0;
+
+    if ( producer.headerLength < BinarySink::HEADER_BYTES )
+    {
+        offset = std::min( BinarySink::HEADER_BYTES - producer.headerLength, length );
+
+        memcpy( producer.header + producer.headerLength, input, offset );
+
+        producer.headerLength += offset;
+
+        if ( BinarySink::HEADER_BYTES == producer.headerLength && !BinarySink::ValidHeader( producer.header ) )
+        {
+            bump( _rejected, 1 );
+            closeProducer( producer );
+            return;
+        }
+    }
+
+    for ( ; offset + BinarySink::RECORD_BYTES <= length; offset += BinarySink::RECORD_BYTES )
+    {
+        addRecord( producer, input + offset );
+    }
+
+    producer.partialLength = length - offset;
+
+    memcpy( producer.partial, input + offset, producer.partialLength );
+
+    if ( _limit == producer.count )
+    {
+        pauseProducer( producer );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    addRecord()
+
+DESCRIPTION:
+    Checks a record, gives its sensor a merged index the first time
+    it is seen and puts it in its producer's ring in time order.
+    Nearly every reading is the newest and just goes on the end; one
+    a little out of order is moved back past the later ones.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::addRecord( Producer& producer, const unsigned char* record )
+{
+    if ( BinarySink::SYNC != record[ 0 ] )
+    {
+        bump( _bad, 1 );
+        return;
+    }
+
+    size_t own = ( size_t ) record[ 2 ] | ( ( size_t ) record[ 3 ] << 8 );
+
+    if ( producer.sensors.size() <= own )
+    {
+        producer.sensors.resize( own + 1, -1 );
+    }
+
+    if ( producer.sensors[ own ] < 0 )
+    {
+        if ( _options.maxSensors <= _nextSensor )
+        {
+            bump( _bad, 1 );
+            return;
+        }
+
+        producer.sensors[ own ] = ( int32_t ) _nextSensor++;
+
+        if ( _sensorHandler )
+        {
+            _sensorHandler( ( size_t ) producer.sensors[ own ], producer.name, own );
+        }
+    }
+
+    long long time = recordTime( record );
+
+    if ( time < _releasedMicroseconds )
+    {
+        bump( _late, 1 );
+        return;
+    }
+
+    if ( _newestMicroseconds < time )
+    {
+        _newestMicroseconds = time;
+    }
+
+    if ( producer.ring.size() == producer.count )
+    {
+        std::vector< Record > ring( std::max( FIRST_RING_RECORDS, 2 * producer.ring.size() ) );
+
+        for ( size_t r = 0; r < producer.count; ++r )
+        {
+            ring[ r ] = producer.ring[ ( producer.head + r ) & ( producer.ring.size() - 1 ) ];
+        }
+
+        producer.ring.swap( ring );
+        producer.head = 0;
+    }
+
+    size_t mask     = producer.ring.size() - 1;
+    size_t position = producer.count;
+
+    while ( 0 < position && time < producer.ring[ ( producer.head + position - 1 ) & mask ].timeMicroseconds )
+    {
+        producer.ring[ ( producer.head + position ) & mask ] = producer.ring[ ( producer.head + position - 1 ) & mask ];
+        --position;
+    }
+
+    Record& held = producer.ring[ ( producer.head + position ) & mask ];
+
+    held.timeMicroseconds = time;
+    held.sensor           = ( uint32_t ) producer.sensors[ own ];
+
+    memcpy( held.frame, record + 4, Honeywell6130Sensor::FRAME_SIZE );
+
+    ++producer.count;
+
+    if ( 1 == producer.count )
+    {
+        _heap.push_back( &producer );
+
+        if ( !_heapStale )
+        {
+            std::push_heap( _heap.begin(), _heap.end(), newerHead );
+        }
+    }
+    else if ( 0 == position )
+    {
+        _heapStale = true;
+    }
+
+    if ( _peakHeld.load( std::memory_order_relaxed ) < ++_held )
+    {
+        _peakHeld.store( _held, std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    closeProducer()
+
+DESCRIPTION:
+    Hangs up on a producer.  What it sent is still merged; the
+    producer itself goes once that is written out.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::closeProducer( Producer& producer )
+{
+    if ( producer.paused )
+    {
+        producer.paused = false;
+        --_pausedCount;
+    }
+    else
+    {
+        epoll_ctl( _epoll, EPOLL_CTL_DEL, producer.fileDescriptor, 0 );
+    }
+
+    close( producer.fileDescriptor );
+
+    producer.fileDescriptor = -1;
+    producer.closed         = true;
+
+    ++_closedCount;
+
+    _openProducers.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+/*======================================================================
+FUNCTION:
+    pauseProducer()
+
+DESCRIPTION:
+    Stops reading a producer whose ring is full by taking it out of
+    the epoll set, so what it sends backs up in the socket and its
+    writes wait.  It is taken out rather than left in with no events
+    asked for, since epoll reports a hang up or an error whatever
+    is asked for, and a producer that is not read would then wake
+    every pass.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::pauseProducer( Producer& producer )
+{
+    if ( producer.paused || producer.closed )
+    {
+        return;
+    }
+
+    epoll_ctl( _epoll, EPOLL_CTL_DEL, producer.fileDescriptor, 0 );
+
+    producer.paused = true;
+
+    ++_pausedCount;
+
+    bump( _paused, 1 );
+}
+
+/*======================================================================
+FUNCTION:
+    resumeProducer()
+
+DESCRIPTION:
+    Puts a paused producer back in the epoll set.  If it can not go
+    back it is hung up on, since it would never be read again.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::resumeProducer( Producer& producer )
+{
+    if ( !producer.paused )
+    {
+        return;
+    }
+
+    producer.paused = false;
+
+    --_pausedCount;
+
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( event ) );
+
+    event.events   = EPOLLIN;
+    event.data.u64 = ( uintptr_t ) &producer;
+
+    if ( 0 != epoll_ctl( _epoll, EPOLL_CTL_ADD, producer.fileDescriptor, &event ) )
+    {
+        producer.paused = true;
+        ++_pausedCount;
+
+        closeProducer( producer );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    release()
+
+DESCRIPTION:
+    Writes out the oldest held readings, in time order, while they
+    are older than the newest one seen by more than the window, or
+    all of them if everything is set.  Paused producers that drain
+    to drainTo are resumed.  As a last resort, while every open
+    producer is paused, readings are written before their window is
+    up (forced) until one of them can be resumed.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::release( bool everything )
+{
+    if ( _heapStale )
+    {
+        std::make_heap( _heap.begin(), _heap.end(), newerHead );
+        _heapStale = false;
+    }
+
+    long long watermark = _newestMicroseconds - _options.reorderMicroseconds;
+
+    while ( !_heap.empty() )
+    {
+        Producer* producer = _heap.front();
+
+        const Record& oldest = producer->ring[ producer->head ];
+
+        bool due = everything || oldest.timeMicroseconds <= watermark;
+
+        // Nothing more can be read to move the watermark on
+        bool stalled = 0 < _pausedCount && _openProducers.load( std::memory_order_relaxed ) == _pausedCount;
+
+        if ( !due && !stalled )
+        {
+            break;
+        }
+
+        std::pop_heap( _heap.begin(), _heap.end(), newerHead );
+        _heap.pop_back();
+
+        _batch.push_back( oldest );
+
+        _releasedMicroseconds = oldest.timeMicroseconds;
+
+        producer->head = ( producer->head + 1 ) & ( producer->ring.size() - 1 );
+
+        --producer->count;
+        --_held;
+
+        if ( !due )
+        {
+            bump( _forced, 1 );
+        }
+
+        if ( producer->paused && producer->count <= _drainTo )
+        {
+            resumeProducer( *producer );
+        }
+
+        if ( 0 < producer->count )
+        {
+            _heap.push_back( producer );
+            std::push_heap( _heap.begin(), _heap.end(), newerHead );
+        }
+
+        if ( BATCH == _batch.size() )
+        {
+            deliver();
+        }
+    }
+
+    deliver();
+}
+
+/*======================================================================
+FUNCTION:
+    deliver()
+
+DESCRIPTION:
+    Decodes the batch with DecodeFrames() and hands the readings to
+    the handler
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::deliver()
+{
+    size_t count = _batch.size();
+
+    if ( 0 == count )
+    {
+        return;
+    }
+
+    unsigned char frames[ BATCH * Honeywell6130Sensor::FRAME_SIZE ];
+
+    unsigned char status[ BATCH ];
+    float tempCelcius[ BATCH ];
+    float tempFahrenheit[ BATCH ];
+    float relativeHumidity[ BATCH ];
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        memcpy( frames + i * Honeywell6130Sensor::FRAME_SIZE, _batch[ i ].frame, Honeywell6130Sensor::FRAME_SIZE );
+    }
+
+    DecodeFrames( frames, count, status, tempCelcius, tempFahrenheit, relativeHumidity );
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        FleetSample sample;
+
+        sample.sensorIndex           = _batch[ i ].sensor;
+        sample.timeMicroseconds      = _batch[ i ].timeMicroseconds;
+        sample.data.status           = status[ i ];
+        sample.data.tempCelcius      = tempCelcius[ i ];
+        sample.data.tempFahrenheit   = tempFahrenheit[ i ];
+        sample.data.relativeHumidity = relativeHumidity[ i ];
+
+        _handler( sample );
+    }
+
+    _batch.clear();
+
+    bump( _merged, count );
+}
+
+/*======================================================================
+FUNCTION:
+    freeClosedProducers()
+
+DESCRIPTION:
+    Frees the producers that have hung up and have nothing held.
+    Done after a pass, never during one, since the pass's events can
+    still point at them.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleCollector::freeClosedProducers()
+{
+    if ( 0 == _closedCount )
+    {
+        return;
+    }
+
+    size_t kept = 0;
+
+    for ( size_t p = 0; p < _producers.size(); ++p )
+    {
+        Producer* producer = _producers[ p ];
+
+        if ( producer->closed && 0 == producer->count )
+        {
+            delete producer;
+            --_closedCount;
+            continue;
+        }
+
+        _producers[ kept++ ] = producer;
+    }
+
+    _producers.resize( kept );
+}
+
+/*======================================================================
+FUNCTION:
+    newerHead()
+
+DESCRIPTION:
+    The heap's ordering, which puts the oldest reading at the front
+
+RETURN VALUE:
+    bool - true if left's oldest reading is newer than right's
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SampleCollector::newerHead( const Producer* left, const Producer* right )
+{
+    return left->ring[ left->head ].timeMicroseconds > right->ring[ right->head ].timeMicroseconds;
+}
+
+/*======================================================================
+FUNCTION:
+    ConnectUnixCollector()
+
+DESCRIPTION:
+    Connects to a collector's Unix socket, with a small send buffer
+    so that a paused producer blocks instead of queueing
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    int - the connected socket, blocking
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int ConnectUnixCollector( const std::string& path )
+{
+    struct sockaddr_un address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sun_family = AF_UNIX;
+
+    if ( path.size() >= sizeof( address.sun_path ) )
+    {
+        throw SensorException( "Unix socket path is too long: " + path );
+    }
+
+    strcpy( address.sun_path, path.c_str() );
+
+    int producer = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( producer < 0 || 0 != connect( producer, ( struct sockaddr* ) &address, sizeof( address ) ) )
+    {
+        if ( 0 <= producer )
+        {
+            close( producer );
+        }
+
+        throw SensorException( "Failed to connect to the collector at " + path );
+    }
+
+    setsockopt( producer, SOL_SOCKET, SO_SNDBUF, &PRODUCER_SEND_BYTES, sizeof( PRODUCER_SEND_BYTES ) );
+
+    return producer;
+}
+
+/*======================================================================
+FUNCTION:
+    ConnectTcpCollector()
+
+DESCRIPTION:
+    Connects to a collector's TCP port, with Nagle off so a reading
+    a second is not held back waiting for an ACK, and a small send
+    buffer so that a paused producer blocks instead of queueing
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    int - the connected socket, blocking
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+int ConnectTcpCollector( const std::string& address, int port )
+{
+    struct sockaddr_in collector;
+
+    memset( &collector, 0, sizeof( collector ) );
+
+    collector.sin_family = AF_INET;
+    collector.sin_port   = htons( ( uint16_t ) port );
+
+    if ( 1 != inet_pton( AF_INET, address.c_str(), &collector.sin_addr ) )
+    {
+        throw SensorException( "Not an IPv4 address: " + address );
+    }
+
+    int producer = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( producer < 0 || 0 != connect( producer, ( struct sockaddr* ) &collector, sizeof( collector ) ) )
+    {
+        if ( 0 <= producer )
+        {
+            close( producer );
+        }
+
+        char text[ 32 ];
+
+        snprintf( text, sizeof( text ), ":%d", port );
+
+        throw SensorException( "Failed to connect to the collector at " + address + text );
+    }
+
+    int on = 1;
+
+    setsockopt( producer, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+
+    setsockopt( producer, SOL_SOCKET, SO_SNDBUF, &PRODUCER_SEND_BYTES, sizeof( PRODUCER_SEND_BYTES ) );
+
+    return producer;
+}
+
+/*======================================================================
+FUNCTION:
+    recordTime()
+
+DESCRIPTION:
+    Reads a record's little endian time, the way BinarySink wrote it
+
+RETURN VALUE:
+    long long - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long recordTime( const unsigned char* record )
+{
+    unsigned long long time = 0;
+
+    for ( size_t b = 0; b < 8; ++b )
+    {
+        time |= ( unsigned long long ) record[ 8 + b ] << ( 8 * b );
+    }
+
+    return ( long long ) time;
+}
+
+/*======================================================================
+FUNCTION:
+    bump()
+
+DESCRIPTION:
+    Adds to a counter only this thread writes, without a locked
+    instruction
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void bump( std::atomic< unsigned long long >& counter, unsigned long long amount )
+{
+    counter.store( counter.load( std::memory_order_relaxed ) + amount, std::memory_order_relaxed );
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Why a buffer per producer and a heap over them, rather than one heap
+of every reading: each producer's readings already come in time order,
+so its buffer is a queue that only grows at the end, and the heap only
+has to order the producers' oldest readings.  Writing a reading out is
+then a pop and a push on a heap of producers (about ten levels for
+hundreds of them) however many readings are held.
+
+Late readings are dropped rather than written out of order because
+everything downstream (the rollups' windows, SampleLog's appends, a
+reader of the binary stream) expects time to only go forward.
+
+Backpressure: a read takes no more than the producer's ring has room
+for, and the loop goes on to the next producer, so a fast producer can
+not starve the rest or make the collector hold more than producerRecords
+of its readings.  Once its ring is full the producer is paused, out of
+the epoll set, until the window has let enough of it go to make room
+for a whole read again.  Meanwhile its socket buffer fills and its
+writes wait, so it is held back to the pace of the window.  Writing its
+readings out early instead would push the watermark past everyone
+else, and make their readings late.  The handler holds every producer
+back the same way: while it blocks (ws's queue with --overflow=block, a
+slow disk) nothing is read.
+
+Forcing is the last resort, for when every open producer is paused.
+Nothing can then arrive to move the watermark on, and the collector
+would otherwise sit out a window of quiet with every buffer full.  It
+only goes on until one producer has drained enough to be read again.
+A lone producer writing flat out is the usual case; it is forced along
+a read at a time.
+
+=====================================================================*/
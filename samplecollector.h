@@ -0,0 +1,473 @@
+#ifndef _SAMPLECOLLECTOR_H_
+#define _SAMPLECOLLECTOR_H_
+
+/*======================================================================
+FILE:
+    samplecollector.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Merges the readings of many ws processes, on this board or on
+    others, into one stream in time order.
+
+DESCRIPTION:
+    This header defines the collector and the calls a producer
+    connects to it with.  A producer is any process writing the
+    BinarySink format (ws --send does) to the collector's Unix or
+    TCP socket.  The collector keeps each producer's readings in a
+    short sorted buffer and merges the buffers by time, holding
+    readings back by a bounded reorder window so a producer that is
+    a little behind still lands in order.  Everything is bounded:
+    producers are read no faster than the merged stream is handed
+    on, so the kernel pushes back on them when it can not keep up;
+    a producer whose buffer fills is not read until it drains, so
+    its socket fills and its writes wait; and a producer that falls
+    further behind than the window loses the readings that come too
+    late.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    CollectorOptions
+    SampleCollector
+    ConnectUnixCollector
+    ConnectTcpCollector
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorfleet.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// Where to listen and how much to hold.  Leave unixPath empty and/or
+// set tcpPort below zero to skip that listener; a tcpPort of 0 picks
+// a free port.
+struct CollectorOptions
+{
+    std::string unixPath;
+
+    std::string tcpAddress;
+
+    int tcpPort;
+
+    // How long a reading is held for ones older than it that are
+    // still on their way, in the readings' own time
+    long long reorderMicroseconds;
+
+    // Readings held per producer at most (rounded up to a power of
+    // two); it should cover a producer's readings over the window
+    size_t producerRecords;
+
+    // Open connections at once; producers past this are turned away
+    size_t maxProducers;
+
+    // Sensors in the merged stream.  Every producer's sensor gets
+    // the next free index the first time it is seen; readings for
+    // sensors past this are counted as bad records.  Whatever the
+    // merged stream feeds is usually sized for this many up front,
+    // so raise it for a large fleet rather than leaving it large.
+    size_t maxSensors;
+
+    CollectorOptions()
+    : tcpAddress( "127.0.0.1" ),
+      tcpPort( -1 ),
+      reorderMicroseconds( 2000000 ),
+      producerRecords( 4096 ),
+      maxProducers( 1024 ),
+      maxSensors( 64 ) { }
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Run() calls both handlers on the calling thread, one reading at a
+// time in time order.  Stop() and the counts are safe from any
+// thread; nothing else is.
+//
+// The window is in the producers' time stamps, which ws takes from
+// the wall clock.  Keep the boards on NTP: a producer whose clock runs
+// ahead by more than the window makes everyone else's readings late.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// Connect a producer to a collector's Unix socket, or to its TCP
+// port.  Write a BinarySink stream to the descriptor they return;
+// its send buffer is kept small, so a write() to a collector that has
+// paused us blocks.  Throw a SensorException if the collector is not
+// there.
+int ConnectUnixCollector( const std::string& path );
+
+int ConnectTcpCollector( const std::string& address, int port );
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SampleCollector
+
+DESCRIPTION:
+    One thread and one epoll set serve every producer.  Each read
+    takes at most READ_RECORDS readings from a producer, so every
+    producer moves forward at about the same pace, and each reading
+    goes into its producer's buffer in time order (a reading that is
+    a little out of order is moved back past the later ones).  A
+    heap of the buffers' oldest readings merges them.
+
+    A reading is written once it is older than the newest reading
+    seen from anyone by more than the window, or when nothing at
+    all has arrived for a window of real time.  A producer whose
+    buffer fills is not read again until its buffer has drained,
+    so its socket fills and its writes wait.  Only when every open
+    producer is waiting like that, and nothing can arrive to move
+    the window on, are readings written before their window is up.
+    A reading older than one already written is late; it is counted
+    and dropped, so the merged stream never goes back in time.
+
+HOW TO USE:
+    1. Construct the object with the options (the sockets are bound
+       here)
+    2. Call Run() with the reading handler, and optionally a handler
+       told where each merged sensor index comes from
+    3. Call Stop() from another thread to take the producers already
+       waiting, read each to its end, write out what is held and
+       return from Run()
+
+======================================================================*/
+class SampleCollector
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Told once per merged sensor, on its first reading: the index
+    // in the merged stream, the producer (its pid for a Unix socket,
+    // its address for TCP) and the producer's own sensor index
+    typedef std::function< void ( size_t sensor, const std::string& producer, size_t producerSensor ) > SensorHandler;
+
+    // Readings read from one producer at a time
+    static const size_t READ_RECORDS = 256;
+
+    // Readings decoded at a time on the way out
+    static const size_t BATCH = 256;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if a listener can not be set up
+    SampleCollector( const CollectorOptions& options );
+
+    virtual ~SampleCollector();
+
+    // Returns the readings handed over, once Stop() has been called
+    // and the producers are done
+    unsigned long long Run( SensorFleet::SampleHandler handler, SensorHandler sensorHandler = SensorHandler() );
+
+    void Stop();
+
+    const CollectorOptions& Options() const { return _options; }
+
+    // The bound TCP port, or -1 without a TCP listener
+    int TcpPort() const { return _tcpPort; }
+
+    // Connections accepted, and those still open
+    unsigned long long ProducerCount() const { return _producerCount.load( std::memory_order_relaxed ); }
+
+    size_t OpenProducerCount() const { return _openProducers.load( std::memory_order_relaxed ); }
+
+    // Producers turned away: too many, or not a BinarySink stream
+    unsigned long long RejectedCount() const { return _rejected.load( std::memory_order_relaxed ); }
+
+    unsigned long long MergedCount() const { return _merged.load( std::memory_order_relaxed ); }
+
+    // Readings dropped for coming in behind one already written
+    unsigned long long LateCount() const { return _late.load( std::memory_order_relaxed ); }
+
+    // Times a producer's buffer filled and it stopped being read
+    unsigned long long PausedCount() const { return _paused.load( std::memory_order_relaxed ); }
+
+    // Readings written before their window was up, because every
+    // open producer was paused
+    unsigned long long ForcedCount() const { return _forced.load( std::memory_order_relaxed ); }
+
+    // Records without the sync byte, or for a sensor past maxSensors
+    unsigned long long BadRecordCount() const { return _bad.load( std::memory_order_relaxed ); }
+
+    // Most readings held at once, over every producer
+    size_t PeakHeldCount() const { return _peakHeld.load( std::memory_order_relaxed ); }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // A reading as it is held: the sensor is already the merged index
+    struct Record
+    {
+        long long timeMicroseconds;
+
+        uint32_t sensor;
+
+        unsigned char frame[ 4 ];
+    };
+
+    struct Producer
+    {
+        int fileDescriptor;
+
+        std::string name;
+
+        // The stream header, until all of it has come
+        unsigned char header[ 8 ];
+        size_t headerLength;
+
+        // The start of a record cut off by the last read
+        unsigned char partial[ 16 ];
+        size_t partialLength;
+
+        // Merged index per producer sensor, -1 until first seen
+        std::vector< int32_t > sensors;
+
+        // A ring held in time order, from head, growing up to limit
+        std::vector< Record > ring;
+        size_t head;
+        size_t count;
+
+        // Reached the limit, so out of the epoll set until the ring
+        // drains to drainTo
+        bool paused;
+
+        // The producer hung up; freed once its ring is empty
+        bool closed;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleCollector( const SampleCollector &rhs );
+
+    void openUnixListener();
+
+    void openTcpListener();
+
+    void acceptProducers( int listener );
+
+    void readProducer( Producer& producer );
+
+    void addRecord( Producer& producer, const unsigned char* record );
+
+    void closeProducer( Producer& producer );
+
+    void pauseProducer( Producer& producer );
+
+    void resumeProducer( Producer& producer );
+
+    void release( bool everything );
+
+    void deliver();
+
+    void freeClosedProducers();
+
+    // Heap order: the producer with the newer oldest reading is
+    // further down
+    static bool newerHead( const Producer* left, const Producer* right );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    CollectorOptions _options;
+
+    int _unixListener;
+
+    int _tcpListener;
+
+    int _tcpPort;
+
+    int _epoll;
+
+    int _wake;
+
+    // Ring capacity per producer, and how far a paused one has to
+    // drain before it is read again
+    size_t _limit;
+    size_t _drainTo;
+
+    std::vector< Producer* > _producers;
+
+    // Producers with readings held, ordered by their oldest
+    std::vector< Producer* > _heap;
+
+    // A producer's oldest reading changed in place
+    bool _heapStale;
+
+    size_t _pausedCount;
+
+    size_t _closedCount;
+
+    size_t _held;
+
+    size_t _nextSensor;
+
+    // Newest time seen from anyone, and the time last written
+    long long _newestMicroseconds;
+    long long _releasedMicroseconds;
+
+    // What Run() was handed
+    SensorFleet::SampleHandler _handler;
+    SensorHandler _sensorHandler;
+
+    // Read buffer, and the batch on its way to the handler
+    std::vector< unsigned char > _input;
+    std::vector< Record > _batch;
+
+    std::atomic< unsigned long long > _producerCount;
+    std::atomic< size_t > _openProducers;
+    std::atomic< unsigned long long > _rejected;
+    std::atomic< unsigned long long > _merged;
+    std::atomic< unsigned long long > _late;
+    std::atomic< unsigned long long > _paused;
+    std::atomic< unsigned long long > _forced;
+    std::atomic< unsigned long long > _bad;
+    std::atomic< size_t > _peakHeld;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+The producers: ws --send=/run/ws-collect.sock (or --send-tcp=) writes
+every reading it takes, deadband or not, as BinarySink records to the
+collector as well as printing it.  If the collector stops reading, the
+printer thread waits on the socket and ws's queue overflows the way
+--overflow says, so a slow collector costs readings at the edge and
+never memory.  If the collector goes away, the send is given up and ws
+carries on.
+
+The collector: ws --collect=/run/ws-collect.sock (and/or
+--collect-tcp=) takes the place of the sensors, and the merged
+readings go through the same printing, rollups, deadband, log,
+publishing and serving as a fleet's.
+
+Choosing the window: it has to cover the clock skew between boards,
+plus how long a reading can sit in a producer (its queue and its
+SinkWriter's flush interval, 100ms at most).  Two seconds is
+generous on a LAN with NTP.  Every reading waits that long before it
+is written, so it is also the latency of the merged stream.  A quiet
+producer does not hold it up, since the window runs on the newest
+reading from anyone; when every producer is quiet for a window of
+real time, what is held is written anyway.  The window also bounds
+how far the collector itself can fall behind: readings that sit in
+the sockets longer than that come out late.
+
+Measured with bench collect on one core, the producers forked on the
+same machine: 512 producers at 2000 readings a second each merge at
+1M readings a second with nothing late, 30% of the core, and the
+readings come out 270-290ms after they were taken with a 250ms
+window.  Four producers writing flat out next to 252 steady ones were
+paused about 200 times in 3 seconds and merged at about 35k readings
+a second each.  The steady producers' readings still came out
+270-290ms behind, none of them late.
+
+The collector keeps each producer's socket receive buffer to about
+producerRecords, and the Connect functions keep the producer's send
+buffer to 16k, so a paused flood blocks in write() after a few
+thousand readings; only those come out late.  Left to the kernel's
+defaults the loopback buffers hold megabytes: with 100 producers the
+floods wrote about 550k readings a second each, 1.8M readings were
+merged and 5M sat in the sockets past the window and came out late.
+With the buffers kept small they write about 40k a second each and
+well under 100k come out late.  Readings were only forced at the end,
+once the steady producers had hung up and only the paused floods were
+left.
+
+A producer's sensors get merged indexes in the order they are first
+seen, so they differ from run to run; the sensor handler says which
+is which.  A producer that reconnects gets new indexes.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLECOLLECTOR_H_
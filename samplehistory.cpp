@@ -0,0 +1,554 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    samplehistory.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to keep a compact history of raw Honeywell 6130
+    frames
+
+GENERAL DESCRIPTION:
+    This file implements the delta coded ring of raw frames
+    and the iterator that rebuilds the timestamps
+
+PUBLIC CLASSES AND FUNCTIONS:
+    HistoryEntry
+    SampleHistory
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "samplehistory.h"
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// The two temperature bits the sensor never sets
+static const uint32_t DELTA_HIGH_MASK = 0x3;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long toTicks( long long timeMicroseconds, unsigned int tickMicroseconds );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    HistoryEntry::Data()
+
+DESCRIPTION:
+    Decodes the whole sample
+
+RETURN VALUE:
+    TempHumidityData
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+TempHumidityData HistoryEntry::Data() const
+{
+    unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+    Frame( frame );
+
+    TempHumidityData data;
+
+    Honeywell6130Sensor::Decode( frame, data );
+
+    return data;
+}
+
+/*======================================================================
+FUNCTION:
+    HistoryEntry::Frame()
+
+DESCRIPTION:
+    Unpacks the stored frame back into bytes
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void HistoryEntry::Frame( unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ] ) const
+{
+    frame[ 0 ] = ( unsigned char ) ( _frame >> 24 );
+    frame[ 1 ] = ( unsigned char ) ( _frame >> 16 );
+    frame[ 2 ] = ( unsigned char ) ( _frame >> 8 );
+    frame[ 3 ] = ( unsigned char ) _frame;
+}
+
+/*======================================================================
+FUNCTION:
+    SampleHistory::const_iterator::operator*()
+
+DESCRIPTION:
+    Builds the view of the sample the iterator is on
+
+RETURN VALUE:
+    HistoryEntry
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+HistoryEntry SampleHistory::const_iterator::operator*() const
+{
+    return HistoryEntry( _history->_frames[ _slot ] & ~DELTA_HIGH_MASK,
+                         _ticks * _history->_tickMicroseconds );
+}
+
+/*======================================================================
+FUNCTION:
+    SampleHistory::const_iterator::operator++()
+
+DESCRIPTION:
+    Steps to the next sample and adds its delta (or picks up its
+    keyframe) to get its time
+
+RETURN VALUE:
+    const_iterator&
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::const_iterator& SampleHistory::const_iterator::operator++()
+{
+    ++_sequence;
+
+    if ( ++_slot == _history->_frames.size() )
+    {
+        _slot = 0;
+    }
+
+    if ( _sequence < _history->_appended )
+    {
+        unsigned int delta = _history->deltaCode( _slot );
+
+        if ( KEYFRAME_DELTA == delta )
+        {
+            _ticks = _history->_keyframes[ _keyframe++ ].ticks;
+        }
+        else
+        {
+            _ticks += delta;
+        }
+    }
+
+    return *this;
+}
+
+/*======================================================================
+FUNCTION:
+    SampleHistory()
+
+DESCRIPTION:
+    This c-tor allocates room for capacity samples up front so
+    Append() never allocates (except for a rare keyframe)
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::SampleHistory( size_t capacity, unsigned int tickMicroseconds )
+: _frames( capacity ? capacity : 1 ),
+  _deltas( capacity ? capacity : 1 ),
+  _tickMicroseconds( tickMicroseconds ? tickMicroseconds : 1 ),
+  _count( 0 ),
+  _appended( 0 ),
+  _oldestTicks( 0 ),
+  _newestTicks( 0 )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ~SampleHistory()
+
+DESCRIPTION:
+    Nothing to clean up beyond the members
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::~SampleHistory()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Append()
+
+DESCRIPTION:
+    Stores the frame in the next slot.  If the ring is full the
+    oldest sample goes first.  The time is stored as the number of
+    ticks since the sample before, or as a keyframe if that does
+    not fit in 10 bits.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleHistory::Append( const unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ], long long timeMicroseconds )
+{
+    if ( _count == _frames.size() )
+    {
+        dropOldest();
+    }
+
+    long long ticks = toTicks( timeMicroseconds, _tickMicroseconds );
+
+    unsigned int delta = 0;
+
+    if ( 0 == _count )
+    {
+        // The oldest sample's time is kept in _oldestTicks
+        _oldestTicks = ticks;
+    }
+    else if ( ticks < _newestTicks || ticks - _newestTicks >= KEYFRAME_DELTA )
+    {
+        Keyframe keyframe = { _appended, ticks };
+
+        _keyframes.push_back( keyframe );
+
+        delta = KEYFRAME_DELTA;
+    }
+    else
+    {
+        delta = ( unsigned int ) ( ticks - _newestTicks );
+    }
+
+    uint32_t packed = ( ( uint32_t ) frame[ 0 ] << 24 ) |
+                      ( ( uint32_t ) frame[ 1 ] << 16 ) |
+                      ( ( uint32_t ) frame[ 2 ] << 8 ) |
+                      ( uint32_t ) frame[ 3 ];
+
+    size_t slot = ( size_t ) ( _appended % _frames.size() );
+
+    _frames[ slot ] = ( packed & ~DELTA_HIGH_MASK ) | ( delta >> 8 );
+    _deltas[ slot ] = ( uint8_t ) delta;
+
+    _newestTicks = ticks;
+
+    ++_appended;
+    ++_count;
+}
+
+/*======================================================================
+FUNCTION:
+    Clear()
+
+DESCRIPTION:
+    Forgets every sample
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleHistory::Clear()
+{
+    _keyframes.clear();
+
+    _count = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    begin()
+
+DESCRIPTION:
+    Iterator on the oldest sample
+
+RETURN VALUE:
+    const_iterator
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::const_iterator SampleHistory::begin() const
+{
+    const_iterator it;
+
+    it._history  = this;
+    it._sequence = _appended - _count;
+    it._slot     = ( size_t ) ( it._sequence % _frames.size() );
+    it._ticks    = _oldestTicks;
+    it._keyframe = 0;
+
+    return it;
+}
+
+/*======================================================================
+FUNCTION:
+    end()
+
+DESCRIPTION:
+    Iterator one past the newest sample
+
+RETURN VALUE:
+    const_iterator
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::const_iterator SampleHistory::end() const
+{
+    const_iterator it;
+
+    it._history  = this;
+    it._sequence = _appended;
+    it._slot     = ( size_t ) ( it._sequence % _frames.size() );
+    it._ticks    = _newestTicks;
+    it._keyframe = _keyframes.size();
+
+    return it;
+}
+
+/*======================================================================
+FUNCTION:
+    Between()
+
+DESCRIPTION:
+    Finds the samples stamped from fromMicroseconds through
+    toMicroseconds.  The search only adds up deltas, nothing is
+    decoded until the caller reads an entry.  Times are assumed
+    to go forward; after a keyframe that went backwards the range
+    stops at the first sample past toMicroseconds.
+
+RETURN VALUE:
+    Range
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleHistory::Range SampleHistory::Between( long long fromMicroseconds, long long toMicroseconds ) const
+{
+    Range range;
+
+    range.first = begin();
+
+    const_iterator last = end();
+
+    while ( range.first != last && range.first._ticks * _tickMicroseconds < fromMicroseconds )
+    {
+        ++range.first;
+    }
+
+    range.last = range.first;
+
+    while ( range.last != last && range.last._ticks * _tickMicroseconds <= toMicroseconds )
+    {
+        ++range.last;
+    }
+
+    return range;
+}
+
+/*======================================================================
+FUNCTION:
+    FootprintBytes()
+
+DESCRIPTION:
+    Adds up the memory the samples take
+
+RETURN VALUE:
+    size_t - bytes
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t SampleHistory::FootprintBytes() const
+{
+    return _frames.size() * sizeof( uint32_t ) +
+           _deltas.size() * sizeof( uint8_t ) +
+           _keyframes.size() * sizeof( Keyframe );
+}
+
+/*======================================================================
+FUNCTION:
+    deltaCode()
+
+DESCRIPTION:
+    Puts the two halves of a sample's delta back together
+
+RETURN VALUE:
+    unsigned int - ticks since the sample before, or KEYFRAME_DELTA
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned int SampleHistory::deltaCode( size_t slot ) const
+{
+    return ( ( _frames[ slot ] & DELTA_HIGH_MASK ) << 8 ) | _deltas[ slot ];
+}
+
+/*======================================================================
+FUNCTION:
+    dropOldest()
+
+DESCRIPTION:
+    Forgets the oldest sample.  The next one becomes the oldest, so
+    its full time moves into _oldestTicks and any keyframe it had
+    is no longer needed.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleHistory::dropOldest()
+{
+    --_count;
+
+    if ( 0 == _count )
+    {
+        _keyframes.clear();
+        return;
+    }
+
+    unsigned int delta = deltaCode( ( size_t ) ( ( _appended - _count ) % _frames.size() ) );
+
+    if ( KEYFRAME_DELTA == delta )
+    {
+        _oldestTicks = _keyframes.front().ticks;
+        _keyframes.pop_front();
+    }
+    else
+    {
+        _oldestTicks += delta;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    toTicks()
+
+DESCRIPTION:
+    Rounds a time down to a whole number of ticks
+
+RETURN VALUE:
+    long long - ticks
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long toTicks( long long timeMicroseconds, unsigned int tickMicroseconds )
+{
+    long long ticks = timeMicroseconds / tickMicroseconds;
+
+    if ( timeMicroseconds < 0 && ticks * tickMicroseconds != timeMicroseconds )
+    {
+        --ticks;
+    }
+
+    return ticks;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Keyframes only exist for samples after the oldest one, and always in
+order, so dropping the oldest sample pops at most the front keyframe
+and an iterator can walk the list with a plain index.
+
+=====================================================================*/
@@ -0,0 +1,365 @@
+#ifndef _SAMPLEHISTORY_H_
+#define _SAMPLEHISTORY_H_
+
+/*======================================================================
+FILE:
+    samplehistory.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Keeps a long history of Honeywell 6130 samples in a small
+    amount of memory.
+
+DESCRIPTION:
+    This header defines a fixed size ring of raw sensor frames with
+    delta coded timestamps.  A sample costs 5 bytes instead of the
+    16 a TempHumidityData takes, and the floats are only computed
+    when somebody looks at a sample.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    HistoryEntry
+    SampleHistory
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "humidiconsensor.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// No locking.  Append() from one thread, and do not hold iterators
+// across an Append() (it may overwrite the entry they point at).
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    HistoryEntry
+
+DESCRIPTION:
+    A view of one stored sample.  It holds the raw frame and the
+    time; every accessor decodes only what it is asked for.
+
+HOW TO USE:
+    Get one from a SampleHistory iterator and call the accessors
+
+======================================================================*/
+class HistoryEntry
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef ArithmeticConversion< Hih6130 > Converter;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    HistoryEntry( uint32_t frame, long long timeMicroseconds )
+    : _frame( frame ), _timeMicroseconds( timeMicroseconds ) { }
+
+    long long TimeMicroseconds() const { return _timeMicroseconds; }
+
+    unsigned char Status() const { return ( unsigned char ) ( _frame >> 30 ); }
+
+    float RelativeHumidity() const { return Converter::RelativeHumidity( ( _frame >> 16 ) & 0x3fff ); }
+
+    float Celcius() const { return Converter::Celcius( ( _frame & 0xffff ) >> 2 ); }
+
+    float Fahrenheit() const { return Converter::Fahrenheit( ( _frame & 0xffff ) >> 2 ); }
+
+    // Everything at once, same as Honeywell6130Sensor::Decode()
+    TempHumidityData Data() const;
+
+    // The frame as it came off the wire
+    void Frame( unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ] ) const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // Big endian frame with the two unused temperature bits cleared
+    uint32_t _frame;
+
+    long long _timeMicroseconds;
+
+};
+
+/*======================================================================
+CLASS:
+    SampleHistory
+
+DESCRIPTION:
+    A ring buffer holding the newest Capacity() samples of one
+    sensor.  Each sample is stored as its raw 4 byte frame plus a
+    10 bit time delta from the sample before it, in ticks of a
+    size picked at construction.  The low 8 bits of the delta sit
+    in their own byte array and the top 2 ride in the two bits of
+    the frame the sensor never uses.  A gap too long for 10 bits
+    (or time going backwards) is stored as a keyframe with the
+    full time in a small side list.
+
+HOW TO USE:
+    1. Construct the object with the number of samples to keep
+    2. Call Append() with every fresh frame and its time
+    3. Walk the samples oldest first with begin()/end() or
+       Between(), reading only the values you need
+
+======================================================================*/
+class SampleHistory
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const unsigned int DEFAULT_TICK_MICROSECONDS = 10000;
+
+    // Delta code meaning "look the time up in the keyframe list"
+    static const unsigned int KEYFRAME_DELTA = 0x3ff;
+
+    class const_iterator
+    {
+    public:
+
+        const_iterator() : _history( 0 ), _sequence( 0 ), _slot( 0 ), _ticks( 0 ), _keyframe( 0 ) { }
+
+        HistoryEntry operator*() const;
+
+        const_iterator& operator++();
+
+        bool operator==( const const_iterator& rhs ) const { return _sequence == rhs._sequence; }
+
+        bool operator!=( const const_iterator& rhs ) const { return _sequence != rhs._sequence; }
+
+    private:
+
+        friend class SampleHistory;
+
+        const SampleHistory* _history;
+
+        unsigned long long _sequence;
+
+        size_t _slot;
+
+        long long _ticks;
+
+        size_t _keyframe;
+    };
+
+    // A begin/end pair for range based for loops
+    struct Range
+    {
+        const_iterator first;
+        const_iterator last;
+
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SampleHistory( size_t capacity, unsigned int tickMicroseconds = DEFAULT_TICK_MICROSECONDS );
+
+    virtual ~SampleHistory();
+
+    // Stores a frame, dropping the oldest one if the ring is full.
+    // Times are rounded down to a whole tick.
+    void Append( const unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ], long long timeMicroseconds );
+
+    void Clear();
+
+    size_t Size() const { return _count; }
+
+    size_t Capacity() const { return _frames.size(); }
+
+    unsigned int TickMicroseconds() const { return _tickMicroseconds; }
+
+    // Oldest first
+    const_iterator begin() const;
+
+    const_iterator end() const;
+
+    // Samples with from <= time <= to
+    Range Between( long long fromMicroseconds, long long toMicroseconds ) const;
+
+    size_t KeyframeCount() const { return _keyframes.size(); }
+
+    // Bytes of memory holding samples, including the keyframes
+    size_t FootprintBytes() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct Keyframe
+    {
+        unsigned long long sequence;
+        long long ticks;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleHistory( const SampleHistory &rhs );
+
+    unsigned int deltaCode( size_t slot ) const;
+
+    void dropOldest();
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::vector< uint32_t > _frames;
+
+    std::vector< uint8_t > _deltas;
+
+    std::deque< Keyframe > _keyframes;
+
+    unsigned int _tickMicroseconds;
+
+    size_t _count;
+
+    // Number of samples ever appended.  Sample n lives in slot
+    // n % Capacity().
+    unsigned long long _appended;
+
+    long long _oldestTicks;
+
+    long long _newestTicks;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Storage per sample is 4 bytes of frame plus 1 byte of delta, kept in
+two separate arrays so neither one has padding.  With the default 10ms
+tick a delta covers up to 10.22 seconds, so a sensor polled every
+second never needs a keyframe unless it drops out.  The oldest sample's
+time is kept on its own, which is what lets the ring drop samples off
+the back without rewriting anything.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLEHISTORY_H_
@@ -0,0 +1,986 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    samplelog.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to append samples to and query the on-disk log
+
+GENERAL DESCRIPTION:
+    This file creates, maps and recovers the segment files and
+    implements the append and range query paths
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SampleLog
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "samplelog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+static const uint32_t LOG_MAGIC   = 0x474f4c48;    // "HLOG"
+static const uint32_t LOG_VERSION = 1;
+
+// Reads back as something else on a machine of the other byte order
+static const uint32_t LOG_BYTE_ORDER = 0x01020304;
+
+static const size_t PAGE_BYTES = 4096;
+
+// Largest gap one record can hold
+static const long long MAX_DELTA_MICROSECONDS = 0x7fffffff;
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static size_t recordsOffset( size_t blockCount );
+
+static size_t segmentBytes( size_t blockCount );
+
+static void resetSummary( LogBlockSummary& summary, long long timeMicroseconds );
+
+static void addToSummary( LogBlockSummary& summary, uint32_t frame );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SampleLog()
+
+DESCRIPTION:
+    This c-tor maps every segment in the directory, oldest first,
+    and recovers the newest one so appends carry on from its last
+    complete record.  An empty directory gets its first segment on
+    the first append.
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleLog::SampleLog( const char* directory, size_t blocksPerSegment )
+: _directory( directory ),
+  _blocksPerSegment( ( 0 < blocksPerSegment ) ? blocksPerSegment : 1 ),
+  _block( 0 ),
+  _next( 0 ),
+  _lastMicroseconds( 0 ),
+  _recordCount( 0 ),
+  _recovered( 0 ),
+  _discarded( 0 )
+{
+    if ( 0 != mkdir( _directory.c_str(), 0755 ) && EEXIST != errno )
+    {
+        throw SensorException( "Failed to create log directory " + _directory );
+    }
+
+    DIR* listing = opendir( _directory.c_str() );
+
+    if ( 0 == listing )
+    {
+        throw SensorException( "Failed to open log directory " + _directory );
+    }
+
+    std::vector< unsigned long long > sequences;
+
+    while ( struct dirent* entry = readdir( listing ) )
+    {
+        unsigned long long sequence;
+        int length = 0;
+
+        if ( 1 == sscanf( entry->d_name, "%llu.hlog%n", &sequence, &length ) &&
+             ( size_t ) length == strlen( entry->d_name ) )
+        {
+            sequences.push_back( sequence );
+        }
+    }
+
+    closedir( listing );
+
+    std::sort( sequences.begin(), sequences.end() );
+
+    try
+    {
+        for ( size_t s = 0; s < sequences.size(); ++s )
+        {
+            openSegment( sequences[ s ], s + 1 == sequences.size() );
+        }
+
+        recover();
+    }
+    catch( SensorException& )
+    {
+        closeSegments();
+        throw;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SampleLog()
+
+DESCRIPTION:
+    This destructor unmaps the segments.  Whatever has not reached
+    the disk yet is written back by the kernel as usual.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleLog::~SampleLog()
+{
+    closeSegments();
+}
+
+/*======================================================================
+FUNCTION:
+    Append()
+
+DESCRIPTION:
+    Stores a frame.  The record goes in with its valid bit last,
+    then the block summary is brought up to date.  Starting a new
+    block, and now and then a new segment, is the only slow path.
+
+    Throws a SensorException if a new segment can not be created
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::Append( const unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ], long long timeMicroseconds )
+{
+    uint32_t packed = ( ( uint32_t ) frame[ 0 ] << 24 ) |
+                      ( ( uint32_t ) frame[ 1 ] << 16 ) |
+                      ( ( uint32_t ) frame[ 2 ] << 8 )  |
+                      ( ( uint32_t ) frame[ 3 ] & 0xfc );
+
+    if ( 0 != _block && timeMicroseconds < _lastMicroseconds )
+    {
+        timeMicroseconds = _lastMicroseconds;
+    }
+
+    long long delta = timeMicroseconds - _lastMicroseconds;
+
+    if ( 0 == _block || BLOCK_RECORDS == _block->count || MAX_DELTA_MICROSECONDS < delta )
+    {
+        startBlock( timeMicroseconds );
+        delta = 0;
+    }
+
+    _next->frame = packed;
+
+    // Keeps the compiler from storing the valid bit first; a process
+    // killed in between must leave an invalid record, not a bad one
+    std::atomic_signal_fence( std::memory_order_release );
+
+    _next->meta = ( ( uint32_t ) delta << 1 ) | 1;
+
+    std::atomic_signal_fence( std::memory_order_release );
+
+    addToSummary( *_block, packed );
+
+    _block->lastMicroseconds = timeMicroseconds;
+
+    ++_block->count;
+    ++_next;
+
+    _lastMicroseconds = timeMicroseconds;
+
+    ++_recordCount;
+}
+
+void SampleLog::Append( const TempHumidityData& data, long long timeMicroseconds )
+{
+    unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+    Honeywell6130Sensor::Encode( data, frame );
+
+    Append( frame, timeMicroseconds );
+}
+
+/*======================================================================
+FUNCTION:
+    Query()
+
+DESCRIPTION:
+    Finds the records in a time range and hands them back as spans
+    of the mapped blocks
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::Query( long long fromMicroseconds, long long toMicroseconds, std::vector< LogSpan >& spans ) const
+{
+    spans.clear();
+
+    auto collect = [ &spans ]( const LogBlockSummary&, bool, const LogRecord* records, size_t count, long long firstMicroseconds )
+    {
+        spans.push_back( LogSpan( records, count, firstMicroseconds ) );
+    };
+
+    visit( fromMicroseconds, toMicroseconds, collect );
+}
+
+/*======================================================================
+FUNCTION:
+    Summarize()
+
+DESCRIPTION:
+    Finds the lowest and highest counts in a time range.  Only the
+    blocks at the two ends of the range are read; the ones in
+    between come from their summaries.
+
+RETURN VALUE:
+    bool - false if the range has no records
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SampleLog::Summarize( long long fromMicroseconds, long long toMicroseconds, LogSummary& summary ) const
+{
+    LogBlockSummary total;
+
+    resetSummary( total, 0 );
+
+    unsigned long long count = 0;
+
+    auto merge = [ &total, &count ]( const LogBlockSummary& block, bool whole, const LogRecord* records, size_t length, long long )
+    {
+        if ( whole )
+        {
+            total.minTemperature = std::min( total.minTemperature, block.minTemperature );
+            total.maxTemperature = std::max( total.maxTemperature, block.maxTemperature );
+            total.minHumidity    = std::min( total.minHumidity, block.minHumidity );
+            total.maxHumidity    = std::max( total.maxHumidity, block.maxHumidity );
+            total.statusBits    |= block.statusBits;
+        }
+        else
+        {
+            for ( size_t r = 0; r < length; ++r )
+            {
+                addToSummary( total, records[ r ].frame );
+            }
+        }
+
+        count += length;
+    };
+
+    visit( fromMicroseconds, toMicroseconds, merge );
+
+    if ( 0 == count )
+    {
+        return false;
+    }
+
+    summary.count          = count;
+    summary.minTemperature = total.minTemperature;
+    summary.maxTemperature = total.maxTemperature;
+    summary.minHumidity    = total.minHumidity;
+    summary.maxHumidity    = total.maxHumidity;
+    summary.statusBits     = total.statusBits;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    Flush()
+
+DESCRIPTION:
+    Waits for the newest segment's dirty pages to reach the disk.
+    Without it a killed process loses nothing, but a power cut can
+    lose whatever the kernel had not written back yet.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::Flush()
+{
+    if ( !_segments.empty() )
+    {
+        msync( _segments.back().mapping, _segments.back().size, MS_SYNC );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    FileBytes()
+
+DESCRIPTION:
+    Adds up the segment file sizes
+
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SampleLog::FileBytes() const
+{
+    unsigned long long total = 0;
+
+    for ( size_t s = 0; s < _segments.size(); ++s )
+    {
+        total += _segments[ s ].size;
+    }
+
+    return total;
+}
+
+/*======================================================================
+FUNCTION:
+    segmentPath()
+
+DESCRIPTION:
+    Builds the file name of a segment
+
+RETURN VALUE:
+    std::string
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+std::string SampleLog::segmentPath( unsigned long long sequence ) const
+{
+    char name[ 32 ];
+
+    snprintf( name, sizeof( name ), "/%08llu.hlog", sequence );
+
+    return _directory + name;
+}
+
+/*======================================================================
+FUNCTION:
+    openSegment()
+
+DESCRIPTION:
+    Maps an existing segment and checks its header.  Only the
+    newest one is mapped writable.  Its used blocks are the ones
+    whose summary has a count; recover() looks past that for the
+    newest segment.
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::openSegment( unsigned long long sequence, bool writable )
+{
+    std::string path = segmentPath( sequence );
+
+    int fileDescriptor = open( path.c_str(), ( writable ? O_RDWR : O_RDONLY ) | O_CLOEXEC );
+
+    if ( fileDescriptor < 0 )
+    {
+        throw SensorException( "Failed to open log segment " + path );
+    }
+
+    struct stat status;
+
+    void* mapping = MAP_FAILED;
+
+    size_t size = 0;
+
+    if ( 0 == fstat( fileDescriptor, &status ) && ( size_t ) status.st_size >= sizeof( SegmentHeader ) )
+    {
+        size = ( size_t ) status.st_size;
+
+        mapping = mmap( 0, size, PROT_READ | ( writable ? PROT_WRITE : 0 ), MAP_SHARED, fileDescriptor, 0 );
+    }
+
+    close( fileDescriptor );
+
+    if ( MAP_FAILED == mapping )
+    {
+        throw SensorException( "Failed to map log segment " + path );
+    }
+
+    Segment segment;
+
+    segment.sequence = sequence;
+    segment.mapping  = mapping;
+    segment.size     = size;
+    segment.header   = ( SegmentHeader* ) mapping;
+
+    const SegmentHeader& header = *segment.header;
+
+    if ( LOG_MAGIC != header.magic || LOG_VERSION != header.version || LOG_BYTE_ORDER != header.byteOrder ||
+         BLOCK_RECORDS != header.blockRecords || size != segmentBytes( header.blockCount ) )
+    {
+        munmap( mapping, size );
+        throw SensorException( "Not a sample log segment (or from another machine): " + path );
+    }
+
+    segment.blockCount = header.blockCount;
+    segment.summaries  = ( LogBlockSummary* ) ( ( unsigned char* ) mapping + sizeof( SegmentHeader ) );
+    segment.records    = ( LogRecord* ) ( ( unsigned char* ) mapping + recordsOffset( segment.blockCount ) );
+    segment.usedBlocks = 0;
+
+    while ( segment.usedBlocks < segment.blockCount && 0 < segment.summaries[ segment.usedBlocks ].count )
+    {
+        _recordCount += segment.summaries[ segment.usedBlocks ].count;
+
+        ++segment.usedBlocks;
+    }
+
+    _segments.push_back( segment );
+}
+
+/*======================================================================
+FUNCTION:
+    createSegment()
+
+DESCRIPTION:
+    Creates, sizes and maps a new segment.  The file starts out
+    all zeros, which is a segment with no records; the magic goes
+    in last.
+
+    Throws a SensorException on failure
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::createSegment( unsigned long long sequence )
+{
+    std::string path = segmentPath( sequence );
+
+    size_t size = segmentBytes( _blocksPerSegment );
+
+    int fileDescriptor = open( path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+
+    if ( fileDescriptor < 0 )
+    {
+        throw SensorException( "Failed to create log segment " + path );
+    }
+
+    void* mapping = MAP_FAILED;
+
+    if ( 0 == ftruncate( fileDescriptor, ( off_t ) size ) )
+    {
+        mapping = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+    }
+
+    close( fileDescriptor );
+
+    if ( MAP_FAILED == mapping )
+    {
+        unlink( path.c_str() );
+        throw SensorException( "Failed to size and map log segment " + path );
+    }
+
+    Segment segment;
+
+    segment.sequence   = sequence;
+    segment.mapping    = mapping;
+    segment.size       = size;
+    segment.header     = ( SegmentHeader* ) mapping;
+    segment.blockCount = _blocksPerSegment;
+    segment.summaries  = ( LogBlockSummary* ) ( ( unsigned char* ) mapping + sizeof( SegmentHeader ) );
+    segment.records    = ( LogRecord* ) ( ( unsigned char* ) mapping + recordsOffset( _blocksPerSegment ) );
+    segment.usedBlocks = 0;
+
+    SegmentHeader& header = *segment.header;
+
+    header.version      = LOG_VERSION;
+    header.blockRecords = BLOCK_RECORDS;
+    header.blockCount   = ( uint32_t ) _blocksPerSegment;
+    header.sequence     = sequence;
+    header.byteOrder    = LOG_BYTE_ORDER;
+
+    std::atomic_signal_fence( std::memory_order_release );
+
+    header.magic = LOG_MAGIC;
+
+    _segments.push_back( segment );
+}
+
+/*======================================================================
+FUNCTION:
+    recover()
+
+DESCRIPTION:
+    Finds where appends left off in the newest segment.  The block
+    after the last counted one is taken too if its first record
+    made it.  The tail block is then recounted from its valid
+    bits, its summary rebuilt, and everything after the last good
+    record wiped so a later recovery can not pick up stale records.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::recover()
+{
+    if ( _segments.empty() )
+    {
+        return;
+    }
+
+    Segment& segment = _segments.back();
+
+    size_t used = segment.usedBlocks;
+
+    if ( used < segment.blockCount && 0 != ( segment.records[ used * BLOCK_RECORDS ].meta & 1 ) )
+    {
+        ++used;
+    }
+
+    if ( 0 == used )
+    {
+        return;
+    }
+
+    size_t tail = used - 1;
+
+    LogBlockSummary& summary = segment.summaries[ tail ];
+    LogRecord* records = segment.records + tail * BLOCK_RECORDS;
+
+    _recordCount -= summary.count;
+
+    long long time = summary.firstMicroseconds;
+
+    resetSummary( summary, time );
+
+    size_t count = 0;
+
+    while ( count < BLOCK_RECORDS && 0 != ( records[ count ].meta & 1 ) )
+    {
+        if ( 0 < count )
+        {
+            time += records[ count ].meta >> 1;
+        }
+
+        addToSummary( summary, records[ count ].frame );
+
+        ++count;
+    }
+
+    summary.count            = ( uint32_t ) count;
+    summary.lastMicroseconds = time;
+
+    // Anything left past the good records, in this block or the
+    // blocks after it
+    for ( size_t r = count; r < BLOCK_RECORDS; ++r )
+    {
+        if ( 0 != records[ r ].frame || 0 != records[ r ].meta )
+        {
+            records[ r ].frame = 0;
+            records[ r ].meta  = 0;
+            ++_discarded;
+        }
+    }
+
+    for ( size_t b = used; b < segment.blockCount; ++b )
+    {
+        LogRecord* first = segment.records + b * BLOCK_RECORDS;
+
+        if ( 0 == segment.summaries[ b ].count && 0 == first->meta )
+        {
+            break;
+        }
+
+        memset( &segment.summaries[ b ], 0, sizeof( LogBlockSummary ) );
+        memset( first, 0, BLOCK_RECORDS * sizeof( LogRecord ) );
+
+        ++_discarded;
+    }
+
+    _recovered     = count;
+    _recordCount  += count;
+
+    if ( 0 == count )
+    {
+        // The block never got its first record; it will be started
+        // over by the next append
+        segment.usedBlocks = tail;
+        return;
+    }
+
+    segment.usedBlocks = used;
+
+    _block            = &summary;
+    _next             = records + count;
+    _lastMicroseconds = time;
+}
+
+/*======================================================================
+FUNCTION:
+    startBlock()
+
+DESCRIPTION:
+    Opens the next block for appends, in a new segment if the
+    newest one is full.  The summary is written before the block's
+    first record so recovery can trust its time.
+
+    Throws a SensorException if a new segment can not be created
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::startBlock( long long timeMicroseconds )
+{
+    if ( _segments.empty() || _segments.back().usedBlocks == _segments.back().blockCount )
+    {
+        createSegment( _segments.empty() ? 0 : _segments.back().sequence + 1 );
+    }
+
+    Segment& segment = _segments.back();
+
+    LogBlockSummary& summary = segment.summaries[ segment.usedBlocks ];
+
+    resetSummary( summary, timeMicroseconds );
+
+    std::atomic_signal_fence( std::memory_order_release );
+
+    _block = &summary;
+    _next  = segment.records + segment.usedBlocks * BLOCK_RECORDS;
+
+    ++segment.usedBlocks;
+}
+
+/*======================================================================
+FUNCTION:
+    closeSegments()
+
+DESCRIPTION:
+    Unmaps every segment
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SampleLog::closeSegments()
+{
+    for ( size_t s = 0; s < _segments.size(); ++s )
+    {
+        munmap( _segments[ s ].mapping, _segments[ s ].size );
+    }
+
+    _segments.clear();
+
+    _block = 0;
+    _next  = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    visit()
+
+DESCRIPTION:
+    Walks the blocks overlapping a time range.  The segments and
+    the blocks in each are in time order, so the first block is
+    found with a binary search on the summaries' last times.  A
+    block wholly inside the range is passed on as it is; one at an
+    end of the range is trimmed by walking its deltas.  The visitor
+    gets ( summary, whole, records, count, time of records[ 0 ] ).
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class Visitor >
+void SampleLog::visit( long long fromMicroseconds, long long toMicroseconds, Visitor& visitor ) const
+{
+    for ( size_t s = 0; s < _segments.size(); ++s )
+    {
+        const Segment& segment = _segments[ s ];
+
+        size_t used = segment.usedBlocks;
+
+        if ( 0 == used || segment.summaries[ used - 1 ].lastMicroseconds < fromMicroseconds )
+        {
+            continue;
+        }
+
+        size_t low  = 0;
+        size_t high = used;
+
+        while ( low < high )
+        {
+            size_t middle = ( low + high ) / 2;
+
+            if ( segment.summaries[ middle ].lastMicroseconds < fromMicroseconds )
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+
+        for ( size_t b = low; b < used; ++b )
+        {
+            const LogBlockSummary& summary = segment.summaries[ b ];
+
+            if ( summary.firstMicroseconds > toMicroseconds )
+            {
+                return;
+            }
+
+            const LogRecord* records = segment.records + b * BLOCK_RECORDS;
+
+            size_t count = summary.count;
+
+            if ( summary.firstMicroseconds >= fromMicroseconds && summary.lastMicroseconds <= toMicroseconds )
+            {
+                if ( 0 < count )
+                {
+                    visitor( summary, true, records, count, summary.firstMicroseconds );
+                }
+
+                continue;
+            }
+
+            long long time = summary.firstMicroseconds;
+
+            size_t r = 0;
+
+            while ( r < count && time < fromMicroseconds )
+            {
+                if ( ++r < count )
+                {
+                    time += records[ r ].meta >> 1;
+                }
+            }
+
+            size_t first = r;
+
+            long long firstMicroseconds = time;
+
+            while ( r < count && time <= toMicroseconds )
+            {
+                if ( ++r < count )
+                {
+                    time += records[ r ].meta >> 1;
+                }
+            }
+
+            if ( first < r )
+            {
+                visitor( summary, false, records + first, r - first, firstMicroseconds );
+            }
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    recordsOffset() and segmentBytes()
+
+DESCRIPTION:
+    Segment layout: the header, the summaries, then the blocks
+    starting on a page boundary
+
+RETURN VALUE:
+    size_t
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static size_t recordsOffset( size_t blockCount )
+{
+    size_t summaries = 64 + blockCount * sizeof( LogBlockSummary );
+
+    return ( summaries + PAGE_BYTES - 1 ) / PAGE_BYTES * PAGE_BYTES;
+}
+
+static size_t segmentBytes( size_t blockCount )
+{
+    return recordsOffset( blockCount ) + blockCount * SampleLog::BLOCK_RECORDS * sizeof( LogRecord );
+}
+
+/*======================================================================
+FUNCTION:
+    resetSummary()
+
+DESCRIPTION:
+    Empties a block summary, ready for a block starting at the
+    given time
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void resetSummary( LogBlockSummary& summary, long long timeMicroseconds )
+{
+    summary.firstMicroseconds = timeMicroseconds;
+    summary.lastMicroseconds  = timeMicroseconds;
+    summary.count             = 0;
+    summary.minTemperature    = 0xffff;
+    summary.maxTemperature    = 0;
+    summary.minHumidity       = 0xffff;
+    summary.maxHumidity       = 0;
+    summary.statusBits        = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    addToSummary()
+
+DESCRIPTION:
+    Folds one packed frame into a summary's extremes (not its
+    count or times)
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void addToSummary( LogBlockSummary& summary, uint32_t frame )
+{
+    uint16_t humidity    = ( uint16_t ) ( ( frame >> 16 ) & 0x3fff );
+    uint16_t temperature = ( uint16_t ) ( ( frame & 0xffff ) >> 2 );
+
+    summary.minTemperature = std::min( summary.minTemperature, temperature );
+    summary.maxTemperature = std::max( summary.maxTemperature, temperature );
+    summary.minHumidity    = std::min( summary.minHumidity, humidity );
+    summary.maxHumidity    = std::max( summary.maxHumidity, humidity );
+    summary.statusBits    |= 1u << ( frame >> 30 );
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The sequence in the header, like the file name, only orders the
+segments; nothing needs it to be dense.
+
+An append touches the record and the block summary, two cache lines
+that stay hot, so it costs a handful of stores.  Only the first record
+of a page faults, and only creating a segment makes system calls.
+
+=====================================================================*/
@@ -0,0 +1,476 @@
+#ifndef _SAMPLELOG_H_
+#define _SAMPLELOG_H_
+
+/*======================================================================
+FILE:
+    samplelog.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Keeps every sample of a sensor on disk in a compact binary log
+    that can be searched by time without parsing anything.
+
+DESCRIPTION:
+    This header defines an append-only log made of fixed size,
+    memory mapped segment files.  A sample is its raw 4 byte frame
+    plus the time since the sample before it, 8 bytes in all,
+    against roughly 60 for a line of the text output.  Samples are
+    grouped into page sized blocks, and every segment starts with
+    a summary of each block (first and last time, count, lowest
+    and highest counts), which serves as a sparse time index and
+    lets whole blocks be answered or skipped without reading them.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    LogRecord
+    LogBlockSummary
+    LogSummary
+    LogSpan
+    SampleLog
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "samplehistory.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// One sample as it sits in the file.  frame is the sensor frame read
+// big endian with the two unused bits cleared (the same packing
+// SampleHistory uses).  meta is the time since the sample before in
+// microseconds, shifted up one, with bit 0 set once the record is
+// complete.
+struct LogRecord
+{
+    uint32_t frame;
+    uint32_t meta;
+};
+
+// What a segment knows about one of its blocks
+struct LogBlockSummary
+{
+    int64_t firstMicroseconds;
+    int64_t lastMicroseconds;
+    uint32_t count;
+    uint16_t minTemperature;
+    uint16_t maxTemperature;
+    uint16_t minHumidity;
+    uint16_t maxHumidity;
+
+    // Every status value seen, one bit each
+    uint32_t statusBits;
+};
+
+// Lowest and highest counts over a time range
+struct LogSummary
+{
+    unsigned long long count;
+    unsigned int minTemperature;
+    unsigned int maxTemperature;
+    unsigned int minHumidity;
+    unsigned int maxHumidity;
+    unsigned int statusBits;
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+static_assert( 8 == sizeof( LogRecord ), "LogRecord is part of the file format" );
+static_assert( 32 == sizeof( LogBlockSummary ), "LogBlockSummary is part of the file format" );
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A SampleLog is not thread safe; append and query from one thread (or
+// lock around it).  Spans point straight into the mappings and stay
+// good until the SampleLog is destroyed.  Times must not go backwards:
+// a sample older than the one before it is stored with that one's
+// time.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    LogSpan
+
+DESCRIPTION:
+    A run of consecutive records inside one block, handed out by
+    SampleLog::Query() without copying.  Walking it adds up the
+    time deltas and hands back the same HistoryEntry view that
+    SampleHistory does.
+
+HOW TO USE:
+    Walk it with begin()/end(), or use Records() directly
+
+======================================================================*/
+class LogSpan
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    class const_iterator
+    {
+    public:
+
+        const_iterator() : _record( 0 ), _end( 0 ), _timeMicroseconds( 0 ) { }
+
+        HistoryEntry operator*() const { return HistoryEntry( _record->frame, _timeMicroseconds ); }
+
+        const_iterator& operator++()
+        {
+            // The record past the end may be past the mapping
+            if ( ++_record != _end )
+            {
+                _timeMicroseconds += _record->meta >> 1;
+            }
+
+            return *this;
+        }
+
+        bool operator==( const const_iterator& rhs ) const { return _record == rhs._record; }
+
+        bool operator!=( const const_iterator& rhs ) const { return _record != rhs._record; }
+
+    private:
+
+        friend class LogSpan;
+
+        const LogRecord* _record;
+
+        const LogRecord* _end;
+
+        long long _timeMicroseconds;
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    LogSpan( const LogRecord* records, size_t count, long long firstMicroseconds )
+    : _records( records ), _count( count ), _firstMicroseconds( firstMicroseconds ) { }
+
+    const LogRecord* Records() const { return _records; }
+
+    size_t Size() const { return _count; }
+
+    // Time of Records()[ 0 ]
+    long long FirstMicroseconds() const { return _firstMicroseconds; }
+
+    const_iterator begin() const
+    {
+        const_iterator i;
+
+        i._record           = _records;
+        i._end              = _records + _count;
+        i._timeMicroseconds = _firstMicroseconds;
+
+        return i;
+    }
+
+    const_iterator end() const
+    {
+        const_iterator i;
+
+        i._record = _records + _count;
+        i._end    = i._record;
+
+        return i;
+    }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    const LogRecord* _records;
+
+    size_t _count;
+
+    long long _firstMicroseconds;
+
+};
+
+/*======================================================================
+CLASS:
+    SampleLog
+
+DESCRIPTION:
+    Stores samples in numbered segment files in one directory.
+    Each segment is created at its full size and mapped, so an
+    append is a few stores into memory; the kernel writes the
+    pages back on its own, or at once with Flush().
+
+    A record's valid bit is stored after the rest of it.  On open,
+    the newest segment is scanned from its last block's summary to
+    the first record without the bit, the summary is rebuilt from
+    what is there and anything past it is wiped, so a process
+    killed in the middle of an append loses at most that sample.
+
+HOW TO USE:
+    1. Construct the object with the directory (created if need
+       be); existing segments are opened and recovered
+    2. Call Append() with every sample
+    3. Call Query() for the spans covering a time range, or
+       Summarize() for its extremes
+
+======================================================================*/
+class SampleLog
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // One block is one 4KB page
+    static const size_t BLOCK_RECORDS = 512;
+
+    // 4MB of records per segment
+    static const size_t DEFAULT_BLOCKS_PER_SEGMENT = 1024;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if the directory or a segment can not
+    // be opened, or a segment is not one of ours
+    SampleLog( const char* directory, size_t blocksPerSegment = DEFAULT_BLOCKS_PER_SEGMENT );
+
+    virtual ~SampleLog();
+
+    // Throws a SensorException if a new segment can not be created
+    void Append( const unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ], long long timeMicroseconds );
+
+    // Stores the frame data decodes from
+    void Append( const TempHumidityData& data, long long timeMicroseconds );
+
+    // Replaces spans with the records from <= time <= to, oldest
+    // first, one span per block touched
+    void Query( long long fromMicroseconds, long long toMicroseconds, std::vector< LogSpan >& spans ) const;
+
+    // Extremes of the records from <= time <= to.  Blocks that lie
+    // wholly inside the range are answered from their summaries.
+    // Returns false if there are no such records.
+    bool Summarize( long long fromMicroseconds, long long toMicroseconds, LogSummary& summary ) const;
+
+    // Writes the dirty pages of the newest segment to disk and waits
+    void Flush();
+
+    unsigned long long RecordCount() const { return _recordCount; }
+
+    size_t SegmentCount() const { return _segments.size(); }
+
+    // Records found in the tail block when the log was opened, and
+    // incomplete ones that were thrown away
+    size_t RecoveredCount() const { return _recovered; }
+
+    size_t DiscardedCount() const { return _discarded; }
+
+    // Bytes of segment files, allocated or not
+    unsigned long long FileBytes() const;
+
+    const std::string& Directory() const { return _directory; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // First 64 bytes of every segment file
+    struct SegmentHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t blockRecords;
+        uint32_t blockCount;
+        uint64_t sequence;
+        uint32_t byteOrder;
+        uint32_t reserved[ 9 ];
+    };
+
+    struct Segment
+    {
+        unsigned long long sequence;
+
+        void* mapping;
+        size_t size;
+
+        SegmentHeader* header;
+        LogBlockSummary* summaries;
+        LogRecord* records;
+
+        size_t blockCount;
+
+        // Blocks with at least one record
+        size_t usedBlocks;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleLog( const SampleLog &rhs );
+
+    std::string segmentPath( unsigned long long sequence ) const;
+
+    void openSegment( unsigned long long sequence, bool writable );
+
+    void createSegment( unsigned long long sequence );
+
+    void recover();
+
+    void startBlock( long long timeMicroseconds );
+
+    void closeSegments();
+
+    template< class Visitor >
+    void visit( long long fromMicroseconds, long long toMicroseconds, Visitor& visitor ) const;
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::string _directory;
+
+    size_t _blocksPerSegment;
+
+    std::vector< Segment > _segments;
+
+    // Where the next record goes; null until the first block starts
+    LogBlockSummary* _block;
+    LogRecord* _next;
+
+    long long _lastMicroseconds;
+
+    unsigned long long _recordCount;
+
+    size_t _recovered;
+
+    size_t _discarded;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+A segment file is laid out as
+
+    header (64 bytes)
+    one LogBlockSummary per block
+    padding up to the next 4KB
+    the blocks, BLOCK_RECORDS records each
+
+Files are named by sequence number (00000000.hlog, 00000001.hlog, ...)
+and are never rewritten once full; delete the oldest ones to trim the
+log.  The frame and time are stored in host byte order, and the header
+records which order that was.
+
+A delta takes 31 bits, so one block can go 35 minutes between samples;
+a longer gap just starts a new block, whose first record carries its
+time in the summary.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLELOG_H_
@@ -0,0 +1,651 @@
+#ifndef _SAMPLEQUEUE_H_
+#define _SAMPLEQUEUE_H_
+
+/*======================================================================
+FILE:
+    samplequeue.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Hands samples from the acquisition threads to consumer threads
+    without locks.
+
+DESCRIPTION:
+    This header defines a bounded queue that any number of threads
+    can push into and pop from without a mutex.  When it fills up
+    it follows an overflow policy picked at construction and counts
+    what it had to throw away, so a slow logger or network sink
+    never holds up the next measurement.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SampleQueue
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// T is copied in and out of the queue, so keep it small and plain
+// (a FleetSample is a couple of dozen bytes).  The capacity is
+// rounded up to a power of two.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SampleQueue
+
+DESCRIPTION:
+    A bounded lock-free queue.  Every slot carries a sequence number
+    that says whether it is ready to be written or read on the
+    current lap, so producers and consumers each claim a slot with
+    one compare-and-swap on their own counter and never touch a
+    lock.  The counters sit on their own cache lines so producers
+    and consumers do not slow each other down.
+
+    With one producer and one consumer it is an SPSC ring; nothing
+    has to change to add more of either.
+
+HOW TO USE:
+    1. Construct the object with a capacity and an overflow policy
+    2. Call Push() from the acquisition side
+    3. Call Pop() (or TryPop()) from one or more consumer threads
+    4. Call Close() to let the consumers drain the queue and quit
+
+======================================================================*/
+template< class T >
+class SampleQueue
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // What Push() does when the queue is full
+    enum OverflowPolicy
+    {
+        // Throw away the oldest queued sample to make room
+        DROP_OLDEST,
+
+        // Throw away the sample being pushed
+        DROP_NEWEST,
+
+        // Wait for a consumer to make room
+        BLOCK
+    };
+
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SampleQueue( size_t capacity, OverflowPolicy policy = DROP_OLDEST );
+
+    virtual ~SampleQueue();
+
+    // Returns false if the sample was dropped (DROP_NEWEST only)
+    // or the queue is closed, whether or not there is room.  A push
+    // racing Close() may still land; close once the producers are
+    // done.
+    bool Push( const T& item );
+
+    // Returns false right away if the queue is empty
+    bool TryPop( T& item );
+
+    // Waits for a sample.  Returns false once the queue is closed
+    // and empty.
+    bool Pop( T& item );
+
+    // Wakes up every waiting Pop() once the queue runs dry
+    void Close();
+
+    bool Closed() const { return _closed.load( std::memory_order_acquire ); }
+
+    size_t Capacity() const { return _mask + 1; }
+
+    OverflowPolicy Policy() const { return _policy; }
+
+    // Close to exact; it can be off by the pushes and pops in flight
+    size_t Size() const;
+
+    unsigned long long PushedCount() const { return _pushed.load( std::memory_order_relaxed ); }
+
+    unsigned long long PoppedCount() const { return _popped.load( std::memory_order_relaxed ); }
+
+    unsigned long long DroppedOldestCount() const { return _droppedOldest.load( std::memory_order_relaxed ); }
+
+    unsigned long long DroppedNewestCount() const { return _droppedNewest.load( std::memory_order_relaxed ); }
+
+    unsigned long long DroppedCount() const { return DroppedOldestCount() + DroppedNewestCount(); }
+
+    // Number of times Push() had to wait (BLOCK only)
+    unsigned long long BlockedCount() const { return _blocked.load( std::memory_order_relaxed ); }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct Cell
+    {
+        std::atomic< size_t > sequence;
+        T item;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleQueue( const SampleQueue &rhs );
+
+    bool tryPush( const T& item );
+
+    bool tryPop( T& item );
+
+    static void backoff( unsigned int& attempt );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    Cell* _cells;
+
+    size_t _mask;
+
+    OverflowPolicy _policy;
+
+    alignas( CACHE_LINE_SIZE ) std::atomic< size_t > _enqueue;
+
+    alignas( CACHE_LINE_SIZE ) std::atomic< size_t > _dequeue;
+
+    alignas( CACHE_LINE_SIZE ) std::atomic< bool > _closed;
+
+    std::atomic< unsigned long long > _pushed;
+
+    std::atomic< unsigned long long > _popped;
+
+    std::atomic< unsigned long long > _droppedOldest;
+
+    std::atomic< unsigned long long > _droppedNewest;
+
+    std::atomic< unsigned long long > _blocked;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SampleQueue()
+
+DESCRIPTION:
+    This c-tor allocates every slot up front.  Slot n starts out
+    with sequence n, which means "free on lap 0".
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+SampleQueue< T >::SampleQueue( size_t capacity, OverflowPolicy policy )
+: _cells( 0 ),
+  _mask( 0 ),
+  _policy( policy ),
+  _enqueue( 0 ),
+  _dequeue( 0 ),
+  _closed( false ),
+  _pushed( 0 ),
+  _popped( 0 ),
+  _droppedOldest( 0 ),
+  _droppedNewest( 0 ),
+  _blocked( 0 )
+{
+    size_t size = 2;
+
+    while ( size < capacity )
+    {
+        size <<= 1;
+    }
+
+    _mask  = size - 1;
+    _cells = new Cell[ size ];
+
+    for ( size_t c = 0; c < size; ++c )
+    {
+        _cells[ c ].sequence.store( c, std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SampleQueue()
+
+DESCRIPTION:
+    Frees the slots.  Nobody may be pushing or popping.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+SampleQueue< T >::~SampleQueue()
+{
+    delete [] _cells;
+}
+
+/*======================================================================
+FUNCTION:
+    Push()
+
+DESCRIPTION:
+    Queues a copy of item.  If the queue is full, DROP_OLDEST pops
+    the oldest sample itself and tries again, DROP_NEWEST gives up
+    right away, and BLOCK backs off until a consumer makes room.
+    Once the queue is closed nothing goes in, full or not, since
+    the consumers may already have seen it closed and empty and
+    gone.
+
+RETURN VALUE:
+    bool - true if the item was queued
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline bool SampleQueue< T >::Push( const T& item )
+{
+    unsigned int attempt = 0;
+
+    // Relaxed is enough: a Close() that happened before this push
+    // is seen by any load of the flag
+    if ( _closed.load( std::memory_order_relaxed ) )
+    {
+        return false;
+    }
+
+    while ( !tryPush( item ) )
+    {
+        if ( Closed() )
+        {
+            return false;
+        }
+
+        if ( DROP_NEWEST == _policy )
+        {
+            _droppedNewest.fetch_add( 1, std::memory_order_relaxed );
+            return false;
+        }
+
+        if ( DROP_OLDEST == _policy )
+        {
+            T discarded;
+
+            // A consumer may have beaten us to it, which is fine
+            if ( tryPop( discarded ) )
+            {
+                _droppedOldest.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+        else
+        {
+            if ( 0 == attempt )
+            {
+                _blocked.fetch_add( 1, std::memory_order_relaxed );
+            }
+
+            backoff( attempt );
+        }
+    }
+
+    _pushed.fetch_add( 1, std::memory_order_relaxed );
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    TryPop()
+
+DESCRIPTION:
+    Takes the oldest item if there is one
+
+RETURN VALUE:
+    bool - true if item was filled in
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline bool SampleQueue< T >::TryPop( T& item )
+{
+    if ( !tryPop( item ) )
+    {
+        return false;
+    }
+
+    _popped.fetch_add( 1, std::memory_order_relaxed );
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    Pop()
+
+DESCRIPTION:
+    Takes the oldest item, backing off (spin, then yield, then
+    short sleeps) while the queue is empty
+
+RETURN VALUE:
+    bool - true if item was filled in, false if the queue was
+           closed and there is nothing left
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline bool SampleQueue< T >::Pop( T& item )
+{
+    unsigned int attempt = 0;
+
+    while ( !TryPop( item ) )
+    {
+        if ( Closed() )
+        {
+            // One last look, a push may have landed before the close
+            return TryPop( item );
+        }
+
+        backoff( attempt );
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    Close()
+
+DESCRIPTION:
+    Stops new pushes.  Consumers keep getting what is left.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline void SampleQueue< T >::Close()
+{
+    _closed.store( true, std::memory_order_release );
+}
+
+/*======================================================================
+FUNCTION:
+    Size()
+
+DESCRIPTION:
+    Number of items queued right now
+
+RETURN VALUE:
+    size_t
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline size_t SampleQueue< T >::Size() const
+{
+    size_t dequeue = _dequeue.load( std::memory_order_relaxed );
+    size_t enqueue = _enqueue.load( std::memory_order_relaxed );
+
+    return ( enqueue > dequeue ) ? enqueue - dequeue : 0;
+}
+
+/*======================================================================
+FUNCTION:
+    tryPush()
+
+DESCRIPTION:
+    Claims the next free slot and fills it in.  A slot is free on
+    this lap when its sequence equals our position; it is still
+    full from the last lap when its sequence is behind.
+
+RETURN VALUE:
+    bool - false if the queue is full
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline bool SampleQueue< T >::tryPush( const T& item )
+{
+    size_t position = _enqueue.load( std::memory_order_relaxed );
+
+    while ( true )
+    {
+        Cell& cell = _cells[ position & _mask ];
+
+        size_t sequence = cell.sequence.load( std::memory_order_acquire );
+
+        intptr_t difference = ( intptr_t ) sequence - ( intptr_t ) position;
+
+        if ( 0 == difference )
+        {
+            if ( _enqueue.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+            {
+                cell.item = item;
+                cell.sequence.store( position + 1, std::memory_order_release );
+
+                return true;
+            }
+        }
+        else if ( difference < 0 )
+        {
+            return false;
+        }
+        else
+        {
+            position = _enqueue.load( std::memory_order_relaxed );
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    tryPop()
+
+DESCRIPTION:
+    Claims the oldest full slot, copies it out and hands the slot
+    back for the next lap
+
+RETURN VALUE:
+    bool - false if the queue is empty
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline bool SampleQueue< T >::tryPop( T& item )
+{
+    size_t position = _dequeue.load( std::memory_order_relaxed );
+
+    while ( true )
+    {
+        Cell& cell = _cells[ position & _mask ];
+
+        size_t sequence = cell.sequence.load( std::memory_order_acquire );
+
+        intptr_t difference = ( intptr_t ) sequence - ( intptr_t ) ( position + 1 );
+
+        if ( 0 == difference )
+        {
+            if ( _dequeue.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+            {
+                item = cell.item;
+                cell.sequence.store( position + _mask + 1, std::memory_order_release );
+
+                return true;
+            }
+        }
+        else if ( difference < 0 )
+        {
+            return false;
+        }
+        else
+        {
+            position = _dequeue.load( std::memory_order_relaxed );
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    backoff()
+
+DESCRIPTION:
+    Waits a little longer every time it is called: spins first,
+    then gives up the cpu, then sleeps 50us at a time
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+inline void SampleQueue< T >::backoff( unsigned int& attempt )
+{
+    if ( attempt < 64 )
+    {
+        // Busy wait
+    }
+    else if ( attempt < 128 )
+    {
+        sched_yield();
+    }
+    else
+    {
+        usleep( 50 );
+    }
+
+    ++attempt;
+}
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+This is the bounded queue Dmitry Vyukov published on 1024cores.net.
+Every push and pop is one compare-and-swap on the shared counter plus
+an acquire/release pair on the slot, and a slow consumer can only hold
+up the slot it is copying out of.
+
+DROP_OLDEST makes the producer act as a consumer for one pop.  A real
+consumer can take the same slot first, in which case nothing was
+dropped and the producer simply tries the push again.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLEQUEUE_H_
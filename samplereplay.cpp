@@ -0,0 +1,444 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    samplereplay.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to play a capture of raw frames back through the
+    sample handler
+
+GENERAL DESCRIPTION:
+    This file maps the capture, finds its extent, and decodes and
+    delivers its readings in batches, paced or not
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SampleReplay
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "samplereplay.h"
+#include "samplesink.h"
+#include "framedecoder.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long recordTime( const unsigned char* record );
+
+static long long nowMicroseconds();
+
+static void sleepUntil( long long microseconds );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SampleReplay()
+
+DESCRIPTION:
+    This c-tor maps the capture, checks the header and runs through
+    the records once for the sensor count and the time span
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleReplay::SampleReplay( const char* path )
+: _path( path ),
+  _mapping( MAP_FAILED ),
+  _size( 0 ),
+  _records( 0 ),
+  _sensors( 0 ),
+  _firstMicroseconds( 0 ),
+  _lastMicroseconds( 0 ),
+  _skipped( 0 ),
+  _maxLatenessMicroseconds( 0 ),
+  _stop( false )
+{
+    int fileDescriptor = open( path, O_RDONLY | O_CLOEXEC );
+
+    if ( fileDescriptor < 0 )
+    {
+        throw SensorException( "Failed to open capture " + _path );
+    }
+
+    struct stat status;
+
+    if ( 0 == fstat( fileDescriptor, &status ) && ( size_t ) status.st_size >= BinarySink::HEADER_BYTES )
+    {
+        _size = ( size_t ) status.st_size;
+
+        _mapping = mmap( 0, _size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+    }
+
+    close( fileDescriptor );
+
+    if ( MAP_FAILED == _mapping )
+    {
+        throw SensorException( "Failed to map capture " + _path );
+    }
+
+    if ( !BinarySink::ValidHeader( ( const unsigned char* ) _mapping ) )
+    {
+        munmap( _mapping, _size );
+        throw SensorException( "Not a capture written by BinarySink: " + _path );
+    }
+
+    _records = ( _size - BinarySink::HEADER_BYTES ) / BinarySink::RECORD_BYTES;
+
+    bool first = true;
+
+    for ( size_t r = 0; r < _records; ++r )
+    {
+        const unsigned char* in = record( r );
+
+        if ( BinarySink::SYNC != in[ 0 ] )
+        {
+            ++_skipped;
+            continue;
+        }
+
+        size_t sensor = ( size_t ) in[ 2 ] | ( ( size_t ) in[ 3 ] << 8 );
+
+        if ( _sensors <= sensor )
+        {
+            _sensors = sensor + 1;
+        }
+
+        _lastMicroseconds = recordTime( in );
+
+        if ( first )
+        {
+            _firstMicroseconds = _lastMicroseconds;
+            first = false;
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SampleReplay()
+
+DESCRIPTION:
+    This destructor unmaps the capture
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleReplay::~SampleReplay()
+{
+    munmap( _mapping, _size );
+}
+
+/*======================================================================
+FUNCTION:
+    Replay()
+
+DESCRIPTION:
+    Gathers up to BATCH frames, decodes them with DecodeFrames() and
+    hands the readings over one at a time.  When paced, each waits
+    for its time: the start of the replay plus its distance from the
+    first reading, divided by speed.
+
+RETURN VALUE:
+    unsigned long long - the readings handed over
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SampleReplay::Replay( SensorFleet::SampleHandler handler, Pace pace, double speed )
+{
+    unsigned char frames[ BATCH * Honeywell6130Sensor::FRAME_SIZE ];
+
+    unsigned char status[ BATCH ];
+    float tempCelcius[ BATCH ];
+    float tempFahrenheit[ BATCH ];
+    float relativeHumidity[ BATCH ];
+
+    size_t sensors[ BATCH ];
+    long long times[ BATCH ];
+
+    if ( !( 0 < speed ) )
+    {
+        speed = 1.0;
+    }
+
+    _stop.store( false, std::memory_order_relaxed );
+
+    _maxLatenessMicroseconds = 0;
+
+    long long start = nowMicroseconds();
+
+    unsigned long long delivered = 0;
+
+    size_t r = 0;
+
+    while ( r < _records && !_stop.load( std::memory_order_relaxed ) )
+    {
+        size_t count = 0;
+
+        for ( ; r < _records && count < BATCH; ++r )
+        {
+            const unsigned char* in = record( r );
+
+            if ( BinarySink::SYNC != in[ 0 ] )
+            {
+                continue;
+            }
+
+            memcpy( frames + count * Honeywell6130Sensor::FRAME_SIZE, in + 4, Honeywell6130Sensor::FRAME_SIZE );
+
+            sensors[ count ] = ( size_t ) in[ 2 ] | ( ( size_t ) in[ 3 ] << 8 );
+            times[ count ]   = recordTime( in );
+
+            ++count;
+        }
+
+        DecodeFrames( frames, count, status, tempCelcius, tempFahrenheit, relativeHumidity );
+
+        for ( size_t i = 0; i < count; ++i )
+        {
+            if ( PACE_RECORDED == pace )
+            {
+                if ( _stop.load( std::memory_order_relaxed ) )
+                {
+                    return delivered;
+                }
+
+                long long due = start + ( long long ) ( ( times[ i ] - _firstMicroseconds ) / speed );
+
+                long long now = nowMicroseconds();
+
+                if ( now < due )
+                {
+                    sleepUntil( due );
+
+                    now = nowMicroseconds();
+                }
+
+                if ( _maxLatenessMicroseconds < now - due )
+                {
+                    _maxLatenessMicroseconds = now - due;
+                }
+            }
+
+            FleetSample sample;
+
+            sample.sensorIndex           = sensors[ i ];
+            sample.timeMicroseconds      = times[ i ];
+            sample.data.status           = status[ i ];
+            sample.data.tempCelcius      = tempCelcius[ i ];
+            sample.data.tempFahrenheit   = tempFahrenheit[ i ];
+            sample.data.relativeHumidity = relativeHumidity[ i ];
+
+            handler( sample );
+
+            ++delivered;
+        }
+    }
+
+    return delivered;
+}
+
+/*======================================================================
+FUNCTION:
+    record()
+
+DESCRIPTION:
+    Finds a record in the mapping
+
+RETURN VALUE:
+    const unsigned char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const unsigned char* SampleReplay::record( size_t index ) const
+{
+    return ( const unsigned char* ) _mapping + BinarySink::HEADER_BYTES + index * BinarySink::RECORD_BYTES;
+}
+
+/*======================================================================
+FUNCTION:
+    recordTime()
+
+DESCRIPTION:
+    Reads a record's little endian time, the way BinarySink wrote it
+
+RETURN VALUE:
+    long long - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long recordTime( const unsigned char* record )
+{
+    unsigned long long time = 0;
+
+    for ( size_t b = 0; b < 8; ++b )
+    {
+        time |= ( unsigned long long ) record[ 8 + b ] << ( 8 * b );
+    }
+
+    return ( long long ) time;
+}
+
+/*======================================================================
+FUNCTION:
+    nowMicroseconds()
+
+DESCRIPTION:
+    CLOCK_MONOTONIC in microseconds
+
+RETURN VALUE:
+    long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*======================================================================
+FUNCTION:
+    sleepUntil()
+
+DESCRIPTION:
+    Sleeps until CLOCK_MONOTONIC reaches microseconds
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void sleepUntil( long long microseconds )
+{
+    struct timespec when;
+
+    when.tv_sec  = ( time_t ) ( microseconds / 1000000 );
+    when.tv_nsec = ( long ) ( microseconds % 1000000 ) * 1000;
+
+    while ( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &when, 0 ) )
+    {
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The capture is mapped rather than read so a replay of a large one
+starts at once and pages in as it goes.  The record count is fixed
+when the capture is opened, so one that is still being recorded plays
+up to that point.
+
+Decoding goes through DecodeFrames(), so a replay runs the same
+decoder (and picks the same SIMD path) as the batched acquisition.
+
+=====================================================================*/
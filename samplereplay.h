@@ -0,0 +1,250 @@
+#ifndef _SAMPLEREPLAY_H_
+#define _SAMPLEREPLAY_H_
+
+/*======================================================================
+FILE:
+    samplereplay.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Plays a recorded capture of raw sensor frames back through the
+    acquisition pipeline, without a sensor attached.
+
+DESCRIPTION:
+    This header defines the replay half of record and replay.  A
+    capture is the stream BinarySink writes (ws --record or
+    --format=binary): per reading the raw 4 byte frame with its
+    status bits, the sensor and the time it was fetched.  Replaying
+    decodes the frames in batches and hands each reading to the same
+    SampleHandler SensorFleet calls, either as fast as possible or
+    on the recorded time line, so everything downstream (queue,
+    sinks, logs, rollups, server) runs exactly as it did live.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SampleReplay
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorfleet.h"
+
+#include <atomic>
+#include <string>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Replay() calls the handler on the calling thread, one reading at a
+// time in capture order; a handler written for SensorFleet (which
+// may call it from several threads) is fine with that.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SampleReplay
+
+DESCRIPTION:
+    Maps a capture read only and checks its header.  Records that
+    do not start with BinarySink::SYNC are skipped and counted, and
+    a partial record at the end (a capture cut off mid write) is
+    left out.
+
+HOW TO USE:
+    1. Construct the object with the capture's path
+    2. Size anything per sensor with SensorCount()
+    3. Call Replay() with the handler and the pace; Stop() from
+       another thread ends it early
+
+======================================================================*/
+class SampleReplay
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    enum Pace
+    {
+        PACE_FAST,          // no waiting at all
+        PACE_RECORDED       // each reading when it came, scaled by speed
+    };
+
+    // Frames decoded at a time
+    static const size_t BATCH = 256;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws SensorException if the file can not be read or is not a
+    // capture
+    SampleReplay( const char* path );
+
+    virtual ~SampleReplay();
+
+    // Hands every reading to the handler with its recorded time.
+    // speed only matters for PACE_RECORDED: 2 plays twice as fast.
+    // Returns the readings handed over.
+    unsigned long long Replay( SensorFleet::SampleHandler handler, Pace pace = PACE_FAST, double speed = 1.0 );
+
+    // Safe from any thread
+    void Stop() { _stop.store( true, std::memory_order_relaxed ); }
+
+    size_t RecordCount() const { return _records; }
+
+    // Highest sensor index in the capture plus one
+    size_t SensorCount() const { return _sensors; }
+
+    long long FirstMicroseconds() const { return _firstMicroseconds; }
+
+    long long LastMicroseconds() const { return _lastMicroseconds; }
+
+    unsigned long long SkippedCount() const { return _skipped; }
+
+    // How far behind the recorded time line the last paced Replay()
+    // handed a reading over, at worst
+    long long MaxLatenessMicroseconds() const { return _maxLatenessMicroseconds; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleReplay( const SampleReplay &rhs );
+
+    const unsigned char* record( size_t index ) const;
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::string _path;
+
+    void* _mapping;
+
+    size_t _size;
+
+    size_t _records;
+
+    size_t _sensors;
+
+    long long _firstMicroseconds;
+
+    long long _lastMicroseconds;
+
+    unsigned long long _skipped;
+
+    long long _maxLatenessMicroseconds;
+
+    std::atomic< bool > _stop;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Why frames: the capture keeps what the sensor sent, not what we made of
+it, so a replay runs the decode again and a change to the decode (or a
+regression in it) shows up.  At 16 bytes a reading, an hour of a
+hundred sensors at 1Hz is under 6MB.
+
+Recording happens on ws's printer thread, so a reading the queue
+dropped under overload is not in the capture either; record with
+--overflow=block when every reading matters.
+
+Timing in a paced replay is against CLOCK_MONOTONIC from the start of
+Replay(), so a handler that falls behind catches up without drifting;
+MaxLatenessMicroseconds() says how far behind it got.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLEREPLAY_H_
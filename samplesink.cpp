@@ -0,0 +1,832 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    samplesink.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to buffer output and encode readings into it
+
+GENERAL DESCRIPTION:
+    This file implements the number formatters, the buffered
+    writer and the text, CSV, JSON lines and binary sinks
+
+PUBLIC CLASSES AND FUNCTIONS:
+    FormatUnsigned
+    FormatSigned
+    FormatFixed
+    SinkWriter
+    SampleSink
+    TextSink
+    CsvSink
+    JsonLinesSink
+    BinarySink
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "samplesink.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// "00" to "99", so two digits go out per division
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const unsigned long long POWERS_OF_TEN[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL
+};
+
+static const unsigned int MAX_DECIMALS = 9;
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+// Records between looks at the clock under FLUSH_INTERVAL
+static const unsigned int CLOCK_CHECK_COMMITS = 64;
+
+static const char BINARY_MAGIC[ BinarySink::HEADER_BYTES ] = { 'H', 'I', 'H', '6', '1', '3', '0', 1 };
+
+#endif
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+#if !defined( HONEYWELL_EMBEDDED )
+template< size_t N >
+static char* appendText( char* out, const char ( &text )[ N ] );
+#endif
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    FormatUnsigned()
+
+DESCRIPTION:
+    Writes value in decimal, two digits per step from the right
+
+RETURN VALUE:
+    size_t - characters written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t FormatUnsigned( unsigned long long value, char* out )
+{
+    char digits[ 20 ];
+
+    char* start = digits + sizeof( digits );
+
+    while ( 100 <= value )
+    {
+        unsigned int pair = ( unsigned int ) ( value % 100 ) * 2;
+
+        value /= 100;
+
+        *--start = DIGIT_PAIRS[ pair + 1 ];
+        *--start = DIGIT_PAIRS[ pair ];
+    }
+
+    if ( 10 <= value )
+    {
+        unsigned int pair = ( unsigned int ) value * 2;
+
+        *--start = DIGIT_PAIRS[ pair + 1 ];
+        *--start = DIGIT_PAIRS[ pair ];
+    }
+    else
+    {
+        *--start = ( char ) ( '0' + value );
+    }
+
+    size_t length = digits + sizeof( digits ) - start;
+
+    memcpy( out, start, length );
+
+    return length;
+}
+
+/*======================================================================
+FUNCTION:
+    FormatSigned()
+
+DESCRIPTION:
+    Writes value in decimal with a leading '-' when negative
+
+RETURN VALUE:
+    size_t - characters written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t FormatSigned( long long value, char* out )
+{
+    if ( value < 0 )
+    {
+        *out = '-';
+
+        // Negated as unsigned so the most negative value works too
+        return 1 + FormatUnsigned( 0 - ( unsigned long long ) value, out + 1 );
+    }
+
+    return FormatUnsigned( ( unsigned long long ) value, out );
+}
+
+/*======================================================================
+FUNCTION:
+    FormatFixed()
+
+DESCRIPTION:
+    Scales value up by 10^decimals, rounds it to an integer and
+    writes that with the decimal point put back in
+
+RETURN VALUE:
+    size_t - characters written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t FormatFixed( double value, unsigned int decimals, char* out )
+{
+    if ( MAX_DECIMALS < decimals )
+    {
+        decimals = MAX_DECIMALS;
+    }
+
+    double scale = ( double ) POWERS_OF_TEN[ decimals ];
+
+    // Also false for NaN
+    if ( !( fabs( value ) * scale < 9.0e18 ) )
+    {
+        return ( size_t ) snprintf( out, 32, "%.17g", value );
+    }
+
+    size_t length = 0;
+
+    if ( std::signbit( value ) )
+    {
+        out[ length++ ] = '-';
+        value = -value;
+    }
+
+    unsigned long long scaled = ( unsigned long long ) ( value * scale + 0.5 );
+
+    if ( 0 == decimals )
+    {
+        return length + FormatUnsigned( scaled, out + length );
+    }
+
+    unsigned long long fraction = scaled % POWERS_OF_TEN[ decimals ];
+
+    length += FormatUnsigned( scaled / POWERS_OF_TEN[ decimals ], out + length );
+
+    out[ length++ ] = '.';
+
+    // The fraction with its leading zeros
+    for ( unsigned int d = decimals; 0 < d; --d )
+    {
+        out[ length + d - 1 ] = ( char ) ( '0' + fraction % 10 );
+        fraction /= 10;
+    }
+
+    return length + decimals;
+}
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+FUNCTION:
+    SinkWriter()
+
+DESCRIPTION:
+    This c-tor allocates the buffer; nothing is written until the
+    first record
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SinkWriter::SinkWriter( int fileDescriptor, FlushPolicy policy, size_t bufferBytes, unsigned int intervalMicroseconds )
+: _fileDescriptor( fileDescriptor ),
+  _policy( policy ),
+  _intervalMicroseconds( intervalMicroseconds ),
+  _buffer( bufferBytes < SampleSink::MAX_RECORD_BYTES ? SampleSink::MAX_RECORD_BYTES : bufferBytes ),
+  _length( 0 ),
+  _oldestMicroseconds( 0 ),
+  _uncheckedCommits( 0 ),
+  _writes( 0 ),
+  _bytes( 0 ),
+  _error( 0 ),
+  _lost( 0 )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ~SinkWriter()
+
+DESCRIPTION:
+    This d-tor writes out whatever is still buffered
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SinkWriter::~SinkWriter()
+{
+    Flush();
+}
+
+/*======================================================================
+FUNCTION:
+    Commit()
+
+DESCRIPTION:
+    Takes bytes written at Reserve() into the buffer and flushes
+    if the policy says so.  FLUSH_INTERVAL reads the clock once
+    every CLOCK_CHECK_COMMITS records; a stream slow enough for
+    that to matter goes idle, and is flushed, long before.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SinkWriter::Commit( size_t bytes )
+{
+    bool wasEmpty = ( 0 == _length );
+
+    _length += bytes;
+
+    switch ( _policy )
+    {
+    case FLUSH_EVERY_RECORD:
+        Flush();
+        break;
+
+    case FLUSH_INTERVAL:
+        if ( wasEmpty )
+        {
+            _oldestMicroseconds = nowMicroseconds();
+            _uncheckedCommits   = 0;
+        }
+        else if ( CLOCK_CHECK_COMMITS <= ++_uncheckedCommits )
+        {
+            _uncheckedCommits = 0;
+
+            if ( _intervalMicroseconds <= nowMicroseconds() - _oldestMicroseconds )
+            {
+                Flush();
+            }
+        }
+        break;
+
+    case FLUSH_WHEN_FULL:
+        break;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Write()
+
+DESCRIPTION:
+    Adds bytes as one record.  Something bigger than the whole
+    buffer goes straight out after what is already buffered.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SinkWriter::Write( const void* data, size_t bytes )
+{
+    if ( _buffer.size() < bytes )
+    {
+        Flush();
+
+        if ( 0 == _error )
+        {
+            writeAll( ( const char* ) data, bytes );
+        }
+        else
+        {
+            _lost += bytes;
+        }
+
+        return;
+    }
+
+    memcpy( Reserve( bytes ), data, bytes );
+
+    Commit( bytes );
+}
+
+/*======================================================================
+FUNCTION:
+    Idle()
+
+DESCRIPTION:
+    Called when the producer has nothing more for now.  Flushes
+    unless the policy is FLUSH_WHEN_FULL, so a quiet stream is
+    never left sitting in the buffer.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SinkWriter::Idle()
+{
+    if ( FLUSH_WHEN_FULL != _policy )
+    {
+        Flush();
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Flush()
+
+DESCRIPTION:
+    Writes out the buffer.  After a failure the buffer is thrown
+    away instead.
+
+RETURN VALUE:
+    bool - false once a write has failed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SinkWriter::Flush()
+{
+    if ( 0 != _length )
+    {
+        if ( 0 == _error )
+        {
+            writeAll( &_buffer[ 0 ], _length );
+        }
+        else
+        {
+            _lost += _length;
+        }
+
+        _length = 0;
+    }
+
+    return 0 == _error;
+}
+
+/*======================================================================
+FUNCTION:
+    writeAll()
+
+DESCRIPTION:
+    write(2) until everything is out, across short writes and
+    signals.  The first error is kept and the rest is counted as
+    lost.
+
+RETURN VALUE:
+    bool - true if everything was written
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SinkWriter::writeAll( const char* data, size_t bytes )
+{
+    while ( 0 < bytes )
+    {
+        ssize_t written = write( _fileDescriptor, data, bytes );
+
+        ++_writes;
+
+        if ( written < 0 )
+        {
+            if ( EINTR == errno )
+            {
+                continue;
+            }
+
+            _error = errno;
+            _lost += bytes;
+
+            return false;
+        }
+
+        data   += written;
+        bytes  -= written;
+        _bytes += written;
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    nowMicroseconds()
+
+DESCRIPTION:
+    Reads the coarse monotonic clock, which is good to a few
+    milliseconds and costs next to nothing
+
+RETURN VALUE:
+    long long - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+long long SinkWriter::nowMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC_COARSE, &now );
+
+    return ( long long ) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*======================================================================
+FUNCTION:
+    Create()
+
+DESCRIPTION:
+    Makes the sink for a format name
+
+RETURN VALUE:
+    SampleSink* - the caller owns it; 0 for an unknown format
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SampleSink* SampleSink::Create( const char* format, SinkWriter& writer, unsigned int decimals )
+{
+    if ( 0 == strcmp( format, "text" ) )
+    {
+        return new TextSink( writer, decimals );
+    }
+
+    if ( 0 == strcmp( format, "csv" ) )
+    {
+        return new CsvSink( writer, decimals );
+    }
+
+    if ( 0 == strcmp( format, "json" ) )
+    {
+        return new JsonLinesSink( writer, decimals );
+    }
+
+    if ( 0 == strcmp( format, "binary" ) )
+    {
+        return new BinarySink( writer );
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    TextSink::Write()
+
+DESCRIPTION:
+    Sensor: 0  TempC: 22.49  TempF: 72.48  Humidity: 45.21
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void TextSink::Write( size_t sensor, long long, const TempHumidityData& data )
+{
+    char* start = _writer.Reserve( MAX_RECORD_BYTES );
+    char* out   = start;
+
+    out  = appendText( out, "Sensor: " );
+    out += FormatUnsigned( sensor, out );
+    out  = appendText( out, "  TempC: " );
+    out += FormatFixed( data.tempCelcius, _decimals, out );
+    out  = appendText( out, "  TempF: " );
+    out += FormatFixed( data.tempFahrenheit, _decimals, out );
+    out  = appendText( out, "  Humidity: " );
+    out += FormatFixed( data.relativeHumidity, _decimals, out );
+
+    *out++ = '\n';
+
+    _writer.Commit( out - start );
+}
+
+/*======================================================================
+FUNCTION:
+    CsvSink::Begin()
+
+DESCRIPTION:
+    Writes the header line
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void CsvSink::Begin()
+{
+    static const char HEADER[] = "sensor,time_us,status,celcius,fahrenheit,humidity\n";
+
+    _writer.Write( HEADER, sizeof( HEADER ) - 1 );
+}
+
+/*======================================================================
+FUNCTION:
+    CsvSink::Write()
+
+DESCRIPTION:
+    0,1792262724867221,0,22.49,72.48,45.21
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void CsvSink::Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    char* start = _writer.Reserve( MAX_RECORD_BYTES );
+    char* out   = start;
+
+    out   += FormatUnsigned( sensor, out );
+    *out++ = ',';
+    out   += FormatSigned( timeMicroseconds, out );
+    *out++ = ',';
+    out   += FormatUnsigned( data.status, out );
+    *out++ = ',';
+    out   += FormatFixed( data.tempCelcius, _decimals, out );
+    *out++ = ',';
+    out   += FormatFixed( data.tempFahrenheit, _decimals, out );
+    *out++ = ',';
+    out   += FormatFixed( data.relativeHumidity, _decimals, out );
+    *out++ = '\n';
+
+    _writer.Commit( out - start );
+}
+
+/*======================================================================
+FUNCTION:
+    JsonLinesSink::Write()
+
+DESCRIPTION:
+    {"sensor":0,"time_us":1792262724867221,"status":0,
+     "celcius":22.49,"fahrenheit":72.48,"humidity":45.21}
+    on one line.  FormatFixed() only produces a number JSON can
+    hold (it never writes "nan" for a reading that decoded).
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void JsonLinesSink::Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    char* start = _writer.Reserve( MAX_RECORD_BYTES );
+    char* out   = start;
+
+    out  = appendText( out, "{\"sensor\":" );
+    out += FormatUnsigned( sensor, out );
+    out  = appendText( out, ",\"time_us\":" );
+    out += FormatSigned( timeMicroseconds, out );
+    out  = appendText( out, ",\"status\":" );
+    out += FormatUnsigned( data.status, out );
+    out  = appendText( out, ",\"celcius\":" );
+    out += FormatFixed( data.tempCelcius, _decimals, out );
+    out  = appendText( out, ",\"fahrenheit\":" );
+    out += FormatFixed( data.tempFahrenheit, _decimals, out );
+    out  = appendText( out, ",\"humidity\":" );
+    out += FormatFixed( data.relativeHumidity, _decimals, out );
+    out  = appendText( out, "}\n" );
+
+    _writer.Commit( out - start );
+}
+
+/*======================================================================
+FUNCTION:
+    BinarySink::ValidHeader()
+
+DESCRIPTION:
+    Compares against the header Begin() writes, version included
+
+RETURN VALUE:
+    bool
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool BinarySink::ValidHeader( const unsigned char* header )
+{
+    return 0 == memcmp( header, BINARY_MAGIC, sizeof( BINARY_MAGIC ) );
+}
+
+/*======================================================================
+FUNCTION:
+    BinarySink::Begin()
+
+DESCRIPTION:
+    Writes the stream header
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void BinarySink::Begin()
+{
+    _writer.Write( BINARY_MAGIC, sizeof( BINARY_MAGIC ) );
+}
+
+/*======================================================================
+FUNCTION:
+    BinarySink::Write()
+
+DESCRIPTION:
+    Packs one 16 byte record, a byte at a time so the layout does
+    not depend on the host
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void BinarySink::Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    unsigned char* out = ( unsigned char* ) _writer.Reserve( RECORD_BYTES );
+
+    out[ 0 ] = SYNC;
+    out[ 1 ] = data.status;
+    out[ 2 ] = ( unsigned char ) sensor;
+    out[ 3 ] = ( unsigned char ) ( sensor >> 8 );
+
+    Honeywell6130Sensor::Encode( data, out + 4 );
+
+    unsigned long long time = ( unsigned long long ) timeMicroseconds;
+
+    for ( size_t b = 0; b < 8; ++b )
+    {
+        out[ 8 + b ] = ( unsigned char ) ( time >> ( 8 * b ) );
+    }
+
+    _writer.Commit( RECORD_BYTES );
+}
+
+/*======================================================================
+FUNCTION:
+    appendText()
+
+DESCRIPTION:
+    Copies a string literal, without its terminator.  The length
+    is known at compile time, so this is a couple of stores.
+
+RETURN VALUE:
+    char* - just past what was copied
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< size_t N >
+static char* appendText( char* out, const char ( &text )[ N ] )
+{
+    memcpy( out, text, N - 1 );
+
+    return out + N - 1;
+}
+
+#endif
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The old printer built each line with snprintf("%g") and pushed it
+through cout with a flush, so every reading cost a format parse, three
+float conversions and a write(2).  Here the formatting is integer
+arithmetic on the scaled value and, away from a terminal, the write
+happens once per buffer or per burst of readings.
+
+=====================================================================*/
@@ -0,0 +1,647 @@
+#ifndef _SAMPLESINK_H_
+#define _SAMPLESINK_H_
+
+/*======================================================================
+FILE:
+    samplesink.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Writes streams of readings out as text, CSV, JSON lines or
+    fixed width binary records without allocating or flushing
+    per sample.
+
+DESCRIPTION:
+    This header defines a block buffered writer over a file
+    descriptor, with a choice of when it flushes, and a small
+    family of sinks that encode readings straight into its buffer.
+    The numbers are formatted by hand (FormatFixed() and friends)
+    rather than through printf or iostreams, which is where most of
+    the time used to go.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    FormatUnsigned
+    FormatSigned
+    FormatFixed
+    SinkWriter
+    SampleSink
+    TextSink
+    CsvSink
+    JsonLinesSink
+    BinarySink
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <cstddef>
+#if !defined( HONEYWELL_EMBEDDED )
+#include <vector>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The Embedded build (HONEYWELL_EMBEDDED) has only the Format
+// functions; the writer's buffer and Create() need the heap.
+
+// A SinkWriter and the sinks on it belong to one thread.  Anything
+// else writing to the same descriptor only interleaves with it at
+// the writer's flushes, which always end on a record boundary.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// These write the number at out, without a terminator, and return the
+// length.  out needs room for 32 characters.
+
+size_t FormatUnsigned( unsigned long long value, char* out );
+
+size_t FormatSigned( long long value, char* out );
+
+// value rounded to decimals places (at most 9), like printf's "%.*f"
+// apart from exact ties, which round away from zero.  Values too big
+// to scale into 64 bits, NaN and infinity come out as "%.17g".
+size_t FormatFixed( double value, unsigned int decimals, char* out );
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+CLASS:
+    SinkWriter
+
+DESCRIPTION:
+    Collects output in one buffer and hands it to write(2) in large
+    pieces.  Records are reserved and committed so a record is
+    never split across two writes, and the flush policy decides
+    what a commit and an idle queue do:
+
+        FLUSH_EVERY_RECORD  write each record at once (a terminal)
+        FLUSH_INTERVAL      write when the buffer is full, when the
+                            oldest buffered record is older than
+                            the interval, or when the producer goes
+                            idle
+        FLUSH_WHEN_FULL     write only when the buffer is full and
+                            on Flush()
+
+    A failed write is remembered and everything after it is
+    counted and thrown away, so a full disk never stops the caller.
+
+HOW TO USE:
+    1. Construct the object with the descriptor and policy
+    2. Call Reserve() for room for a record, fill it in and call
+       Commit() with its length (the sinks do this)
+    3. Call Idle() when there is nothing more to write for now
+    4. Call Flush() before the end; the d-tor does it as well
+
+======================================================================*/
+class SinkWriter
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    enum FlushPolicy
+    {
+        FLUSH_EVERY_RECORD,
+        FLUSH_INTERVAL,
+        FLUSH_WHEN_FULL
+    };
+
+    static const size_t DEFAULT_BUFFER_BYTES = 64 * 1024;
+
+    static const unsigned int DEFAULT_INTERVAL_MICROSECONDS = 100000;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // The descriptor stays open when the writer goes
+    SinkWriter( int fileDescriptor,
+                FlushPolicy policy,
+                size_t bufferBytes = DEFAULT_BUFFER_BYTES,
+                unsigned int intervalMicroseconds = DEFAULT_INTERVAL_MICROSECONDS );
+
+    virtual ~SinkWriter();
+
+    // Room for bytes more (no more than the buffer), flushing first if
+    // need be
+    char* Reserve( size_t bytes )
+    {
+        if ( _buffer.size() - _length < bytes )
+        {
+            Flush();
+        }
+
+        return &_buffer[ _length ];
+    }
+
+    // Ends a record of bytes written at Reserve()
+    void Commit( size_t bytes );
+
+    // Reserve(), copy and Commit()
+    void Write( const void* data, size_t bytes );
+
+    // Nothing more is coming for now
+    void Idle();
+
+    // Returns false once a write has failed
+    bool Flush();
+
+    FlushPolicy Policy() const { return _policy; }
+
+    // Calls to write(2)
+    unsigned long long WriteCount() const { return _writes; }
+
+    unsigned long long ByteCount() const { return _bytes; }
+
+    // errno of the first failed write, or 0
+    int Error() const { return _error; }
+
+    // Bytes thrown away after a failed write
+    unsigned long long LostCount() const { return _lost; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SinkWriter( const SinkWriter &rhs );
+
+    bool writeAll( const char* data, size_t bytes );
+
+    static long long nowMicroseconds();
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    int _fileDescriptor;
+
+    FlushPolicy _policy;
+
+    long long _intervalMicroseconds;
+
+    std::vector< char > _buffer;
+
+    size_t _length;
+
+    // When the oldest buffered record was committed
+    long long _oldestMicroseconds;
+
+    // Commits since the clock was last read
+    unsigned int _uncheckedCommits;
+
+    unsigned long long _writes;
+
+    unsigned long long _bytes;
+
+    int _error;
+
+    unsigned long long _lost;
+
+};
+
+/*======================================================================
+CLASS:
+    SampleSink
+
+DESCRIPTION:
+    Base class for the encoders.  A sink formats each reading into
+    the writer's buffer in place; Begin() writes whatever the format
+    puts at the start of a stream (a CSV header, the binary magic).
+
+HOW TO USE:
+    1. Call Create() with a format name, or construct a subclass,
+       on a SinkWriter
+    2. Call Begin() once
+    3. Call Write() for every reading
+
+======================================================================*/
+class SampleSink
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Longest record any of the sinks writes
+    static const size_t MAX_RECORD_BYTES = 192;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // "text", "csv", "json" or "binary".  Returns 0 for anything else.
+    // decimals applies to the text formats.
+    static SampleSink* Create( const char* format, SinkWriter& writer, unsigned int decimals = 2 );
+
+    virtual ~SampleSink() { }
+
+    virtual void Begin() { }
+
+    virtual void Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data ) = 0;
+
+    SinkWriter& Writer() { return _writer; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    SampleSink( SinkWriter& writer ) : _writer( writer ) { }
+
+    SinkWriter& _writer;
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SampleSink( const SampleSink &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // None.
+
+};
+
+/*======================================================================
+CLASS:
+    TextSink
+
+DESCRIPTION:
+    The console format ws prints:
+
+        Sensor: 0  TempC: 22.49  TempF: 72.48  Humidity: 45.21
+
+HOW TO USE:
+    See SampleSink
+
+======================================================================*/
+class TextSink : public SampleSink
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    TextSink( SinkWriter& writer, unsigned int decimals = 2 ) : SampleSink( writer ), _decimals( decimals ) { }
+
+    virtual void Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    unsigned int _decimals;
+
+};
+
+/*======================================================================
+CLASS:
+    CsvSink
+
+DESCRIPTION:
+    A header line, then one row per reading:
+
+        sensor,time_us,status,celcius,fahrenheit,humidity
+
+HOW TO USE:
+    See SampleSink
+
+======================================================================*/
+class CsvSink : public SampleSink
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    CsvSink( SinkWriter& writer, unsigned int decimals = 2 ) : SampleSink( writer ), _decimals( decimals ) { }
+
+    virtual void Begin();
+
+    virtual void Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    unsigned int _decimals;
+
+};
+
+/*======================================================================
+CLASS:
+    JsonLinesSink
+
+DESCRIPTION:
+    One JSON object per line, with the same fields as CsvSink
+
+HOW TO USE:
+    See SampleSink
+
+======================================================================*/
+class JsonLinesSink : public SampleSink
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    JsonLinesSink( SinkWriter& writer, unsigned int decimals = 2 ) : SampleSink( writer ), _decimals( decimals ) { }
+
+    virtual void Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    unsigned int _decimals;
+
+};
+
+/*======================================================================
+CLASS:
+    BinarySink
+
+DESCRIPTION:
+    An 8 byte stream header, then a 16 byte record per reading
+    carrying the sensor's own frame (see DOCUMENTATION below), so
+    nothing is lost to rounding and a reader decodes it with
+    Honeywell6130Sensor::Decode().
+
+HOW TO USE:
+    See SampleSink
+
+======================================================================*/
+class BinarySink : public SampleSink
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const size_t HEADER_BYTES = 8;
+
+    static const size_t RECORD_BYTES = 16;
+
+    // First byte of every record
+    static const unsigned char SYNC = 0xa5;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    BinarySink( SinkWriter& writer ) : SampleSink( writer ) { }
+
+    // True if header (HEADER_BYTES long) starts a stream Begin()
+    // wrote, for readers such as SampleReplay
+    static bool ValidHeader( const unsigned char* header );
+
+    virtual void Begin();
+
+    virtual void Write( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // None.
+
+};
+
+#endif
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+The binary stream starts with the 8 bytes "HIH6130" and a version byte
+(1), then holds 16 byte records, every field little endian whatever
+the host:
+
+    0       0xa5, to check the framing with
+    1       status (0 - 3)
+    2 - 3   sensor index
+    4 - 7   the sensor's frame, as it came off the bus
+    8 - 15  time in microseconds since the epoch
+
+The text formats print FormatFixed() values.  Two decimals is already
+finer than the sensor resolves (about 0.01C and 0.006%RH), and unlike
+"%g" it never switches to an exponent or changes width with the value.
+
+======================================================================*/
+
+#endif	// #ifendif _SAMPLESINK_H_
@@ -0,0 +1,633 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sensordiscovery.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to find the sensors on every i2c bus
+
+GENERAL DESCRIPTION:
+    This file lists the i2c-dev nodes, runs the probe on one thread
+    per bus and gathers up what the threads found
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DiscoveryOptions
+    SensorDiscovery
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensordiscovery.h"
+#include "i2ctransport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <thread>
+#include <time.h>
+#include <utility>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// The measurement request, same as Honeywell6130Sensor sends
+static const unsigned char MEASUREMENT_COMMAND = 0;
+
+static const unsigned int STATUS_NORMAL = 0;
+static const unsigned int STATUS_STALE  = 1;
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static bool transfer( I2cTransport& transport, int address, bool read, unsigned char* data, int length );
+
+static bool claimed( I2cTransport& transport, int address );
+
+static bool sameCounts( const unsigned char first[ Honeywell6130Sensor::FRAME_SIZE ],
+                        const unsigned char second[ Honeywell6130Sensor::FRAME_SIZE ] );
+
+static long long nowMicroseconds();
+
+static void sleepUntil( long long microseconds );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    DiscoveryOptions::DiscoveryOptions()
+
+DESCRIPTION:
+    Defaults to every ordinary 7 bit address, a wait of one typical
+    conversion and polling every millisecond for up to 60ms
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+DiscoveryOptions::DiscoveryOptions()
+: conversionMicroseconds( 37000 ),
+  pollMicroseconds( 1000 ),
+  timeoutMicroseconds( 60000 )
+{
+    for ( int a = 0x08; a <= 0x77; ++a )
+    {
+        addresses.push_back( a );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SensorDiscovery()
+
+DESCRIPTION:
+    This c-tor keeps the options and the transport factory.  An
+    empty factory means i2c-dev.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorDiscovery::SensorDiscovery( const DiscoveryOptions& options,
+                                  SensorFleet::TransportFactory transportFactory )
+: _options( options ),
+  _transportFactory( transportFactory ),
+  _elapsedMicroseconds( 0 )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ~SensorDiscovery()
+
+DESCRIPTION:
+    Nothing to release; the transports go at the end of Discover()
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorDiscovery::~SensorDiscovery()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ListBuses()
+
+DESCRIPTION:
+    Reads the directory for i2c-<number> entries and sorts them by
+    number, so i2c-10 comes after i2c-2
+
+RETURN VALUE:
+    std::vector< std::string > - full paths, empty if the directory
+    can not be read
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+std::vector< std::string > SensorDiscovery::ListBuses( const char* directory )
+{
+    std::vector< std::pair< long, std::string > > found;
+
+    DIR* dir = opendir( directory );
+
+    if ( 0 != dir )
+    {
+        struct dirent* entry;
+
+        while ( 0 != ( entry = readdir( dir ) ) )
+        {
+            const char* number = entry->d_name + 4;
+
+            if ( 0 != strncmp( entry->d_name, "i2c-", 4 ) || '\0' == *number )
+            {
+                continue;
+            }
+
+            char* end = 0;
+
+            long bus = strtol( number, &end, 10 );
+
+            if ( '\0' == *end && 0 <= bus )
+            {
+                found.push_back( std::make_pair( bus, std::string( directory ) + "/" + entry->d_name ) );
+            }
+        }
+
+        closedir( dir );
+    }
+
+    std::sort( found.begin(), found.end() );
+
+    std::vector< std::string > buses;
+
+    for ( size_t b = 0; b < found.size(); ++b )
+    {
+        buses.push_back( found[ b ].second );
+    }
+
+    return buses;
+}
+
+/*======================================================================
+FUNCTION:
+    Discover()
+
+DESCRIPTION:
+    Makes a transport per bus on this thread, probes every bus on a
+    thread of its own and puts the results together in bus order
+
+RETURN VALUE:
+    std::vector< SensorAddress > - the sensors found
+
+SIDE EFFECTS:
+    Sends a measurement request to every sensor found
+
+======================================================================*/
+std::vector< SensorAddress > SensorDiscovery::Discover( const std::vector< std::string >& buses )
+{
+    long long start = nowMicroseconds();
+
+    _sensors.clear();
+
+    _buses.assign( buses.size(), BusDiscovery() );
+
+    std::vector< std::vector< DiscoveredSensor > > found( buses.size() );
+
+    std::vector< I2cTransport* > transports;
+
+    for ( size_t b = 0; b < buses.size(); ++b )
+    {
+        _buses[ b ].device = buses[ b ];
+
+        transports.push_back( _transportFactory ? _transportFactory( buses[ b ] ) : new I2cDevTransport( buses[ b ].c_str() ) );
+    }
+
+    std::vector< std::thread > threads;
+
+    for ( size_t b = 0; b < buses.size(); ++b )
+    {
+        threads.push_back( std::thread( ProbeBus, std::ref( *transports[ b ] ), std::cref( _options ),
+                                        std::ref( _buses[ b ] ), std::ref( found[ b ] ) ) );
+    }
+
+    std::vector< SensorAddress > sensors;
+
+    for ( size_t b = 0; b < buses.size(); ++b )
+    {
+        threads[ b ].join();
+
+        delete transports[ b ];
+
+        for ( size_t s = 0; s < found[ b ].size(); ++s )
+        {
+            _sensors.push_back( found[ b ][ s ] );
+
+            sensors.push_back( found[ b ][ s ].sensor );
+        }
+    }
+
+    _elapsedMicroseconds = nowMicroseconds() - start;
+
+    return sensors;
+}
+
+/*======================================================================
+FUNCTION:
+    ProbeBus()
+
+DESCRIPTION:
+    Skips the candidate addresses a kernel driver has claimed, reads
+    one byte from every other one to see who answers and with what
+    status bits, sends a measurement request to each
+    one that could be a sensor, waits one conversion for all of them
+    and then fetches each until it is fresh, and once more to see it
+    go stale with the same counts.  Sensors still converting at the
+    timeout are given up on.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    Appends the sensors found to found, in address order
+
+======================================================================*/
+void SensorDiscovery::ProbeBus( I2cTransport& transport,
+                                const DiscoveryOptions& options,
+                                BusDiscovery& bus,
+                                std::vector< DiscoveredSensor >& found )
+{
+    long long start = nowMicroseconds();
+
+    bus.claimed    = 0;
+    bus.responding = 0;
+    bus.rejected   = 0;
+    bus.recognized = 0;
+
+    bus.opened = transport.Open();
+
+    if ( !bus.opened )
+    {
+        bus.elapsedMicroseconds = nowMicroseconds() - start;
+        return;
+    }
+
+    std::vector< int > candidates;
+
+    for ( size_t a = 0; a < options.addresses.size(); ++a )
+    {
+        int address = options.addresses[ a ];
+
+        unsigned char status;
+
+        if ( address < 0 || 0x7f < address )
+        {
+            continue;
+        }
+
+        if ( claimed( transport, address ) )
+        {
+            ++bus.claimed;
+            continue;
+        }
+
+        if ( !transfer( transport, address, true, &status, 1 ) )
+        {
+            continue;
+        }
+
+        ++bus.responding;
+
+        if ( ( unsigned int ) ( status >> 6 ) <= STATUS_STALE )
+        {
+            candidates.push_back( address );
+        }
+    }
+
+    std::vector< int > pending;
+
+    long long requested = nowMicroseconds();
+
+    for ( size_t c = 0; c < candidates.size(); ++c )
+    {
+        unsigned char command = MEASUREMENT_COMMAND;
+
+        if ( transfer( transport, candidates[ c ], false, &command, 1 ) )
+        {
+            pending.push_back( candidates[ c ] );
+        }
+        else
+        {
+            ++bus.rejected;
+        }
+    }
+
+    size_t first = found.size();
+
+    if ( !pending.empty() )
+    {
+        sleepUntil( requested + options.conversionMicroseconds );
+    }
+
+    while ( !pending.empty() )
+    {
+        std::vector< int > converting;
+
+        for ( size_t p = 0; p < pending.size(); ++p )
+        {
+            unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+            unsigned char again[ Honeywell6130Sensor::FRAME_SIZE ];
+
+            if ( !transfer( transport, pending[ p ], true, frame, sizeof( frame ) ) )
+            {
+                ++bus.rejected;
+                continue;
+            }
+
+            unsigned int status = frame[ 0 ] >> 6;
+
+            if ( STATUS_STALE == status )
+            {
+                converting.push_back( pending[ p ] );
+                continue;
+            }
+
+            if ( STATUS_NORMAL != status ||
+                 !transfer( transport, pending[ p ], true, again, sizeof( again ) ) ||
+                 STATUS_STALE != ( unsigned int ) ( again[ 0 ] >> 6 ) ||
+                 !sameCounts( frame, again ) )
+            {
+                ++bus.rejected;
+                continue;
+            }
+
+            DiscoveredSensor sensor;
+
+            sensor.sensor.device  = bus.device;
+            sensor.sensor.address = pending[ p ];
+
+            Honeywell6130Sensor::Decode( frame, sensor.data );
+
+            found.push_back( sensor );
+
+            ++bus.recognized;
+        }
+
+        pending.swap( converting );
+
+        if ( pending.empty() )
+        {
+            break;
+        }
+
+        long long now = nowMicroseconds();
+
+        if ( requested + options.timeoutMicroseconds <= now )
+        {
+            bus.rejected += ( unsigned int ) pending.size();
+            break;
+        }
+
+        sleepUntil( now + options.pollMicroseconds );
+    }
+
+    std::sort( found.begin() + first, found.end(), []( const DiscoveredSensor& a, const DiscoveredSensor& b )
+    {
+        return a.sensor.address < b.sensor.address;
+    } );
+
+    transport.Close();
+
+    bus.elapsedMicroseconds = nowMicroseconds() - start;
+}
+
+/*======================================================================
+FUNCTION:
+    transfer()
+
+DESCRIPTION:
+    One read or write message to address through Transfer(), so the
+    transport's bound address is left alone
+
+RETURN VALUE:
+    bool - false on a NACK or any other failure
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool transfer( I2cTransport& transport, int address, bool read, unsigned char* data, int length )
+{
+    struct i2c_msg message;
+
+    message.addr  = ( __u16 ) address;
+    message.flags = read ? I2C_M_RD : 0;
+    message.len   = ( __u16 ) length;
+    message.buf   = data;
+
+    return 1 == transport.Transfer( &message, 1 );
+}
+
+/*======================================================================
+FUNCTION:
+    claimed()
+
+DESCRIPTION:
+    Binds address the way i2cdetect does before it probes.  i2c-dev
+    refuses I2C_SLAVE with EBUSY for an address a kernel driver is
+    bound to (the "UU" in i2cdetect's table).  Nothing goes out on
+    the bus.
+
+RETURN VALUE:
+    bool - true if the address belongs to a driver.  Any other
+    failure is left to the probe itself.
+
+SIDE EFFECTS:
+    Leaves the transport bound to address, which the probe does
+    not use
+
+======================================================================*/
+static bool claimed( I2cTransport& transport, int address )
+{
+    return !transport.SetAddress( address ) && EBUSY == errno;
+}
+
+/*======================================================================
+FUNCTION:
+    sameCounts()
+
+DESCRIPTION:
+    Compares the humidity and temperature counts of two frames,
+    leaving out the status bits and the two unused low bits
+
+RETURN VALUE:
+    bool
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static bool sameCounts( const unsigned char first[ Honeywell6130Sensor::FRAME_SIZE ],
+                        const unsigned char second[ Honeywell6130Sensor::FRAME_SIZE ] )
+{
+    return ( first[ 0 ] & 0x3f ) == ( second[ 0 ] & 0x3f ) &&
+           first[ 1 ] == second[ 1 ] &&
+           first[ 2 ] == second[ 2 ] &&
+           ( first[ 3 ] & 0xfc ) == ( second[ 3 ] & 0xfc );
+}
+
+/*======================================================================
+FUNCTION:
+    nowMicroseconds()
+
+DESCRIPTION:
+    CLOCK_MONOTONIC in microseconds
+
+RETURN VALUE:
+    long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*======================================================================
+FUNCTION:
+    sleepUntil()
+
+DESCRIPTION:
+    Sleeps until CLOCK_MONOTONIC reaches microseconds
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void sleepUntil( long long microseconds )
+{
+    struct timespec when;
+
+    when.tv_sec  = ( time_t ) ( microseconds / 1000000 );
+    when.tv_nsec = ( long ) ( microseconds % 1000000 ) * 1000;
+
+    while ( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &when, 0 ) )
+    {
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The probe uses Transfer() (I2C_RDWR) rather than SetAddress() and
+read()/write(): the address travels in the message, so one transport
+serves the whole bus.  Unlike I2C_SLAVE, I2C_RDWR does not refuse
+addresses a kernel driver has claimed, and reading or writing behind
+the driver's back can upset the part it drives.  So every address is
+first tried with SetAddress() (I2C_SLAVE), and the ones that come back
+EBUSY are counted as claimed and never touched.  That is one ioctl per
+address and no bus traffic.  The sysfs alternative
+(/sys/bus/i2c/devices/<bus>-00XX/driver) would need the bus number
+taken apart from the device path and means nothing to a simulated
+transport.
+
+The threads only share the options, which they read.  Each writes its
+own BusDiscovery and found list, and Discover() reads them after the
+join.
+
+=====================================================================*/
@@ -0,0 +1,292 @@
+#ifndef _SENSORDISCOVERY_H_
+#define _SENSORDISCOVERY_H_
+
+/*======================================================================
+FILE:
+    sensordiscovery.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Finds the HIH6130 family sensors on a board: lists the i2c-dev
+    buses, probes them all at once and hands back a sensor list
+    ready for SensorFleet.
+
+DESCRIPTION:
+    This header defines bus and address discovery.  Each bus is
+    probed on its own thread, and on a bus the probe is pipelined:
+    every candidate address is read once to see who answers, every
+    device that could be a sensor is sent a measurement request,
+    there is one conversion wait for all of them, and then each is
+    fetched twice.  A sensor is recognized by its frame and the way
+    its status bits behave: the first fetch after a conversion is
+    fresh (status 00) and a second one straight after is stale
+    (status 01) with the same counts.  A whole bus takes about one
+    conversion plus the address scan, whatever is on it.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    DiscoveryOptions
+    DiscoveredSensor
+    BusDiscovery
+    SensorDiscovery
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "sensorfleet.h"
+
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// What to probe and how long to wait for it
+struct DiscoveryOptions
+{
+    // The 7 bit addresses to try on every bus.  The c-tor fills in
+    // 0x08 - 0x77, the range i2cdetect scans; the HIH6130 ships at
+    // 0x27 but can be programmed anywhere.
+    std::vector< int > addresses;
+
+    // From the measurement requests to the first fetch.  The
+    // HIH6130 takes 36.65ms typically.
+    unsigned int conversionMicroseconds;
+
+    // Then poll every pollMicroseconds for sensors still converting,
+    // until timeoutMicroseconds after the requests
+    unsigned int pollMicroseconds;
+
+    unsigned int timeoutMicroseconds;
+
+    DiscoveryOptions();
+};
+
+// A recognized sensor and the reading it was recognized by
+struct DiscoveredSensor
+{
+    SensorAddress sensor;
+
+    TempHumidityData data;
+};
+
+// What happened on one bus
+struct BusDiscovery
+{
+    std::string device;
+
+    bool opened;
+
+    // Addresses a kernel driver is bound to.  These are skipped.
+    unsigned int claimed;
+
+    // Addresses that acknowledged, and of those the ones whose
+    // frames looked like a sensor's but whose status bits did not
+    // behave like one
+    unsigned int responding;
+    unsigned int rejected;
+
+    unsigned int recognized;
+
+    long long elapsedMicroseconds;
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Probing reads every candidate address and sends a measurement
+// request (a single 0 byte write) to whatever answers with a frame
+// that could be a sensor's.  Leave addresses of parts that object to
+// that out of DiscoveryOptions::addresses.  Addresses a kernel driver
+// has claimed are skipped without being touched.  Run discovery before
+// the fleet starts; it opens its own transport on every bus.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SensorDiscovery
+
+DESCRIPTION:
+    Probes a list of buses, one thread per bus, and keeps what it
+    found.  Transports come from the same factory SensorFleet takes,
+    so simulated buses can stand in for the real ones.  A bus that
+    can not be opened is noted and skipped.
+
+HOW TO USE:
+    1. Construct the object with the options and, for anything but
+       i2c-dev, a transport factory
+    2. Call Discover(), with ListBuses() or your own bus list
+    3. Hand the result to SensorFleet; look at Sensors() and Buses()
+       for the details
+
+======================================================================*/
+class SensorDiscovery
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SensorDiscovery( const DiscoveryOptions& options = DiscoveryOptions(),
+                     SensorFleet::TransportFactory transportFactory = SensorFleet::TransportFactory() );
+
+    virtual ~SensorDiscovery();
+
+    // The i2c-dev nodes (i2c-0, i2c-1, ...) in directory, in bus
+    // number order
+    static std::vector< std::string > ListBuses( const char* directory = "/dev" );
+
+    // Probes every bus at once.  Returns the sensors found, by bus
+    // in the order given and then by address.
+    std::vector< SensorAddress > Discover( const std::vector< std::string >& buses );
+
+    const std::vector< DiscoveredSensor >& Sensors() const { return _sensors; }
+
+    const std::vector< BusDiscovery >& Buses() const { return _buses; }
+
+    // Wall time of the last Discover()
+    long long ElapsedMicroseconds() const { return _elapsedMicroseconds; }
+
+    // Probes one bus on the calling thread.  Discover() runs this
+    // once per bus.
+    static void ProbeBus( I2cTransport& transport,
+                          const DiscoveryOptions& options,
+                          BusDiscovery& bus,
+                          std::vector< DiscoveredSensor >& found );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorDiscovery( const SensorDiscovery &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    DiscoveryOptions _options;
+
+    SensorFleet::TransportFactory _transportFactory;
+
+    std::vector< DiscoveredSensor > _sensors;
+
+    std::vector< BusDiscovery > _buses;
+
+    long long _elapsedMicroseconds;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+What counts as a sensor: the first read must acknowledge with status
+00 or 01 (a part that has not been asked to measure yet shows its old
+result as stale).  After the measurement request a fetch must come
+back fresh within the timeout, and a second fetch straight after must
+come back stale with the same 14 bit counts.  An EEPROM or register
+device reads the same bytes, status bits and all, every time, and
+most other parts answer 0xff or 0x00 to a bare read, so they fall
+out at one step or the other.  A part whose first byte happens to read
+01 every time (a real time clock at 45 seconds) looks like a sensor
+still converting and holds its bus until the timeout.
+
+Where the time goes: the address scan is a 1 byte read per address,
+about 0.2ms at 100kHz, so 112 addresses are about 20ms.  Then one
+conversion wait, about 37ms, covers every sensor on the bus.  Probing
+address by address with a conversion wait each would take seconds
+for a bus with a few sensors on it.
+
+======================================================================*/
+
+#endif	// #ifendif _SENSORDISCOVERY_H_
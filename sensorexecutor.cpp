@@ -0,0 +1,559 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sensorexecutor.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to run sensor coroutines on one thread
+
+GENERAL DESCRIPTION:
+    This file implements the epoll/timerfd event loop behind
+    SensorExecutor and the sensor version of WhenAll()
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SensorExecutor
+    WhenAll
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorexecutor.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static void drain( int fileDescriptor );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SensorExecutor()
+
+DESCRIPTION:
+    This c-tor creates the epoll set with the timerfd and the
+    eventfd Stop() uses in it
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorExecutor::SensorExecutor()
+: _epoll( -1 ),
+  _timer( -1 ),
+  _wake( -1 ),
+  _sequence( 0 ),
+  _armedDeadline( 0 ),
+  _active( 0 ),
+  _stopping( false ),
+  _wakeups( 0 )
+{
+    _epoll = epoll_create1( EPOLL_CLOEXEC );
+    _timer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    _wake  = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+    bool ok = ( 0 <= _epoll && 0 <= _timer && 0 <= _wake );
+
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( event ) );
+
+    event.events = EPOLLIN;
+
+    if ( ok )
+    {
+        event.data.fd = _timer;
+        ok = ( 0 == epoll_ctl( _epoll, EPOLL_CTL_ADD, _timer, &event ) );
+    }
+
+    if ( ok )
+    {
+        event.data.fd = _wake;
+        ok = ( 0 == epoll_ctl( _epoll, EPOLL_CTL_ADD, _wake, &event ) );
+    }
+
+    if ( !ok )
+    {
+        int descriptors[] = { _epoll, _timer, _wake };
+
+        for ( size_t d = 0; d < sizeof( descriptors ) / sizeof( descriptors[ 0 ] ); ++d )
+        {
+            if ( 0 <= descriptors[ d ] )
+            {
+                close( descriptors[ d ] );
+            }
+        }
+
+        throw SensorException( "Failed to create the executor's epoll set" );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SensorExecutor()
+
+DESCRIPTION:
+    This destructor closes the descriptors.  Coroutines still
+    asleep are never resumed, and their frames leak, so let Run()
+    finish first.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorExecutor::~SensorExecutor()
+{
+    close( _epoll );
+    close( _timer );
+    close( _wake );
+}
+
+/*======================================================================
+FUNCTION:
+    Spawn()
+
+DESCRIPTION:
+    This method starts a top level task and keeps count of it so
+    Run() knows when everything is done
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorExecutor::Spawn( SensorTask< void > task )
+{
+    ++_active;
+
+    runSpawned( std::move( task ) );
+}
+
+/*======================================================================
+FUNCTION:
+    runSpawned()
+
+DESCRIPTION:
+    The detached coroutine that owns a spawned task
+
+RETURN VALUE:
+    DetachedTask
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+DetachedTask SensorExecutor::runSpawned( SensorTask< void > task )
+{
+    co_await task;
+
+    --_active;
+}
+
+/*======================================================================
+FUNCTION:
+    Sleep()
+
+DESCRIPTION:
+    This method works out the deadline for a sleep.  The awaiter
+    puts the coroutine in the timer heap when it suspends.
+
+RETURN VALUE:
+    SleepAwaiter
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorExecutor::SleepAwaiter SensorExecutor::Sleep( unsigned int microseconds )
+{
+    return SleepAwaiter( *this, ( 0 == microseconds ) ? 0 : Now() + ( long long ) microseconds * 1000 );
+}
+
+/*======================================================================
+FUNCTION:
+    schedule()
+
+DESCRIPTION:
+    This method puts a suspended coroutine in the timer heap
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorExecutor::schedule( long long deadline, std::coroutine_handle<> handle )
+{
+    Timer timer;
+
+    timer.deadline = deadline;
+    timer.sequence = _sequence++;
+    timer.handle   = handle;
+
+    _timers.push( timer );
+}
+
+/*======================================================================
+FUNCTION:
+    Run()
+
+DESCRIPTION:
+    This method is the event loop.  It resumes every coroutine
+    whose deadline has passed, points the timerfd at the next
+    deadline and waits in epoll_wait() for it (or for Stop()).
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    Throws a SensorException if epoll_wait() fails
+
+======================================================================*/
+void SensorExecutor::Run()
+{
+    while ( 0 < _active && !_stopping.load( std::memory_order_relaxed ) )
+    {
+        resumeDue();
+
+        if ( 0 == _active || _stopping.load( std::memory_order_relaxed ) )
+        {
+            break;
+        }
+
+        if ( !_timers.empty() )
+        {
+            armTimer( _timers.top().deadline );
+        }
+
+        struct epoll_event events[ 2 ];
+
+        int ready = epoll_wait( _epoll, events, 2, -1 );
+
+        ++_wakeups;
+
+        if ( ready < 0 )
+        {
+            if ( EINTR == errno )
+            {
+                continue;
+            }
+
+            throw SensorException( "epoll_wait failed" );
+        }
+
+        for ( int e = 0; e < ready; ++e )
+        {
+            drain( events[ e ].data.fd );
+
+            if ( _timer == events[ e ].data.fd )
+            {
+                _armedDeadline = 0;
+            }
+        }
+    }
+
+    _stopping = false;
+}
+
+/*======================================================================
+FUNCTION:
+    Stop()
+
+DESCRIPTION:
+    This method asks Run() to return after the coroutine it is
+    running now suspends
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorExecutor::Stop()
+{
+    _stopping = true;
+
+    const unsigned long long one = 1;
+
+    // Non-blocking, and a full counter already means Run() will wake
+    if ( write( _wake, &one, sizeof( one ) ) < 0 )
+    {
+        return;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ActiveTasks(), WakeupCount()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    The requested count
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t SensorExecutor::ActiveTasks() const
+{
+    return _active;
+}
+
+unsigned long long SensorExecutor::WakeupCount() const
+{
+    return _wakeups;
+}
+
+/*======================================================================
+FUNCTION:
+    Now()
+
+DESCRIPTION:
+    Reads the monotonic clock, the same one the timerfd runs on
+
+RETURN VALUE:
+    long long - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+long long SensorExecutor::Now()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*======================================================================
+FUNCTION:
+    resumeDue()
+
+DESCRIPTION:
+    This method resumes every coroutine whose deadline is at or
+    before now.  The clock is read once, so a coroutine that goes
+    back to sleep right away waits for the next pass.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorExecutor::resumeDue()
+{
+    const long long now = Now();
+
+    while ( !_timers.empty() && _timers.top().deadline <= now &&
+            !_stopping.load( std::memory_order_relaxed ) )
+    {
+        std::coroutine_handle<> handle = _timers.top().handle;
+
+        _timers.pop();
+
+        handle.resume();
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    armTimer()
+
+DESCRIPTION:
+    This method points the timerfd at a deadline, unless it is
+    already set for that deadline or an earlier one.  An earlier
+    one just gives us a wakeup with nothing to do.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorExecutor::armTimer( long long deadline )
+{
+    if ( 0 != _armedDeadline && _armedDeadline <= deadline )
+    {
+        return;
+    }
+
+    struct itimerspec setting;
+
+    memset( &setting, 0, sizeof( setting ) );
+
+    setting.it_value.tv_sec  = deadline / 1000000000LL;
+    setting.it_value.tv_nsec = deadline % 1000000000LL;
+
+    timerfd_settime( _timer, TFD_TIMER_ABSTIME, &setting, 0 );
+
+    _armedDeadline = deadline;
+}
+
+/*======================================================================
+FUNCTION:
+    WhenAll()
+
+DESCRIPTION:
+    Starts a ReadAsync() on every sensor and waits for all of them.
+    The sensors list is taken by value since the coroutine outlives
+    the caller's expression.
+
+RETURN VALUE:
+    SensorTask< std::vector< SensorReading > > - one reading per
+    sensor, in order
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorTask< std::vector< SensorReading > > WhenAll( SensorExecutor& executor,
+                                                    std::vector< Honeywell6130Sensor* > sensors )
+{
+    std::vector< SensorTask< SensorReading > > reads;
+
+    reads.reserve( sensors.size() );
+
+    for ( size_t s = 0; s < sensors.size(); ++s )
+    {
+        reads.push_back( sensors[ s ]->ReadAsync( executor ) );
+    }
+
+    co_return co_await WhenAll( std::move( reads ) );
+}
+
+/*======================================================================
+FUNCTION:
+    drain()
+
+DESCRIPTION:
+    Empties the counter of a timerfd or eventfd so epoll stops
+    reporting it
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void drain( int fileDescriptor )
+{
+    unsigned long long count;
+
+    while ( read( fileDescriptor, &count, sizeof( count ) ) == sizeof( count ) )
+    {
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+A round of N sensors through WhenAll() sleeps N coroutines with
+deadlines a few microseconds apart.  The timerfd is armed for the
+first one, and by the time epoll_wait() returns the rest are due too,
+so resumeDue() runs all of them in one pass.
+
+=====================================================================*/
@@ -0,0 +1,637 @@
+#ifndef _SENSOREXECUTOR_H_
+#define _SENSOREXECUTOR_H_
+
+/*======================================================================
+FILE:
+    sensorexecutor.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Lets coroutines read Honeywell 6130 sensors without blocking
+    the thread they run on.
+
+DESCRIPTION:
+    This header defines a coroutine task type, a single threaded
+    executor that sleeps in epoll_wait() on a timerfd, and the
+    WhenAll() fan-out helpers.  Honeywell6130Sensor::ReadAsync()
+    is built on them: the settle time suspends the coroutine, not
+    the thread, so thousands of reads interleave on one thread.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SensorReading
+    SensorTask
+    SensorExecutor
+    WhenAll
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// What ReadAsync() hands back.  data is good for READ_OK, and for
+// READ_STALE if the sensor never came back with a fresh measurement.
+struct SensorReading
+{
+    Honeywell6130Sensor::ReadError error;
+    TempHumidityData data;
+};
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Everything here runs on the thread that calls Run().  Only Stop()
+// may be called from another thread.  A sensor must not have two
+// reads in flight at once, since both would share its transport.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SensorTask
+
+DESCRIPTION:
+    A coroutine that produces a T.  It does not start until it is
+    co_awaited (or handed to SensorExecutor::Spawn()), and when it
+    finishes it resumes whoever awaited it.  An exception thrown
+    inside comes out of the co_await.
+
+HOW TO USE:
+    1. Write a coroutine returning SensorTask< T > and co_return
+       a T from it
+    2. co_await it from another coroutine
+
+======================================================================*/
+template< class T >
+class SensorTask;
+
+// The parts of the promise that do not depend on T
+class SensorPromiseBase
+{
+public:
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template< class Promise >
+        std::coroutine_handle<> await_suspend( std::coroutine_handle< Promise > handle ) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise()._continuation;
+
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept { }
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return std::suspend_always(); }
+
+    FinalAwaiter final_suspend() const noexcept { return FinalAwaiter(); }
+
+    void unhandled_exception() { _exception = std::current_exception(); }
+
+    void SetContinuation( std::coroutine_handle<> continuation ) { _continuation = continuation; }
+
+    void RethrowIfFailed() const
+    {
+        if ( _exception )
+        {
+            std::rethrow_exception( _exception );
+        }
+    }
+
+private:
+
+    std::coroutine_handle<> _continuation;
+
+    std::exception_ptr _exception;
+};
+
+template< class T >
+class SensorPromise : public SensorPromiseBase
+{
+public:
+
+    SensorTask< T > get_return_object();
+
+    void return_value( T value ) { _value = std::move( value ); }
+
+    T& Value() { RethrowIfFailed(); return _value; }
+
+private:
+
+    T _value;
+};
+
+template<>
+class SensorPromise< void > : public SensorPromiseBase
+{
+public:
+
+    SensorTask< void > get_return_object();
+
+    void return_void() { }
+
+    void Value() { RethrowIfFailed(); }
+};
+
+template< class T >
+class SensorTask
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef SensorPromise< T > promise_type;
+
+    typedef std::coroutine_handle< promise_type > Handle;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SensorTask() : _handle( 0 ) { }
+
+    explicit SensorTask( Handle handle ) : _handle( handle ) { }
+
+    SensorTask( SensorTask&& rhs ) noexcept : _handle( rhs._handle ) { rhs._handle = 0; }
+
+    SensorTask& operator=( SensorTask&& rhs ) noexcept
+    {
+        if ( this != &rhs )
+        {
+            destroy();
+            _handle = rhs._handle;
+            rhs._handle = 0;
+        }
+
+        return *this;
+    }
+
+    ~SensorTask() { destroy(); }
+
+    bool Done() const { return !_handle || _handle.done(); }
+
+    // What co_await uses.  Awaiting starts the task and picks up
+    // where we left off once it finishes.
+    class Awaiter
+    {
+    public:
+
+        explicit Awaiter( Handle handle ) : _handle( handle ) { }
+
+        bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+        std::coroutine_handle<> await_suspend( std::coroutine_handle<> awaiting ) noexcept
+        {
+            _handle.promise().SetContinuation( awaiting );
+
+            return _handle;
+        }
+
+        T await_resume()
+        {
+            if constexpr ( std::is_void< T >::value )
+            {
+                _handle.promise().Value();
+            }
+            else
+            {
+                return std::move( _handle.promise().Value() );
+            }
+        }
+
+    private:
+
+        Handle _handle;
+    };
+
+    Awaiter operator co_await() const noexcept { return Awaiter( _handle ); }
+
+private:
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorTask( const SensorTask &rhs );
+
+    void destroy()
+    {
+        if ( _handle )
+        {
+            _handle.destroy();
+            _handle = 0;
+        }
+    }
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    Handle _handle;
+
+};
+
+/*======================================================================
+CLASS:
+    DetachedTask
+
+DESCRIPTION:
+    The coroutine type used under the covers to run a SensorTask
+    that nobody awaits.  It starts right away and frees itself when
+    it is done.  Not for use outside of this header.
+
+HOW TO USE:
+    Return it from a coroutine that co_awaits the real work
+
+======================================================================*/
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() const noexcept { return DetachedTask(); }
+
+        std::suspend_never initial_suspend() const noexcept { return std::suspend_never(); }
+
+        std::suspend_never final_suspend() const noexcept { return std::suspend_never(); }
+
+        void return_void() const noexcept { }
+
+        // Same as an exception escaping a std::thread
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+/*======================================================================
+CLASS:
+    SensorExecutor
+
+DESCRIPTION:
+    A single threaded event loop for sensor coroutines.  Sleeping
+    coroutines wait in a deadline ordered heap.  Run() arms one
+    timerfd for the earliest deadline, waits for it in epoll, and
+    resumes everyone who is due, so a thousand sensors settling
+    at the same time cost one wakeup instead of a thousand.
+
+HOW TO USE:
+    1. Construct the object
+    2. Spawn() the top level coroutines
+    3. Call Run(); it returns when they are all done or when
+       Stop() is called
+
+======================================================================*/
+class SensorExecutor
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // What Sleep() returns
+    class SleepAwaiter
+    {
+    public:
+
+        SleepAwaiter( SensorExecutor& executor, long long deadline )
+        : _executor( executor ), _deadline( deadline ) { }
+
+        bool await_ready() const noexcept { return _deadline <= 0; }
+
+        void await_suspend( std::coroutine_handle<> handle ) { _executor.schedule( _deadline, handle ); }
+
+        void await_resume() const noexcept { }
+
+    private:
+
+        SensorExecutor& _executor;
+
+        long long _deadline;
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if epoll or the timerfd can not be
+    // created
+    SensorExecutor();
+
+    virtual ~SensorExecutor();
+
+    // Starts the task right away.  It runs until its first
+    // suspension before Spawn() returns, and the rest of it runs
+    // inside Run().
+    void Spawn( SensorTask< void > task );
+
+    // Suspends the calling coroutine for at least the given time.
+    // Zero does not suspend.
+    SleepAwaiter Sleep( unsigned int microseconds );
+
+    void Run();
+
+    // Can be called from any thread, or from inside a coroutine
+    void Stop();
+
+    // Spawned tasks that have not finished
+    size_t ActiveTasks() const;
+
+    // Times Run() came back from epoll_wait()
+    unsigned long long WakeupCount() const;
+
+    // Monotonic clock in nanoseconds
+    static long long Now();
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct Timer
+    {
+        long long deadline;
+        unsigned long long sequence;
+        std::coroutine_handle<> handle;
+
+        // Earliest first, and first come first served on a tie
+        bool operator>( const Timer& rhs ) const
+        {
+            return deadline != rhs.deadline ? deadline > rhs.deadline : sequence > rhs.sequence;
+        }
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorExecutor( const SensorExecutor &rhs );
+
+    void schedule( long long deadline, std::coroutine_handle<> handle );
+
+    void resumeDue();
+
+    void armTimer( long long deadline );
+
+    DetachedTask runSpawned( SensorTask< void > task );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    int _epoll;
+
+    int _timer;
+
+    // Written by Stop() to break epoll_wait()
+    int _wake;
+
+    std::priority_queue< Timer, std::vector< Timer >, std::greater< Timer > > _timers;
+
+    unsigned long long _sequence;
+
+    // Deadline the timerfd is set for, or 0 if it is not set
+    long long _armedDeadline;
+
+    size_t _active;
+
+    std::atomic< bool > _stopping;
+
+    unsigned long long _wakeups;
+
+};
+
+/*======================================================================
+CLASS:
+    WhenAllAwaiter
+
+DESCRIPTION:
+    Starts every task at once and resumes the awaiting coroutine
+    when the last one finishes.  A task that throws still counts as
+    finished; the others run to the end and the first exception is
+    rethrown to the awaiting coroutine.  Use it through WhenAll().
+
+HOW TO USE:
+    co_await WhenAllAwaiter< T >( tasks, results )
+
+======================================================================*/
+template< class T >
+class WhenAllAwaiter
+{
+public:
+
+    WhenAllAwaiter( std::vector< SensorTask< T > >& tasks, std::vector< T >& results )
+    : _tasks( tasks ), _results( results ), _remaining( 0 ), _exception() { }
+
+    bool await_ready() const noexcept { return _tasks.empty(); }
+
+    bool await_suspend( std::coroutine_handle<> awaiting )
+    {
+        _awaiting = awaiting;
+
+        // One extra so a task that finishes without suspending
+        // can not resume us before everyone has been started
+        _remaining = _tasks.size() + 1;
+
+        for ( size_t t = 0; t < _tasks.size(); ++t )
+        {
+            runOne( this, t );
+        }
+
+        return 0 != --_remaining;
+    }
+
+    void await_resume() const
+    {
+        if ( _exception )
+        {
+            std::rethrow_exception( _exception );
+        }
+    }
+
+private:
+
+    // Catches what the task throws, since escaping a DetachedTask
+    // terminates, and the awaiting coroutine would never be resumed
+    static DetachedTask runOne( WhenAllAwaiter* awaiter, size_t index )
+    {
+        try
+        {
+            awaiter->_results[ index ] = co_await awaiter->_tasks[ index ];
+        }
+        catch( ... )
+        {
+            if ( !awaiter->_exception )
+            {
+                awaiter->_exception = std::current_exception();
+            }
+        }
+
+        if ( 0 == --awaiter->_remaining )
+        {
+            awaiter->_awaiting.resume();
+        }
+    }
+
+    std::vector< SensorTask< T > >& _tasks;
+
+    std::vector< T >& _results;
+
+    size_t _remaining;
+
+    std::coroutine_handle<> _awaiting;
+
+    // The first exception a task threw
+    std::exception_ptr _exception;
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+template< class T >
+inline SensorTask< T > SensorPromise< T >::get_return_object()
+{
+    return SensorTask< T >( std::coroutine_handle< SensorPromise< T > >::from_promise( *this ) );
+}
+
+inline SensorTask< void > SensorPromise< void >::get_return_object()
+{
+    return SensorTask< void >( std::coroutine_handle< SensorPromise< void > >::from_promise( *this ) );
+}
+
+/*======================================================================
+FUNCTION:
+    WhenAll()
+
+DESCRIPTION:
+    Runs every task at the same time and waits for all of them
+
+RETURN VALUE:
+    SensorTask< std::vector< T > > - the results, in task order.
+    If a task threw, awaiting it throws the first exception once
+    every task has finished.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< class T >
+SensorTask< std::vector< T > > WhenAll( std::vector< SensorTask< T > > tasks )
+{
+    std::vector< T > results( tasks.size() );
+
+    co_await WhenAllAwaiter< T >( tasks, results );
+
+    co_return results;
+}
+
+// One ReadAsync() per sensor, all settling at the same time.  The
+// readings come back in the same order as the sensors.
+SensorTask< std::vector< SensorReading > > WhenAll( SensorExecutor& executor,
+                                                    std::vector< Honeywell6130Sensor* > sensors );
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Tasks are lazy and resume their awaiter by symmetric transfer from
+final_suspend, so a chain of co_awaits never grows the stack.  Nothing
+here allocates per wakeup except the coroutine frames themselves and
+the timer heap, which stops growing once it has held the largest
+number of sleepers.
+
+The executor does not own a thread.  With one executor per thread
+and no shared sensors, several can run side by side.
+
+======================================================================*/
+
+#endif	// #ifendif _SENSOREXECUTOR_H_
@@ -0,0 +1,962 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sensorfilterbank.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Round at a time smoothing and outlier rejection
+
+GENERAL DESCRIPTION:
+    This file has the filter bank's bookkeeping and one vector
+    kernel for a round, built for AVX2, SSE2, 64 bit ARM NEON and
+    plain C++ and picked once at run time
+
+PUBLIC CLASSES AND FUNCTIONS:
+    FilterBankOptions
+    SensorFilterBank
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define FILTERBANK_X86
+#elif defined( __aarch64__ )
+#define FILTERBANK_NEON
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorfilterbank.h"
+
+#include <cstring>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// Everything a pass over the sensors needs, pointing into the bank
+struct FilterRound
+{
+    const unsigned char* status;
+    const float* celcius;
+    const float* humidity;
+
+    // Sensors first to first + count - 1; count is a multiple of
+    // the widest pass
+    size_t first;
+    size_t count;
+
+    float* ema[ 2 ];
+    float* median[ 2 ];
+    float* kalman[ 2 ];
+    float* variance[ 2 ];
+    float* window[ 2 ];
+
+    size_t stride;
+    unsigned int windowSize;
+    unsigned int windowSlot;
+
+    int32_t* primed;
+    unsigned char* reasons;
+
+    const FilterBankOptions* options;
+
+    // Out: accepted, then one per reason bit
+    unsigned long long counts[ 6 ];
+};
+
+typedef void ( *RoundFunction )( FilterRound& round );
+
+// GCC vector extensions, as in psychrometrics.cpp
+typedef float    Float4 __attribute__(( vector_size( 16 ) ));
+typedef int32_t  Int4   __attribute__(( vector_size( 16 ) ));
+typedef uint8_t  Byte4  __attribute__(( vector_size( 4 ) ));
+
+#if defined( FILTERBANK_X86 )
+typedef float    Float8 __attribute__(( vector_size( 32 ) ));
+typedef int32_t  Int8   __attribute__(( vector_size( 32 ) ));
+typedef uint8_t  Byte8  __attribute__(( vector_size( 8 ) ));
+#endif
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static RoundFunction pickImplementation( const char** name );
+
+static void roundGeneric( FilterRound& round );
+
+#if defined( FILTERBANK_X86 )
+static void roundSse2( FilterRound& round );
+static void roundAvx2( FilterRound& round );
+#endif
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    FilterBankOptions::FilterBankOptions()
+
+DESCRIPTION:
+    The defaults the header's DOCUMENTATION explains
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+FilterBankOptions::FilterBankOptions()
+: emaAlpha( 0.2f ),
+  medianWindow( 5 ),
+  spikeCelcius( 2.0f ),
+  spikeHumidity( 5.0f ),
+  minCelcius( -40.0f ),
+  maxCelcius( 125.0f ),
+  minHumidity( 0.0f ),
+  maxHumidity( 100.0f ),
+  processCelcius( 0.02f * 0.02f ),
+  processHumidity( 0.05f * 0.05f ),
+  noiseCelcius( 0.05f * 0.05f ),
+  noiseHumidity( 0.2f * 0.2f )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    SensorFilterBank()
+
+DESCRIPTION:
+    This c-tor sizes every array to the sensor count rounded up to
+    LANES, so a pass never needs a scalar tail on the state, and
+    stages an empty round
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorFilterBank::SensorFilterBank( size_t sensorCount, const FilterBankOptions& options )
+: _options( options ),
+  _sensorCount( sensorCount ),
+  _stride( ( sensorCount + LANES - 1 ) / LANES * LANES ),
+  _windowSlot( 0 ),
+  _rounds( 0 ),
+  _accepted( 0 )
+{
+    if ( !( 1 == options.medianWindow || 3 == options.medianWindow ||
+            5 == options.medianWindow || 7 == options.medianWindow ) )
+    {
+        throw SensorException( "The median window must be 1, 3, 5 or 7 readings" );
+    }
+
+    for ( int c = 0; c < 2; ++c )
+    {
+        _ema[ c ].assign( _stride, 0.0f );
+        _median[ c ].assign( _stride, 0.0f );
+        _kalman[ c ].assign( _stride, 0.0f );
+        _variance[ c ].assign( _stride, 0.0f );
+
+        // A window of one is the reading itself
+        if ( 1 < options.medianWindow )
+        {
+            _window[ c ].assign( _stride * options.medianWindow, 0.0f );
+        }
+    }
+
+    _primed.assign( _stride, 0 );
+
+    _reasons.assign( _stride, REJECT_MISSING );
+
+    _stagedStatus.assign( _stride, ( unsigned char ) STATUS_MISSING );
+    _stagedCelcius.assign( _stride, 0.0f );
+    _stagedHumidity.assign( _stride, 0.0f );
+
+    memset( _rejected, 0, sizeof( _rejected ) );
+}
+
+/*======================================================================
+FUNCTION:
+    ~SensorFilterBank()
+
+DESCRIPTION:
+    Nothing to release
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorFilterBank::~SensorFilterBank()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Update()
+
+DESCRIPTION:
+    Runs the kernel over the whole groups of LANES sensors straight
+    from the caller's arrays, and over the last partial group from a
+    copy padded out with missing readings
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFilterBank::Update( const unsigned char* status,
+                               const float* tempCelcius,
+                               const float* relativeHumidity,
+                               size_t count,
+                               unsigned char* reasons )
+{
+    static const RoundFunction run = pickImplementation( 0 );
+
+    if ( _sensorCount < count )
+    {
+        count = _sensorCount;
+    }
+
+    FilterRound round;
+
+    round.stride     = _stride;
+    round.windowSize = _options.medianWindow;
+    round.windowSlot = _windowSlot;
+    round.primed     = _primed.data();
+    round.reasons    = _reasons.data();
+    round.options    = &_options;
+
+    for ( int c = 0; c < 2; ++c )
+    {
+        round.ema[ c ]      = _ema[ c ].data();
+        round.median[ c ]   = _median[ c ].data();
+        round.kalman[ c ]   = _kalman[ c ].data();
+        round.variance[ c ] = _variance[ c ].data();
+        round.window[ c ]   = _window[ c ].data();
+    }
+
+    memset( round.counts, 0, sizeof( round.counts ) );
+
+    size_t whole = count / LANES * LANES;
+
+    if ( 0 < whole )
+    {
+        round.status   = status;
+        round.celcius  = tempCelcius;
+        round.humidity = relativeHumidity;
+        round.first    = 0;
+        round.count    = whole;
+
+        run( round );
+    }
+
+    size_t padding = 0;
+
+    if ( whole < count )
+    {
+        unsigned char tailStatus[ LANES ];
+        float tailCelcius[ LANES ];
+        float tailHumidity[ LANES ];
+
+        for ( size_t l = 0; l < LANES; ++l )
+        {
+            bool real = whole + l < count;
+
+            tailStatus[ l ]   = real ? ( status ? status[ whole + l ] : 0 ) : STATUS_MISSING;
+            tailCelcius[ l ]  = real ? tempCelcius[ whole + l ] : 0.0f;
+            tailHumidity[ l ] = real ? relativeHumidity[ whole + l ] : 0.0f;
+        }
+
+        padding = LANES - ( count - whole );
+
+        round.status   = tailStatus;
+        round.celcius  = tailCelcius;
+        round.humidity = tailHumidity;
+        round.first    = whole;
+        round.count    = LANES;
+
+        run( round );
+    }
+
+    // Sensors past count were not in the round at all
+    for ( size_t s = count; s < _sensorCount; ++s )
+    {
+        _reasons[ s ] = REJECT_MISSING;
+    }
+
+    _accepted += round.counts[ 0 ];
+
+    for ( size_t r = 0; r < REASONS; ++r )
+    {
+        _rejected[ r ] += round.counts[ r + 1 ];
+    }
+
+    // The padding was counted as missing; the sensors past count
+    // were not counted at all
+    _rejected[ 0 ] -= padding;
+    _rejected[ 0 ] += _sensorCount - count;
+
+    if ( 1 < _options.medianWindow )
+    {
+        _windowSlot = ( _windowSlot + 1 ) % _options.medianWindow;
+    }
+
+    ++_rounds;
+
+    if ( 0 != reasons )
+    {
+        memcpy( reasons, _reasons.data(), count );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Stage()
+
+DESCRIPTION:
+    Keeps the reading for the sensor's place in the next round
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFilterBank::Stage( size_t sensor, const TempHumidityData& data )
+{
+    if ( sensor < _sensorCount )
+    {
+        _stagedStatus[ sensor ]   = data.status;
+        _stagedCelcius[ sensor ]  = data.tempCelcius;
+        _stagedHumidity[ sensor ] = data.relativeHumidity;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    UpdateStaged()
+
+DESCRIPTION:
+    Runs the staged round and marks every sensor missing for the
+    next one
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFilterBank::UpdateStaged( unsigned char* reasons )
+{
+    Update( _stagedStatus.data(), _stagedCelcius.data(), _stagedHumidity.data(), _sensorCount, reasons );
+
+    memset( _stagedStatus.data(), STATUS_MISSING, _stagedStatus.size() );
+}
+
+/*======================================================================
+FUNCTION:
+    Reset()
+
+DESCRIPTION:
+    Unprimes the sensor.  Its next good reading fills its window and
+    starts its filters again, so nothing else needs clearing.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFilterBank::Reset( size_t sensor )
+{
+    if ( sensor < _sensorCount )
+    {
+        _primed[ sensor ] = 0;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    RejectedCount()
+
+DESCRIPTION:
+    Looks up the count for one reason bit
+
+RETURN VALUE:
+    unsigned long long - 0 for anything that is not a single bit
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SensorFilterBank::RejectedCount( Reason reason ) const
+{
+    for ( size_t r = 0; r < REASONS; ++r )
+    {
+        if ( ( unsigned int ) reason == ( 1u << r ) )
+        {
+            return _rejected[ r ];
+        }
+    }
+
+    return 0;
+}
+
+/*======================================================================
+FUNCTION:
+    Implementation()
+
+DESCRIPTION:
+    Names the kernel Update() uses
+
+RETURN VALUE:
+    const char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* SensorFilterBank::Implementation()
+{
+    const char* name = 0;
+
+    pickImplementation( &name );
+
+    return name;
+}
+
+/*======================================================================
+FUNCTION:
+    pickImplementation()
+
+DESCRIPTION:
+    Checks what the CPU can do and hands back the best kernel
+
+RETURN VALUE:
+    RoundFunction
+
+SIDE EFFECTS:
+    *name is set to the implementation name if name is not 0
+
+======================================================================*/
+static RoundFunction pickImplementation( const char** name )
+{
+    const char* ignored;
+
+    if ( 0 == name )
+    {
+        name = &ignored;
+    }
+
+#if defined( FILTERBANK_X86 )
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        *name = "avx2";
+        return roundAvx2;
+    }
+
+    if ( __builtin_cpu_supports( "sse2" ) )
+    {
+        *name = "sse2";
+        return roundSse2;
+    }
+#elif defined( FILTERBANK_NEON )
+    // Float4 is a NEON register here
+    *name = "neon";
+    return roundGeneric;
+#endif
+
+    *name = "generic";
+    return roundGeneric;
+}
+
+/*======================================================================
+FUNCTION:
+    widen()
+
+DESCRIPTION:
+    Zero extends a vector's worth of status bytes to 32 bit lanes.
+    The bytes are loaded as one integer and spread out with a byte
+    shuffle against zeros, which comes out as a move and one zero
+    extend; a convert of a byte vector comes out lane by lane.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    *lanes is set
+
+======================================================================*/
+static inline __attribute__(( always_inline )) void widen( const unsigned char* bytes, Int4& lanes )
+{
+    typedef uint8_t Byte16 __attribute__(( vector_size( 16 ) ));
+
+    uint32_t word;
+
+    memcpy( &word, bytes, sizeof( word ) );
+
+    Int4 loaded = { ( int32_t ) word, 0, 0, 0 };
+
+    Byte16 spread = ( Byte16 ) loaded;
+
+    lanes = ( Int4 ) __builtin_shufflevector( spread, spread,
+                                              0, 4, 4, 4, 1, 4, 4, 4, 2, 4, 4, 4, 3, 4, 4, 4 );
+}
+
+#if defined( FILTERBANK_X86 )
+static inline __attribute__(( always_inline )) void widen( const unsigned char* bytes, Int8& lanes )
+{
+    typedef uint8_t  Byte16 __attribute__(( vector_size( 16 ) ));
+    typedef uint64_t Long2  __attribute__(( vector_size( 16 ) ));
+
+    uint64_t word;
+
+    memcpy( &word, bytes, sizeof( word ) );
+
+    Long2 loaded = { word, 0 };
+
+    Byte16 spread = ( Byte16 ) loaded;
+
+    lanes = ( Int8 ) __builtin_shufflevector( spread, spread,
+                                              0, 8, 8, 8, 1, 8, 8, 8, 2, 8, 8, 8, 3, 8, 8, 8,
+                                              4, 8, 8, 8, 5, 8, 8, 8, 6, 8, 8, 8, 7, 8, 8, 8 );
+}
+#endif
+
+/*======================================================================
+FUNCTION:
+    narrow()
+
+DESCRIPTION:
+    Stores the low byte of each 32 bit lane, the other way round from
+    widen()
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    bytes[ 0 ] to bytes[ lanes - 1 ] are written
+
+======================================================================*/
+static inline __attribute__(( always_inline )) void narrow( const Int4& lanes, unsigned char* bytes )
+{
+    typedef uint8_t Byte16 __attribute__(( vector_size( 16 ) ));
+
+    Byte16 all = ( Byte16 ) lanes;
+
+    Byte4 low = __builtin_shufflevector( all, all, 0, 4, 8, 12 );
+
+    memcpy( bytes, &low, sizeof( low ) );
+}
+
+#if defined( FILTERBANK_X86 )
+static inline __attribute__(( always_inline )) void narrow( const Int8& lanes, unsigned char* bytes )
+{
+    typedef uint8_t Byte32 __attribute__(( vector_size( 32 ) ));
+
+    Byte32 all = ( Byte32 ) lanes;
+
+    Byte8 low = __builtin_shufflevector( all, all, 0, 4, 8, 12, 16, 20, 24, 28 );
+
+    memcpy( bytes, &low, sizeof( low ) );
+}
+#endif
+
+/*======================================================================
+FUNCTION:
+    filterPass()
+
+DESCRIPTION:
+    One round for every group of sensors a vector wide.  Per channel
+    the reading goes into its window slice (every slice, for a
+    sensor's first good reading), the window is sorted with an odd
+    even transposition network and the middle taken.  Everything
+    after that is selects on the lane masks, so all lanes run the
+    same instructions whatever happened to their readings.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    round.counts is added to
+
+======================================================================*/
+template< typename F, typename I, unsigned int N >
+static inline __attribute__(( always_inline )) void filterPass( FilterRound& round )
+{
+    const size_t WIDTH = sizeof( F ) / sizeof( float );
+
+    const FilterBankOptions& options = *round.options;
+
+    // Copied out of round and options, because the reason codes are
+    // stored through a char pointer, which as far as the compiler
+    // knows could change any of them
+    const unsigned char* statusIn = round.status;
+    const float* readingIn[ 2 ]   = { round.celcius, round.humidity };
+
+    float* emaState[ 2 ]      = { round.ema[ 0 ], round.ema[ 1 ] };
+    float* medianState[ 2 ]   = { round.median[ 0 ], round.median[ 1 ] };
+    float* kalmanState[ 2 ]   = { round.kalman[ 0 ], round.kalman[ 1 ] };
+    float* varianceState[ 2 ] = { round.variance[ 0 ], round.variance[ 1 ] };
+    float* windowState[ 2 ]   = { round.window[ 0 ], round.window[ 1 ] };
+
+    int32_t* primedState      = round.primed;
+    unsigned char* reasonsOut = round.reasons;
+
+    const size_t first      = round.first;
+    const size_t count      = round.count;
+    const size_t stride     = round.stride;
+    const unsigned int slot = round.windowSlot;
+
+    const float alpha        = options.emaAlpha;
+    const float low[ 2 ]     = { options.minCelcius, options.minHumidity };
+    const float high[ 2 ]    = { options.maxCelcius, options.maxHumidity };
+    const float process[ 2 ] = { options.processCelcius, options.processHumidity };
+    const float noise[ 2 ]   = { options.noiseCelcius, options.noiseHumidity };
+    const float spike[ 2 ]   = { options.spikeCelcius, options.spikeHumidity };
+
+    I accepted     = I{};
+    I missingCount = I{};
+    I statusCount  = I{};
+    I rangeCount   = I{};
+    I spikeCount[ 2 ] = { I{}, I{} };
+
+    for ( size_t j = 0; j < count; j += WIDTH )
+    {
+        size_t i = first + j;
+
+        F reading[ 2 ];
+
+        memcpy( &reading[ 0 ], &readingIn[ 0 ][ j ], sizeof( F ) );
+        memcpy( &reading[ 1 ], &readingIn[ 1 ][ j ], sizeof( F ) );
+
+        I status = I{};
+
+        if ( 0 != statusIn )
+        {
+            widen( &statusIn[ j ], status );
+        }
+
+        I primed;
+
+        memcpy( &primed, &primedState[ i ], sizeof( primed ) );
+
+        I missing   = ( status > 3 );
+        I badStatus = ( status != 0 ) & ~missing;
+
+        // Written so a NaN fails
+        I inRange = ( reading[ 0 ] >= low[ 0 ] ) & ( reading[ 0 ] <= high[ 0 ] ) &
+                    ( reading[ 1 ] >= low[ 1 ] ) & ( reading[ 1 ] <= high[ 1 ] );
+
+        I badRange = ( status == 0 ) & ~inRange;
+        I good     = ( status == 0 ) & inRange;
+        I start    = good & ~primed;
+
+        F median[ 2 ];
+        I spiked[ 2 ];
+
+        #pragma GCC unroll 8
+        for ( int c = 0; c < 2; ++c )
+        {
+            median[ c ] = reading[ c ];
+            spiked[ c ] = I{};
+
+            if ( 1 < N )
+            {
+                F window[ N ];
+
+                #pragma GCC unroll 8
+                for ( unsigned int k = 0; k < N; ++k )
+                {
+                    float* slice = &windowState[ c ][ k * stride + i ];
+
+                    memcpy( &window[ k ], slice, sizeof( F ) );
+
+                    I take = ( k == slot ) ? good : start;
+
+                    window[ k ] = take ? reading[ c ] : window[ k ];
+
+                    memcpy( slice, &window[ k ], sizeof( F ) );
+                }
+
+                #pragma GCC unroll 8
+                for ( unsigned int pass = 0; pass < N; ++pass )
+                {
+                    #pragma GCC unroll 8
+                    for ( unsigned int k = pass & 1; k + 1 < N; k += 2 )
+                    {
+                        F lower  = ( window[ k ] < window[ k + 1 ] ) ? window[ k ] : window[ k + 1 ];
+                        F higher = ( window[ k ] < window[ k + 1 ] ) ? window[ k + 1 ] : window[ k ];
+
+                        window[ k ]     = lower;
+                        window[ k + 1 ] = higher;
+                    }
+                }
+
+                median[ c ] = window[ N / 2 ];
+
+                F distance = reading[ c ] - median[ c ];
+
+                distance = ( distance < 0.0f ) ? -distance : distance;
+
+                spiked[ c ] = good & primed & ( distance > spike[ c ] );
+            }
+        }
+
+        I accept = good & ~spiked[ 0 ] & ~spiked[ 1 ];
+        I update = accept & primed;
+
+        #pragma GCC unroll 8
+        for ( int c = 0; c < 2; ++c )
+        {
+            F ema;
+            F kalman;
+            F variance;
+            F last;
+
+            memcpy( &ema, &emaState[ c ][ i ], sizeof( F ) );
+            memcpy( &kalman, &kalmanState[ c ][ i ], sizeof( F ) );
+            memcpy( &variance, &varianceState[ c ][ i ], sizeof( F ) );
+            memcpy( &last, &medianState[ c ][ i ], sizeof( F ) );
+
+            F x = reading[ c ];
+
+            ema = start ? x : ( update ? ema + alpha * ( x - ema ) : ema );
+
+            F predicted = variance + process[ c ];
+            F gain      = predicted / ( predicted + noise[ c ] );
+
+            F estimate = kalman + gain * ( x - kalman );
+            F settled  = ( 1.0f - gain ) * predicted;
+
+            kalman   = start ? x : ( update ? estimate : kalman );
+            variance = start ? F{} + noise[ c ] : ( update ? settled : variance );
+            last     = good ? median[ c ] : last;
+
+            memcpy( &emaState[ c ][ i ], &ema, sizeof( F ) );
+            memcpy( &kalmanState[ c ][ i ], &kalman, sizeof( F ) );
+            memcpy( &varianceState[ c ][ i ], &variance, sizeof( F ) );
+            memcpy( &medianState[ c ][ i ], &last, sizeof( F ) );
+        }
+
+        primed = primed | good;
+
+        memcpy( &primedState[ i ], &primed, sizeof( primed ) );
+
+        I reason = ( missing & ( int ) SensorFilterBank::REJECT_MISSING ) |
+                   ( badStatus & ( int ) SensorFilterBank::REJECT_STATUS ) |
+                   ( badRange & ( int ) SensorFilterBank::REJECT_RANGE ) |
+                   ( spiked[ 0 ] & ( int ) SensorFilterBank::REJECT_TEMPERATURE_SPIKE ) |
+                   ( spiked[ 1 ] & ( int ) SensorFilterBank::REJECT_HUMIDITY_SPIKE );
+
+        narrow( reason, &reasonsOut[ i ] );
+
+        // Masks are -1, so subtracting counts them
+        accepted      -= accept;
+        missingCount  -= missing;
+        statusCount   -= badStatus;
+        rangeCount    -= badRange;
+        spikeCount[ 0 ] -= spiked[ 0 ];
+        spikeCount[ 1 ] -= spiked[ 1 ];
+    }
+
+    for ( size_t l = 0; l < WIDTH; ++l )
+    {
+        round.counts[ 0 ] += ( unsigned int ) accepted[ l ];
+        round.counts[ 1 ] += ( unsigned int ) missingCount[ l ];
+        round.counts[ 2 ] += ( unsigned int ) statusCount[ l ];
+        round.counts[ 3 ] += ( unsigned int ) rangeCount[ l ];
+        round.counts[ 4 ] += ( unsigned int ) spikeCount[ 0 ][ l ];
+        round.counts[ 5 ] += ( unsigned int ) spikeCount[ 1 ][ l ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    filterRound()
+
+DESCRIPTION:
+    Picks the pass for the window size, so the sorting network is
+    unrolled for it
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+template< typename F, typename I >
+static inline __attribute__(( always_inline )) void filterRound( FilterRound& round )
+{
+    switch ( round.windowSize )
+    {
+        case 3:  filterPass< F, I, 3 >( round ); break;
+        case 5:  filterPass< F, I, 5 >( round ); break;
+        case 7:  filterPass< F, I, 7 >( round ); break;
+        default: filterPass< F, I, 1 >( round ); break;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    roundGeneric()
+
+DESCRIPTION:
+    4 sensors per pass in whatever the compiler makes of a 16 byte
+    vector: NEON on 64 bit ARM, SSE2 on x86, pairs or single floats
+    elsewhere
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void roundGeneric( FilterRound& round )
+{
+    filterRound< Float4, Int4 >( round );
+}
+
+#if defined( FILTERBANK_X86 )
+
+/*======================================================================
+FUNCTION:
+    roundSse2()
+
+DESCRIPTION:
+    4 sensors per pass with SSE2
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "sse2" ) ))
+static void roundSse2( FilterRound& round )
+{
+    filterRound< Float4, Int4 >( round );
+}
+
+/*======================================================================
+FUNCTION:
+    roundAvx2()
+
+DESCRIPTION:
+    8 sensors per pass with AVX2
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+__attribute__(( target( "avx2" ) ))
+static void roundAvx2( FilterRound& round )
+{
+    filterRound< Float8, Int8 >( round );
+}
+
+#endif
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Every lane does all the work every round, accepted or not, and the
+masks decide what is kept.  That costs nothing extra in a vector and
+keeps the pass free of branches that depend on the readings, which a
+fleet with a few bad sensors would otherwise mispredict all the time.
+
+The window is stored as medianWindow slices of one float per sensor,
+not medianWindow floats per sensor, so loading one slot for a vector
+of sensors is one contiguous load.
+
+The counts are kept per lane in the pass and added up once at the
+end of it.
+
+=====================================================================*/
@@ -0,0 +1,354 @@
+#ifndef _SENSORFILTERBANK_H_
+#define _SENSORFILTERBANK_H_
+
+/*======================================================================
+FILE:
+    sensorfilterbank.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Smooths every sensor's readings and throws out the bad ones, a
+    whole polling round at a time.
+
+DESCRIPTION:
+    This header defines the filter bank.  It keeps per sensor state
+    for three filters on both channels: an exponential moving
+    average, a median of the last few readings that also rejects
+    spikes, and a one dimensional Kalman filter.  The state lives in
+    one array per quantity (structure of arrays), so a round of
+    readings for thousands of sensors is one pass over contiguous
+    memory, several sensors at a time with SIMD instructions where
+    the CPU has them.  Every reading gets a reason code saying
+    whether it was used and if not, why.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    FilterBankOptions
+    SensorFilterBank
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+struct FilterBankOptions
+{
+    // Weight of the newest reading in the moving average (0 - 1]
+    float emaAlpha;
+
+    // Readings the median is taken over: 1 (no spike rejection),
+    // 3, 5 or 7
+    unsigned int medianWindow;
+
+    // A reading this far from the median of the window it is in is
+    // a spike
+    float spikeCelcius;
+    float spikeHumidity;
+
+    // Anything outside these is impossible for where the sensors
+    // are.  The defaults are the sensor's full scale, so only a NaN
+    // fails them; tighten them to catch stuck at 0 or all ones frames.
+    float minCelcius;
+    float maxCelcius;
+    float minHumidity;
+    float maxHumidity;
+
+    // Kalman filter: how much the true value may wander per round
+    // and how noisy a reading is, both as variances
+    float processCelcius;
+    float processHumidity;
+    float noiseCelcius;
+    float noiseHumidity;
+
+    FilterBankOptions();
+};
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A SensorFilterBank belongs to one thread, like a WindowAggregator.
+// Stage() from the bus threads and Update() from another would race;
+// hand the readings over through a SampleQueue instead.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SensorFilterBank
+
+DESCRIPTION:
+    One round is one reading (or none) per sensor.  A reading is
+    checked in order for a missing or non zero status, for range and
+    for a spike against the median of its window; a reading that
+    passes updates all three filters, one that does not leaves them
+    alone.  The window still takes every reading with a good status
+    in range, so a real step change is accepted once it holds for
+    more than half the window.  A sensor's first good reading starts
+    all of its filters at that value.
+
+HOW TO USE:
+    1. Construct the object with the sensor count and the options
+    2. Each round either call Update() with arrays indexed by
+       sensor, or Stage() the readings as they come and then call
+       UpdateStaged()
+    3. Read the filtered values from the arrays EmaCelcius() and
+       friends hand back, and the reason codes from Reasons()
+
+======================================================================*/
+class SensorFilterBank
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Why a reading was not used.  The spike bits can come together.
+    enum Reason
+    {
+        ACCEPTED                 = 0,
+        REJECT_MISSING           = 0x01,    // no reading this round
+        REJECT_STATUS            = 0x02,    // stale, command mode or diagnostic
+        REJECT_RANGE             = 0x04,    // outside the options' range, or NaN
+        REJECT_TEMPERATURE_SPIKE = 0x08,
+        REJECT_HUMIDITY_SPIKE    = 0x10
+    };
+
+    static const unsigned int MAX_MEDIAN_WINDOW = 7;
+
+    // A status past the sensor's two bits, for a sensor that has no
+    // reading this round
+    static const unsigned char STATUS_MISSING = 0xff;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws SensorException for a median window that is not 1, 3,
+    // 5 or 7
+    SensorFilterBank( size_t sensorCount, const FilterBankOptions& options = FilterBankOptions() );
+
+    virtual ~SensorFilterBank();
+
+    // One round for sensors 0 to count - 1; the rest are left as
+    // they are.  status can be 0 if every reading is fresh, and
+    // reasons 0 if Reasons() will do.
+    void Update( const unsigned char* status,
+                 const float* tempCelcius,
+                 const float* relativeHumidity,
+                 size_t count,
+                 unsigned char* reasons = 0 );
+
+    // Holds a reading for the next UpdateStaged().  A sensor staged
+    // twice keeps the later reading.
+    void Stage( size_t sensor, const TempHumidityData& data );
+
+    // Runs the staged round and starts the next one with every
+    // sensor missing
+    void UpdateStaged( unsigned char* reasons = 0 );
+
+    // Forgets everything about the sensor; its next good reading
+    // starts it again
+    void Reset( size_t sensor );
+
+    size_t SensorCount() const { return _sensorCount; }
+
+    const FilterBankOptions& Options() const { return _options; }
+
+    // The filtered values, indexed by sensor.  A sensor that has
+    // not had a good reading yet reads 0.
+    const float* EmaCelcius() const       { return _ema[ 0 ].data(); }
+    const float* EmaHumidity() const      { return _ema[ 1 ].data(); }
+    const float* MedianCelcius() const    { return _median[ 0 ].data(); }
+    const float* MedianHumidity() const   { return _median[ 1 ].data(); }
+    const float* KalmanCelcius() const    { return _kalman[ 0 ].data(); }
+    const float* KalmanHumidity() const   { return _kalman[ 1 ].data(); }
+
+    // The Kalman filters' variances, how sure they are
+    const float* KalmanCelciusVariance() const  { return _variance[ 0 ].data(); }
+    const float* KalmanHumidityVariance() const { return _variance[ 1 ].data(); }
+
+    // The last round's reason codes, indexed by sensor
+    const unsigned char* Reasons() const { return _reasons.data(); }
+
+    unsigned long long RoundCount() const { return _rounds; }
+
+    unsigned long long AcceptedCount() const { return _accepted; }
+
+    // Readings that carried reason (one of the bits)
+    unsigned long long RejectedCount( Reason reason ) const;
+
+    // Name of the implementation picked ("avx2", "sse2", "neon" or
+    // "generic")
+    static const char* Implementation();
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorFilterBank( const SensorFilterBank &rhs );
+
+    // Arrays are padded to this many sensors, the widest pass
+    static const size_t LANES = 8;
+
+    // The reason bits counted, in bit order
+    static const size_t REASONS = 5;
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    FilterBankOptions _options;
+
+    size_t _sensorCount;
+
+    // Rounded up to LANES
+    size_t _stride;
+
+    // [ channel ], 0 Celcius and 1 humidity
+    std::vector< float > _ema[ 2 ];
+    std::vector< float > _median[ 2 ];
+    std::vector< float > _kalman[ 2 ];
+    std::vector< float > _variance[ 2 ];
+
+    // [ channel ], medianWindow slices of _stride readings each
+    std::vector< float > _window[ 2 ];
+
+    // Slice the next reading goes in; the same for every sensor
+    unsigned int _windowSlot;
+
+    // -1 once a sensor has had a good reading, 0 before
+    std::vector< int32_t > _primed;
+
+    std::vector< unsigned char > _reasons;
+
+    // The staged round
+    std::vector< unsigned char > _stagedStatus;
+    std::vector< float > _stagedCelcius;
+    std::vector< float > _stagedHumidity;
+
+    unsigned long long _rounds;
+
+    unsigned long long _accepted;
+
+    unsigned long long _rejected[ REASONS ];
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Which filter to read: the median follows steps at once and ignores
+single bad readings but moves in counts; the moving average is smooth
+but lags by about 1 / emaAlpha rounds; the Kalman filter weighs each
+reading by how sure it is of itself, so it settles quickly after a
+start and then smooths about as hard as the noise settings say.
+
+Why rejected readings still go in the window: a window of only the
+readings it kept would never move to a new level, and everything
+after a real step would be a spike for ever.  A sensor with a bad
+status or an impossible value is not in the window at all.
+
+The window's slices are shared by every sensor and move on once per
+round.  A sensor with no reading in a round keeps what was in the
+slice, so its window is still its last readings, just aged out in a
+slightly different order, which the median does not care about.
+
+The defaults: an alpha of 0.2, a median of 5 with spikes at 2C and
+5%RH (far past a real change between readings a second apart), and
+Kalman noise of 0.05C and 0.2%RH per reading (a little over the
+sensor's resolution) with the true value wandering by 0.02C and
+0.05%RH a round.
+
+======================================================================*/
+
+#endif	// #ifendif _SENSORFILTERBANK_H_
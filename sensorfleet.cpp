@@ -0,0 +1,907 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sensorfleet.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Polls many Honeywell 6130 sensors across several i2c buses
+
+GENERAL DESCRIPTION:
+    This file has the bus worker threads that pipeline the
+    measurement rounds for every sensor on a bus
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SensorFleet
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Make sure the sensors are connected to the i2c buses
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorfleet.h"
+#include "sensorstats.h"
+#include "uringacquisition.h"
+
+#include <chrono>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long nowNanoseconds();
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SensorFleet()
+
+DESCRIPTION:
+    This c-tor groups the sensors by bus and opens every one
+    of them.  A sensor that fails to open throws a
+    SensorException just like a single Honeywell6130Sensor does.
+    MODE_URING quietly becomes MODE_PER_SENSOR if the ring can
+    not be used.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorFleet::SensorFleet( const std::vector< SensorAddress >& sensors,
+                          unsigned int roundMicroseconds,
+                          Mode mode,
+                          TransportFactory transportFactory )
+: _mode( mode ),
+  _uring( 0 ),
+  _sensorCount( sensors.size() ),
+  _roundMicroseconds( roundMicroseconds ),
+  _running( false ),
+  _sampleCount( 0 ),
+  _errorCount( 0 ),
+  _startNanoseconds( 0 )
+{
+    for ( size_t index = 0; index < sensors.size(); ++index )
+    {
+        Bus* bus = 0;
+
+        for ( size_t b = 0; b < _buses.size(); ++b )
+        {
+            if ( _buses[ b ]->device == sensors[ index ].device )
+            {
+                bus = _buses[ b ];
+                break;
+            }
+        }
+
+        if ( 0 == bus )
+        {
+            bus = new Bus;
+            bus->device = sensors[ index ].device;
+            bus->batch = 0;
+            _buses.push_back( bus );
+        }
+
+        bus->addresses.push_back( sensors[ index ].address );
+        bus->sensorIndexes.push_back( index );
+    }
+
+    try
+    {
+        for ( size_t b = 0; b < _buses.size(); ++b )
+        {
+            Bus* bus = _buses[ b ];
+
+            if ( MODE_BATCHED == mode )
+            {
+                if ( transportFactory )
+                {
+                    bus->transports.push_back( transportFactory( bus->device ) );
+                    bus->batch = new Honeywell6130Bus( bus->transports.back(), bus->addresses );
+                }
+                else
+                {
+                    bus->batch = new Honeywell6130Bus( bus->device.c_str(), bus->addresses );
+                }
+
+                bus->batchData.resize( bus->addresses.size() );
+                continue;
+            }
+
+            for ( size_t s = 0; s < bus->addresses.size(); ++s )
+            {
+                // The io_uring needs the file descriptors, so the
+                // fleet keeps hold of the transports
+                if ( MODE_URING == mode && !transportFactory )
+                {
+                    bus->transports.push_back( new I2cDevTransport( bus->device.c_str() ) );
+                    bus->sensors.push_back( new Honeywell6130Sensor( bus->transports.back(),
+                                                                     bus->addresses[ s ] ) );
+                }
+                else if ( transportFactory )
+                {
+                    bus->transports.push_back( transportFactory( bus->device ) );
+                    bus->sensors.push_back( new Honeywell6130Sensor( bus->transports.back(),
+                                                                     bus->addresses[ s ] ) );
+                }
+                else
+                {
+                    bus->sensors.push_back( new Honeywell6130Sensor( bus->device.c_str(),
+                                                                     bus->addresses[ s ] ) );
+                }
+            }
+        }
+    }
+    catch( ... )
+    {
+        destroyBuses();
+        throw;
+    }
+
+    if ( MODE_URING == _mode )
+    {
+        setupUring();
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    setupUring()
+
+DESCRIPTION:
+    This method gathers the bound file descriptor of every sensor
+    and builds the ring.  If the kernel has no io_uring, or a
+    transport has no file descriptor (a simulated one), the
+    sensors are already open for the blocking path, so we just
+    switch to MODE_PER_SENSOR.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::setupUring()
+{
+    _mode = MODE_PER_SENSOR;
+
+    if ( !UringAcquisition::Available() )
+    {
+        return;
+    }
+
+    std::vector< int > fileDescriptors;
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        for ( size_t s = 0; s < _buses[ b ]->transports.size(); ++s )
+        {
+            int fileDescriptor = _buses[ b ]->transports[ s ]->FileDescriptor();
+
+            if ( fileDescriptor < 0 )
+            {
+                return;
+            }
+
+            fileDescriptors.push_back( fileDescriptor );
+            _uringSensorIndexes.push_back( _buses[ b ]->sensorIndexes[ s ] );
+        }
+    }
+
+    if ( fileDescriptors.empty() )
+    {
+        return;
+    }
+
+    try
+    {
+        _uring = new UringAcquisition( fileDescriptors, DEFAULT_SETTLE_MICROSECONDS, DEFAULT_STALE_RETRIES );
+    }
+    catch( SensorException& )
+    {
+        _uringSensorIndexes.clear();
+        return;
+    }
+
+    _uringData.resize( fileDescriptors.size() );
+
+    _mode = MODE_URING;
+}
+
+/*======================================================================
+FUNCTION:
+    ~SensorFleet()
+
+DESCRIPTION:
+    This destructor stops the workers and closes every sensor
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorFleet::~SensorFleet()
+{
+    Stop();
+
+    destroyBuses();
+}
+
+/*======================================================================
+FUNCTION:
+    destroyBuses()
+
+DESCRIPTION:
+    This method closes every sensor and throws the buses away
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::destroyBuses()
+{
+    delete _uring;
+    _uring = 0;
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        for ( size_t s = 0; s < _buses[ b ]->sensors.size(); ++s )
+        {
+            delete _buses[ b ]->sensors[ s ];
+        }
+
+        delete _buses[ b ]->batch;
+
+        for ( size_t t = 0; t < _buses[ b ]->transports.size(); ++t )
+        {
+            delete _buses[ b ]->transports[ t ];
+        }
+
+        delete _buses[ b ];
+    }
+
+    _buses.clear();
+}
+
+/*======================================================================
+FUNCTION:
+    Start()
+
+DESCRIPTION:
+    This method starts one worker thread per bus.  Workers are
+    spread across the available cores.  In MODE_URING there is
+    only the one worker.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    handler is called from the worker threads
+
+======================================================================*/
+void SensorFleet::Start( SampleHandler handler )
+{
+    if ( _running.exchange( true ) )
+    {
+        return;
+    }
+
+    _handler = handler;
+
+    _sampleCount = 0;
+    _errorCount  = 0;
+    _startNanoseconds = nowNanoseconds();
+
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+
+    if ( cores < 1 )
+    {
+        cores = 1;
+    }
+
+    if ( 0 != _uring )
+    {
+        _uringWorker = std::thread( &SensorFleet::runBus, this, ( Bus* ) 0, 0u );
+        return;
+    }
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        _buses[ b ]->worker = std::thread( &SensorFleet::runBus, this, _buses[ b ],
+                                           ( unsigned int ) ( b % cores ) );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SetCombined()
+
+DESCRIPTION:
+    This method turns combined transfers on or off for the batched
+    buses on device, or every batched bus
+
+RETURN VALUE:
+    size_t - number of buses changed, 0 outside MODE_BATCHED
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t SensorFleet::SetCombined( bool combined, const std::string& device )
+{
+    size_t changed = 0;
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        Bus* bus = _buses[ b ];
+
+        if ( 0 != bus->batch && ( device.empty() || device == bus->device ) )
+        {
+            bus->batch->SetCombined( combined );
+            ++changed;
+        }
+    }
+
+    return changed;
+}
+
+/*======================================================================
+FUNCTION:
+    Stop()
+
+DESCRIPTION:
+    This method asks the workers to finish their current round
+    and waits for them
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::Stop()
+{
+    if ( !_running.exchange( false ) )
+    {
+        return;
+    }
+
+    if ( _uringWorker.joinable() )
+    {
+        _uringWorker.join();
+    }
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        if ( _buses[ b ]->worker.joinable() )
+        {
+            _buses[ b ]->worker.join();
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SensorCount(), BusCount(), GetMode(), SampleCount(), ErrorCount()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    The requested count
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t SensorFleet::SensorCount() const
+{
+    return _sensorCount;
+}
+
+size_t SensorFleet::BusCount() const
+{
+    return _buses.size();
+}
+
+SensorFleet::Mode SensorFleet::GetMode() const
+{
+    return _mode;
+}
+
+unsigned long long SensorFleet::SampleCount() const
+{
+    return _sampleCount.load( std::memory_order_relaxed );
+}
+
+unsigned long long SensorFleet::ErrorCount() const
+{
+    return _errorCount.load( std::memory_order_relaxed );
+}
+
+/*======================================================================
+FUNCTION:
+    SyscallCount()
+
+DESCRIPTION:
+    This method adds up the system calls made by every bus.  The
+    counters are plain integers owned by the workers, so while
+    the fleet is running this is only a close estimate.
+
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SensorFleet::SyscallCount() const
+{
+    unsigned long long count = ( 0 != _uring ) ? _uring->SyscallCount() : 0;
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        if ( 0 != _buses[ b ]->batch )
+        {
+            count += _buses[ b ]->batch->SyscallCount();
+        }
+
+        for ( size_t s = 0; s < _buses[ b ]->sensors.size(); ++s )
+        {
+            count += _buses[ b ]->sensors[ s ]->SyscallCount();
+        }
+    }
+
+    return count;
+}
+
+/*======================================================================
+FUNCTION:
+    Stats()
+
+DESCRIPTION:
+    This method merges the stats of every sensor into one
+    snapshot
+
+RETURN VALUE:
+    bool - false if the build does not collect them
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SensorFleet::Stats( SensorStatsSnapshot& snapshot ) const
+{
+    if ( !SensorStats::ENABLED )
+    {
+        return false;
+    }
+
+    snapshot = SensorStatsSnapshot();
+
+    for ( size_t b = 0; b < _buses.size(); ++b )
+    {
+        for ( size_t s = 0; s < _buses[ b ]->sensors.size(); ++s )
+        {
+            SensorStatsSnapshot sensor;
+
+            if ( _buses[ b ]->sensors[ s ]->Stats( sensor ) )
+            {
+                snapshot.Merge( sensor );
+            }
+        }
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    SamplesPerSecond()
+
+DESCRIPTION:
+    This method works out the aggregate sample rate of all
+    buses since Start() was called
+
+RETURN VALUE:
+    double - samples per second
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double SensorFleet::SamplesPerSecond() const
+{
+    long long elapsed = nowNanoseconds() - _startNanoseconds.load();
+
+    if ( elapsed <= 0 )
+    {
+        return 0;
+    }
+
+    return ( double ) SampleCount() * 1e9 / elapsed;
+}
+
+/*======================================================================
+FUNCTION:
+    WallClockMicroseconds()
+
+DESCRIPTION:
+    Reads the clock the samples are stamped with
+
+RETURN VALUE:
+    long long - microseconds since the epoch
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+long long SensorFleet::WallClockMicroseconds()
+{
+    return std::chrono::duration_cast< std::chrono::microseconds >(
+        std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+/*======================================================================
+FUNCTION:
+    runBus()
+
+DESCRIPTION:
+    This is the worker thread body for one bus, or for every
+    bus when bus is 0 (MODE_URING).  It pins itself to a core
+    and runs polling rounds until Stop() is called.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::runBus( Bus* bus, unsigned int core )
+{
+    cpu_set_t cpus;
+
+    CPU_ZERO( &cpus );
+    CPU_SET( core, &cpus );
+
+    // Pinning is only a hint.  If it fails we still run.
+    pthread_setaffinity_np( pthread_self(), sizeof( cpus ), &cpus );
+
+    long long nextRound = nowNanoseconds();
+
+    while ( _running.load( std::memory_order_relaxed ) )
+    {
+        if ( 0 == bus )
+        {
+            pollUringRound();
+        }
+        else if ( 0 != bus->batch )
+        {
+            pollBatchedRound( bus );
+        }
+        else
+        {
+            pollRound( bus );
+        }
+
+        if ( 0 < _roundMicroseconds )
+        {
+            nextRound += ( long long ) _roundMicroseconds * 1000;
+
+            long long remaining = nextRound - nowNanoseconds();
+
+            if ( 0 < remaining )
+            {
+                usleep( ( useconds_t ) ( remaining / 1000 ) );
+            }
+            else
+            {
+                // We fell behind, so start counting from now
+                nextRound = nowNanoseconds();
+            }
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    pollRound()
+
+DESCRIPTION:
+    This method does one round on a bus.  All of the sensors get
+    their measurement command first, then we wait for the settle
+    time once and fetch everyone.  Sensors that still say their
+    data is stale get a few more chances.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::pollRound( Bus* bus )
+{
+    const size_t count = bus->sensors.size();
+
+    std::vector< size_t > pending;
+
+    pending.reserve( count );
+
+    for ( size_t s = 0; s < count; ++s )
+    {
+        if ( Honeywell6130Sensor::READ_OK == bus->sensors[ s ]->TryTriggerMeasurement() )
+        {
+            pending.push_back( s );
+        }
+        else
+        {
+            ++_errorCount;
+        }
+    }
+
+    for ( unsigned int attempt = 0;
+          !pending.empty() && attempt <= DEFAULT_STALE_RETRIES;
+          ++attempt )
+    {
+        usleep( DEFAULT_SETTLE_MICROSECONDS );
+
+        size_t stillPending = 0;
+
+        for ( size_t p = 0; p < pending.size(); ++p )
+        {
+            size_t s = pending[ p ];
+
+            FleetSample sample;
+
+            sample.sensorIndex      = bus->sensorIndexes[ s ];
+            sample.timeMicroseconds = WallClockMicroseconds();
+
+            Honeywell6130Sensor::ReadError error = bus->sensors[ s ]->TryFetchResult( sample.data );
+
+            if ( Honeywell6130Sensor::READ_STALE == error )
+            {
+                pending[ stillPending++ ] = s;
+                continue;
+            }
+
+            if ( Honeywell6130Sensor::READ_OK != error )
+            {
+                ++_errorCount;
+                continue;
+            }
+
+            ++_sampleCount;
+
+            if ( _handler )
+            {
+                _handler( sample );
+            }
+        }
+
+        pending.resize( stillPending );
+    }
+
+    // Anyone left never finished the conversion
+    _errorCount += pending.size();
+}
+
+/*======================================================================
+FUNCTION:
+    pollBatchedRound()
+
+DESCRIPTION:
+    Same as pollRound() but the whole bus goes through one
+    Honeywell6130Bus: one batch of measurement commands, then one
+    batch of fetches per settle period.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::pollBatchedRound( Bus* bus )
+{
+    Honeywell6130Bus* batch = bus->batch;
+
+    unsigned long long errorsBefore = batch->ErrorCount();
+
+    std::vector< size_t > pending;
+    std::vector< size_t > fresh;
+
+    batch->TriggerAll( pending );
+
+    for ( unsigned int attempt = 0;
+          !pending.empty() && attempt <= DEFAULT_STALE_RETRIES;
+          ++attempt )
+    {
+        usleep( DEFAULT_SETTLE_MICROSECONDS );
+
+        batch->Fetch( pending, &bus->batchData[ 0 ], fresh );
+
+        for ( size_t f = 0; f < fresh.size(); ++f )
+        {
+            FleetSample sample;
+
+            sample.sensorIndex      = bus->sensorIndexes[ fresh[ f ] ];
+            sample.timeMicroseconds = WallClockMicroseconds();
+            sample.data             = bus->batchData[ fresh[ f ] ];
+
+            ++_sampleCount;
+
+            if ( _handler )
+            {
+                _handler( sample );
+            }
+        }
+    }
+
+    // Anyone left never finished the conversion
+    _errorCount += pending.size() + ( batch->ErrorCount() - errorsBefore );
+}
+
+/*======================================================================
+FUNCTION:
+    pollUringRound()
+
+DESCRIPTION:
+    Same as pollRound() but for every sensor on every bus at once,
+    through the io_uring.  The settle wait is a ring timeout, so
+    the round is a single trip into the kernel unless somebody is
+    stale.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorFleet::pollUringRound()
+{
+    unsigned long long errorsBefore = _uring->ErrorCount();
+
+    std::vector< size_t > fresh;
+
+    _uring->Poll( &_uringData[ 0 ], fresh );
+
+    for ( size_t f = 0; f < fresh.size(); ++f )
+    {
+        FleetSample sample;
+
+        sample.sensorIndex      = _uringSensorIndexes[ fresh[ f ] ];
+        sample.timeMicroseconds = WallClockMicroseconds();
+        sample.data             = _uringData[ fresh[ f ] ];
+
+        ++_sampleCount;
+
+        if ( _handler )
+        {
+            _handler( sample );
+        }
+    }
+
+    _errorCount += _uring->ErrorCount() - errorsBefore;
+}
+
+/*======================================================================
+FUNCTION:
+    nowNanoseconds()
+
+DESCRIPTION:
+    Reads the monotonic clock
+
+RETURN VALUE:
+    long long - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowNanoseconds()
+{
+    return std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Each sensor still has its own file descriptor bound to its address
+with I2C_SLAVE, so sensors on the same bus can be driven back to back
+by one thread without any rebinding.  Keeping all of the traffic for
+a bus on a single worker is what serializes the bus; nothing else
+touches those file descriptors.
+
+=====================================================================*/
@@ -0,0 +1,329 @@
+#ifndef _SENSORFLEET_H_
+#define _SENSORFLEET_H_
+
+/*======================================================================
+FILE:
+    sensorfleet.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Polls many Honeywell 6130 sensors spread across several
+    i2c buses.
+
+DESCRIPTION:
+    This header defines a fleet of sensors.  Sensors are grouped
+    by the i2c bus they live on and every bus gets its own worker
+    thread, so transactions on one bus are serialized while the
+    buses run side by side.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SensorAddress
+    FleetSample
+    SensorFleet
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "honeywell6130bus.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+class UringAcquisition;
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// Where a sensor lives: the i2c bus device and the address on it
+struct SensorAddress
+{
+    std::string device;
+    int address;
+};
+
+// One measurement from one sensor in the fleet.  sensorIndex is
+// the position of the sensor in the list handed to the fleet, and
+// timeMicroseconds the wall clock time it was fetched.
+struct FleetSample
+{
+    size_t sensorIndex;
+    long long timeMicroseconds;
+    TempHumidityData data;
+};
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The sample handler is called from the bus worker threads.  Several
+// buses can call it at the same time, and a slow handler holds up
+// the next polling round on its bus.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SensorFleet
+
+DESCRIPTION:
+    This class drives a list of sensors.  Each i2c bus gets one
+    worker thread.  In every polling round the worker sends the
+    measurement command to all of the sensors on its bus, waits
+    for the settle time once, and then fetches all of the results.
+    That way the conversions on a bus overlap instead of paying
+    the settle time once per sensor.
+
+HOW TO USE:
+    1. Construct the object passing the list of sensors
+       (MODE_BATCHED: call SetCombined() for the buses that take
+       combined transfers)
+    2. Call Start() with a handler to begin polling
+    3. Call SamplesPerSecond() to see how fast things are going
+    4. Call Stop() (or destroy the object) to shut the workers down
+
+======================================================================*/
+class SensorFleet
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef std::function< void ( const FleetSample& sample ) > SampleHandler;
+
+    // How a bus talks to its sensors.  MODE_PER_SENSOR gives every
+    // sensor its own file descriptor and a write()/read() pair per
+    // sample.  MODE_BATCHED shares one file descriptor per bus and
+    // sends every command and fetch through I2C_RDWR.  On its own
+    // that only saves the I2C_SLAVE ioctls of the per-sensor
+    // objects, since it is still a call per message; SetCombined()
+    // packs a bus's round into one call.
+    // MODE_URING keeps a file descriptor per sensor but drives
+    // every bus from one thread through an io_uring; where that
+    // can not run the fleet falls back to MODE_PER_SENSOR.
+    enum Mode
+    {
+        MODE_PER_SENSOR,
+        MODE_BATCHED,
+        MODE_URING
+    };
+
+    // Makes a transport for a device name.  The fleet owns what it
+    // gets back.  Leave it empty to use i2c-dev.
+    typedef std::function< I2cTransport* ( const std::string& device ) > TransportFactory;
+
+    // How long the sensors get to finish a conversion before
+    // we fetch, and how many times we come back for a sensor
+    // that still reports stale data
+    static const unsigned int DEFAULT_SETTLE_MICROSECONDS = 1000;
+    static const unsigned int DEFAULT_STALE_RETRIES       = 3;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // roundMicroseconds is the polling period for each bus.  Zero
+    // means poll as fast as the bus allows.
+    SensorFleet( const std::vector< SensorAddress >& sensors,
+                 unsigned int roundMicroseconds = 0,
+                 Mode mode = MODE_PER_SENSOR,
+                 TransportFactory transportFactory = TransportFactory() );
+
+    virtual ~SensorFleet();
+
+    void Start( SampleHandler handler );
+
+    // MODE_BATCHED only, and before Start().  Sends each round on
+    // device (every bus if it is empty) as combined I2C_RDWR
+    // transfers; see Honeywell6130Bus::SetCombined() for why that
+    // is only for buses whose sensors are known to take it.
+    // Returns the number of buses changed.
+    size_t SetCombined( bool combined, const std::string& device = std::string() );
+
+    void Stop();
+
+    size_t SensorCount() const;
+
+    size_t BusCount() const;
+
+    // The mode the fleet ended up in, after any fallback
+    Mode GetMode() const;
+
+    unsigned long long SampleCount() const;
+
+    unsigned long long ErrorCount() const;
+
+    // Aggregate rate across all buses since Start()
+    double SamplesPerSecond() const;
+
+    // System calls made against the i2c devices by every bus
+    unsigned long long SyscallCount() const;
+
+    // Read path timings and counters of every sensor, merged.
+    // Returns false if the build does not collect them.  Batched
+    // and io_uring rounds do not go through the sensor objects,
+    // so only MODE_PER_SENSOR sensors show up.
+    bool Stats( SensorStatsSnapshot& snapshot ) const;
+
+    // The clock samples are stamped with (CLOCK_REALTIME)
+    static long long WallClockMicroseconds();
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // Everything that lives on one i2c bus.  Only one of sensors
+    // or batch is used, depending on the mode.
+    struct Bus
+    {
+        std::string device;
+        std::vector< int > addresses;
+        std::vector< size_t > sensorIndexes;
+        std::vector< Honeywell6130Sensor* > sensors;
+        Honeywell6130Bus* batch;
+        std::vector< TempHumidityData > batchData;
+        std::vector< I2cTransport* > transports;
+        std::thread worker;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorFleet( const SensorFleet &rhs );
+
+    void runBus( Bus* bus, unsigned int core );
+
+    void pollRound( Bus* bus );
+
+    void pollBatchedRound( Bus* bus );
+
+    void pollUringRound();
+
+    void setupUring();
+
+    void destroyBuses();
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::vector< Bus* > _buses;
+
+    Mode _mode;
+
+    // Only used in MODE_URING.  One worker drives every sensor,
+    // listed bus by bus.
+    UringAcquisition* _uring;
+
+    std::vector< size_t > _uringSensorIndexes;
+
+    std::vector< TempHumidityData > _uringData;
+
+    std::thread _uringWorker;
+
+    size_t _sensorCount;
+
+    unsigned int _roundMicroseconds;
+
+    SampleHandler _handler;
+
+    std::atomic< bool > _running;
+
+    std::atomic< unsigned long long > _sampleCount;
+
+    std::atomic< unsigned long long > _errorCount;
+
+    std::atomic< long long > _startNanoseconds;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _SENSORFLEET_H_
@@ -0,0 +1,681 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sensorstats.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to time the sensor read path and count its outcomes
+
+GENERAL DESCRIPTION:
+    This file implements the latency histograms, the counters
+    and the snapshot printing
+
+PUBLIC CLASSES AND FUNCTIONS:
+    LatencyHistogram
+    SensorStats
+    SensorStatsSnapshot
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sensorstats.h"
+
+#include <cstring>
+#include <time.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+static const char* phaseNames[ SensorStats::PHASE_COUNT ] =
+{
+    "command",
+    "settle",
+    "fetch",
+    "decode"
+};
+
+static const char* failureNames[ SensorStats::FAILURE_COUNT ] =
+{
+    "open",
+    "bind",
+    "command",
+    "fetch"
+};
+
+static const char* statusNames[ SensorStats::STATUS_COUNT ] =
+{
+    "normal",
+    "stale",
+    "command mode",
+    "diagnostic"
+};
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    LatencyHistogram()
+
+DESCRIPTION:
+    This c-tor zeroes every counter
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+LatencyHistogram::LatencyHistogram()
+: _count( 0 ),
+  _total( 0 ),
+  _max( 0 )
+{
+    for ( unsigned int b = 0; b < BUCKETS; ++b )
+    {
+        _buckets[ b ].store( 0, std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~LatencyHistogram()
+
+DESCRIPTION:
+    Nothing to clean up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+LatencyHistogram::~LatencyHistogram()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Record()
+
+DESCRIPTION:
+    Counts one latency.  A negative one (the clock can not go
+    backwards, but just in case) counts as zero.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void LatencyHistogram::Record( long long nanoseconds )
+{
+    unsigned long long value = ( 0 < nanoseconds ) ? ( unsigned long long ) nanoseconds : 0;
+
+    _buckets[ BucketIndex( value ) ].fetch_add( 1, std::memory_order_relaxed );
+
+    _count.fetch_add( 1, std::memory_order_relaxed );
+    _total.fetch_add( value, std::memory_order_relaxed );
+
+    unsigned long long max = _max.load( std::memory_order_relaxed );
+
+    while ( value > max && !_max.compare_exchange_weak( max, value, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Snapshot()
+
+DESCRIPTION:
+    Copies the counters out.  Records that land while we copy may
+    or may not be in it, but nothing is torn.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void LatencyHistogram::Snapshot( Counts& counts ) const
+{
+    counts.count            = _count.load( std::memory_order_relaxed );
+    counts.totalNanoseconds = _total.load( std::memory_order_relaxed );
+    counts.maxNanoseconds   = _max.load( std::memory_order_relaxed );
+
+    for ( unsigned int b = 0; b < BUCKETS; ++b )
+    {
+        counts.buckets[ b ] = _buckets[ b ].load( std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    BucketIndex()
+
+DESCRIPTION:
+    Values under 4 get a bucket each.  Above that the power of two
+    picks the octave and the next two bits pick the bucket in it.
+
+RETURN VALUE:
+    unsigned int - the bucket
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned int LatencyHistogram::BucketIndex( unsigned long long nanoseconds )
+{
+    if ( nanoseconds < SUB_BUCKETS )
+    {
+        return ( unsigned int ) nanoseconds;
+    }
+
+    unsigned int exponent = 63 - __builtin_clzll( nanoseconds );
+
+    unsigned int bucket = SUB_BUCKETS * ( exponent - SUB_BUCKET_BITS + 1 ) +
+                          ( unsigned int ) ( ( nanoseconds >> ( exponent - SUB_BUCKET_BITS ) ) & ( SUB_BUCKETS - 1 ) );
+
+    return ( bucket < BUCKETS ) ? bucket : BUCKETS - 1;
+}
+
+/*======================================================================
+FUNCTION:
+    BucketLimit()
+
+DESCRIPTION:
+    Inverse of BucketIndex()
+
+RETURN VALUE:
+    unsigned long long - the largest value in the bucket
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long LatencyHistogram::BucketLimit( unsigned int bucket )
+{
+    if ( bucket < SUB_BUCKETS )
+    {
+        return bucket;
+    }
+
+    unsigned int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    unsigned long long step = 1ULL << ( exponent - SUB_BUCKET_BITS );
+
+    return ( SUB_BUCKETS + bucket % SUB_BUCKETS ) * step + step - 1;
+}
+
+/*======================================================================
+FUNCTION:
+    LatencyHistogram::Counts::PercentileNanoseconds()
+
+DESCRIPTION:
+    Walks the buckets until it has covered the fraction asked for
+
+RETURN VALUE:
+    unsigned long long - nanoseconds (a bucket limit, capped at
+                         the largest value seen)
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long LatencyHistogram::Counts::PercentileNanoseconds( double fraction ) const
+{
+    unsigned long long seen = 0;
+
+    for ( unsigned int b = 0; b < BUCKETS; ++b )
+    {
+        seen += buckets[ b ];
+
+        if ( 0 < seen && seen >= fraction * count )
+        {
+            unsigned long long limit = BucketLimit( b );
+
+            return ( limit < maxNanoseconds ) ? limit : maxNanoseconds;
+        }
+    }
+
+    return maxNanoseconds;
+}
+
+/*======================================================================
+FUNCTION:
+    LatencyHistogram::Counts::MeanNanoseconds()
+
+DESCRIPTION:
+    Average latency
+
+RETURN VALUE:
+    double - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double LatencyHistogram::Counts::MeanNanoseconds() const
+{
+    return count ? ( double ) totalNanoseconds / count : 0;
+}
+
+/*======================================================================
+FUNCTION:
+    LatencyHistogram::Counts::Merge()
+
+DESCRIPTION:
+    Adds another histogram's counts to this one
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void LatencyHistogram::Counts::Merge( const Counts& other )
+{
+    count            += other.count;
+    totalNanoseconds += other.totalNanoseconds;
+
+    if ( other.maxNanoseconds > maxNanoseconds )
+    {
+        maxNanoseconds = other.maxNanoseconds;
+    }
+
+    for ( unsigned int b = 0; b < BUCKETS; ++b )
+    {
+        buckets[ b ] += other.buckets[ b ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SensorStats()
+
+DESCRIPTION:
+    This c-tor zeroes every counter
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorStats::SensorStats()
+{
+    for ( unsigned int s = 0; s < STATUS_COUNT; ++s )
+    {
+        _statuses[ s ].store( 0, std::memory_order_relaxed );
+    }
+
+    for ( unsigned int f = 0; f < FAILURE_COUNT; ++f )
+    {
+        _failures[ f ].store( 0, std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SensorStats()
+
+DESCRIPTION:
+    Nothing to clean up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorStats::~SensorStats()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    RecordPhase()
+
+DESCRIPTION:
+    Files the time one phase of a read took
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStats::RecordPhase( Phase phase, long long nanoseconds )
+{
+    _phases[ phase ].Record( nanoseconds );
+}
+
+/*======================================================================
+FUNCTION:
+    RecordStatus()
+
+DESCRIPTION:
+    Counts the status bits of one frame
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStats::RecordStatus( unsigned int status )
+{
+    _statuses[ status & ( STATUS_COUNT - 1 ) ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+/*======================================================================
+FUNCTION:
+    RecordFailure()
+
+DESCRIPTION:
+    Counts one failure at a site
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStats::RecordFailure( FailureSite site )
+{
+    _failures[ site ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+/*======================================================================
+FUNCTION:
+    Snapshot()
+
+DESCRIPTION:
+    Copies everything out
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStats::Snapshot( SensorStatsSnapshot& snapshot ) const
+{
+    for ( unsigned int p = 0; p < PHASE_COUNT; ++p )
+    {
+        _phases[ p ].Snapshot( snapshot.phases[ p ] );
+    }
+
+    for ( unsigned int s = 0; s < STATUS_COUNT; ++s )
+    {
+        snapshot.statuses[ s ] = _statuses[ s ].load( std::memory_order_relaxed );
+    }
+
+    for ( unsigned int f = 0; f < FAILURE_COUNT; ++f )
+    {
+        snapshot.failures[ f ] = _failures[ f ].load( std::memory_order_relaxed );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Now()
+
+DESCRIPTION:
+    Reads the monotonic clock
+
+RETURN VALUE:
+    long long - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+long long SensorStats::Now()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*======================================================================
+FUNCTION:
+    PhaseName()
+
+DESCRIPTION:
+    Printable name of a phase
+
+RETURN VALUE:
+    const char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* SensorStats::PhaseName( Phase phase )
+{
+    return ( phase < PHASE_COUNT ) ? phaseNames[ phase ] : "?";
+}
+
+/*======================================================================
+FUNCTION:
+    FailureName()
+
+DESCRIPTION:
+    Printable name of a failure site
+
+RETURN VALUE:
+    const char*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+const char* SensorStats::FailureName( FailureSite site )
+{
+    return ( site < FAILURE_COUNT ) ? failureNames[ site ] : "?";
+}
+
+/*======================================================================
+FUNCTION:
+    SensorStatsSnapshot()
+
+DESCRIPTION:
+    This c-tor starts out with everything at zero, ready to Merge()
+    into
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SensorStatsSnapshot::SensorStatsSnapshot()
+{
+    memset( phases, 0, sizeof( phases ) );
+    memset( statuses, 0, sizeof( statuses ) );
+    memset( failures, 0, sizeof( failures ) );
+}
+
+/*======================================================================
+FUNCTION:
+    Merge()
+
+DESCRIPTION:
+    Adds another snapshot to this one
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStatsSnapshot::Merge( const SensorStatsSnapshot& other )
+{
+    for ( unsigned int p = 0; p < SensorStats::PHASE_COUNT; ++p )
+    {
+        phases[ p ].Merge( other.phases[ p ] );
+    }
+
+    for ( unsigned int s = 0; s < SensorStats::STATUS_COUNT; ++s )
+    {
+        statuses[ s ] += other.statuses[ s ];
+    }
+
+    for ( unsigned int f = 0; f < SensorStats::FAILURE_COUNT; ++f )
+    {
+        failures[ f ] += other.failures[ f ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Dump()
+
+DESCRIPTION:
+    Prints the snapshot, times in microseconds
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SensorStatsSnapshot::Dump( FILE* file ) const
+{
+    fprintf( file, "%-8s %10s %10s %10s %10s %10s %10s\n",
+             "phase", "count", "mean us", "p50 us", "p99 us", "p99.9 us", "max us" );
+
+    for ( unsigned int p = 0; p < SensorStats::PHASE_COUNT; ++p )
+    {
+        const LatencyHistogram::Counts& counts = phases[ p ];
+
+        fprintf( file, "%-8s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                 SensorStats::PhaseName( ( SensorStats::Phase ) p ),
+                 counts.count,
+                 counts.MeanNanoseconds() / 1e3,
+                 counts.PercentileNanoseconds( 0.5 ) / 1e3,
+                 counts.PercentileNanoseconds( 0.99 ) / 1e3,
+                 counts.PercentileNanoseconds( 0.999 ) / 1e3,
+                 counts.maxNanoseconds / 1e3 );
+    }
+
+    fprintf( file, "status:" );
+
+    for ( unsigned int s = 0; s < SensorStats::STATUS_COUNT; ++s )
+    {
+        fprintf( file, "  %s %llu", statusNames[ s ], statuses[ s ] );
+    }
+
+    fprintf( file, "\nfailures:" );
+
+    for ( unsigned int f = 0; f < SensorStats::FAILURE_COUNT; ++f )
+    {
+        fprintf( file, "  %s %llu", SensorStats::FailureName( ( SensorStats::FailureSite ) f ), failures[ f ] );
+    }
+
+    fprintf( file, "\n" );
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The max is kept with a compare-and-swap loop, which only spins when
+two threads record a new max for the same histogram at once.  Nothing
+else in a record is more than a relaxed fetch_add.
+
+=====================================================================*/
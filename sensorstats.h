@@ -0,0 +1,421 @@
+#ifndef _SENSORSTATS_H_
+#define _SENSORSTATS_H_
+
+/*======================================================================
+FILE:
+    sensorstats.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Low overhead timing and error counters for the sensor read path.
+
+DESCRIPTION:
+    This header defines lock-free latency histograms for each phase
+    of a read (command, settle, fetch, decode), counters for the
+    status the sensor reported and for every place a read can fail,
+    and a snapshot that can be printed or merged.  The sensor code
+    records through macros that compile away to nothing unless
+    HONEYWELL_STATS is defined.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    LatencyHistogram
+    SensorStats
+    SensorStatsSnapshot
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// Recording hooks for the sensor code.  With HONEYWELL_STATS off they
+// expand to nothing, so a build without it has no clock reads, no
+// atomics and no branches in the read path.
+#ifdef HONEYWELL_STATS
+#define HONEYWELL_STATS_START( name )                   const long long name = SensorStats::Now()
+#define HONEYWELL_STATS_PHASE( stats, phase, start )    ( stats )->RecordPhase( phase, SensorStats::Now() - ( start ) )
+#define HONEYWELL_STATS_STATUS( stats, status )         ( stats )->RecordStatus( status )
+#define HONEYWELL_STATS_FAILURE( stats, site )          ( stats )->RecordFailure( site )
+#else
+#define HONEYWELL_STATS_START( name )
+#define HONEYWELL_STATS_PHASE( stats, phase, start )    ( ( void ) 0 )
+#define HONEYWELL_STATS_STATUS( stats, status )         ( ( void ) 0 )
+#define HONEYWELL_STATS_FAILURE( stats, site )          ( ( void ) 0 )
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+class SensorStatsSnapshot;
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// HONEYWELL_STATS has to be the same for every file in a build; it
+// is set once in wsmake.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    LatencyHistogram
+
+DESCRIPTION:
+    An HDR style histogram of nanosecond latencies.  Each power of
+    two is split into 4 linear buckets, so any value is off by at
+    most 25% (and usually much less) from the bucket it lands in,
+    from 1ns up to over an hour.  Recording is one relaxed atomic
+    add per bucket and counter; any number of threads can record
+    while another one reads.
+
+HOW TO USE:
+    1. Call Record() with each latency
+    2. Call Snapshot() to copy the counts out
+
+======================================================================*/
+class LatencyHistogram
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const unsigned int SUB_BUCKET_BITS = 2;
+    static const unsigned int SUB_BUCKETS     = 1u << SUB_BUCKET_BITS;
+    static const unsigned int OCTAVES         = 41;
+    static const unsigned int BUCKETS         = SUB_BUCKETS * OCTAVES;
+
+    // A plain copy of the counters
+    struct Counts
+    {
+        unsigned long long count;
+        unsigned long long totalNanoseconds;
+        unsigned long long maxNanoseconds;
+        unsigned long long buckets[ BUCKETS ];
+
+        // Upper edge of the bucket holding that fraction ( 0 - 1 )
+        // of the values
+        unsigned long long PercentileNanoseconds( double fraction ) const;
+
+        double MeanNanoseconds() const;
+
+        void Merge( const Counts& other );
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    LatencyHistogram();
+
+    virtual ~LatencyHistogram();
+
+    void Record( long long nanoseconds );
+
+    void Snapshot( Counts& counts ) const;
+
+    static unsigned int BucketIndex( unsigned long long nanoseconds );
+
+    // Largest value that lands in the bucket
+    static unsigned long long BucketLimit( unsigned int bucket );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    LatencyHistogram( const LatencyHistogram &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::atomic< unsigned long long > _count;
+
+    std::atomic< unsigned long long > _total;
+
+    std::atomic< unsigned long long > _max;
+
+    std::atomic< unsigned long long > _buckets[ BUCKETS ];
+
+};
+
+/*======================================================================
+CLASS:
+    SensorStats
+
+DESCRIPTION:
+    Everything we track for one sensor: a LatencyHistogram per
+    phase of a read, a counter per status code the sensor sent,
+    and a counter per place a read can fail.
+
+HOW TO USE:
+    1. Let the sensor record into it through the HONEYWELL_STATS_
+       macros
+    2. Call Snapshot() to read it, and SensorStatsSnapshot::Dump()
+       to print it
+
+======================================================================*/
+class SensorStats
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    enum Phase
+    {
+        PHASE_COMMAND,      // write() of the measurement command
+        PHASE_SETTLE,       // the conversion wait
+        PHASE_FETCH,        // read() of the 4 byte frame
+        PHASE_DECODE,       // counts to floats
+        PHASE_COUNT
+    };
+
+    // One per place the sensor code throws a SensorException
+    enum FailureSite
+    {
+        FAILURE_OPEN,
+        FAILURE_BIND,
+        FAILURE_COMMAND,
+        FAILURE_FETCH,
+        FAILURE_COUNT
+    };
+
+    static const unsigned int STATUS_COUNT = 4;
+
+    // True when the build records anything
+#ifdef HONEYWELL_STATS
+    static const bool ENABLED = true;
+#else
+    static const bool ENABLED = false;
+#endif
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SensorStats();
+
+    virtual ~SensorStats();
+
+    void RecordPhase( Phase phase, long long nanoseconds );
+
+    void RecordStatus( unsigned int status );
+
+    void RecordFailure( FailureSite site );
+
+    void Snapshot( SensorStatsSnapshot& snapshot ) const;
+
+    // Monotonic clock in nanoseconds
+    static long long Now();
+
+    static const char* PhaseName( Phase phase );
+
+    static const char* FailureName( FailureSite site );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SensorStats( const SensorStats &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    LatencyHistogram _phases[ PHASE_COUNT ];
+
+    std::atomic< unsigned long long > _statuses[ STATUS_COUNT ];
+
+    std::atomic< unsigned long long > _failures[ FAILURE_COUNT ];
+
+};
+
+/*======================================================================
+CLASS:
+    SensorStatsSnapshot
+
+DESCRIPTION:
+    A plain copy of a SensorStats at one moment.  Snapshots from
+    several sensors can be merged into one.
+
+HOW TO USE:
+    1. Fill it in with SensorStats::Snapshot() (or a sensor's
+       Stats())
+    2. Merge() others into it if you want totals
+    3. Read the members or Dump() it
+
+======================================================================*/
+class SensorStatsSnapshot
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SensorStatsSnapshot();
+
+    void Merge( const SensorStatsSnapshot& other );
+
+    // One line per phase with count, mean and percentiles, then
+    // the status and failure counters
+    void Dump( FILE* file ) const;
+
+    LatencyHistogram::Counts phases[ SensorStats::PHASE_COUNT ];
+
+    unsigned long long statuses[ SensorStats::STATUS_COUNT ];
+
+    unsigned long long failures[ SensorStats::FAILURE_COUNT ];
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    // None.
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Cost with HONEYWELL_STATS on is two reads of the vDSO monotonic clock
+per phase plus a handful of relaxed atomic adds, tens of nanoseconds
+against a read that takes over a millisecond.  "bench stats" prints
+the per read cost of the sensor code with whatever the build has, so
+running it from a build with and without STATS shows the difference.
+
+======================================================================*/
+
+#endif	// #ifendif _SENSORSTATS_H_
@@ -0,0 +1,353 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    sharedpublisher.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to publish readings into shared memory
+
+GENERAL DESCRIPTION:
+    This file creates the segment laid out in sharedreadings.h and
+    runs the writer side of the per sensor seqlock
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SharedPublisher
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sharedpublisher.h"
+
+#include <time.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static void copyIn( std::atomic< uint32_t >* words, const SharedRecord& record );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SharedPublisher()
+
+DESCRIPTION:
+    This c-tor creates the segment (retiring one left behind by
+    an earlier daemon), sizes it for the sensors and fills in
+    the header.  The magic goes in last so a reader never sees a
+    half built segment.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SharedPublisher::SharedPublisher( const char* name, size_t sensorCount )
+: _name( name ),
+  _sensorCount( sensorCount ),
+  _mapping( MAP_FAILED ),
+  _size( SHARED_SLOTS_OFFSET + sensorCount * sizeof( SharedSensorSlot ) ),
+  _header( 0 ),
+  _slots( 0 )
+{
+    // A segment left by an earlier daemon is marked dead and
+    // unlinked, not resized.  Readers still mapping it see the magic
+    // go away and reopen, instead of taking a SIGBUS.
+    int fileDescriptor = shm_open( _name.c_str(), O_RDWR, 0 );
+
+    if ( 0 <= fileDescriptor )
+    {
+        struct stat status;
+
+        if ( 0 == fstat( fileDescriptor, &status ) && ( size_t ) status.st_size >= sizeof( SharedSegmentHeader ) )
+        {
+            void* old = mmap( 0, sizeof( SharedSegmentHeader ), PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+
+            if ( MAP_FAILED != old )
+            {
+                ( ( SharedSegmentHeader* ) old )->magic.store( 0, std::memory_order_release );
+                munmap( old, sizeof( SharedSegmentHeader ) );
+            }
+        }
+
+        close( fileDescriptor );
+        shm_unlink( _name.c_str() );
+    }
+
+    fileDescriptor = shm_open( _name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+
+    if ( fileDescriptor < 0 )
+    {
+        throw SensorException( "Failed to create shared memory segment " + _name );
+    }
+
+    if ( 0 != ftruncate( fileDescriptor, ( off_t ) _size ) )
+    {
+        close( fileDescriptor );
+        shm_unlink( _name.c_str() );
+        throw SensorException( "Failed to size shared memory segment " + _name );
+    }
+
+    _mapping = mmap( 0, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0 );
+
+    close( fileDescriptor );
+
+    if ( MAP_FAILED == _mapping )
+    {
+        shm_unlink( _name.c_str() );
+        throw SensorException( "Failed to map shared memory segment " + _name );
+    }
+
+    // ftruncate() handed us zeroed pages, which is a valid empty
+    // slot for every sensor
+    _header = ( SharedSegmentHeader* ) _mapping;
+    _slots  = ( SharedSensorSlot* ) ( ( unsigned char* ) _mapping + SHARED_SLOTS_OFFSET );
+
+    _header->version       = SHARED_VERSION;
+    _header->sensorCount   = ( uint32_t ) sensorCount;
+    _header->historyLength = SHARED_HISTORY_LENGTH;
+    _header->slotBytes     = sizeof( SharedSensorSlot );
+    _header->writerPid     = ( uint32_t ) getpid();
+
+    _header->magic.store( SHARED_MAGIC, std::memory_order_release );
+}
+
+/*======================================================================
+FUNCTION:
+    ~SharedPublisher()
+
+DESCRIPTION:
+    This destructor unmaps and removes the segment.  Readers that
+    still have it mapped keep their copy until they close it.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SharedPublisher::~SharedPublisher()
+{
+    _header->magic.store( 0, std::memory_order_release );
+
+    munmap( _mapping, _size );
+
+    shm_unlink( _name.c_str() );
+}
+
+/*======================================================================
+FUNCTION:
+    Publish()
+
+DESCRIPTION:
+    This method is the seqlock write.  The sequence goes odd, the
+    release fence keeps the payload stores after it, the payload
+    goes in, and the release store of the next even sequence keeps
+    them before that.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SharedPublisher::Publish( size_t sensor, const TempHumidityData& data, long long timeMicroseconds )
+{
+    if ( sensor >= _sensorCount )
+    {
+        return;
+    }
+
+    SharedSensorSlot& slot = _slots[ sensor ];
+
+    SharedRecord record;
+
+    memset( &record, 0, sizeof( record ) );
+
+    record.timeMicroseconds = timeMicroseconds;
+    record.data = data;
+
+    uint32_t sequence  = slot.sequence.load( std::memory_order_relaxed );
+    uint32_t published = slot.published.load( std::memory_order_relaxed );
+
+    slot.sequence.store( sequence + 1, std::memory_order_relaxed );
+
+    std::atomic_thread_fence( std::memory_order_release );
+
+    copyIn( slot.latest, record );
+    copyIn( slot.history[ published % SHARED_HISTORY_LENGTH ], record );
+
+    slot.published.store( published + 1, std::memory_order_relaxed );
+
+    slot.sequence.store( sequence + 2, std::memory_order_release );
+}
+
+void SharedPublisher::Publish( size_t sensor, const TempHumidityData& data )
+{
+    Publish( sensor, data, NowMicroseconds() );
+}
+
+/*======================================================================
+FUNCTION:
+    SensorCount(), Name()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    The requested value
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t SharedPublisher::SensorCount() const
+{
+    return _sensorCount;
+}
+
+const char* SharedPublisher::Name() const
+{
+    return _name.c_str();
+}
+
+/*======================================================================
+FUNCTION:
+    NowMicroseconds()
+
+DESCRIPTION:
+    Reads the monotonic clock the records are stamped with
+
+RETURN VALUE:
+    long long - microseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+long long SharedPublisher::NowMicroseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+/*======================================================================
+FUNCTION:
+    copyIn()
+
+DESCRIPTION:
+    Stores a record into a slot word by word
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static void copyIn( std::atomic< uint32_t >* words, const SharedRecord& record )
+{
+    uint32_t copy[ SHARED_RECORD_WORDS ];
+
+    memcpy( copy, &record, sizeof( record ) );
+
+    for ( uint32_t w = 0; w < SHARED_RECORD_WORDS; ++w )
+    {
+        words[ w ].store( copy[ w ], std::memory_order_relaxed );
+    }
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+The record is cleared before it is filled so the padding inside
+TempHumidityData is zero rather than stack garbage, which keeps the
+segment byte for byte reproducible.
+
+=====================================================================*/
@@ -0,0 +1,204 @@
+#ifndef _SHAREDPUBLISHER_H_
+#define _SHAREDPUBLISHER_H_
+
+/*======================================================================
+FILE:
+    sharedpublisher.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Publishes sensor readings into shared memory for any number
+    of local readers.
+
+DESCRIPTION:
+    This header defines the writer side of the segment described
+    in sharedreadings.h.  The ws daemon owns the sensors and
+    publishes every fresh reading; other processes read it with
+    SharedReadingsReader instead of opening the bus themselves.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SharedPublisher
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "sharedreadings.h"
+
+#include <string>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Publish() for a given sensor must always come from the same thread
+// (the seqlock allows one writer per slot).  Different sensors can be
+// published from different threads at the same time.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SharedPublisher
+
+DESCRIPTION:
+    Creates (or takes over) a POSIX shared memory segment with one
+    seqlocked slot per sensor and writes readings into it.  Each
+    slot holds the latest reading and a ring of the last
+    SHARED_HISTORY_LENGTH of them.
+
+HOW TO USE:
+    1. Construct the object with the segment name and the number
+       of sensors
+    2. Call Publish() with every fresh reading
+    3. Destroy it to remove the segment
+
+======================================================================*/
+class SharedPublisher
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if the segment can not be created
+    SharedPublisher( const char* name, size_t sensorCount );
+
+    virtual ~SharedPublisher();
+
+    void Publish( size_t sensor, const TempHumidityData& data, long long timeMicroseconds );
+
+    // Same as Publish() stamped with the current CLOCK_MONOTONIC time
+    void Publish( size_t sensor, const TempHumidityData& data );
+
+    size_t SensorCount() const;
+
+    const char* Name() const;
+
+    static long long NowMicroseconds();
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SharedPublisher( const SharedPublisher &rhs );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::string _name;
+
+    size_t _sensorCount;
+
+    void* _mapping;
+
+    size_t _size;
+
+    SharedSegmentHeader* _header;
+
+    SharedSensorSlot* _slots;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _SHAREDPUBLISHER_H_
@@ -0,0 +1,574 @@
+#ifndef _SHAREDREADINGS_H_
+#define _SHAREDREADINGS_H_
+
+/*======================================================================
+FILE:
+    sharedreadings.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Lets any local process read the latest sensor values published
+    by the ws daemon without touching the i2c bus.
+
+DESCRIPTION:
+    This header defines the layout of the shared memory segment the
+    daemon publishes into, and the reader for it.  It is header only
+    on purpose: a client includes it, links with nothing but -lrt on
+    older C libraries, and reads straight out of the mapping.  Every
+    sensor has its own seqlock, so a read is a handful of loads with
+    no system calls and no locks.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SharedRecord
+    SharedSegmentHeader
+    SharedSensorSlot
+    SharedReadingsReader
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// Where the daemon publishes unless told otherwise
+static const char* const SHARED_DEFAULT_SEGMENT = "/honeywell6130";
+
+// Bump SHARED_VERSION whenever anything below changes shape
+static const uint32_t SHARED_MAGIC          = 0x36484948;    // "HIH6"
+static const uint32_t SHARED_VERSION        = 1;
+static const uint32_t SHARED_HISTORY_LENGTH = 64;
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// One published reading.  The time is CLOCK_MONOTONIC, which every
+// process on the machine shares.
+struct SharedRecord
+{
+    long long timeMicroseconds;
+    TempHumidityData data;
+};
+
+static const uint32_t SHARED_RECORD_WORDS = sizeof( SharedRecord ) / sizeof( uint32_t );
+
+static_assert( 0 == sizeof( SharedRecord ) % sizeof( uint32_t ), "SharedRecord must be whole words" );
+static_assert( std::atomic< uint32_t >::is_always_lock_free, "shared memory needs lock free atomics" );
+
+// First thing in the segment.  magic is written last, so a reader
+// that sees it sees the rest.
+struct SharedSegmentHeader
+{
+    std::atomic< uint32_t > magic;
+    uint32_t version;
+    uint32_t sensorCount;
+    uint32_t historyLength;
+    uint32_t slotBytes;
+    uint32_t writerPid;
+};
+
+// The slots start on the first cache line after the header
+static const size_t SHARED_SLOTS_OFFSET = 64;
+
+static_assert( sizeof( SharedSegmentHeader ) <= SHARED_SLOTS_OFFSET, "header outgrew its cache line" );
+
+// One sensor.  sequence is odd while the daemon is writing.  The
+// payload is kept in atomic words so that the racing copy a seqlock
+// reader makes is well defined; relaxed loads cost the same as
+// plain ones.
+struct alignas( 64 ) SharedSensorSlot
+{
+    std::atomic< uint32_t > sequence;
+    std::atomic< uint32_t > published;
+    std::atomic< uint32_t > latest[ SHARED_RECORD_WORDS ];
+    std::atomic< uint32_t > history[ SHARED_HISTORY_LENGTH ][ SHARED_RECORD_WORDS ];
+};
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A reader object is not thread safe (it keeps a retry counter), but
+// any number of readers in any number of processes can share the
+// segment.  Values are only as fresh as the daemon's polling period.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SharedReadingsReader
+
+DESCRIPTION:
+    Maps the daemon's segment read only and copies readings out of
+    it.  TryLatest() makes one attempt and never waits, so it fails
+    if the daemon happens to be writing that sensor right then.
+    Latest() tries again until it gets a clean copy, which with a
+    writer that publishes once a second is almost never more than
+    once.  Every read checks the magic, so a segment the daemon has
+    retired (it restarted, or exited) reads as nothing rather than
+    as its last values, and a slot left half written by a daemon
+    killed inside Publish() is given up on after MAX_RETRIES tries
+    rather than spun on for ever.
+
+HOW TO USE:
+    1. Construct the object with the segment name (or nothing)
+    2. Call Open(); false means the daemon is not running
+    3. Call Latest() or History() as often as you like
+    4. When they fail and Retired() says so (or they keep failing),
+       Close() and Open() again to find the new segment
+
+======================================================================*/
+class SharedReadingsReader
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Tries Latest() and History() make at a slot that is being
+    // written before giving up; a few milliseconds of spinning,
+    // far longer than any Publish() takes
+    static const unsigned int MAX_RETRIES = 1 << 20;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SharedReadingsReader( const char* name = SHARED_DEFAULT_SEGMENT )
+    : _name( name ), _mapping( MAP_FAILED ), _size( 0 ), _header( 0 ), _slots( 0 ), _retryCount( 0 ) { }
+
+    virtual ~SharedReadingsReader() { Close(); }
+
+    inline bool Open();
+
+    inline void Close();
+
+    bool IsOpen() const { return 0 != _header; }
+
+    // True once the daemon that laid the segment out has let it go;
+    // nothing read from it is current any more
+    bool Retired() const { return 0 != _header && SHARED_MAGIC != _header->magic.load( std::memory_order_acquire ); }
+
+    size_t SensorCount() const { return _header ? _header->sensorCount : 0; }
+
+    // False if the slot is being written, nothing has been
+    // published for that sensor yet or the segment was retired
+    inline bool TryLatest( size_t sensor, SharedRecord& record ) const;
+
+    // False if nothing has been published yet, the segment was
+    // retired, or the slot stayed mid write for MAX_RETRIES tries
+    // (its writer died in Publish())
+    inline bool Latest( size_t sensor, SharedRecord& record ) const;
+
+    // Copies up to max readings, newest first.  0 for the same
+    // reasons Latest() fails.
+    inline size_t History( size_t sensor, SharedRecord* records, size_t max ) const;
+
+    // Readings published for a sensor since the daemon started
+    inline unsigned long long PublishCount( size_t sensor ) const;
+
+    // Times Latest() or History() had to go around again
+    unsigned long long RetryCount() const { return _retryCount; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SharedReadingsReader( const SharedReadingsReader &rhs );
+
+    static void copyOut( const std::atomic< uint32_t >* words, SharedRecord& record )
+    {
+        uint32_t copy[ SHARED_RECORD_WORDS ];
+
+        for ( uint32_t w = 0; w < SHARED_RECORD_WORDS; ++w )
+        {
+            copy[ w ] = words[ w ].load( std::memory_order_relaxed );
+        }
+
+        memcpy( &record, copy, sizeof( record ) );
+    }
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::string _name;
+
+    void* _mapping;
+
+    size_t _size;
+
+    const SharedSegmentHeader* _header;
+
+    const SharedSensorSlot* _slots;
+
+    mutable unsigned long long _retryCount;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::Open()
+
+DESCRIPTION:
+    Maps the segment and checks that it was laid out by a daemon
+    built from this same header
+
+RETURN VALUE:
+    bool - true if the segment is there and makes sense
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline bool SharedReadingsReader::Open()
+{
+    if ( IsOpen() )
+    {
+        return true;
+    }
+
+    int fileDescriptor = shm_open( _name.c_str(), O_RDONLY, 0 );
+
+    if ( fileDescriptor < 0 )
+    {
+        return false;
+    }
+
+    struct stat status;
+
+    if ( 0 != fstat( fileDescriptor, &status ) || ( size_t ) status.st_size < sizeof( SharedSegmentHeader ) )
+    {
+        close( fileDescriptor );
+        return false;
+    }
+
+    _size = ( size_t ) status.st_size;
+
+    _mapping = mmap( 0, _size, PROT_READ, MAP_SHARED, fileDescriptor, 0 );
+
+    // The mapping keeps the segment alive on its own
+    close( fileDescriptor );
+
+    if ( MAP_FAILED == _mapping )
+    {
+        return false;
+    }
+
+    const SharedSegmentHeader* header = ( const SharedSegmentHeader* ) _mapping;
+
+    if ( SHARED_MAGIC != header->magic.load( std::memory_order_acquire ) ||
+         SHARED_VERSION != header->version ||
+         SHARED_HISTORY_LENGTH != header->historyLength ||
+         sizeof( SharedSensorSlot ) != header->slotBytes ||
+         _size < SHARED_SLOTS_OFFSET + header->sensorCount * sizeof( SharedSensorSlot ) )
+    {
+        Close();
+        return false;
+    }
+
+    _header = header;
+    _slots  = ( const SharedSensorSlot* ) ( ( const unsigned char* ) _mapping + SHARED_SLOTS_OFFSET );
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::Close()
+
+DESCRIPTION:
+    Unmaps the segment
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline void SharedReadingsReader::Close()
+{
+    if ( MAP_FAILED != _mapping )
+    {
+        munmap( _mapping, _size );
+    }
+
+    _mapping = MAP_FAILED;
+    _header  = 0;
+    _slots   = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::TryLatest()
+
+DESCRIPTION:
+    One pass of the seqlock read: sample the sequence, copy, and
+    check the sequence did not move, nor the magic
+
+RETURN VALUE:
+    bool - true if record holds a clean, current copy
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline bool SharedReadingsReader::TryLatest( size_t sensor, SharedRecord& record ) const
+{
+    if ( sensor >= SensorCount() )
+    {
+        return false;
+    }
+
+    const SharedSensorSlot& slot = _slots[ sensor ];
+
+    uint32_t before = slot.sequence.load( std::memory_order_acquire );
+
+    if ( before & 1 )
+    {
+        return false;
+    }
+
+    uint32_t published = slot.published.load( std::memory_order_relaxed );
+
+    copyOut( slot.latest, record );
+
+    std::atomic_thread_fence( std::memory_order_acquire );
+
+    return 0 != published && before == slot.sequence.load( std::memory_order_relaxed ) && !Retired();
+}
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::Latest()
+
+DESCRIPTION:
+    TryLatest() until it works, the segment is retired or
+    MAX_RETRIES tries have failed
+
+RETURN VALUE:
+    bool - true if record holds a clean, current copy
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline bool SharedReadingsReader::Latest( size_t sensor, SharedRecord& record ) const
+{
+    if ( 0 == PublishCount( sensor ) )
+    {
+        return false;
+    }
+
+    for ( unsigned int tries = 1; !TryLatest( sensor, record ); ++tries )
+    {
+        if ( Retired() || MAX_RETRIES <= tries )
+        {
+            return false;
+        }
+
+        ++_retryCount;
+    }
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::History()
+
+DESCRIPTION:
+    Copies the newest readings out of the sensor's history ring
+    under the seqlock, giving up like Latest() does
+
+RETURN VALUE:
+    size_t - number of records copied, 0 if it gave up
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline size_t SharedReadingsReader::History( size_t sensor, SharedRecord* records, size_t max ) const
+{
+    if ( sensor >= SensorCount() )
+    {
+        return 0;
+    }
+
+    const SharedSensorSlot& slot = _slots[ sensor ];
+
+    for ( unsigned int tries = 1; ; ++tries )
+    {
+        if ( Retired() || MAX_RETRIES < tries )
+        {
+            return 0;
+        }
+
+        uint32_t before = slot.sequence.load( std::memory_order_acquire );
+
+        if ( before & 1 )
+        {
+            ++_retryCount;
+            continue;
+        }
+
+        uint32_t published = slot.published.load( std::memory_order_relaxed );
+
+        size_t count = published < SHARED_HISTORY_LENGTH ? published : SHARED_HISTORY_LENGTH;
+
+        if ( count > max )
+        {
+            count = max;
+        }
+
+        for ( size_t r = 0; r < count; ++r )
+        {
+            copyOut( slot.history[ ( published - 1 - r ) % SHARED_HISTORY_LENGTH ], records[ r ] );
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+
+        if ( before == slot.sequence.load( std::memory_order_relaxed ) && !Retired() )
+        {
+            return count;
+        }
+
+        ++_retryCount;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SharedReadingsReader::PublishCount()
+
+DESCRIPTION:
+    Reads the number of publishes for a sensor.  It is a single
+    word, so no seqlock is needed.
+
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+inline unsigned long long SharedReadingsReader::PublishCount( size_t sensor ) const
+{
+    if ( sensor >= SensorCount() )
+    {
+        return 0;
+    }
+
+    return _slots[ sensor ].published.load( std::memory_order_acquire );
+}
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Segment layout:
+
+    offset 0                      SharedSegmentHeader (padded to 64)
+    offset 64 + n * slotBytes     SharedSensorSlot for sensor n
+
+The writer side is SharedPublisher (sharedpublisher.h).  Each slot has
+exactly one writer, the bus thread that owns the sensor, so the
+seqlock never needs a writer lock.  Slots are cache line aligned so
+readers of one sensor do not slow down the writer of another.
+
+A daemon that starts over makes a new segment and zeroes the old
+one's magic before unlinking it, and one that exits zeroes it too.
+Readers never block the writer and give up rather than wait on it:
+a retired segment or a slot that stays mid write is a false return,
+after which Close() and Open() picks up the new segment, or finds
+there is none.
+
+======================================================================*/
+
+#endif	// #ifendif _SHAREDREADINGS_H_
@@ -0,0 +1,920 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    simulatedi2c.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods for the simulated HIH6130, bus and transport
+
+GENERAL DESCRIPTION:
+    This file makes 4 byte frames the same way the real sensor
+    does, including stale data while a conversion is running and
+    injected faults
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SimulatedHih6130
+    SimulatedI2cBus
+    SimulatedTransport
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None.
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "simulatedi2c.h"
+
+#include <errno.h>
+#include <time.h>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// Largest 14 bit count
+static const unsigned int MAX_COUNT = 16383;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+static long long nowNanoseconds();
+
+static unsigned int toCount( double value, double offset, double span );
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    SimulatedHih6130::Config::Config()
+
+DESCRIPTION:
+    Defaults to a comfortable room, a little noise, instant
+    conversions and no faults
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedHih6130::Config::Config()
+: temperatureCelcius( 22.5 ),
+  relativeHumidity( 45.0 ),
+  noiseCounts( 4 ),
+  conversionMicroseconds( 0 ),
+  nackRate( 0 ),
+  commandModeRate( 0 ),
+  diagnosticRate( 0 ),
+  seed( 1 )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    SimulatedHih6130()
+
+DESCRIPTION:
+    This c-tor powers the device up.  Until the first measurement
+    request every fetch gives stale data.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedHih6130::SimulatedHih6130( const Config& config )
+: _config( config ),
+  _random( config.seed ? config.seed : 1 ),
+  _temperatureCount( 0 ),
+  _humidityCount( 0 ),
+  _converting( false ),
+  _fetched( true ),
+  _readyNanoseconds( 0 ),
+  _pendingStatus( 0 ),
+  _measurementCount( 0 ),
+  _fetchCount( 0 )
+{
+    SetEnvironment( config.temperatureCelcius, config.relativeHumidity );
+
+    _frame[ 0 ] = ( unsigned char ) ( _humidityCount >> 8 );
+    _frame[ 1 ] = ( unsigned char ) ( _humidityCount );
+    _frame[ 2 ] = ( unsigned char ) ( _temperatureCount >> 6 );
+    _frame[ 3 ] = ( unsigned char ) ( _temperatureCount << 2 );
+}
+
+/*======================================================================
+FUNCTION:
+    ~SimulatedHih6130()
+
+DESCRIPTION:
+    Nothing to clean up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedHih6130::~SimulatedHih6130()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    SetEnvironment()
+
+DESCRIPTION:
+    This method sets what the device is sensing.  It shows up in
+    the next conversion.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SimulatedHih6130::SetEnvironment( double temperatureCelcius, double relativeHumidity )
+{
+    _config.temperatureCelcius = temperatureCelcius;
+    _config.relativeHumidity   = relativeHumidity;
+
+    // Run the datasheet formulas backwards
+    _temperatureCount = toCount( temperatureCelcius, 40.0, 165.0 );
+    _humidityCount    = toCount( relativeHumidity, 0.0, 100.0 );
+}
+
+/*======================================================================
+FUNCTION:
+    MeasurementRequest()
+
+DESCRIPTION:
+    Starts a conversion.  With no conversion latency the result is
+    ready right away.
+
+RETURN VALUE:
+    bool - false if the device NACKed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SimulatedHih6130::MeasurementRequest()
+{
+    ++_measurementCount;
+
+    if ( happens( _config.nackRate ) )
+    {
+        return false;
+    }
+
+    _pendingStatus = 0x00;
+
+    if ( happens( _config.commandModeRate ) )
+    {
+        _pendingStatus = 0x02;
+    }
+    else if ( happens( _config.diagnosticRate ) )
+    {
+        _pendingStatus = 0x03;
+    }
+
+    if ( 0 == _config.conversionMicroseconds )
+    {
+        convert();
+        return true;
+    }
+
+    _converting = true;
+    _readyNanoseconds = nowNanoseconds() + ( long long ) _config.conversionMicroseconds * 1000;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    Fetch()
+
+DESCRIPTION:
+    Hands back the 4 byte frame.  If the conversion is still going,
+    or the result was already fetched, the last result comes back
+    with the stale status bits set.
+
+RETURN VALUE:
+    bool - false if the device NACKed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SimulatedHih6130::Fetch( unsigned char frame[ 4 ] )
+{
+    ++_fetchCount;
+
+    if ( happens( _config.nackRate ) )
+    {
+        return false;
+    }
+
+    if ( _converting && _readyNanoseconds <= nowNanoseconds() )
+    {
+        convert();
+    }
+
+    frame[ 0 ] = _frame[ 0 ];
+    frame[ 1 ] = _frame[ 1 ];
+    frame[ 2 ] = _frame[ 2 ];
+    frame[ 3 ] = _frame[ 3 ];
+
+    if ( _converting || _fetched )
+    {
+        frame[ 0 ] = ( unsigned char ) ( ( frame[ 0 ] & 0x3f ) | 0x40 );
+    }
+
+    _fetched = !_converting;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    MeasurementCount(), FetchCount()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    unsigned long long
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned long long SimulatedHih6130::MeasurementCount() const
+{
+    return _measurementCount;
+}
+
+unsigned long long SimulatedHih6130::FetchCount() const
+{
+    return _fetchCount;
+}
+
+/*======================================================================
+FUNCTION:
+    convert()
+
+DESCRIPTION:
+    Finishes a conversion: adds some noise to the counts and packs
+    them into the frame with the status picked at request time
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SimulatedHih6130::convert()
+{
+    unsigned int humidity    = noisy( _humidityCount );
+    unsigned int temperature = noisy( _temperatureCount );
+
+    _frame[ 0 ] = ( unsigned char ) ( ( _pendingStatus << 6 ) | ( humidity >> 8 ) );
+    _frame[ 1 ] = ( unsigned char ) ( humidity );
+    _frame[ 2 ] = ( unsigned char ) ( temperature >> 6 );
+    _frame[ 3 ] = ( unsigned char ) ( temperature << 2 );
+
+    _converting = false;
+    _fetched = false;
+}
+
+/*======================================================================
+FUNCTION:
+    random(), happens(), noisy()
+
+DESCRIPTION:
+    A small xorshift generator so the simulation is repeatable
+    for a given seed and costs next to nothing per frame
+
+RETURN VALUE:
+    As named
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned int SimulatedHih6130::random()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+
+    return _random;
+}
+
+bool SimulatedHih6130::happens( unsigned int rate )
+{
+    return 0 != rate && random() % 1000000 < rate;
+}
+
+unsigned int SimulatedHih6130::noisy( unsigned int count )
+{
+    if ( 0 == _config.noiseCounts )
+    {
+        return count;
+    }
+
+    int value = ( int ) count + ( int ) ( random() % ( 2 * _config.noiseCounts + 1 ) ) - ( int ) _config.noiseCounts;
+
+    if ( value < 0 )
+    {
+        return 0;
+    }
+
+    if ( ( int ) MAX_COUNT < value )
+    {
+        return MAX_COUNT;
+    }
+
+    return ( unsigned int ) value;
+}
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+FUNCTION:
+    SimulatedI2cBus()
+
+DESCRIPTION:
+    This c-tor makes an empty bus
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedI2cBus::SimulatedI2cBus()
+: _hertz( 0 )
+{
+    for ( int a = 0; a < ADDRESS_COUNT; ++a )
+    {
+        _devices[ a ] = 0;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~SimulatedI2cBus()
+
+DESCRIPTION:
+    This destructor throws away the devices
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedI2cBus::~SimulatedI2cBus()
+{
+    for ( int a = 0; a < ADDRESS_COUNT; ++a )
+    {
+        delete _devices[ a ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    AddDevice()
+
+DESCRIPTION:
+    This method puts a simulated sensor on the bus.  A device that
+    was already at that address is replaced.
+
+RETURN VALUE:
+    SimulatedHih6130* - the new device (owned by the bus), or 0 if
+    the address is not a valid 7 bit address
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedHih6130* SimulatedI2cBus::AddDevice( int i2cAddress, const SimulatedHih6130::Config& config )
+{
+    if ( i2cAddress < 0 || ADDRESS_COUNT <= i2cAddress )
+    {
+        return 0;
+    }
+
+    delete _devices[ i2cAddress ];
+
+    _devices[ i2cAddress ] = new SimulatedHih6130( config );
+
+    _foreign[ i2cAddress ].clear();
+
+    return _devices[ i2cAddress ];
+}
+
+/*======================================================================
+FUNCTION:
+    Device()
+
+DESCRIPTION:
+    Looks up the device at an address
+
+RETURN VALUE:
+    SimulatedHih6130* - or 0 if nobody is there
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedHih6130* SimulatedI2cBus::Device( int i2cAddress ) const
+{
+    if ( i2cAddress < 0 || ADDRESS_COUNT <= i2cAddress )
+    {
+        return 0;
+    }
+
+    return _devices[ i2cAddress ];
+}
+
+/*======================================================================
+FUNCTION:
+    AddForeignDevice()
+
+DESCRIPTION:
+    This method puts something other than an HIH6130 on the bus.
+    A sensor that was already at that address is removed.
+
+RETURN VALUE:
+    bool - false if the address is not a valid 7 bit address or
+    there are no contents
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool SimulatedI2cBus::AddForeignDevice( int i2cAddress, const std::vector< unsigned char >& contents )
+{
+    if ( i2cAddress < 0 || ADDRESS_COUNT <= i2cAddress || contents.empty() )
+    {
+        return false;
+    }
+
+    delete _devices[ i2cAddress ];
+
+    _devices[ i2cAddress ] = 0;
+
+    _foreign[ i2cAddress ] = contents;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    SetClock()
+
+DESCRIPTION:
+    Sets the clock the transfers are timed at
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void SimulatedI2cBus::SetClock( unsigned int hertz )
+{
+    _hertz = hertz;
+}
+
+/*======================================================================
+FUNCTION:
+    Write()
+
+DESCRIPTION:
+    Any write to an HIH6130 is a measurement request.  The data
+    bytes, if any, are ignored.  A foreign device takes anything.
+
+RETURN VALUE:
+    int - length on success, -1 on a NACK
+
+SIDE EFFECTS:
+    errno is set to ENXIO on a NACK
+
+======================================================================*/
+int SimulatedI2cBus::Write( int i2cAddress, const unsigned char* /*data*/, int length )
+{
+    SimulatedHih6130* device = Device( i2cAddress );
+
+    if ( 0 == device && 0 <= i2cAddress && i2cAddress < ADDRESS_COUNT && !_foreign[ i2cAddress ].empty() )
+    {
+        wire( 1 + length );
+        return length;
+    }
+
+    if ( 0 == device || !device->MeasurementRequest() )
+    {
+        wire( 1 );
+
+        errno = ENXIO;
+        return -1;
+    }
+
+    wire( 1 + length );
+    return length;
+}
+
+/*======================================================================
+FUNCTION:
+    Read()
+
+DESCRIPTION:
+    Reads up to 4 bytes from a device.  Like the real part, you
+    can stop early (2 bytes gets you the humidity only).  Reading
+    past the 4th byte just gets 0xff.  A foreign device hands back
+    its contents from the start every time.
+
+RETURN VALUE:
+    int - length on success, -1 on a NACK
+
+SIDE EFFECTS:
+    errno is set to ENXIO on a NACK
+
+======================================================================*/
+int SimulatedI2cBus::Read( int i2cAddress, unsigned char* data, int length )
+{
+    SimulatedHih6130* device = Device( i2cAddress );
+
+    unsigned char frame[ 4 ];
+
+    if ( 0 == device && 0 <= i2cAddress && i2cAddress < ADDRESS_COUNT && !_foreign[ i2cAddress ].empty() )
+    {
+        const std::vector< unsigned char >& contents = _foreign[ i2cAddress ];
+
+        for ( int i = 0; i < length; ++i )
+        {
+            data[ i ] = contents[ i % contents.size() ];
+        }
+
+        wire( 1 + length );
+        return length;
+    }
+
+    if ( 0 == device || !device->Fetch( frame ) )
+    {
+        wire( 1 );
+
+        errno = ENXIO;
+        return -1;
+    }
+
+    for ( int i = 0; i < length; ++i )
+    {
+        data[ i ] = ( i < 4 ) ? frame[ i ] : 0xff;
+    }
+
+    wire( 1 + length );
+    return length;
+}
+
+/*======================================================================
+FUNCTION:
+    wire()
+
+DESCRIPTION:
+    Spends the time bytes take on the wire at the bus clock.  A
+    NACK still costs the address byte.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    The calling thread sleeps
+
+======================================================================*/
+void SimulatedI2cBus::wire( int bytes ) const
+{
+    if ( 0 == _hertz )
+    {
+        return;
+    }
+
+    long long nanoseconds = ( long long ) bytes * 9 * 1000000000LL / _hertz;
+
+    struct timespec delay = { ( time_t ) ( nanoseconds / 1000000000 ), ( long ) ( nanoseconds % 1000000000 ) };
+
+    while ( 0 != nanosleep( &delay, &delay ) && EINTR == errno )
+    {
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    SimulatedTransport()
+
+DESCRIPTION:
+    This c-tor hooks the transport up to a simulated bus
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedTransport::SimulatedTransport( SimulatedI2cBus& bus )
+: _bus( bus ),
+  _address( -1 ),
+  _open( false )
+{
+}
+
+/*======================================================================
+FUNCTION:
+    ~SimulatedTransport()
+
+DESCRIPTION:
+    Nothing to clean up
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+SimulatedTransport::~SimulatedTransport()
+{
+}
+
+/*======================================================================
+FUNCTION:
+    Open(), Close(), SetAddress(), Write(), Read()
+
+DESCRIPTION:
+    The same calls an i2c-dev file descriptor takes, routed to
+    the simulated bus
+
+RETURN VALUE:
+    The same as the matching system call
+
+SIDE EFFECTS:
+    errno is set on failure
+
+======================================================================*/
+bool SimulatedTransport::Open()
+{
+    if ( !_open )
+    {
+        ++_syscallCount;
+        _open = true;
+    }
+
+    return true;
+}
+
+void SimulatedTransport::Close()
+{
+    _open = false;
+    _address = -1;
+}
+
+bool SimulatedTransport::SetAddress( int i2cAddress )
+{
+    ++_syscallCount;
+
+    if ( !_open || i2cAddress < 0 || SimulatedI2cBus::ADDRESS_COUNT <= i2cAddress )
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    _address = i2cAddress;
+
+    return true;
+}
+
+int SimulatedTransport::Write( const unsigned char* data, int length )
+{
+    ++_syscallCount;
+
+    if ( !_open )
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    return _bus.Write( _address, data, length );
+}
+
+int SimulatedTransport::Read( unsigned char* data, int length )
+{
+    ++_syscallCount;
+
+    if ( !_open )
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    return _bus.Read( _address, data, length );
+}
+
+/*======================================================================
+FUNCTION:
+    Transfer()
+
+DESCRIPTION:
+    Runs a list of messages like I2C_RDWR does.  The first NACK
+    stops the transfer and fails the whole call.
+
+RETURN VALUE:
+    int - count on success, -1 on failure
+
+SIDE EFFECTS:
+    errno is set on failure
+
+======================================================================*/
+int SimulatedTransport::Transfer( struct i2c_msg* messages, int count )
+{
+    ++_syscallCount;
+
+    if ( !_open )
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    for ( int m = 0; m < count; ++m )
+    {
+        int moved;
+
+        if ( messages[ m ].flags & I2C_M_RD )
+        {
+            moved = _bus.Read( messages[ m ].addr, messages[ m ].buf, messages[ m ].len );
+        }
+        else
+        {
+            moved = _bus.Write( messages[ m ].addr, messages[ m ].buf, messages[ m ].len );
+        }
+
+        if ( moved < 0 )
+        {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+#endif
+
+/*======================================================================
+FUNCTION:
+    nowNanoseconds()
+
+DESCRIPTION:
+    Reads the monotonic clock
+
+RETURN VALUE:
+    long long - nanoseconds
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static long long nowNanoseconds()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( long long ) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*======================================================================
+FUNCTION:
+    toCount()
+
+DESCRIPTION:
+    Turns a real value back into a 14 bit count with the datasheet
+    formula:  count = ( value + offset ) / span X ( 2^14 - 1 )
+
+RETURN VALUE:
+    unsigned int - the count, clamped to 14 bits
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static unsigned int toCount( double value, double offset, double span )
+{
+    double count = ( value + offset ) / span * MAX_COUNT + 0.5;
+
+    if ( count < 0 )
+    {
+        return 0;
+    }
+
+    if ( MAX_COUNT < count )
+    {
+        return MAX_COUNT;
+    }
+
+    return ( unsigned int ) count;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+Frames are packed with the bit layout documented at the bottom of
+honeywell6130sensor.cpp: status in the top two bits of byte 1, 14 bits
+of humidity, then 14 bits of temperature left justified in bytes 3
+and 4 with the bottom two bits unused.
+
+With conversionMicroseconds at 0 nothing here touches the clock, which
+is what lets a single core push millions of frames a second through
+the sensor classes.
+
+=====================================================================*/
@@ -0,0 +1,417 @@
+#ifndef _SIMULATEDI2C_H_
+#define _SIMULATEDI2C_H_
+
+/*======================================================================
+FILE:
+    simulatedi2c.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    An in-process stand-in for an i2c bus full of Honeywell 6130
+    sensors.
+
+DESCRIPTION:
+    This header defines a simulated HIH6130, a simulated bus to
+    hang them on, and a transport that plugs the simulated bus in
+    under the sensor classes.  It lets the decode and scheduling
+    code run (and be timed) on any Linux box with no hardware.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    SimulatedHih6130
+    SimulatedI2cBus
+    SimulatedTransport
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "i2ctransport.h"
+
+#if !defined( HONEYWELL_EMBEDDED )
+#include <vector>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// Like a real bus, a simulated bus has no locking.  Keep all of the
+// traffic for one bus on one thread (SensorFleet already does).
+
+// The Embedded build (HONEYWELL_EMBEDDED) has SimulatedHih6130 but
+// not the bus or its transport, which keep their devices on the heap.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    SimulatedHih6130
+
+DESCRIPTION:
+    Acts like one HIH6130 on the bus.  A measurement request starts
+    a conversion.  Fetching before the conversion is done, or
+    fetching the same result twice, gives stale data (status 01),
+    exactly like the real part.  Faults can be injected at a given
+    rate: NACKs, command mode frames (10) and diagnostic frames (11).
+
+HOW TO USE:
+    1. Fill in a Config and hand it to SimulatedI2cBus::AddDevice()
+    2. Change the environment with SetEnvironment() whenever you like
+
+======================================================================*/
+class SimulatedHih6130
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // Fault rates are in parts per million of transactions
+    struct Config
+    {
+        double temperatureCelcius;
+        double relativeHumidity;
+        unsigned int noiseCounts;
+        unsigned int conversionMicroseconds;
+        unsigned int nackRate;
+        unsigned int commandModeRate;
+        unsigned int diagnosticRate;
+        unsigned int seed;
+
+        Config();
+    };
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SimulatedHih6130( const Config& config );
+
+    virtual ~SimulatedHih6130();
+
+    void SetEnvironment( double temperatureCelcius, double relativeHumidity );
+
+    // Bus side.  Both return false when the device NACKs.
+    bool MeasurementRequest();
+
+    bool Fetch( unsigned char frame[ 4 ] );
+
+    unsigned long long MeasurementCount() const;
+
+    unsigned long long FetchCount() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SimulatedHih6130( const SimulatedHih6130 &rhs );
+
+    unsigned int random();
+
+    bool happens( unsigned int rate );
+
+    unsigned int noisy( unsigned int count );
+
+    void convert();
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    Config _config;
+
+    unsigned int _random;
+
+    unsigned int _temperatureCount;
+
+    unsigned int _humidityCount;
+
+    // The result the device hands back, already packed
+    unsigned char _frame[ 4 ];
+
+    bool _converting;
+
+    bool _fetched;
+
+    long long _readyNanoseconds;
+
+    unsigned char _pendingStatus;
+
+    unsigned long long _measurementCount;
+
+    unsigned long long _fetchCount;
+
+};
+
+#if !defined( HONEYWELL_EMBEDDED )
+
+/*======================================================================
+CLASS:
+    SimulatedI2cBus
+
+DESCRIPTION:
+    Holds the simulated devices at their 7 bit addresses and routes
+    reads and writes to them.  Nobody home at an address means a
+    NACK, just like on the wire.  Devices that are not HIH6130s
+    (an EEPROM, another sensor) can be added to see that they are
+    told apart, and the bus can be given a clock so transfers take
+    as long as they would on the wire.
+
+HOW TO USE:
+    1. Call AddDevice() for every sensor on the bus, and
+       AddForeignDevice() for anything else
+    2. Call SetClock() for wire timing
+    3. Hand the bus to one SimulatedTransport per sensor object
+
+======================================================================*/
+class SimulatedI2cBus
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const int ADDRESS_COUNT = 128;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SimulatedI2cBus();
+
+    virtual ~SimulatedI2cBus();
+
+    SimulatedHih6130* AddDevice( int i2cAddress,
+                                 const SimulatedHih6130::Config& config = SimulatedHih6130::Config() );
+
+    SimulatedHih6130* Device( int i2cAddress ) const;
+
+    // A device that acknowledges, ignores writes and reads back
+    // contents over and over.  Replaces a sensor at the address.
+    bool AddForeignDevice( int i2cAddress, const std::vector< unsigned char >& contents );
+
+    // Every transfer then sleeps for the address byte and the data
+    // bytes at this clock (9 bits each).  0, the default, is instant.
+    void SetClock( unsigned int hertz );
+
+    // Return the number of bytes moved, or -1 on a NACK
+    int Write( int i2cAddress, const unsigned char* data, int length );
+
+    int Read( int i2cAddress, unsigned char* data, int length );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    SimulatedI2cBus( const SimulatedI2cBus &rhs );
+
+    void wire( int bytes ) const;
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    SimulatedHih6130* _devices[ ADDRESS_COUNT ];
+
+    // Empty where there is no foreign device
+    std::vector< unsigned char > _foreign[ ADDRESS_COUNT ];
+
+    unsigned int _hertz;
+
+};
+
+/*======================================================================
+CLASS:
+    SimulatedTransport
+
+DESCRIPTION:
+    Plugs a SimulatedI2cBus in wherever an I2cTransport is wanted.
+    It counts calls the same way the i2c-dev transport counts
+    system calls so numbers from the two can be compared.
+
+HOW TO USE:
+    1. Construct the object passing the simulated bus
+    2. Use it through the I2cTransport interface
+
+======================================================================*/
+class SimulatedTransport : public I2cTransport
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    SimulatedTransport( SimulatedI2cBus& bus );
+
+    virtual ~SimulatedTransport();
+
+    virtual bool Open();
+
+    virtual void Close();
+
+    virtual bool SetAddress( int i2cAddress );
+
+    virtual int Write( const unsigned char* data, int length );
+
+    virtual int Read( unsigned char* data, int length );
+
+    virtual int Transfer( struct i2c_msg* messages, int count );
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    SimulatedI2cBus& _bus;
+
+    int _address;
+
+    bool _open;
+
+};
+
+#endif
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+None.
+
+======================================================================*/
+
+#endif	// #ifendif _SIMULATEDI2C_H_
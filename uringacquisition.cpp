@@ -0,0 +1,772 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    uringacquisition.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to read many Honeywell 6130 sensors through one
+    io_uring
+
+GENERAL DESCRIPTION:
+    This file sets the ring up with the raw system calls (there
+    is no liburing on the target) and runs the linked
+    write/timeout/read chains
+
+PUBLIC CLASSES AND FUNCTIONS:
+    UringAcquisition
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    Make sure the sensors are connected to the i2c bus
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// Older toolchains do not ship the io_uring header.  Without it the
+// backend still links, but Available() says no.
+#if defined( __has_include )
+#if __has_include( <linux/io_uring.h> )
+#define HONEYWELL_HAVE_IO_URING
+#endif
+#endif
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "uringacquisition.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifdef HONEYWELL_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// The measurement command we send to every sensor
+static unsigned char measurementCommand[ 1 ] = { 0 };
+
+// What a completion belongs to.  The sensor index goes in the
+// rest of user_data.
+enum RequestKind
+{
+    REQUEST_WRITE   = 0,
+    REQUEST_TIMEOUT = 1,
+    REQUEST_READ    = 2
+};
+
+static const unsigned int REQUEST_BITS = 2;
+
+// Requests per sensor in the first pass of a round
+static const unsigned int REQUESTS_PER_SENSOR = 3;
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+#ifdef HONEYWELL_HAVE_IO_URING
+static int ioUringSetup( unsigned int entries, struct io_uring_params* params );
+
+static int ioUringEnter( int ring, unsigned int toSubmit, unsigned int minComplete, unsigned int flags );
+
+static int ioUringRegister( int ring, unsigned int opcode, void* arg, unsigned int count );
+#endif
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    UringAcquisition()
+
+DESCRIPTION:
+    This c-tor sizes the ring so that a whole round fits in the
+    submission queue and maps it
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+UringAcquisition::UringAcquisition( const std::vector< int >& fileDescriptors,
+                                    unsigned int settleMicroseconds,
+                                    unsigned int staleRetries )
+: _fileDescriptors( fileDescriptors ),
+  _staleRetries( staleRetries ),
+  _ringDescriptor( -1 ),
+  _sqRing( MAP_FAILED ),
+  _sqRingSize( 0 ),
+  _cqRing( MAP_FAILED ),
+  _cqRingSize( 0 ),
+  _sqes( 0 ),
+  _sqesSize( 0 ),
+  _sqHead( 0 ),
+  _sqTail( 0 ),
+  _sqMask( 0 ),
+  _sqArray( 0 ),
+  _cqHead( 0 ),
+  _cqTail( 0 ),
+  _cqMask( 0 ),
+  _cqes( 0 ),
+  _queued( 0 ),
+  _frames( fileDescriptors.size() * Honeywell6130Sensor::FRAME_SIZE ),
+  _writeResults( fileDescriptors.size() ),
+  _readResults( fileDescriptors.size() ),
+  _errorCount( 0 ),
+  _syscallCount( 0 )
+{
+    _settle[ 0 ] = settleMicroseconds / 1000000;
+    _settle[ 1 ] = ( long long ) ( settleMicroseconds % 1000000 ) * 1000;
+
+    setup();
+}
+
+/*======================================================================
+FUNCTION:
+    ~UringAcquisition()
+
+DESCRIPTION:
+    This destructor unmaps and closes the ring.  The sensor file
+    descriptors are left alone.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+UringAcquisition::~UringAcquisition()
+{
+    teardown();
+}
+
+/*======================================================================
+FUNCTION:
+    Available()
+
+DESCRIPTION:
+    This method sets up a tiny ring and asks the kernel whether it
+    knows the three opcodes we use
+
+RETURN VALUE:
+    bool - true if the backend can run here
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool UringAcquisition::Available()
+{
+#ifdef HONEYWELL_HAVE_IO_URING
+    struct io_uring_params params;
+
+    memset( &params, 0, sizeof( params ) );
+
+    int ring = ioUringSetup( 4, &params );
+
+    if ( ring < 0 )
+    {
+        return false;
+    }
+
+    // The probe has room for the opcodes after the header
+    const size_t PROBE_OPS = 64;
+
+    std::vector< unsigned char > buffer( sizeof( struct io_uring_probe ) +
+                                         PROBE_OPS * sizeof( struct io_uring_probe_op ) );
+
+    struct io_uring_probe* probe = ( struct io_uring_probe* ) &buffer[ 0 ];
+
+    bool available = false;
+
+    if ( 0 == ioUringRegister( ring, IORING_REGISTER_PROBE, probe, PROBE_OPS ) )
+    {
+        const unsigned int needed[] = { IORING_OP_WRITE, IORING_OP_READ, IORING_OP_TIMEOUT };
+
+        available = true;
+
+        for ( size_t n = 0; n < sizeof( needed ) / sizeof( needed[ 0 ] ); ++n )
+        {
+            if ( probe->last_op < needed[ n ] ||
+                 0 == ( probe->ops[ needed[ n ] ].flags & IO_URING_OP_SUPPORTED ) )
+            {
+                available = false;
+            }
+        }
+    }
+
+    close( ring );
+
+    return available;
+#else
+    return false;
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    SensorCount(), ErrorCount(), SyscallCount()
+
+DESCRIPTION:
+    Simple accessors
+
+RETURN VALUE:
+    The requested value
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+size_t UringAcquisition::SensorCount() const
+{
+    return _fileDescriptors.size();
+}
+
+unsigned long long UringAcquisition::ErrorCount() const
+{
+    return _errorCount;
+}
+
+unsigned long long UringAcquisition::SyscallCount() const
+{
+    return _syscallCount;
+}
+
+/*======================================================================
+FUNCTION:
+    setup()
+
+DESCRIPTION:
+    This method creates the ring and maps the submission queue,
+    the completion queue and the submission entries
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    Throws a SensorException on failure
+
+======================================================================*/
+void UringAcquisition::setup()
+{
+#ifdef HONEYWELL_HAVE_IO_URING
+    unsigned int entries = 4;
+
+    while ( entries < _fileDescriptors.size() * REQUESTS_PER_SENSOR )
+    {
+        entries <<= 1;
+    }
+
+    struct io_uring_params params;
+
+    memset( &params, 0, sizeof( params ) );
+
+    ++_syscallCount;
+
+    _ringDescriptor = ioUringSetup( entries, &params );
+
+    if ( _ringDescriptor < 0 )
+    {
+        throw SensorException( "Failed to set up io_uring" );
+    }
+
+    _sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned int );
+    _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+
+    // Newer kernels put both queues in one mapping
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if ( _sqRingSize < _cqRingSize )
+        {
+            _sqRingSize = _cqRingSize;
+        }
+
+        _cqRingSize = 0;
+    }
+
+    _sqRing = mmap( 0, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    _ringDescriptor, IORING_OFF_SQ_RING );
+
+    if ( MAP_FAILED == _sqRing )
+    {
+        teardown();
+        throw SensorException( "Failed to map io_uring" );
+    }
+
+    if ( 0 == _cqRingSize )
+    {
+        _cqRing = _sqRing;
+    }
+    else
+    {
+        _cqRing = mmap( 0, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _ringDescriptor, IORING_OFF_CQ_RING );
+
+        if ( MAP_FAILED == _cqRing )
+        {
+            teardown();
+            throw SensorException( "Failed to map io_uring" );
+        }
+    }
+
+    _sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    void* sqes = mmap( 0, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       _ringDescriptor, IORING_OFF_SQES );
+
+    if ( MAP_FAILED == sqes )
+    {
+        teardown();
+        throw SensorException( "Failed to map io_uring" );
+    }
+
+    _sqes = ( struct io_uring_sqe* ) sqes;
+
+    unsigned char* sq = ( unsigned char* ) _sqRing;
+    unsigned char* cq = ( unsigned char* ) _cqRing;
+
+    _sqHead  = ( unsigned int* ) ( sq + params.sq_off.head );
+    _sqTail  = ( unsigned int* ) ( sq + params.sq_off.tail );
+    _sqMask  = *( unsigned int* ) ( sq + params.sq_off.ring_mask );
+    _sqArray = ( unsigned int* ) ( sq + params.sq_off.array );
+
+    _cqHead  = ( unsigned int* ) ( cq + params.cq_off.head );
+    _cqTail  = ( unsigned int* ) ( cq + params.cq_off.tail );
+    _cqMask  = *( unsigned int* ) ( cq + params.cq_off.ring_mask );
+    _cqes    = ( struct io_uring_cqe* ) ( cq + params.cq_off.cqes );
+#else
+    throw SensorException( "io_uring is not supported by this build" );
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    teardown()
+
+DESCRIPTION:
+    This method undoes whatever setup() got done
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void UringAcquisition::teardown()
+{
+    if ( 0 != _sqes )
+    {
+        munmap( _sqes, _sqesSize );
+        _sqes = 0;
+    }
+
+    if ( MAP_FAILED != _cqRing && _cqRing != _sqRing )
+    {
+        munmap( _cqRing, _cqRingSize );
+    }
+
+    _cqRing = MAP_FAILED;
+
+    if ( MAP_FAILED != _sqRing )
+    {
+        munmap( _sqRing, _sqRingSize );
+        _sqRing = MAP_FAILED;
+    }
+
+    if ( 0 <= _ringDescriptor )
+    {
+        close( _ringDescriptor );
+        _ringDescriptor = -1;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Poll()
+
+DESCRIPTION:
+    This method does one round.  Every sensor gets a linked
+    write -> timeout -> read chain and the whole lot is submitted
+    and waited for in one system call.  Sensors that report stale
+    data get a timeout -> read chain per retry.
+
+RETURN VALUE:
+    size_t - number of sensors with fresh data
+
+SIDE EFFECTS:
+    fresh is replaced with the sensors that were decoded
+
+======================================================================*/
+size_t UringAcquisition::Poll( TempHumidityData* data, std::vector< size_t >& fresh )
+{
+    fresh.clear();
+
+#ifdef HONEYWELL_HAVE_IO_URING
+    const size_t count = _fileDescriptors.size();
+
+    if ( 0 == count )
+    {
+        return 0;
+    }
+
+    std::vector< size_t > pending;
+
+    pending.reserve( count );
+
+    for ( size_t s = 0; s < count; ++s )
+    {
+        struct io_uring_sqe* sqe = nextSqe();
+
+        sqe->opcode    = IORING_OP_WRITE;
+        sqe->flags     = IOSQE_IO_LINK;
+        sqe->fd        = _fileDescriptors[ s ];
+        sqe->addr      = ( unsigned long ) measurementCommand;
+        sqe->len       = sizeof( measurementCommand );
+        sqe->off       = ( __u64 ) -1;
+        sqe->user_data = ( s << REQUEST_BITS ) | REQUEST_WRITE;
+
+        _writeResults[ s ] = 0;
+
+        queueFetch( s );
+
+        pending.push_back( s );
+    }
+
+    unsigned int completions = ( unsigned int ) count * REQUESTS_PER_SENSOR;
+
+    for ( unsigned int attempt = 0; !pending.empty() && attempt <= _staleRetries; ++attempt )
+    {
+        if ( !submitAndWait( completions ) )
+        {
+            // The ring itself is broken.  Count the round as lost.
+            _errorCount += pending.size();
+            return fresh.size();
+        }
+
+        size_t stillPending = 0;
+
+        for ( size_t p = 0; p < pending.size(); ++p )
+        {
+            size_t s = pending[ p ];
+
+            if ( _writeResults[ s ] < 0 || Honeywell6130Sensor::FRAME_SIZE != _readResults[ s ] )
+            {
+                ++_errorCount;
+                continue;
+            }
+
+            TempHumidityData decoded;
+
+            Honeywell6130Sensor::Decode( &_frames[ s * Honeywell6130Sensor::FRAME_SIZE ], decoded );
+
+            if ( Honeywell6130Sensor::STATUS_STALE == decoded.status )
+            {
+                pending[ stillPending++ ] = s;
+                continue;
+            }
+
+            data[ s ] = decoded;
+            fresh.push_back( s );
+        }
+
+        pending.resize( stillPending );
+
+        if ( attempt < _staleRetries )
+        {
+            for ( size_t p = 0; p < pending.size(); ++p )
+            {
+                queueFetch( pending[ p ] );
+            }
+
+            completions = ( unsigned int ) pending.size() * ( REQUESTS_PER_SENSOR - 1 );
+        }
+    }
+
+    // Anyone left never finished the conversion
+    _errorCount += pending.size();
+#else
+    ( void ) data;
+#endif
+
+    return fresh.size();
+}
+
+/*======================================================================
+FUNCTION:
+    nextSqe()
+
+DESCRIPTION:
+    This method hands out the next free submission entry, cleared.
+    The ring is sized for a whole round, so there is always one.
+
+RETURN VALUE:
+    io_uring_sqe*
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+io_uring_sqe* UringAcquisition::nextSqe()
+{
+#ifdef HONEYWELL_HAVE_IO_URING
+    unsigned int tail = *_sqTail + _queued;
+    unsigned int index = tail & _sqMask;
+
+    struct io_uring_sqe* sqe = &_sqes[ index ];
+
+    memset( sqe, 0, sizeof( *sqe ) );
+
+    _sqArray[ index ] = index;
+
+    ++_queued;
+
+    return sqe;
+#else
+    return 0;
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    queueFetch()
+
+DESCRIPTION:
+    This method queues the settle timeout and the result read for
+    one sensor.  The timeout is hard linked to the read since it
+    always "fails" with -ETIME.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void UringAcquisition::queueFetch( size_t sensor )
+{
+#ifdef HONEYWELL_HAVE_IO_URING
+    struct io_uring_sqe* sqe = nextSqe();
+
+    sqe->opcode    = IORING_OP_TIMEOUT;
+    sqe->flags     = IOSQE_IO_HARDLINK;
+    sqe->fd        = -1;
+    sqe->addr      = ( unsigned long ) _settle;
+    sqe->len       = 1;
+    sqe->user_data = ( sensor << REQUEST_BITS ) | REQUEST_TIMEOUT;
+
+    sqe = nextSqe();
+
+    sqe->opcode    = IORING_OP_READ;
+    sqe->fd        = _fileDescriptors[ sensor ];
+    sqe->addr      = ( unsigned long ) &_frames[ sensor * Honeywell6130Sensor::FRAME_SIZE ];
+    sqe->len       = Honeywell6130Sensor::FRAME_SIZE;
+    sqe->off       = ( __u64 ) -1;
+    sqe->user_data = ( sensor << REQUEST_BITS ) | REQUEST_READ;
+
+    _readResults[ sensor ] = 0;
+#else
+    ( void ) sensor;
+#endif
+}
+
+/*======================================================================
+FUNCTION:
+    submitAndWait()
+
+DESCRIPTION:
+    This method publishes everything queued, enters the kernel
+    once to submit it and wait for it, and then files every
+    completion under its sensor
+
+RETURN VALUE:
+    bool - false if io_uring_enter() failed
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool UringAcquisition::submitAndWait( unsigned int completions )
+{
+#ifdef HONEYWELL_HAVE_IO_URING
+    __atomic_store_n( _sqTail, *_sqTail + _queued, __ATOMIC_RELEASE );
+
+    unsigned int toSubmit = _queued;
+
+    _queued = 0;
+
+    while ( 0 < completions )
+    {
+        unsigned int head = *_cqHead;
+        unsigned int tail = __atomic_load_n( _cqTail, __ATOMIC_ACQUIRE );
+
+        if ( head == tail )
+        {
+            ++_syscallCount;
+
+            int submitted = ioUringEnter( _ringDescriptor, toSubmit, completions, IORING_ENTER_GETEVENTS );
+
+            if ( submitted < 0 )
+            {
+                if ( EINTR == errno )
+                {
+                    continue;
+                }
+
+                return false;
+            }
+
+            toSubmit -= ( unsigned int ) submitted;
+            continue;
+        }
+
+        for ( ; head != tail && 0 < completions; ++head, --completions )
+        {
+            const struct io_uring_cqe& cqe = _cqes[ head & _cqMask ];
+
+            size_t sensor = ( size_t ) ( cqe.user_data >> REQUEST_BITS );
+
+            switch ( cqe.user_data & ( ( 1 << REQUEST_BITS ) - 1 ) )
+            {
+            case REQUEST_WRITE:
+                _writeResults[ sensor ] = cqe.res;
+                break;
+
+            case REQUEST_READ:
+                _readResults[ sensor ] = cqe.res;
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        __atomic_store_n( _cqHead, head, __ATOMIC_RELEASE );
+    }
+
+    return true;
+#else
+    ( void ) completions;
+    return false;
+#endif
+}
+
+#ifdef HONEYWELL_HAVE_IO_URING
+
+/*======================================================================
+FUNCTION:
+    ioUringSetup(), ioUringEnter(), ioUringRegister()
+
+DESCRIPTION:
+    Thin wrappers for the system calls, which the C library does
+    not have
+
+RETURN VALUE:
+    int - same as the system call
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+static int ioUringSetup( unsigned int entries, struct io_uring_params* params )
+{
+    return ( int ) syscall( __NR_io_uring_setup, entries, params );
+}
+
+static int ioUringEnter( int ring, unsigned int toSubmit, unsigned int minComplete, unsigned int flags )
+{
+    return ( int ) syscall( __NR_io_uring_enter, ring, toSubmit, minComplete, flags, 0, 0 );
+}
+
+static int ioUringRegister( int ring, unsigned int opcode, void* arg, unsigned int count )
+{
+    return ( int ) syscall( __NR_io_uring_register, ring, opcode, arg, count );
+}
+
+#endif
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+A round on N sensors costs one io_uring_enter() when nobody is stale,
+against 2N write()/read() calls plus a usleep() on the blocking path.
+i2c-dev does not do non-blocking i/o, so the kernel hands each write
+and read to an io-wq worker.  The i2c core locks the adapter around
+every transfer, so sensors on the same bus still take turns on the
+wire while sensors on different buses run at the same time.
+
+The submission ring is sized to hold three entries per sensor and the
+completion ring is twice that, so a round can never overflow either.
+
+=====================================================================*/
@@ -0,0 +1,263 @@
+#ifndef _URINGACQUISITION_H_
+#define _URINGACQUISITION_H_
+
+/*======================================================================
+FILE:
+    uringacquisition.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Reads many Honeywell 6130 sensors from one thread through an
+    io_uring, without a blocking write()/read() per sensor.
+
+DESCRIPTION:
+    This header defines an acquisition backend that queues the
+    measurement command, the settle wait and the result read for
+    every sensor as one linked chain on an io_uring, submits the
+    whole round in one system call and waits for it in the same
+    call.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    UringAcquisition
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// The file descriptors are not owned and must already be bound to
+// their sensor with I2C_SLAVE (a Honeywell6130Sensor or an open
+// I2cDevTransport does that).  Do not touch them from anywhere else
+// while a Poll() is running.  Poll() is not thread safe.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    UringAcquisition
+
+DESCRIPTION:
+    This class drives a list of sensors, on any number of buses,
+    from the calling thread.  Every round queues three linked
+    requests per sensor: write the measurement command, wait the
+    settle time with a ring timeout, read the 4 byte result.  The
+    whole round goes to the kernel in one io_uring_enter() that
+    also waits for it to finish.  Sensors that come back stale
+    get another timeout and read, again all in one call.
+
+HOW TO USE:
+    1. Check Available(); older kernels and seccomp sandboxes do
+       not have io_uring
+    2. Construct the object passing the bound file descriptors
+    3. Call Poll() once per polling round
+
+======================================================================*/
+class UringAcquisition
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const unsigned int DEFAULT_SETTLE_MICROSECONDS = 1000;
+    static const unsigned int DEFAULT_STALE_RETRIES       = 3;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // Throws a SensorException if the ring can not be set up
+    UringAcquisition( const std::vector< int >& fileDescriptors,
+                      unsigned int settleMicroseconds = DEFAULT_SETTLE_MICROSECONDS,
+                      unsigned int staleRetries = DEFAULT_STALE_RETRIES );
+
+    virtual ~UringAcquisition();
+
+    // True if this build and this kernel can run the backend
+    static bool Available();
+
+    size_t SensorCount() const;
+
+    // One polling round on every sensor.  Fresh results go into
+    // data[ sensor index ] and their indexes go into fresh.
+    size_t Poll( TempHumidityData* data, std::vector< size_t >& fresh );
+
+    // Sensors that failed a transfer or never finished converting
+    unsigned long long ErrorCount() const;
+
+    // Number of io_uring system calls, including the setup
+    unsigned long long SyscallCount() const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    UringAcquisition( const UringAcquisition &rhs );
+
+    void setup();
+
+    void teardown();
+
+    io_uring_sqe* nextSqe();
+
+    void queueFetch( size_t sensor );
+
+    bool submitAndWait( unsigned int completions );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    std::vector< int > _fileDescriptors;
+
+    unsigned int _staleRetries;
+
+    // A __kernel_timespec, kept as two fields so the header does
+    // not need the kernel headers
+    long long _settle[ 2 ];
+
+    int _ringDescriptor;
+
+    void* _sqRing;
+    size_t _sqRingSize;
+
+    void* _cqRing;
+    size_t _cqRingSize;
+
+    io_uring_sqe* _sqes;
+    size_t _sqesSize;
+
+    unsigned int* _sqHead;
+    unsigned int* _sqTail;
+    unsigned int _sqMask;
+    unsigned int* _sqArray;
+
+    unsigned int* _cqHead;
+    unsigned int* _cqTail;
+    unsigned int _cqMask;
+    io_uring_cqe* _cqes;
+
+    // Requests queued since the last submit
+    unsigned int _queued;
+
+    std::vector< unsigned char > _frames;
+
+    // Result of the last write and read of every sensor
+    std::vector< int > _writeResults;
+    std::vector< int > _readResults;
+
+    unsigned long long _errorCount;
+
+    unsigned long long _syscallCount;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+The write is linked to the timeout with IOSQE_IO_LINK, so a sensor
+that does not answer its address never gets the read.  The timeout is
+linked to the read with IOSQE_IO_HARDLINK: a timeout that runs out
+completes with -ETIME, which would cancel a soft link.  (Kernels from
+5.16 on can say IORING_TIMEOUT_ETIME_SUCCESS instead; the hard link
+gets the same result back to 5.6, which is where IORING_OP_READ and
+IORING_OP_WRITE showed up.)
+
+======================================================================*/
+
+#endif	// #ifendif _URINGACQUISITION_H_
@@ -0,0 +1,789 @@
+//======================================================================
+// OBJECT FILE COPYRIGHT NOTICE
+//======================================================================
+
+static const char copyright[] =
+"Copyright (C) 2014 Sean Foley, All rights reserved.";
+
+/*======================================================================
+FILE:
+    windowaggregator.cpp
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Methods to roll readings up into tumbling and sliding windows
+
+GENERAL DESCRIPTION:
+    This file implements the quantile sketch, the per-channel
+    moments and extremes, and the per-sensor window bookkeeping
+
+PUBLIC CLASSES AND FUNCTIONS:
+    QuantileSketch
+    ChannelSummary
+    WindowSummary
+    WindowAggregator
+
+INITIALIZATION AND SEQUENCING REQUIREMENTS:
+    None
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND VARIABLE DEFINITIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "windowaggregator.h"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Static Variable Definitions
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Function Prototypes
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Required Libraries
+//----------------------------------------------------------------------
+
+// None. (Where supported these should be in the form
+// of C++ pragmas).
+
+//======================================================================
+// FUNCTION IMPLEMENTATIONS
+//======================================================================
+
+/*======================================================================
+FUNCTION:
+    QuantileSketch()
+
+DESCRIPTION:
+    This c-tor starts with every bin empty
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+QuantileSketch::QuantileSketch()
+: _total( 0 ),
+  _low( BINS ),
+  _high( 0 )
+{
+    memset( _bins, 0, sizeof( _bins ) );
+}
+
+/*======================================================================
+FUNCTION:
+    Clear()
+
+DESCRIPTION:
+    Empties the bins that were touched since the last Clear()
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QuantileSketch::Clear()
+{
+    if ( _low <= _high )
+    {
+        memset( &_bins[ _low ], 0, ( _high - _low + 1 ) * sizeof( _bins[ 0 ] ) );
+    }
+
+    _total = 0;
+    _low   = BINS;
+    _high  = 0;
+}
+
+/*======================================================================
+FUNCTION:
+    Merge()
+
+DESCRIPTION:
+    Adds the other sketch's bins to ours
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void QuantileSketch::Merge( const QuantileSketch& other )
+{
+    for ( unsigned int bin = other._low; bin <= other._high; ++bin )
+    {
+        _bins[ bin ] += other._bins[ bin ];
+    }
+
+    if ( other._low < _low )
+    {
+        _low = other._low;
+    }
+
+    if ( _high < other._high && other._low <= other._high )
+    {
+        _high = other._high;
+    }
+
+    _total += other._total;
+}
+
+/*======================================================================
+FUNCTION:
+    Quantile()
+
+DESCRIPTION:
+    Walks the bins up to the one holding the ceil( q * total )'th
+    smallest count, and places it within the bin as if the bin's
+    readings were spread evenly across it
+
+RETURN VALUE:
+    unsigned int - a count in that bin, or 0 when empty
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned int QuantileSketch::Quantile( double q ) const
+{
+    if ( 0 == _total )
+    {
+        return 0;
+    }
+
+    double wanted = ceil( q * _total );
+
+    unsigned long long rank = ( wanted < 1 ) ? 1 : ( ( _total < wanted ) ? _total : ( unsigned long long ) wanted );
+
+    unsigned long long seen = 0;
+
+    for ( unsigned int bin = _low; bin <= _high; ++bin )
+    {
+        if ( rank <= seen + _bins[ bin ] )
+        {
+            // Spread the bin's readings evenly across it
+            double within = ( rank - seen - 0.5 ) / _bins[ bin ];
+
+            return ( bin << SHIFT ) + ( unsigned int ) ( within * ( 1u << SHIFT ) );
+        }
+
+        seen += _bins[ bin ];
+    }
+
+    return ( _high << SHIFT ) + ( 1u << SHIFT ) / 2;
+}
+
+/*======================================================================
+FUNCTION:
+    ChannelSummary::Clear()
+
+DESCRIPTION:
+    Back to no readings
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void ChannelSummary::Clear()
+{
+    _readings = 0;
+    _mean     = 0;
+    _m2       = 0;
+    _min      = UINT_MAX;
+    _max      = 0;
+
+    _sketch.Clear();
+}
+
+/*======================================================================
+FUNCTION:
+    ChannelSummary::Remove()
+
+DESCRIPTION:
+    Runs Welford's update backwards for a reading leaving the
+    window
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void ChannelSummary::Remove( unsigned int count )
+{
+    _sketch.Remove( count );
+
+    if ( _readings <= 1 )
+    {
+        _readings = 0;
+        _mean     = 0;
+        _m2       = 0;
+        return;
+    }
+
+    double delta = count - _mean;
+
+    --_readings;
+
+    _mean -= delta / _readings;
+    _m2   -= delta * ( count - _mean );
+
+    // Rounding must not leave a negative variance behind
+    if ( _m2 < 0 )
+    {
+        _m2 = 0;
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ChannelSummary::Merge()
+
+DESCRIPTION:
+    Combines the other summary into this one with Chan's parallel
+    form of Welford's update
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void ChannelSummary::Merge( const ChannelSummary& other )
+{
+    if ( 0 == other._readings )
+    {
+        return;
+    }
+
+    unsigned long long readings = _readings + other._readings;
+
+    double delta = other._mean - _mean;
+
+    _mean += delta * other._readings / readings;
+    _m2   += other._m2 + delta * delta * ( ( double ) _readings * other._readings / readings );
+
+    _readings = readings;
+
+    if ( other._min < _min )
+    {
+        _min = other._min;
+    }
+
+    if ( _max < other._max )
+    {
+        _max = other._max;
+    }
+
+    _sketch.Merge( other._sketch );
+}
+
+/*======================================================================
+FUNCTION:
+    ChannelSummary::StandardDeviation()
+
+DESCRIPTION:
+    Square root of Variance()
+
+RETURN VALUE:
+    double - in counts
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+double ChannelSummary::StandardDeviation() const
+{
+    return sqrt( Variance() );
+}
+
+/*======================================================================
+FUNCTION:
+    ChannelSummary::Quantile()
+
+DESCRIPTION:
+    The sketch's answer, pulled in to the exact extremes so a
+    percentile never lies outside what was seen
+
+RETURN VALUE:
+    unsigned int - a count, 0 when empty
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+unsigned int ChannelSummary::Quantile( double q ) const
+{
+    if ( 0 == _readings )
+    {
+        return 0;
+    }
+
+    unsigned int count = _sketch.Quantile( q );
+
+    if ( count < _min )
+    {
+        return _min;
+    }
+
+    return ( _max < count ) ? _max : count;
+}
+
+/*======================================================================
+FUNCTION:
+    WindowSummary::Merge()
+
+DESCRIPTION:
+    Combines both channels and widens the times
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowSummary::Merge( const WindowSummary& other )
+{
+    if ( 0 == other.temperature.Readings() )
+    {
+        return;
+    }
+
+    if ( 0 == temperature.Readings() )
+    {
+        startMicroseconds = other.startMicroseconds;
+        endMicroseconds   = other.endMicroseconds;
+    }
+    else
+    {
+        startMicroseconds = ( other.startMicroseconds < startMicroseconds ) ? other.startMicroseconds : startMicroseconds;
+        endMicroseconds   = ( endMicroseconds < other.endMicroseconds ) ? other.endMicroseconds : endMicroseconds;
+    }
+
+    temperature.Merge( other.temperature );
+    humidity.Merge( other.humidity );
+}
+
+/*======================================================================
+FUNCTION:
+    WindowAggregator()
+
+DESCRIPTION:
+    This c-tor allocates every sensor's windows.  The sliding
+    capacity is rounded up to a power of two.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+WindowAggregator::WindowAggregator( size_t sensorCount,
+                                    long long tumblingMicroseconds,
+                                    WindowHandler handler,
+                                    long long slidingMicroseconds,
+                                    size_t slidingCapacity )
+: _tumblingMicroseconds( tumblingMicroseconds ),
+  _slidingMicroseconds( slidingMicroseconds ),
+  _slidingCapacity( 2 ),
+  _handler( handler ),
+  _updates( 0 ),
+  _windows( 0 ),
+  _slidingOverflows( 0 )
+{
+    while ( _slidingCapacity < slidingCapacity && _slidingCapacity < MAX_SLIDING_CAPACITY )
+    {
+        _slidingCapacity *= 2;
+    }
+
+    for ( size_t s = 0; s < sensorCount; ++s )
+    {
+        SensorWindows* windows = new SensorWindows;
+
+        windows->tumbling.sensor = s;
+        windows->tumbling.startMicroseconds = 0;
+        windows->tumbling.endMicroseconds   = 0;
+
+        windows->sliding.sensor = s;
+        windows->sliding.startMicroseconds = 0;
+        windows->sliding.endMicroseconds   = 0;
+
+        windows->ringHead = 0;
+        windows->ringSize = 0;
+
+        if ( 0 < _slidingMicroseconds )
+        {
+            windows->ring.resize( _slidingCapacity );
+
+            windows->minTemperature.Reset( _slidingCapacity );
+            windows->maxTemperature.Reset( _slidingCapacity );
+            windows->minHumidity.Reset( _slidingCapacity );
+            windows->maxHumidity.Reset( _slidingCapacity );
+        }
+
+        _sensors.push_back( windows );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    ~WindowAggregator()
+
+DESCRIPTION:
+    This d-tor frees the windows.  Open tumbling windows are not
+    handed out; call FlushTumbling() first for those.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+WindowAggregator::~WindowAggregator()
+{
+    for ( size_t s = 0; s < _sensors.size(); ++s )
+    {
+        delete _sensors[ s ];
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Add()
+
+DESCRIPTION:
+    Takes the reading back to counts the way Encode() does and
+    adds those
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::Add( size_t sensor, long long timeMicroseconds, const TempHumidityData& data )
+{
+    unsigned char frame[ Honeywell6130Sensor::FRAME_SIZE ];
+
+    Honeywell6130Sensor::Encode( data, frame );
+
+    AddCounts( sensor,
+               timeMicroseconds,
+               ( ( unsigned int ) frame[ 2 ] << 6 ) | ( frame[ 3 ] >> 2 ),
+               ( ( unsigned int ) ( frame[ 0 ] & 0x3f ) << 8 ) | frame[ 1 ] );
+}
+
+/*======================================================================
+FUNCTION:
+    AddCounts()
+
+DESCRIPTION:
+    Updates the sensor's tumbling window, handing the previous one
+    out first if this reading starts a new one, then its sliding
+    window.  A reading older than the open tumbling window is
+    counted in it rather than reopening a finished one.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::AddCounts( size_t sensor, long long timeMicroseconds, unsigned int temperature, unsigned int humidity )
+{
+    if ( _sensors.size() <= sensor )
+    {
+        return;
+    }
+
+    SensorWindows& windows = *_sensors[ sensor ];
+
+    temperature &= 0x3fff;
+    humidity    &= 0x3fff;
+
+    ++_updates;
+
+    if ( 0 < _tumblingMicroseconds )
+    {
+        long long offset = timeMicroseconds % _tumblingMicroseconds;
+
+        long long start = timeMicroseconds - ( ( offset < 0 ) ? offset + _tumblingMicroseconds : offset );
+
+        if ( 0 != windows.tumbling.temperature.Readings() && windows.tumbling.startMicroseconds < start )
+        {
+            emitTumbling( windows );
+        }
+
+        if ( 0 == windows.tumbling.temperature.Readings() )
+        {
+            windows.tumbling.startMicroseconds = start;
+            windows.tumbling.endMicroseconds   = start + _tumblingMicroseconds;
+        }
+
+        windows.tumbling.temperature.Add( temperature );
+        windows.tumbling.humidity.Add( humidity );
+    }
+
+    if ( 0 < _slidingMicroseconds )
+    {
+        addSliding( windows, timeMicroseconds, temperature, humidity );
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    Sliding()
+
+DESCRIPTION:
+    Points window at the sensor's sliding window
+
+RETURN VALUE:
+    bool - false if there is none
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+bool WindowAggregator::Sliding( size_t sensor, const WindowSummary*& window ) const
+{
+    if ( _slidingMicroseconds <= 0 || _sensors.size() <= sensor || 0 == _sensors[ sensor ]->ringSize )
+    {
+        return false;
+    }
+
+    window = &_sensors[ sensor ]->sliding;
+
+    return true;
+}
+
+/*======================================================================
+FUNCTION:
+    FlushTumbling()
+
+DESCRIPTION:
+    Hands out every tumbling window that has readings
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::FlushTumbling()
+{
+    for ( size_t s = 0; s < _sensors.size(); ++s )
+    {
+        if ( 0 != _sensors[ s ]->tumbling.temperature.Readings() )
+        {
+            emitTumbling( *_sensors[ s ] );
+        }
+    }
+}
+
+/*======================================================================
+FUNCTION:
+    emitTumbling()
+
+DESCRIPTION:
+    Hands the finished window to the handler and clears it
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::emitTumbling( SensorWindows& windows )
+{
+    ++_windows;
+
+    if ( _handler )
+    {
+        _handler( windows.tumbling );
+    }
+
+    windows.tumbling.temperature.Clear();
+    windows.tumbling.humidity.Clear();
+}
+
+/*======================================================================
+FUNCTION:
+    addSliding()
+
+DESCRIPTION:
+    Puts the reading in the ring and the deques, then lets go of
+    everything that has fallen out of the window.  The extremes
+    are the fronts of the deques.
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::addSliding( SensorWindows& windows, long long timeMicroseconds, unsigned int temperature, unsigned int humidity )
+{
+    if ( _slidingCapacity == windows.ringSize )
+    {
+        evictSliding( windows );
+        ++_slidingOverflows;
+    }
+
+    uint32_t position = ( uint32_t ) ( ( windows.ringHead + windows.ringSize ) & ( _slidingCapacity - 1 ) );
+
+    SlidingEntry& entry = windows.ring[ position ];
+
+    entry.timeMicroseconds = timeMicroseconds;
+    entry.temperature      = ( uint16_t ) temperature;
+    entry.humidity         = ( uint16_t ) humidity;
+
+    ++windows.ringSize;
+
+    windows.sliding.temperature.Add( temperature );
+    windows.sliding.humidity.Add( humidity );
+
+    windows.minTemperature.Push( position, temperature );
+    windows.maxTemperature.Push( position, temperature );
+    windows.minHumidity.Push( position, humidity );
+    windows.maxHumidity.Push( position, humidity );
+
+    // The window is ( now - length, now ]; the newest reading always
+    // stays
+    long long cutoff = timeMicroseconds - _slidingMicroseconds;
+
+    while ( windows.ring[ windows.ringHead ].timeMicroseconds <= cutoff )
+    {
+        evictSliding( windows );
+    }
+
+    windows.sliding.startMicroseconds = windows.ring[ windows.ringHead ].timeMicroseconds;
+    windows.sliding.endMicroseconds   = timeMicroseconds;
+
+    windows.sliding.temperature._min = windows.minTemperature.Front();
+    windows.sliding.temperature._max = windows.maxTemperature.Front();
+    windows.sliding.humidity._min    = windows.minHumidity.Front();
+    windows.sliding.humidity._max    = windows.maxHumidity.Front();
+}
+
+/*======================================================================
+FUNCTION:
+    evictSliding()
+
+DESCRIPTION:
+    Takes the oldest reading out of the sliding window
+
+RETURN VALUE:
+    none.
+
+SIDE EFFECTS:
+    none
+
+======================================================================*/
+void WindowAggregator::evictSliding( SensorWindows& windows )
+{
+    uint32_t position = ( uint32_t ) windows.ringHead;
+
+    const SlidingEntry& entry = windows.ring[ position ];
+
+    windows.sliding.temperature.Remove( entry.temperature );
+    windows.sliding.humidity.Remove( entry.humidity );
+
+    windows.minTemperature.Evict( position );
+    windows.maxTemperature.Evict( position );
+    windows.minHumidity.Evict( position );
+    windows.maxHumidity.Evict( position );
+
+    windows.ringHead = ( windows.ringHead + 1 ) & ( _slidingCapacity - 1 );
+    --windows.ringSize;
+}
+
+/*=====================================================================
+// IMPLEMENTATION NOTES
+//=====================================================================
+
+A tumbling window is aligned to multiples of its length from the epoch,
+so every sensor, shard and process agrees on where the minutes and
+hours start and their windows can be merged by start time.
+
+An update is a few adds and compares plus one histogram bin; clearing
+a window afterwards touches only the bins its readings landed in, which
+for a slowly changing quantity is a handful.
+
+=====================================================================*/
@@ -0,0 +1,585 @@
+#ifndef _WINDOWAGGREGATOR_H_
+#define _WINDOWAGGREGATOR_H_
+
+/*======================================================================
+FILE:
+    windowaggregator.h
+
+CREATOR:
+    Sean Foley
+    coding at sean[removethis]foleydotcom
+
+SERVICES:
+    Rolls readings up into per-sensor windows (count, mean,
+    standard deviation, min, max and percentiles) as they arrive.
+
+DESCRIPTION:
+    This header defines an incremental aggregation stage.  Every
+    reading updates a tumbling window (fixed, back to back periods
+    such as each minute) and, optionally, a sliding window (the
+    last N seconds) for temperature and humidity in constant time:
+    Welford's running mean and variance, monotonic deques for the
+    sliding minimum and maximum, and a fixed bin histogram of the
+    counts for the percentiles.  Window results can be merged, so
+    rollups from several sensors or shards combine exactly as if
+    one aggregator had seen all the readings.
+
+PUBLIC CLASSES AND FUNCTIONS:
+    QuantileSketch
+    ChannelSummary
+    WindowSummary
+    WindowAggregator
+
+Copyright (C) 2014 Sean Foley  All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Give back and help someone else out.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+======================================================================*/
+
+//======================================================================
+// INCLUDES AND PUBLIC DATA DECLARATIONS
+//======================================================================
+
+//----------------------------------------------------------------------
+// Defines
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Include Files
+//----------------------------------------------------------------------
+
+#include "honeywell6130sensor.h"
+#include "humidiconsensor.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//----------------------------------------------------------------------
+// Type Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Constant Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//----------------------------------------------------------------------
+// Global Data Declarations
+//----------------------------------------------------------------------
+
+// None.
+
+//======================================================================
+// WARNINGS!!!
+//======================================================================
+
+// A WindowAggregator belongs to one thread; give each shard its own
+// and merge their WindowSummary results.  Everything is kept in sensor
+// counts, so the results are exact to the count and convert to units
+// only when asked.
+
+//======================================================================
+// FUNCTION DECLARATIONS
+//======================================================================
+
+// None.
+
+//======================================================================
+// CLASS DEFINITIONS
+//======================================================================
+
+/*======================================================================
+CLASS:
+    QuantileSketch
+
+DESCRIPTION:
+    A histogram of 14 bit counts in bins of 2^SHIFT counts.  Adding,
+    removing and merging are exact; a percentile is interpolated
+    within its bin, so it is off by at most a bin (0.16C or 0.1%RH
+    with the default SHIFT) and usually far less.  The bins touched
+    are tracked so clearing a window only wipes those.
+
+HOW TO USE:
+    1. Call Add() (and Remove() for sliding windows) with counts
+    2. Call Quantile() for a percentile, Merge() to combine
+
+======================================================================*/
+class QuantileSketch
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    static const unsigned int SHIFT = 4;
+
+    static const unsigned int BINS = ( 1u << 14 ) >> SHIFT;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    QuantileSketch();
+
+    void Clear();
+
+    void Add( unsigned int count )
+    {
+        unsigned int bin = count >> SHIFT;
+
+        ++_bins[ bin ];
+        ++_total;
+
+        if ( bin < _low )
+        {
+            _low = bin;
+        }
+
+        if ( _high < bin )
+        {
+            _high = bin;
+        }
+    }
+
+    // count must have been added
+    void Remove( unsigned int count )
+    {
+        --_bins[ count >> SHIFT ];
+        --_total;
+    }
+
+    void Merge( const QuantileSketch& other );
+
+    unsigned long long Total() const { return _total; }
+
+    // The count below which a fraction q (0 - 1) of the counts lie,
+    // or 0 when empty
+    unsigned int Quantile( double q ) const;
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    uint32_t _bins[ BINS ];
+
+    unsigned long long _total;
+
+    // Every non-empty bin lies in [ _low, _high ]
+    unsigned int _low;
+    unsigned int _high;
+
+};
+
+/*======================================================================
+CLASS:
+    ChannelSummary
+
+DESCRIPTION:
+    One channel (temperature or humidity) of a window, in counts:
+    the count of readings, Welford's running mean and sum of
+    squared deviations, the extremes and the sketch.  Merge() uses
+    Chan's formula for the moments, so merged results agree with
+    a single pass over all the readings to rounding.
+
+HOW TO USE:
+    1. Call Add() per reading, Merge() to combine windows
+    2. Read the results in counts, or through WindowSummary's
+       conversions
+
+======================================================================*/
+class ChannelSummary
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    ChannelSummary() { Clear(); }
+
+    void Clear();
+
+    void Add( unsigned int count )
+    {
+        double delta = count - _mean;
+
+        ++_readings;
+
+        _mean += delta / _readings;
+        _m2   += delta * ( count - _mean );
+
+        if ( count < _min )
+        {
+            _min = count;
+        }
+
+        if ( _max < count )
+        {
+            _max = count;
+        }
+
+        _sketch.Add( count );
+    }
+
+    // Takes back an Add() of count.  The extremes are left alone;
+    // the sliding window sets them from its deques.
+    void Remove( unsigned int count );
+
+    void Merge( const ChannelSummary& other );
+
+    unsigned long long Readings() const { return _readings; }
+
+    double Mean() const { return _mean; }
+
+    // Sample variance, 0 below two readings
+    double Variance() const { return ( 1 < _readings ) ? _m2 / ( _readings - 1 ) : 0; }
+
+    double StandardDeviation() const;
+
+    unsigned int Min() const { return _min; }
+
+    unsigned int Max() const { return _max; }
+
+    // Held to [ Min(), Max() ]
+    unsigned int Quantile( double q ) const;
+
+    const QuantileSketch& Sketch() const { return _sketch; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    friend class WindowAggregator;
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    unsigned long long _readings;
+
+    double _mean;
+
+    double _m2;
+
+    unsigned int _min;
+
+    unsigned int _max;
+
+    QuantileSketch _sketch;
+
+};
+
+// One window of one sensor (or several merged).  Times are those the
+// readings were stamped with: start <= time < end for a tumbling
+// window, the oldest and newest reading for a sliding one.
+struct WindowSummary
+{
+    size_t sensor;
+
+    long long startMicroseconds;
+    long long endMicroseconds;
+
+    ChannelSummary temperature;
+    ChannelSummary humidity;
+
+    // The sensor is kept; the times widen to cover both
+    void Merge( const WindowSummary& other );
+
+    // Counts to units, for a mean, extreme or percentile
+    static double Celcius( double count ) { return count * CELCIUS_PER_COUNT - Hih6130::TEMPERATURE_OFFSET; }
+
+    static double RelativeHumidity( double count ) { return count * HUMIDITY_PER_COUNT; }
+
+    // And for a standard deviation
+    static constexpr double CELCIUS_PER_COUNT  = Hih6130::TEMPERATURE_SPAN / ( ( 1u << Hih6130::TEMPERATURE_BITS ) - 1 );
+    static constexpr double HUMIDITY_PER_COUNT = Hih6130::HUMIDITY_SPAN / ( ( 1u << Hih6130::HUMIDITY_BITS ) - 1 );
+};
+
+/*======================================================================
+CLASS:
+    WindowAggregator
+
+DESCRIPTION:
+    Keeps a tumbling window and a sliding window per sensor.  A
+    tumbling window covers [ k * length, ( k + 1 ) * length ) of the
+    reading times and is handed to the handler when the first
+    reading of a later window arrives (or on FlushTumbling()).  The
+    sliding window covers the readings of the last slidingLength
+    and can be read at any time.
+
+    The sliding window keeps its readings in a ring of
+    slidingCapacity entries; if more than that arrive within the
+    length, the oldest go early and are counted in
+    SlidingOverflowCount().  Everything is allocated in the c-tor.
+
+HOW TO USE:
+    1. Construct the object with the sensor count, the lengths and
+       a handler for finished tumbling windows
+    2. Call Add() with every reading, in time order per sensor
+    3. Call Sliding() whenever the sliding window is wanted
+    4. Call FlushTumbling() at the end for the partial windows
+
+======================================================================*/
+class WindowAggregator
+{
+public:
+
+    //=================================================================
+    // TYPE DECLARATIONS AND CONSTANTS
+    //=================================================================
+
+    typedef std::function< void ( const WindowSummary& window ) > WindowHandler;
+
+    static const size_t DEFAULT_SLIDING_CAPACITY = 1024;
+
+    // Ring positions are 16 bits in the deques
+    static const size_t MAX_SLIDING_CAPACITY = 65536;
+
+    //=================================================================
+    // CLIENT INTERFACE
+    //=================================================================
+
+    // A slidingMicroseconds of 0 turns the sliding windows off
+    WindowAggregator( size_t sensorCount,
+                      long long tumblingMicroseconds,
+                      WindowHandler handler,
+                      long long slidingMicroseconds = 0,
+                      size_t slidingCapacity = DEFAULT_SLIDING_CAPACITY );
+
+    virtual ~WindowAggregator();
+
+    void Add( size_t sensor, long long timeMicroseconds, const TempHumidityData& data );
+
+    // Same, straight from the 14 bit counts
+    void AddCounts( size_t sensor, long long timeMicroseconds, unsigned int temperature, unsigned int humidity );
+
+    // The sliding window as of the last reading.  Returns false if
+    // sliding windows are off or the sensor has no readings.
+    bool Sliding( size_t sensor, const WindowSummary*& window ) const;
+
+    // Hands every open tumbling window to the handler and starts over
+    void FlushTumbling();
+
+    size_t SensorCount() const { return _sensors.size(); }
+
+    unsigned long long UpdateCount() const { return _updates; }
+
+    unsigned long long WindowCount() const { return _windows; }
+
+    unsigned long long SlidingOverflowCount() const { return _slidingOverflows; }
+
+protected:
+
+    //=================================================================
+    // SUBCLASS INTERFACE
+    //=================================================================
+
+    // None.
+
+private:
+
+    //=================================================================
+    // CUSTOMIZATION INTERFACE
+    //=================================================================
+
+    // None.
+
+    //=================================================================
+    // IMPLEMENTATION INTERFACE
+    //=================================================================
+
+    struct SlidingEntry
+    {
+        long long timeMicroseconds;
+        uint16_t temperature;
+        uint16_t humidity;
+    };
+
+    // Candidates for the sliding minimum (or maximum), oldest first,
+    // each packed as ring position << 16 | count.  Every entry is
+    // strictly better than the ones before it, so the front is the
+    // answer and each reading goes in and out once.
+    template< bool MAXIMUM >
+    struct MonotonicDeque
+    {
+        std::vector< uint32_t > slots;
+        size_t head;
+        size_t size;
+
+        void Reset( size_t capacity ) { slots.assign( capacity, 0 ); head = 0; size = 0; }
+
+        void Push( uint32_t position, unsigned int count )
+        {
+            // Drop the back while the new count is at least as good
+            while ( 0 != size )
+            {
+                unsigned int back = slots[ ( head + size - 1 ) & ( slots.size() - 1 ) ] & 0xffff;
+
+                if ( MAXIMUM ? ( count < back ) : ( back < count ) )
+                {
+                    break;
+                }
+
+                --size;
+            }
+
+            slots[ ( head + size ) & ( slots.size() - 1 ) ] = ( position << 16 ) | count;
+            ++size;
+        }
+
+        // The reading at position is leaving the window
+        void Evict( uint32_t position )
+        {
+            if ( 0 != size && ( slots[ head ] >> 16 ) == position )
+            {
+                head = ( head + 1 ) & ( slots.size() - 1 );
+                --size;
+            }
+        }
+
+        unsigned int Front() const { return slots[ head ] & 0xffff; }
+    };
+
+    struct SensorWindows
+    {
+        WindowSummary tumbling;
+
+        WindowSummary sliding;
+
+        std::vector< SlidingEntry > ring;
+        size_t ringHead;
+        size_t ringSize;
+
+        MonotonicDeque< false > minTemperature;
+        MonotonicDeque< true >  maxTemperature;
+        MonotonicDeque< false > minHumidity;
+        MonotonicDeque< true >  maxHumidity;
+    };
+
+    // No copying. Not implementing the method
+    // to force a link error if someone tries to
+    // invode a copy c-tor.
+    WindowAggregator( const WindowAggregator &rhs );
+
+    void emitTumbling( SensorWindows& windows );
+
+    void addSliding( SensorWindows& windows, long long timeMicroseconds, unsigned int temperature, unsigned int humidity );
+
+    void evictSliding( SensorWindows& windows );
+
+    //=================================================================
+    // DATA MEMBERS
+    //=================================================================
+
+    long long _tumblingMicroseconds;
+
+    long long _slidingMicroseconds;
+
+    // A power of two
+    size_t _slidingCapacity;
+
+    WindowHandler _handler;
+
+    std::vector< SensorWindows* > _sensors;
+
+    unsigned long long _updates;
+
+    unsigned long long _windows;
+
+    unsigned long long _slidingOverflows;
+
+};
+
+//======================================================================
+// INLINE FUNCTION DEFINITIONS
+//======================================================================
+
+// None.
+
+
+/*======================================================================
+// DOCUMENTATION
+========================================================================
+
+Why counts: the sensor only ever reports 16384 values per channel, so
+keeping the counts makes the extremes exact, lets the histogram bins be
+fixed and mergeable without any rebalancing, and leaves the unit
+conversion to the end, once per window instead of once per reading.
+
+A window's state is a couple of doubles and the sketch (4KB per
+channel), whatever its length.  A sliding window adds its ring and four
+deques, 32 bytes per reading of capacity.
+
+Welford's update for a reading that leaves a sliding window is the
+exact inverse of the one that added it.  With integer counts and
+windows of thousands of readings the rounding it leaves behind is far
+below a count, but a window that empties starts again from zero anyway.
+
+======================================================================*/
+
+#endif	// #ifendif _WINDOWAGGREGATOR_H_